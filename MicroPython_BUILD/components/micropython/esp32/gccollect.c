@@ -37,6 +37,21 @@
 #include "soc/cpu.h"
 #include "xtensa/hal.h"
 
+#if MICROPY_GC_PARALLEL_MARK
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#define GC_MARK_TASK_STACK_LEN (2048)
+
+extern int MainTaskCore;
+
+// The task which does the other core's part of the marking, and the
+// semaphore it gives when it's done
+static TaskHandle_t gc_mark_task = NULL;
+static SemaphoreHandle_t gc_mark_done = NULL;
+#endif
+
 
 static void gc_collect_inner(int level) {
     if (level < XCHAL_NUM_AREGS / 8) {
@@ -64,3 +79,36 @@ void gc_collect(void) {
     gc_collect_inner(0);
     gc_collect_end();
 }
+
+#if MICROPY_GC_PARALLEL_MARK
+static void gc_mark_task_entry(void *arg) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        gc_mark_helper();
+        xSemaphoreGive(gc_mark_done);
+    }
+}
+
+bool gc_mark_helper_start(void) {
+    if (gc_mark_task == NULL) {
+        // created by the first collection, on the core MicroPython doesn't run on
+        if (gc_mark_done == NULL) {
+            gc_mark_done = xSemaphoreCreateBinary();
+            if (gc_mark_done == NULL) {
+                return false;
+            }
+        }
+        if (xTaskCreatePinnedToCore(gc_mark_task_entry, "gc_mark", GC_MARK_TASK_STACK_LEN, NULL,
+                CONFIG_MICROPY_TASK_PRIORITY, &gc_mark_task, MainTaskCore ^ 1) != pdPASS) {
+            gc_mark_task = NULL;
+            return false;
+        }
+    }
+    xTaskNotifyGive(gc_mark_task);
+    return true;
+}
+
+void gc_mark_helper_wait(void) {
+    xSemaphoreTake(gc_mark_done, portMAX_DELAY);
+}
+#endif
@@ -109,7 +109,12 @@ STATIC void hw_i2c_master_writeto(machine_hw_i2c_obj_t *i2c_obj, uint16_t slave_
         if (i2c_master_stop(cmd) != ESP_OK) goto error;
     }
 
+    // the command list only holds a pointer to data, which may be a heap buffer
+    MP_THREAD_PIN(data);
+    MP_THREAD_GIL_EXIT();
     ret = i2c_master_cmd_begin(i2c_obj->bus_id, cmd, (5000 + (1000 * len)) / portTICK_RATE_MS);
+    MP_THREAD_GIL_ENTER();
+    MP_THREAD_UNPIN();
 
 error:
     i2c_cmd_link_delete(cmd);
@@ -148,7 +153,12 @@ STATIC void hw_i2c_master_readfrom(machine_hw_i2c_obj_t *i2c_obj, uint16_t slave
     if (i2c_master_read_byte(cmd, data + len - 1, I2C_NACK_VAL) != ESP_OK) {ret=8; goto error;};
     if (i2c_master_stop(cmd) != ESP_OK) {ret=8; goto error;};
 
+    // the command list only holds a pointer to data, which may be a heap buffer
+    MP_THREAD_PIN(data);
+    MP_THREAD_GIL_EXIT();
     ret = i2c_master_cmd_begin(i2c_obj->bus_id, cmd, (5000 + (1000 * len)) / portTICK_RATE_MS);
+    MP_THREAD_GIL_ENTER();
+    MP_THREAD_UNPIN();
 
 error:
     i2c_cmd_link_delete(cmd);
@@ -170,7 +180,9 @@ STATIC bool hw_i2c_slave_ping (machine_hw_i2c_obj_t *i2c_obj, uint16_t slave_add
     if (i2c_master_start(cmd) != ESP_OK) goto error;
     if (i2c_master_write_byte(cmd, (slave_addr << 1) | I2C_MASTER_WRITE, I2C_ACK_CHECK_EN) != ESP_OK) goto error;
     if (i2c_master_stop(cmd) != ESP_OK) goto error;
+    MP_THREAD_GIL_EXIT();
     ret = i2c_master_cmd_begin(i2c_obj->bus_id, cmd, 500 / portTICK_RATE_MS);
+    MP_THREAD_GIL_ENTER();
 
 error:
     i2c_cmd_link_delete(cmd);
@@ -313,7 +313,11 @@ STATIC mp_obj_t mp_machine_spi_read(size_t n_args, const mp_obj_t *args)
 		t.tx_buffer = NULL;
     }
 
+	// the transfer is polled to completion; let other threads run meanwhile,
+	// the buffers stay referenced from t and the bus is locked by the driver
+	MP_THREAD_GIL_EXIT();
 	esp_err_t ret = spi_lobo_transfer_data(self->spi, &t);
+	MP_THREAD_GIL_ENTER();
 
 	if (ret == ESP_OK) {
 	    return mp_obj_new_str_from_vstr(&mp_type_bytes, &vstr);
@@ -345,7 +349,9 @@ STATIC mp_obj_t mp_machine_spi_readinto(size_t n_args, const mp_obj_t *args)
 		t.tx_buffer = NULL;
     }
 
+	MP_THREAD_GIL_EXIT();
 	esp_err_t ret = spi_lobo_transfer_data(self->spi, &t);
+	MP_THREAD_GIL_ENTER();
 
 	if (ret == ESP_OK) return mp_const_true;
     return mp_const_false;
@@ -367,7 +373,9 @@ STATIC mp_obj_t mp_machine_spi_write(mp_obj_t self_in, mp_obj_t wr_buf)
     t.rxlength = 0;
     t.rx_buffer = NULL;
 
+	MP_THREAD_GIL_EXIT();
 	esp_err_t ret = spi_lobo_transfer_data(self->spi, &t);
+	MP_THREAD_GIL_ENTER();
 
 	if (ret == ESP_OK) return mp_const_true;
     return mp_const_false;
@@ -390,7 +398,9 @@ STATIC mp_obj_t mp_machine_spi_write_readinto(mp_obj_t self_in, mp_obj_t wr_buf,
     t.tx_buffer = src.buf;
     t.rxlength = dest.len * 8;
     t.rx_buffer = dest.buf;
+	MP_THREAD_GIL_EXIT();
 	esp_err_t ret = spi_lobo_transfer_data(self->spi, &t);
+	MP_THREAD_GIL_ENTER();
 
 	if (ret == ESP_OK) return mp_const_true;
     return mp_const_false;
@@ -436,7 +446,9 @@ STATIC mp_obj_t mp_machine_spi_read_from_mem(mp_uint_t n_args, const mp_obj_t *p
     t.rxlength = args[1].u_int * 8;
     t.rx_buffer = rdbuf;
 
+	MP_THREAD_GIL_EXIT();
 	esp_err_t ret = spi_lobo_transfer_data(self->spi, &t);
+	MP_THREAD_GIL_ENTER();
 
 	mp_obj_t res = mp_const_none;
 	if (ret == ESP_OK) {
@@ -312,7 +312,11 @@ STATIC mp_uint_t machine_uart_read(mp_obj_t self_in, void *buf_in, mp_uint_t siz
         time_to_wait = pdMS_TO_TICKS(self->timeout);
     }
 
+    MP_THREAD_PIN(buf_in);
+    MP_THREAD_GIL_EXIT();
     int bytes_read = uart_read_bytes(self->uart_num, buf_in, size, time_to_wait);
+    MP_THREAD_GIL_ENTER();
+    MP_THREAD_UNPIN();
 
     if (bytes_read < 0) {
         *errcode = MP_EAGAIN;
@@ -326,7 +330,12 @@ STATIC mp_uint_t machine_uart_read(mp_obj_t self_in, void *buf_in, mp_uint_t siz
 STATIC mp_uint_t machine_uart_write(mp_obj_t self_in, const void *buf_in, mp_uint_t size, int *errcode) {
     machine_uart_obj_t *self = MP_OBJ_TO_PTR(self_in);
 
+    // blocks while the tx ring buffer is full
+    MP_THREAD_PIN(buf_in);
+    MP_THREAD_GIL_EXIT();
     int bytes_written = uart_write_bytes(self->uart_num, buf_in, size);
+    MP_THREAD_GIL_ENTER();
+    MP_THREAD_UNPIN();
 
     if (bytes_written < 0) {
         *errcode = MP_EAGAIN;
@@ -75,6 +75,9 @@
 #define MP_TASK_PRIORITY	CONFIG_MICROPY_TASK_PRIORITY
 #define MP_TASK_STACK_SIZE	(CONFIG_MICROPY_STACK_SIZE * 1024)
 #define MP_TASK_HEAP_SIZE	(CONFIG_MICROPY_HEAP_SIZE * 1024)
+#if MICROPY_GC_SPLIT_HEAP
+#define MP_TASK_FAST_HEAP_SIZE	(CONFIG_MICROPY_GC_SPLIT_HEAP_SIZE * 1024)
+#endif
 #define MP_TASK_STACK_LEN	(MP_TASK_STACK_SIZE / sizeof(StackType_t))
 
 STATIC TaskHandle_t MainTaskHandle = NULL;
@@ -83,6 +86,9 @@ STATIC StaticTask_t DRAM_ATTR mp_task_tcb;
 STATIC StackType_t DRAM_ATTR mp_task_stack[MP_TASK_STACK_LEN] __attribute__((aligned (8)));
 #endif
 STATIC uint8_t *mp_task_heap;
+#if MICROPY_GC_SPLIT_HEAP
+STATIC uint8_t *mp_task_fast_heap;
+#endif
 
 int MainTaskCore = 0;
 
@@ -127,7 +133,11 @@ soft_reset:
 	#endif
 
     // initialize the mp heap
+    #if MICROPY_GC_SPLIT_HEAP
+    gc_init_split(mp_task_heap, mp_task_heap + MP_TASK_HEAP_SIZE, mp_task_fast_heap, mp_task_fast_heap + MP_TASK_FAST_HEAP_SIZE);
+    #else
     gc_init(mp_task_heap, mp_task_heap + MP_TASK_HEAP_SIZE);
+    #endif
 
     mp_init();
     mp_obj_list_init(mp_sys_path, 0);
@@ -180,6 +190,9 @@ soft_reset:
     machine_pins_deinit();
 
     mp_deinit();
+    #if MICROPY_EMIT_XTENSAWIN
+    esp_native_code_free_all();
+    #endif
     fflush(stdout);
     goto soft_reset;
 }
@@ -231,6 +244,16 @@ void micropython_entry(void) {
         return;
     }
 
+    #if MICROPY_GC_SPLIT_HEAP
+    // ## small objects are placed in DRAM ##
+    printf("uPY  fast heap size = %d bytes (in DRAM)\n\n", MP_TASK_FAST_HEAP_SIZE);
+    mp_task_fast_heap = heap_caps_malloc(MP_TASK_FAST_HEAP_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (mp_task_fast_heap == NULL) {
+        printf("Error allocating fast heap, Halted.\n");
+        return;
+    }
+    #endif
+
     // Workaround for possible bug in i2c driver !?
     periph_module_disable(PERIPH_I2C0_MODULE);
     periph_module_enable(PERIPH_I2C0_MODULE);
@@ -257,6 +280,103 @@ void micropython_entry(void) {
     #endif
 }
 
+#if MICROPY_EMIT_XTENSAWIN
+// Native code is assembled in a buffer on the MicroPython heap, which can't be
+// executed, so copy it to IRAM. IRAM only allows 32-bit accesses, so the heap
+// copy is kept as the function's data: the runtime reads the prelude from it
+// and the GC scans its constant table for the objects the code refers to.
+// The first word of the heap copy points to a native_code_obj_t, only
+// referenced from there, whose finaliser frees the IRAM copy once the
+// function has been collected.  IRAM copies are also linked into a list,
+// kept in IRAM where the GC doesn't look, to free those left at soft reset.
+
+typedef struct _native_iram_t {
+    struct _native_iram_t *next;
+    struct _native_iram_t **prev_next;
+    uint32_t code[];
+} native_iram_t;
+
+// MICROPY_MAKE_POINTER_CALLABLE reads code from the word after base
+typedef struct _native_code_obj_t {
+    mp_obj_base_t base;
+    void *code;
+    native_iram_t *iram;
+} native_code_obj_t;
+
+STATIC native_iram_t *native_iram_list = NULL;
+
+//-------------------------------------------------
+STATIC void native_iram_free(native_iram_t *iram) {
+    *iram->prev_next = iram->next;
+    if (iram->next != NULL) {
+        iram->next->prev_next = iram->prev_next;
+    }
+    heap_caps_free(iram);
+}
+
+//-------------------------------------------------
+STATIC mp_obj_t native_code_del(mp_obj_t self_in) {
+    native_code_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    if (self->iram != NULL) {
+        native_iram_free(self->iram);
+        self->iram = NULL;
+        self->code = NULL;
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(native_code_del_obj, native_code_del);
+
+STATIC const mp_rom_map_elem_t native_code_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR___del__), MP_ROM_PTR(&native_code_del_obj) },
+};
+STATIC MP_DEFINE_CONST_DICT(native_code_locals_dict, native_code_locals_dict_table);
+
+STATIC const mp_obj_type_t native_code_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_native,
+    .locals_dict = (mp_obj_dict_t*)&native_code_locals_dict,
+};
+
+//----------------------------------------------------
+void *esp_native_code_commit(void *buf, size_t len) {
+    native_code_obj_t *obj = m_new_obj_with_finaliser(native_code_obj_t);
+    obj->base.type = &native_code_type;
+    obj->code = NULL;
+    obj->iram = NULL;
+
+    len = (len + 3) & ~3; // the heap block is padded to at least this
+    native_iram_t *iram = heap_caps_malloc(sizeof(native_iram_t) + len, MALLOC_CAP_EXEC);
+    if (iram == NULL) {
+        m_malloc_fail(len);
+    }
+    const uint32_t *src = buf;
+    for (size_t i = 0; i < len / 4; i++) {
+        iram->code[i] = src[i];
+    }
+    iram->next = native_iram_list;
+    iram->prev_next = &native_iram_list;
+    if (native_iram_list != NULL) {
+        native_iram_list->prev_next = &iram->next;
+    }
+    native_iram_list = iram;
+    obj->code = iram->code;
+    obj->iram = iram;
+
+    // the first word is the jump over the constants, which is only executed
+    // from IRAM, so use it to keep the object which owns the IRAM copy
+    *(void**)buf = obj;
+    return buf;
+}
+
+// Frees the IRAM copies of all native code, once the heap is no longer used
+//-----------------------------------
+void esp_native_code_free_all(void) {
+    while (native_iram_list != NULL) {
+        native_iram_free(native_iram_list);
+    }
+}
+#endif
+
 //-----------------------------
 void nlr_jump_fail(void *val) {
     printf("NLR jump failed, val=%p\n", val);
@@ -477,6 +477,9 @@ STATIC mp_uint_t socket_stream_ioctl(mp_obj_t self_in, mp_uint_t request, uintpt
         if (FD_ISSET(socket->fd, &efds)) ret |= MP_STREAM_POLL_HUP;
         return ret;
     }
+    if (request == MP_STREAM_GET_FILENO) {
+        return socket->fd;
+    }
 
     *errcode = MP_EINVAL;
     return MP_STREAM_ERROR;
@@ -15,6 +15,11 @@
 
 // emitters
 #define MICROPY_PERSISTENT_CODE_LOAD        (1)
+#ifdef CONFIG_MICROPY_EMIT_NATIVE
+#define MICROPY_EMIT_XTENSAWIN              (1)
+#else
+#define MICROPY_EMIT_XTENSAWIN              (0)
+#endif
 
 // compiler configuration
 #define MICROPY_COMP_MODULE_CONST           (1)
@@ -23,11 +28,57 @@
 // optimisations
 #define MICROPY_OPT_COMPUTED_GOTO           (1)
 #define MICROPY_OPT_MPZ_BITWISE             (1)
+#define MICROPY_OPT_MPZ_KARATSUBA           (1)
+#define MICROPY_OPT_MPZ_POW3                (1)
+#define MICROPY_OPT_INLINE_CACHE            (1)
+#ifdef CONFIG_MICROPY_OPT_MAP_CACHED_HASHES
+#define MICROPY_OPT_MAP_CACHED_HASHES       (1)
+#else
+#define MICROPY_OPT_MAP_CACHED_HASHES       (0)
+#endif
+#define MICROPY_OPT_QSTR_INDEX              (1)
+#define MICROPY_OPT_STR_APPEND              (1)
+#define MICROPY_OPT_STR_FORMAT_CACHE        (1)
+#ifdef CONFIG_MICROPY_BYTES_SLICE_VIEW
+#define MICROPY_OPT_BYTES_SLICE_VIEW        (1)
+#define MICROPY_BYTES_SLICE_VIEW_MIN        (CONFIG_MICROPY_BYTES_SLICE_VIEW_MIN)
+#else
+#define MICROPY_OPT_BYTES_SLICE_VIEW        (0)
+#endif
 
 // Python internal features
 #define MICROPY_READER_VFS                  (1)
 #define MICROPY_ENABLE_GC                   (1)
 #define MICROPY_ENABLE_FINALISER            (1)
+#ifdef CONFIG_MICROPY_GC_NURSERY
+#define MICROPY_GC_NURSERY                  (1)
+#define MICROPY_GC_NURSERY_SIZE             (CONFIG_MICROPY_GC_NURSERY_SIZE * 1024)
+#else
+#define MICROPY_GC_NURSERY                  (0)
+#endif
+#ifdef CONFIG_MICROPY_GC_INCREMENTAL
+#define MICROPY_GC_INCREMENTAL              (1)
+#define MICROPY_GC_INCREMENTAL_BUDGET_US    (CONFIG_MICROPY_GC_INCREMENTAL_BUDGET)
+#else
+#define MICROPY_GC_INCREMENTAL              (0)
+#endif
+#define MICROPY_GC_FREE_LISTS               (1)
+#ifdef CONFIG_MICROPY_GC_SPLIT_HEAP
+#define MICROPY_GC_SPLIT_HEAP               (1)
+#else
+#define MICROPY_GC_SPLIT_HEAP               (0)
+#endif
+#ifdef CONFIG_MICROPY_GC_COMPACT
+#define MICROPY_GC_COMPACT                  (1)
+#define MICROPY_GC_COMPACT_THRESHOLD        (CONFIG_MICROPY_GC_COMPACT_THRESHOLD * 1024)
+#else
+#define MICROPY_GC_COMPACT                  (0)
+#endif
+#ifdef CONFIG_MICROPY_GC_PARALLEL_MARK
+#define MICROPY_GC_PARALLEL_MARK            (1)
+#else
+#define MICROPY_GC_PARALLEL_MARK            (0)
+#endif
 #define MICROPY_STACK_CHECK                 (1)
 #define MICROPY_ENABLE_EMERGENCY_EXCEPTION_BUF (1)
 #define MICROPY_KBD_EXCEPTION               (1)
@@ -39,6 +90,7 @@
 #define MICROPY_ERROR_REPORTING             (MICROPY_ERROR_REPORTING_NORMAL)
 #define MICROPY_WARNINGS                    (1)
 #define MICROPY_FLOAT_IMPL                  (MICROPY_FLOAT_IMPL_DOUBLE)
+#define MICROPY_FLOAT_EXACT_CONV            (1)
 #define MICROPY_PY_BUILTINS_COMPLEX         (1)
 #define MICROPY_CPYTHON_COMPAT              (1)
 #define MICROPY_STREAMS_NON_BLOCK           (1)
@@ -53,7 +105,12 @@
 #define MICROPY_USE_INTERNAL_PRINTF         (0) // ESP32 SDK requires its own printf
 #define MICROPY_PY_SYS_EXC_INFO             (1)
 #define MICROPY_ENABLE_SCHEDULER            (1)
-#define MICROPY_SCHEDULER_DEPTH             (8)
+#ifdef CONFIG_MICROPY_SCHEDULER_DEPTH
+#define MICROPY_SCHEDULER_DEPTH             (CONFIG_MICROPY_SCHEDULER_DEPTH)
+#else
+#define MICROPY_SCHEDULER_DEPTH             (16)
+#endif
+#define MICROPY_SCHEDULER_PRIORITIES        (2)
 
 #define MICROPY_VFS                         (1) // !! DO NOT CHANGE, MUST BE 1 !!
 #define MICROPY_VFS_FAT                     (0) // !! DO NOT CHANGE, NOT USED  !!
@@ -89,6 +146,16 @@
 #define MICROPY_PY_BUILTINS_HELP_MODULES    (1)
 #define MICROPY_PY___FILE__                 (1)
 #define MICROPY_PY_MICROPYTHON_MEM_INFO     (1)
+#ifdef CONFIG_MICROPY_HEAP_PROFILE
+#define MICROPY_PY_MICROPYTHON_HEAP_PROFILE (1)
+#else
+#define MICROPY_PY_MICROPYTHON_HEAP_PROFILE (0)
+#endif
+#ifdef CONFIG_MICROPY_PROFILE
+#define MICROPY_PY_MICROPYTHON_PROFILE      (1)
+#else
+#define MICROPY_PY_MICROPYTHON_PROFILE      (0)
+#endif
 #define MICROPY_PY_ARRAY                    (1)
 #define MICROPY_PY_ARRAY_SLICE_ASSIGN       (1)
 #define MICROPY_PY_ATTRTUPLE                (1)
@@ -111,15 +178,23 @@
 #define MICROPY_PY_SYS_STDIO_BUFFER         (1)
 #define MICROPY_PY_UERRNO                   (1)
 #define MICROPY_PY_USELECT                  (1)
+#define MICROPY_PY_USELECT_SELECT_FD        (1)
+#define MICROPY_PY_USELECT_SELECT_FD_H      "lwip/sockets.h"
 #define MICROPY_PY_UTIME_MP_HAL             (1)
 #ifdef CONFIG_MICROPY_USE_THREADS
 #define MICROPY_PY_THREAD                   (1)
 #define MICROPY_PY_THREAD_GIL               (1)
+#define MICROPY_PY_THREAD_CHANNEL           (1)
 #else
 #define MICROPY_PY_THREAD                   (0)
 #define MICROPY_PY_THREAD_GIL               (0)
 #endif
 #define MICROPY_PY_THREAD_GIL_VM_DIVISOR    (32)
+#ifdef CONFIG_MICROPY_THREAD_SWITCH_INTERVAL
+#define MICROPY_PY_THREAD_GIL_SWITCH_INTERVAL (CONFIG_MICROPY_THREAD_SWITCH_INTERVAL)
+#define MICROPY_PY_THREAD_GIL_PRIORITY()    mp_thread_priority()
+#define MICROPY_PY_THREAD_GIL_YIELD()       mp_thread_yield()
+#endif
 
 // extended modules
 #define MICROPY_PY_UCTYPES                  (1)
@@ -128,6 +203,7 @@
 #define MICROPY_PY_URE                      (1)
 #define MICROPY_PY_UHEAPQ                   (1)
 #define MICROPY_PY_UTIMEQ                   (1)
+#define MICROPY_PY_UASYNCIO                 (1)
 #define MICROPY_PY_UHASHLIB                 (0) // We use the ESP32 version
 #define MICROPY_PY_UHASHLIB_SHA1            (MICROPY_PY_USSL && MICROPY_SSL_AXTLS)
 #define MICROPY_PY_UBINASCII                (1)
@@ -291,7 +367,17 @@ extern const struct _mp_obj_module_t mp_module_gsm;
 
 // type definitions for the specific machine
 #define BYTES_PER_WORD (4)
+#if MICROPY_EMIT_XTENSAWIN
+// native code is assembled in the heap and then copied to IRAM to be run,
+// see esp_native_code_commit; the first word of the heap copy points to an
+// object which holds the address of the IRAM copy after its type
+void *esp_native_code_commit(void *buf, size_t len);
+void esp_native_code_free_all(void);
+#define MP_PLAT_COMMIT_EXEC(buf, len) esp_native_code_commit(buf, len)
+#define MICROPY_MAKE_POINTER_CALLABLE(p) (((void**)*(void**)(p))[1])
+#else
 #define MICROPY_MAKE_POINTER_CALLABLE(p) ((void*)((mp_uint_t)(p)))
+#endif
 #define MP_PLAT_PRINT_STRN(str, len) mp_hal_stdout_tx_strn_cooked(str, len)
 #define MP_SSIZE_MAX (0x7fffffff)
 
@@ -302,11 +388,30 @@ extern const struct _mp_obj_module_t mp_module_gsm;
 #define MICROPY_BEGIN_ATOMIC_SECTION() portENTER_CRITICAL_NESTED()
 #define MICROPY_END_ATOMIC_SECTION(state) portEXIT_CRITICAL_NESTED(state)
 
+// the task queueing a callback may be waiting to run on this core
+#define MICROPY_SCHEDULER_RESIZE_WAIT() \
+    do { \
+        extern void vTaskDelay(const TickType_t); \
+        vTaskDelay(1); \
+    } while (0)
+
+// do some incremental GC work while waiting
+#if MICROPY_GC_INCREMENTAL
+#define MICROPY_GC_POLL_HOOK \
+    do { \
+        extern void gc_collect_poll(void); \
+        gc_collect_poll(); \
+    } while (0)
+#else
+#define MICROPY_GC_POLL_HOOK
+#endif
+
 #if MICROPY_PY_THREAD
 #define MICROPY_EVENT_POLL_HOOK \
     do { \
         extern void mp_handle_pending(void); \
         mp_handle_pending(); \
+        MICROPY_GC_POLL_HOOK; \
         MP_THREAD_GIL_EXIT(); \
         vTaskDelay(1); \
         MP_THREAD_GIL_ENTER(); \
@@ -316,6 +421,7 @@ extern const struct _mp_obj_module_t mp_module_gsm;
     do { \
         extern void mp_handle_pending(void); \
         mp_handle_pending(); \
+        MICROPY_GC_POLL_HOOK; \
         asm("waiti 0"); \
     } while (0);
 #endif
@@ -273,6 +273,19 @@ void *mp_thread_create(void *(*entry)(void*), void *arg, size_t *stack_size, cha
 //---------------------------------------
 STATIC void mp_clean_thread(thread_t *th)
 {
+	#if MICROPY_PY_THREAD_CHANNEL || (MICROPY_PY_THREAD_GIL && MICROPY_PY_THREAD_GIL_SWITCH_INTERVAL)
+	mp_state_thread_t *ts = pvTaskGetThreadLocalStoragePointer(th->id, 1);
+	if (ts != NULL) {
+		#if MICROPY_PY_THREAD_CHANNEL
+		// take it off any channel it waits on, its stack is going
+		mp_thread_chan_cancel(ts);
+		#endif
+		#if MICROPY_PY_THREAD_GIL && MICROPY_PY_THREAD_GIL_SWITCH_INTERVAL
+		// and stop counting it as waiting for the GIL
+		mp_thread_gil_cancel(ts);
+		#endif
+	}
+	#endif
 	if (th->threadQueue) {
 		int n = 1;
 		while (n) {
@@ -316,6 +329,45 @@ void mp_thread_mutex_unlock(mp_thread_mutex_t *mutex) {
     xSemaphoreGive(mutex->handle);
 }
 
+//---------------------------------------------
+void mp_thread_sem_init(mp_thread_sem_t *sem) {
+    sem->handle = xSemaphoreCreateBinaryStatic(&sem->buffer);
+}
+
+// Returns 1 once the semaphore is posted, 0 if it wasn't within timeout_ms
+// (rounded up to whole ticks); a negative timeout waits forever
+//------------------------------------------------------------
+int mp_thread_sem_wait(mp_thread_sem_t *sem, int timeout_ms) {
+    TickType_t ticks = portMAX_DELAY;
+    if (timeout_ms >= 0) {
+        ticks = (timeout_ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+    }
+    return (pdTRUE == xSemaphoreTake(sem->handle, ticks));
+}
+
+//---------------------------------------------
+void mp_thread_sem_post(mp_thread_sem_t *sem) {
+    xSemaphoreGive(sem->handle);
+}
+
+//-----------------------------------------------
+void mp_thread_sem_deinit(mp_thread_sem_t *sem) {
+    vSemaphoreDelete(sem->handle);
+}
+
+// Priority of the calling thread, for the GIL handover
+//----------------------------
+int mp_thread_priority(void) {
+    return uxTaskPriorityGet(NULL);
+}
+
+// Let a thread of the same priority which is waiting for the just released
+// GIL run; the mutex handover only switches to a higher priority one
+//--------------------------
+void mp_thread_yield(void) {
+    taskYIELD();
+}
+
 //---------------------------
 void mp_thread_deinit(void) {
     mp_thread_mutex_lock(&thread_mutex, 1);
@@ -82,6 +82,12 @@ typedef struct _mp_thread_mutex_t {
     StaticSemaphore_t buffer;
 } mp_thread_mutex_t;
 
+// binary semaphore, which any thread may post
+typedef struct _mp_thread_sem_t {
+    SemaphoreHandle_t handle;
+    StaticSemaphore_t buffer;
+} mp_thread_sem_t;
+
 #define THREAD_NAME_MAX_SIZE		16
 #define THREAD_MGG_BROADCAST		0xFFFFEEEE
 #define THREAD_MSG_TYPE_NONE		0
@@ -122,6 +128,13 @@ void mp_thread_init(void);
 void mp_thread_gc_others(void);
 void mp_thread_deinit(void);
 
+void mp_thread_sem_init(mp_thread_sem_t *sem);
+int mp_thread_sem_wait(mp_thread_sem_t *sem, int timeout_ms);
+void mp_thread_sem_post(mp_thread_sem_t *sem);
+void mp_thread_sem_deinit(mp_thread_sem_t *sem);
+
+int mp_thread_priority(void);
+void mp_thread_yield(void);
 void mp_thread_allowsuspend(int allow);
 int mp_thread_suspend(TaskHandle_t id);
 int mp_thread_resume(TaskHandle_t id);
@@ -32,6 +32,7 @@
 #include "uart.h"
 
 #include "py/mpstate.h"
+#include "py/runtime.h"
 #include "py/mphal.h"
 
 STATIC void uart_irq_handler(void *arg);
@@ -68,9 +69,7 @@ STATIC void IRAM_ATTR uart_irq_handler(void *arg)
 			// inline version of mp_keyboard_interrupt();
 			MP_STATE_VM(mp_pending_exception) = MP_OBJ_FROM_PTR(&MP_STATE_VM(mp_kbd_exception));
 			#if MICROPY_ENABLE_SCHEDULER
-			if (MP_STATE_VM(sched_state) == MP_SCHED_IDLE) {
-				MP_STATE_VM(sched_state) = MP_SCHED_PENDING;
-			}
+			mp_sched_set_pending();
 			#endif
 		}
 		else {
@@ -35,6 +35,12 @@
 #include "py/stream.h"
 #include "py/mperrno.h"
 #include "py/mphal.h"
+#include "py/mpthread.h"
+#include "extmod/moduselect.h"
+
+#if MICROPY_PY_USELECT_SELECT_FD
+#include MICROPY_PY_USELECT_SELECT_FD_H
+#endif
 
 // Flags for poll()
 #define FLAG_ONESHOT (1)
@@ -43,14 +49,7 @@
 ///
 /// This module provides the select function.
 
-typedef struct _poll_obj_t {
-    mp_obj_t obj;
-    mp_uint_t (*ioctl)(mp_obj_t obj, mp_uint_t request, mp_uint_t arg, int *errcode);
-    mp_uint_t flags;
-    mp_uint_t flags_ret;
-} poll_obj_t;
-
-STATIC void poll_map_add(mp_map_t *poll_map, const mp_obj_t *obj, mp_uint_t obj_len, mp_uint_t flags, bool or_flags) {
+void mp_poll_map_add(mp_map_t *poll_map, const mp_obj_t *obj, mp_uint_t obj_len, mp_uint_t flags, bool or_flags) {
     for (mp_uint_t i = 0; i < obj_len; i++) {
         mp_map_elem_t *elem = mp_map_lookup(poll_map, mp_obj_id(obj[i]), MP_MAP_LOOKUP_ADD_IF_NOT_FOUND);
         if (elem->value == NULL) {
@@ -74,7 +73,7 @@ STATIC void poll_map_add(mp_map_t *poll_map, const mp_obj_t *obj, mp_uint_t obj_
 }
 
 // poll each object in the map
-STATIC mp_uint_t poll_map_poll(mp_map_t *poll_map, mp_uint_t *rwx_num) {
+mp_uint_t mp_poll_map_poll(mp_map_t *poll_map, mp_uint_t *rwx_num) {
     mp_uint_t n_ready = 0;
     for (mp_uint_t i = 0; i < poll_map->alloc; ++i) {
         if (!MP_MAP_SLOT_IS_FILLED(poll_map, i)) {
@@ -110,8 +109,58 @@ STATIC mp_uint_t poll_map_poll(mp_map_t *poll_map, mp_uint_t *rwx_num) {
     return n_ready;
 }
 
+// Blocks, with the GIL released, until one of the objects may be ready or
+// timeout_ms pass (< 0 waits forever); call mp_poll_map_poll() after it to
+// see which.  Returns false without blocking if an object has no file
+// descriptor to wait on, in which case the caller has to keep polling.
+bool mp_poll_map_wait(mp_map_t *poll_map, mp_int_t timeout_ms) {
+    #if MICROPY_PY_USELECT_SELECT_FD
+    fd_set rfds, wfds, efds;
+    FD_ZERO(&rfds);
+    FD_ZERO(&wfds);
+    FD_ZERO(&efds);
+    int max_fd = -1;
+    for (mp_uint_t i = 0; i < poll_map->alloc; ++i) {
+        if (!MP_MAP_SLOT_IS_FILLED(poll_map, i)) {
+            continue;
+        }
+        poll_obj_t *poll_obj = (poll_obj_t*)poll_map->table[i].value;
+        int errcode;
+        mp_int_t fd = poll_obj->ioctl(poll_obj->obj, MP_STREAM_GET_FILENO, 0, &errcode);
+        if (fd < 0 || fd >= FD_SETSIZE) {
+            return false;
+        }
+        if (poll_obj->flags & MP_STREAM_POLL_RD) {
+            FD_SET(fd, &rfds);
+        }
+        if (poll_obj->flags & MP_STREAM_POLL_WR) {
+            FD_SET(fd, &wfds);
+        }
+        FD_SET(fd, &efds);
+        if (fd > max_fd) {
+            max_fd = fd;
+        }
+    }
+    struct timeval tv, *tvp = NULL;
+    if (timeout_ms >= 0) {
+        tv.tv_sec = timeout_ms / 1000;
+        tv.tv_usec = (timeout_ms % 1000) * 1000;
+        tvp = &tv;
+    }
+    // an error, or a signal, just ends the wait early
+    MP_THREAD_GIL_EXIT();
+    select(max_fd + 1, &rfds, &wfds, &efds, tvp);
+    MP_THREAD_GIL_ENTER();
+    return true;
+    #else
+    (void)poll_map;
+    (void)timeout_ms;
+    return false;
+    #endif
+}
+
 /// \function select(rlist, wlist, xlist[, timeout])
-STATIC mp_obj_t select_select(uint n_args, const mp_obj_t *args) {
+STATIC mp_obj_t select_select(size_t n_args, const mp_obj_t *args) {
     // get array data from tuple/list arguments
     size_t rwx_len[3];
     mp_obj_t *r_array, *w_array, *x_array;
@@ -137,15 +186,15 @@ STATIC mp_obj_t select_select(uint n_args, const mp_obj_t *args) {
     // merge separate lists and get the ioctl function for each object
     mp_map_t poll_map;
     mp_map_init(&poll_map, rwx_len[0] + rwx_len[1] + rwx_len[2]);
-    poll_map_add(&poll_map, r_array, rwx_len[0], MP_STREAM_POLL_RD, true);
-    poll_map_add(&poll_map, w_array, rwx_len[1], MP_STREAM_POLL_WR, true);
-    poll_map_add(&poll_map, x_array, rwx_len[2], MP_STREAM_POLL_ERR | MP_STREAM_POLL_HUP, true);
+    mp_poll_map_add(&poll_map, r_array, rwx_len[0], MP_STREAM_POLL_RD, true);
+    mp_poll_map_add(&poll_map, w_array, rwx_len[1], MP_STREAM_POLL_WR, true);
+    mp_poll_map_add(&poll_map, x_array, rwx_len[2], MP_STREAM_POLL_ERR | MP_STREAM_POLL_HUP, true);
 
     mp_uint_t start_tick = mp_hal_ticks_ms();
     rwx_len[0] = rwx_len[1] = rwx_len[2] = 0;
     for (;;) {
         // poll the objects
-        mp_uint_t n_ready = poll_map_poll(&poll_map, rwx_len);
+        mp_uint_t n_ready = mp_poll_map_poll(&poll_map, rwx_len);
 
         if (n_ready > 0 || (timeout != -1 && mp_hal_ticks_ms() - start_tick >= timeout)) {
             // one or more objects are ready, or we had a timeout
@@ -190,7 +239,7 @@ typedef struct _mp_obj_poll_t {
 } mp_obj_poll_t;
 
 /// \method register(obj[, eventmask])
-STATIC mp_obj_t poll_register(uint n_args, const mp_obj_t *args) {
+STATIC mp_obj_t poll_register(size_t n_args, const mp_obj_t *args) {
     mp_obj_poll_t *self = args[0];
     mp_uint_t flags;
     if (n_args == 3) {
@@ -198,7 +247,7 @@ STATIC mp_obj_t poll_register(uint n_args, const mp_obj_t *args) {
     } else {
         flags = MP_STREAM_POLL_RD | MP_STREAM_POLL_WR;
     }
-    poll_map_add(&self->poll_map, &args[1], 1, flags, false);
+    mp_poll_map_add(&self->poll_map, &args[1], 1, flags, false);
     return mp_const_none;
 }
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(poll_register_obj, 2, 3, poll_register);
@@ -224,7 +273,7 @@ STATIC mp_obj_t poll_modify(mp_obj_t self_in, mp_obj_t obj_in, mp_obj_t eventmas
 }
 MP_DEFINE_CONST_FUN_OBJ_3(poll_modify_obj, poll_modify);
 
-STATIC mp_uint_t poll_poll_internal(uint n_args, const mp_obj_t *args) {
+STATIC mp_uint_t poll_poll_internal(size_t n_args, const mp_obj_t *args) {
     mp_obj_poll_t *self = args[0];
 
     // work out timeout (its given already in ms)
@@ -248,7 +297,7 @@ STATIC mp_uint_t poll_poll_internal(uint n_args, const mp_obj_t *args) {
     mp_uint_t n_ready;
     for (;;) {
         // poll the objects
-        n_ready = poll_map_poll(&self->poll_map, NULL);
+        n_ready = mp_poll_map_poll(&self->poll_map, NULL);
         if (n_ready > 0 || (timeout != -1 && mp_hal_ticks_ms() - start_tick >= timeout)) {
             break;
         }
@@ -258,7 +307,7 @@ STATIC mp_uint_t poll_poll_internal(uint n_args, const mp_obj_t *args) {
     return n_ready;
 }
 
-STATIC mp_obj_t poll_poll(uint n_args, const mp_obj_t *args) {
+STATIC mp_obj_t poll_poll(size_t n_args, const mp_obj_t *args) {
     mp_obj_poll_t *self = args[0];
     mp_uint_t n_ready = poll_poll_internal(n_args, args);
 
@@ -349,7 +349,9 @@ STATIC mp_obj_t native_vfs_remove(mp_obj_t vfs_in, mp_obj_t path_in) {
 		return mp_const_none;
 	}
 
+	MP_THREAD_GIL_EXIT();
 	int res = unlink(path);
+	MP_THREAD_GIL_ENTER();
 	if (res < 0) {
 		mp_raise_OSError(errno);
 		return mp_const_none;
@@ -371,7 +373,9 @@ STATIC mp_obj_t native_vfs_rmdir(mp_obj_t vfs_in, mp_obj_t path_in) {
 		return mp_const_none;
 	}
 
+	MP_THREAD_GIL_EXIT();
 	int res = rmdir(path);
+	MP_THREAD_GIL_ENTER();
 	if (res < 0) {
 		mp_raise_OSError(errno);
 		return mp_const_none;
@@ -401,7 +405,9 @@ STATIC mp_obj_t native_vfs_rename(mp_obj_t vfs_in, mp_obj_t path_in, mp_obj_t pa
 		return mp_const_none;
 	}
 
+	MP_THREAD_GIL_EXIT();
 	int res = rename(old_path, new_path);
+	MP_THREAD_GIL_ENTER();
 	/*
 	// FIXME: have to check if we can replace files with this
 	if (res < 0 && errno == EEXISTS) {
@@ -434,7 +440,9 @@ STATIC mp_obj_t native_vfs_mkdir(mp_obj_t vfs_in, mp_obj_t path_o) {
 		return mp_const_none;
 	}
 
+	MP_THREAD_GIL_EXIT();
 	int res = mkdir(path, 0755);
+	MP_THREAD_GIL_ENTER();
 	if (res < 0) {
 		mp_raise_OSError(errno);
 		return mp_const_none;
@@ -507,7 +515,11 @@ STATIC mp_obj_t native_vfs_stat(mp_obj_t vfs_in, mp_obj_t path_in) {
 		buf.st_atime = 946684800; // Jan 1, 2000
 		buf.st_mode = MP_S_IFDIR;
 	} else {
+		// the paths are in stack buffers, so the GIL can be released while the
+		// file system (which has its own lock) is accessed
+		MP_THREAD_GIL_EXIT();
 		int res = stat(path, &buf);
+		MP_THREAD_GIL_ENTER();
 		if (res < 0) {
 			mp_raise_OSError(errno);
 			return mp_const_none;
@@ -547,18 +559,24 @@ STATIC mp_obj_t native_vfs_statvfs(mp_obj_t vfs_in, mp_obj_t path_in) {
 	if (self->device == VFS_NATIVE_TYPE_SPIFLASH) {
 		#if MICROPY_USE_SPIFFS
 		uint32_t total, used;
+		MP_THREAD_GIL_EXIT();
 		spiffs_fs_stat(&total, &used);
+		MP_THREAD_GIL_ENTER();
 		f_bsize = SPIFFS_LOG_PAGE_SIZE;
 		f_blocks = total / SPIFFS_LOG_PAGE_SIZE;
 		f_bfree = (total-used) / SPIFFS_LOG_PAGE_SIZE;
 		maxlfn = MAXNAMLEN;
 		#else
+		MP_THREAD_GIL_EXIT();
 		res = f_getfree(VFS_NATIVE_MOUNT_POINT, &fre_clust, &fatfs);
+		MP_THREAD_GIL_ENTER();
 		goto is_fat;
 		#endif
 	}
 	else if (self->device == VFS_NATIVE_TYPE_SDCARD) {
+		MP_THREAD_GIL_EXIT();
 		res = f_getfree(VFS_NATIVE_SDCARD_MOUNT_POINT, &fre_clust, &fatfs);
+		MP_THREAD_GIL_ENTER();
 #if !MICROPY_USE_SPIFFS
 is_fat:
 #endif
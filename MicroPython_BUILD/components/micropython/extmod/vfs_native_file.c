@@ -48,6 +48,7 @@
 #include "py/nlr.h"
 #include "py/runtime.h"
 #include "py/stream.h"
+#include "py/gc.h"
 #include "py/mperrno.h"
 #include "extmod/vfs_native.h"
 
@@ -73,9 +74,15 @@ STATIC void file_obj_print(const mp_print_t *print, mp_obj_t self_in, mp_print_k
 STATIC mp_uint_t file_obj_read(mp_obj_t self_in, void *buf, mp_uint_t size, int *errcode) {
 	pyb_file_obj_t *self = MP_OBJ_TO_PTR(self_in);
 
-	int sz_out = read(self->fd, buf, size);
+	int fd = self->fd;
+
+	MP_THREAD_PIN(buf);
+	MP_THREAD_GIL_EXIT();
+	int sz_out = read(fd, buf, size);
+	MP_THREAD_GIL_ENTER();
+	MP_THREAD_UNPIN();
 	if (sz_out < 0) {
-		ESP_LOGD(TAG, "read(%d, buf, %d): error %d", self->fd, size, errno);
+		ESP_LOGD(TAG, "read(%d, buf, %d): error %d", fd, size, errno);
 		*errcode = errno;
 		return MP_STREAM_ERROR;
 	}
@@ -86,23 +93,25 @@ STATIC mp_uint_t file_obj_read(mp_obj_t self_in, void *buf, mp_uint_t size, int
 STATIC mp_uint_t file_obj_write(mp_obj_t self_in, const void *buf, mp_uint_t size, int *errcode) {
 	pyb_file_obj_t *self = MP_OBJ_TO_PTR(self_in);
 
-	int sz_out = write(self->fd, buf, size);
-	if (sz_out < 0) {
-		ESP_LOGD(TAG, "write(%d, buf, %d): error %d", self->fd, size, errno);
-		*errcode = errno;
-		return MP_STREAM_ERROR;
-	}
-	mp_uint_t sz_out_sum = sz_out;
+	int fd = self->fd;
+	mp_uint_t sz_out_sum = 0;
+
+	// buf is advanced below, so keep the original pointer to the buffer pinned
+	MP_THREAD_PIN(buf);
+	MP_THREAD_GIL_EXIT();
+	int sz_out = write(fd, buf, size);
 	while (sz_out > 0) {
+		sz_out_sum += sz_out;
 		buf = &((const uint8_t *) buf)[sz_out];
 		size -= sz_out;
-		sz_out = write(self->fd, buf, size);
-		if (sz_out < 0) {
-			ESP_LOGD(TAG, "write(%d, buf, %d): error %d", self->fd, size, errno);
-			*errcode = errno;
-			return MP_STREAM_ERROR;
-		}
-		sz_out_sum += sz_out;
+		sz_out = write(fd, buf, size);
+	}
+	MP_THREAD_GIL_ENTER();
+	MP_THREAD_UNPIN();
+	if (sz_out < 0) {
+		ESP_LOGD(TAG, "write(%d, buf, %d): error %d", fd, size, errno);
+		*errcode = errno;
+		return MP_STREAM_ERROR;
 	}
 
 	return sz_out_sum;
@@ -113,10 +122,20 @@ STATIC mp_obj_t file_obj_close(mp_obj_t self_in) {
 	pyb_file_obj_t *self = MP_OBJ_TO_PTR(self_in);
 	// if fs==NULL then the file is closed and in that case this method is a no-op
 	if (self->fd != -1) {
-		int res = close(self->fd);
+		int fd = self->fd;
 		self->fd = -1;
+		int res;
+		if (gc_is_locked()) {
+			// called as the finaliser, by a collection which holds the GC
+			// mutex, so another thread must not be let in to allocate
+			res = close(fd);
+		} else {
+			MP_THREAD_GIL_EXIT();
+			res = close(fd);
+			MP_THREAD_GIL_ENTER();
+		}
 		if (res < 0) {
-			ESP_LOGD(TAG, "close(%d): error %d", self->fd, errno);
+			ESP_LOGD(TAG, "close(%d): error %d", fd, errno);
 			mp_raise_OSError(errno);
 		}
 	}
@@ -138,7 +157,10 @@ STATIC mp_uint_t file_obj_ioctl(mp_obj_t o_in, mp_uint_t request, uintptr_t arg,
 	if (request == MP_STREAM_SEEK) {
 		struct mp_stream_seek_t *s = (struct mp_stream_seek_t*)(uintptr_t)arg;
 
-		off_t off = lseek(self->fd, s->offset, s->whence);
+		int fd = self->fd;
+		MP_THREAD_GIL_EXIT();
+		off_t off = lseek(fd, s->offset, s->whence);
+		MP_THREAD_GIL_ENTER();
 		if (off == (off_t)-1) {
 			ESP_LOGD(TAG, "ioctl(%d, %d, ..): error %d", self->fd, request, errno);
 			*errcode = errno;
@@ -26,6 +26,7 @@
 
 #include "py/obj.h"
 #include "py/mpstate.h"
+#include "py/runtime.h"
 
 #if MICROPY_KBD_EXCEPTION
 
@@ -41,9 +42,7 @@ void mp_hal_set_interrupt_char(int c) {
 void mp_keyboard_interrupt(void) {
     MP_STATE_VM(mp_pending_exception) = MP_OBJ_FROM_PTR(&MP_STATE_VM(mp_kbd_exception));
     #if MICROPY_ENABLE_SCHEDULER
-    if (MP_STATE_VM(sched_state) == MP_SCHED_IDLE) {
-        MP_STATE_VM(sched_state) = MP_SCHED_PENDING;
-    }
+    mp_sched_set_pending();
     #endif
 }
 
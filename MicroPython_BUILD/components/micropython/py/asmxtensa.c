@@ -30,13 +30,18 @@
 #include "py/mpconfig.h"
 
 // wrapper around everything in this file
-#if MICROPY_EMIT_XTENSA || MICROPY_EMIT_INLINE_XTENSA
+#if MICROPY_EMIT_XTENSA || MICROPY_EMIT_INLINE_XTENSA || MICROPY_EMIT_XTENSAWIN
 
 #include "py/asmxtensa.h"
 
 #define WORD_SIZE (4)
 #define SIGNED_FIT8(x) ((((x) & 0xffffff80) == 0) || (((x) & 0xffffff80) == 0xffffff80))
 #define SIGNED_FIT12(x) ((((x) & 0xfffff800) == 0) || (((x) & 0xfffff800) == 0xfffff800))
+#define SIGNED_FIT16(x) ((((x) & 0xffff8000) == 0) || (((x) & 0xffff8000) == 0xffff8000))
+
+// scratch register for address arithmetic; it's not used by the generic
+// asm API under either ABI, and is clobbered by any call anyway
+#define REG_SCRATCH ASM_XTENSA_REG_A9
 
 void asm_xtensa_end_pass(asm_xtensa_t *as) {
     as->num_const = as->cur_const;
@@ -61,15 +66,34 @@ void asm_xtensa_end_pass(asm_xtensa_t *as) {
     #endif
 }
 
-void asm_xtensa_entry(asm_xtensa_t *as, int num_locals) {
+// reg_dest = reg_src + imm, for imm up to +/-32k; uses addi and/or addmi
+STATIC void asm_xtensa_add_reg_imm(asm_xtensa_t *as, uint reg_dest, uint reg_src, int32_t imm) {
+    if (SIGNED_FIT8(imm)) {
+        asm_xtensa_op_addi(as, reg_dest, reg_src, imm);
+    } else {
+        assert(SIGNED_FIT16(imm + 128));
+        int32_t hi = (imm + 128) >> 8;
+        int32_t lo = imm - (hi << 8);
+        asm_xtensa_op_addmi(as, reg_dest, reg_src, hi);
+        if (lo != 0) {
+            asm_xtensa_op_addi(as, reg_dest, reg_dest, lo);
+        }
+    }
+}
+
+STATIC void asm_xtensa_entry_const_table(asm_xtensa_t *as) {
     // jump over the constants
     asm_xtensa_op_j(as, as->num_const * WORD_SIZE + 4 - 4);
     mp_asm_base_get_cur_to_write_bytes(&as->base, 1); // padding/alignment byte
     as->const_table = (uint32_t*)mp_asm_base_get_cur_to_write_bytes(&as->base, as->num_const * 4);
+}
+
+void asm_xtensa_entry(asm_xtensa_t *as, int num_locals) {
+    asm_xtensa_entry_const_table(as);
 
     // adjust the stack-pointer to store a0, a12, a13, a14 and locals, 16-byte aligned
     as->stack_adjust = (((4 + num_locals) * WORD_SIZE) + 15) & ~15;
-    asm_xtensa_op_addi(as, ASM_XTENSA_REG_A1, ASM_XTENSA_REG_A1, -as->stack_adjust);
+    asm_xtensa_add_reg_imm(as, ASM_XTENSA_REG_A1, ASM_XTENSA_REG_A1, -as->stack_adjust);
 
     // save return value (a0) and callee-save registers (a12, a13, a14)
     asm_xtensa_op_s32i_n(as, ASM_XTENSA_REG_A0, ASM_XTENSA_REG_A1, 0);
@@ -86,10 +110,28 @@ void asm_xtensa_exit(asm_xtensa_t *as) {
     asm_xtensa_op_l32i_n(as, ASM_XTENSA_REG_A0, ASM_XTENSA_REG_A1, 0);
 
     // restore stack-pointer and return
-    asm_xtensa_op_addi(as, ASM_XTENSA_REG_A1, ASM_XTENSA_REG_A1, as->stack_adjust);
+    asm_xtensa_add_reg_imm(as, ASM_XTENSA_REG_A1, ASM_XTENSA_REG_A1, as->stack_adjust);
     asm_xtensa_op_ret_n(as);
 }
 
+void asm_xtensa_entry_win(asm_xtensa_t *as, int num_locals) {
+    asm_xtensa_entry_const_table(as);
+
+    // the entry instruction rotates the register window and allocates the
+    // frame; it has room for the 4 words that asm_xtensa_entry saves (so that
+    // locals are at the same offsets under both ABIs) and the locals, plus the
+    // 32 bytes below the stack pointer that the window overflow handlers use
+    // to spill the registers of this function and of the call8 callees
+    as->stack_adjust = 32 + ((((4 + num_locals) * WORD_SIZE) + 15) & ~15);
+    assert(as->stack_adjust < 32768);
+    asm_xtensa_op_entry(as, ASM_XTENSA_REG_A1, as->stack_adjust);
+}
+
+void asm_xtensa_exit_win(asm_xtensa_t *as) {
+    // retw restores the caller's window and stack-pointer
+    asm_xtensa_op_retw_n(as);
+}
+
 STATIC uint32_t get_label_dest(asm_xtensa_t *as, uint label) {
     assert(label < as->base.max_num_labels);
     return as->base.label_offsets[label];
@@ -137,6 +179,34 @@ void asm_xtensa_bcc_reg_reg_label(asm_xtensa_t *as, uint cond, uint reg1, uint r
     asm_xtensa_op_bcc(as, cond, reg1, reg2, rel);
 }
 
+// These are used by the native emitter, for which a short conditional branch
+// may not reach its label.  As in asmthumb.c, a backwards branch has a known
+// size on the first pass and uses the short form if it fits, but a forwards
+// branch must assume it's far: it's emitted as the inverted short branch
+// over a j, which has an 18-bit range (we assume that's enough).
+
+void asm_xtensa_bccz_reg_label_far(asm_xtensa_t *as, uint cond, uint reg, uint label) {
+    uint32_t dest = get_label_dest(as, label);
+    int32_t rel = dest - as->base.code_offset - 4;
+    if (dest != (uint32_t)-1 && rel < 0 && SIGNED_FIT12(rel)) {
+        asm_xtensa_op_bccz(as, cond, reg, rel);
+    } else {
+        asm_xtensa_op_bccz(as, cond ^ 1, reg, 2); // skip over the following j
+        asm_xtensa_j_label(as, label);
+    }
+}
+
+void asm_xtensa_bcc_reg_reg_label_far(asm_xtensa_t *as, uint cond, uint reg1, uint reg2, uint label) {
+    uint32_t dest = get_label_dest(as, label);
+    int32_t rel = dest - as->base.code_offset - 4;
+    if (dest != (uint32_t)-1 && rel < 0 && SIGNED_FIT8(rel)) {
+        asm_xtensa_op_bcc(as, cond, reg1, reg2, rel);
+    } else {
+        asm_xtensa_op_bcc(as, cond ^ 8, reg1, reg2, 2); // skip over the following j
+        asm_xtensa_j_label(as, label);
+    }
+}
+
 // convenience function; reg_dest must be different from reg_src[12]
 void asm_xtensa_setcc_reg_reg_reg(asm_xtensa_t *as, uint cond, uint reg_dest, uint reg_src1, uint reg_src2) {
     asm_xtensa_op_movi_n(as, reg_dest, 1);
@@ -148,27 +218,57 @@ void asm_xtensa_mov_reg_i32(asm_xtensa_t *as, uint reg_dest, uint32_t i32) {
     if (SIGNED_FIT12(i32)) {
         asm_xtensa_op_movi(as, reg_dest, i32);
     } else {
-        // load the constant
-        asm_xtensa_op_l32r(as, reg_dest, as->base.code_offset, 4 + as->cur_const * WORD_SIZE);
-        // store the constant in the table
-        if (as->const_table != NULL) {
-            as->const_table[as->cur_const] = i32;
-        }
-        ++as->cur_const;
+        asm_xtensa_mov_reg_const(as, reg_dest, i32);
     }
 }
 
+// returns the offset of the constant from the start of the code, so that
+// it can be patched when the code is loaded from a .mpy file
+uint32_t asm_xtensa_mov_reg_const(asm_xtensa_t *as, uint reg_dest, uint32_t i32) {
+    uint32_t const_offset = 4 + as->cur_const * WORD_SIZE;
+    // load the constant
+    asm_xtensa_op_l32r(as, reg_dest, as->base.code_offset, const_offset);
+    // store the constant in the table
+    if (as->const_table != NULL) {
+        as->const_table[as->cur_const] = i32;
+    }
+    ++as->cur_const;
+    return const_offset;
+}
+
+// Locals are at word offset 4 onwards from the stack-pointer.  l32i/s32i
+// reach 255 words; beyond that addmi adds the offset rounded down to a
+// multiple of 256 bytes and l32i/s32i add the rest.
+
 void asm_xtensa_mov_local_reg(asm_xtensa_t *as, int local_num, uint reg_src) {
-    asm_xtensa_op_s32i(as, reg_src, ASM_XTENSA_REG_A1, 4 + local_num);
+    uint word_offset = 4 + local_num;
+    if (word_offset <= 255) {
+        asm_xtensa_op_s32i(as, reg_src, ASM_XTENSA_REG_A1, word_offset);
+    } else {
+        asm_xtensa_op_addmi(as, REG_SCRATCH, ASM_XTENSA_REG_A1, word_offset >> 6);
+        asm_xtensa_op_s32i(as, reg_src, REG_SCRATCH, word_offset & 63);
+    }
 }
 
 void asm_xtensa_mov_reg_local(asm_xtensa_t *as, uint reg_dest, int local_num) {
-    asm_xtensa_op_l32i(as, reg_dest, ASM_XTENSA_REG_A1, 4 + local_num);
+    uint word_offset = 4 + local_num;
+    if (word_offset <= 255) {
+        asm_xtensa_op_l32i(as, reg_dest, ASM_XTENSA_REG_A1, word_offset);
+    } else {
+        asm_xtensa_op_addmi(as, reg_dest, ASM_XTENSA_REG_A1, word_offset >> 6);
+        asm_xtensa_op_l32i(as, reg_dest, reg_dest, word_offset & 63);
+    }
 }
 
 void asm_xtensa_mov_reg_local_addr(asm_xtensa_t *as, uint reg_dest, int local_num) {
-    asm_xtensa_op_mov_n(as, reg_dest, ASM_XTENSA_REG_A1);
-    asm_xtensa_op_addi(as, reg_dest, reg_dest, (4 + local_num) * WORD_SIZE);
+    asm_xtensa_add_reg_imm(as, reg_dest, ASM_XTENSA_REG_A1, (4 + local_num) * WORD_SIZE);
+}
+
+void asm_xtensa_call_ind_win(asm_xtensa_t *as, void *ptr) {
+    // a8 of this function becomes a0 of the callee and is written with the
+    // return address by callx8, so it's free to hold the target address
+    asm_xtensa_mov_reg_i32(as, ASM_XTENSA_REG_A8, (uintptr_t)ptr);
+    asm_xtensa_op_callx8(as, ASM_XTENSA_REG_A8);
 }
 
-#endif // MICROPY_EMIT_XTENSA || MICROPY_EMIT_INLINE_XTENSA
+#endif // MICROPY_EMIT_XTENSA || MICROPY_EMIT_INLINE_XTENSA || MICROPY_EMIT_XTENSAWIN
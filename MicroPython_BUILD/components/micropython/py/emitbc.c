@@ -64,6 +64,15 @@ struct _emit_t {
     size_t bytecode_size;
     byte *code_base; // stores both byte code and code info
 
+    // the instruction(s) at fuse_start, if they can be fused with one that
+    // starts at fuse_end into a superinstruction
+    byte fuse_kind;
+    byte fuse_op;
+    size_t fuse_start;
+    size_t fuse_end;
+    mp_uint_t fuse_local;
+    mp_int_t fuse_small_int;
+
     #if MICROPY_PERSISTENT_CODE
     uint16_t ct_cur_obj;
     uint16_t ct_num_obj;
@@ -306,6 +315,39 @@ STATIC void emit_write_bytecode_byte_signed_label(emit_t *emit, byte b1, mp_uint
     c[2] = bytecode_offset >> 8;
 }
 
+// Superinstructions replace these sequences:
+//     LOAD_FAST, LOAD_ATTR             -> LOAD_FAST_ATTR
+//     LOAD_FAST, LOAD_METHOD           -> LOAD_FAST_METHOD
+//     LOAD_FAST, LOAD_CONST_SMALL_INT, BINARY_OP -> BINARY_OP_FAST_SMALL_INT
+//     BINARY_OP, POP_JUMP_IF_TRUE/FALSE -> BINARY_OP_POP_JUMP_IF_TRUE/FALSE
+// The first instructions are emitted as usual and, when the last one comes
+// straight after them, they are overwritten.  Nothing may sit between them,
+// so a label or a new source line cancels the fusion.
+#define FUSE_NONE (0)
+#define FUSE_LOAD_FAST (1) // fuse_local
+#define FUSE_LOAD_FAST_SMALL_INT (2) // fuse_local, fuse_small_int
+#define FUSE_BINARY_OP (3) // fuse_op
+
+STATIC void emit_bc_fuse_set(emit_t *emit, byte kind, size_t start) {
+    if (!MICROPY_OPT_FUSE_BYTECODE) {
+        return;
+    }
+    emit->fuse_kind = kind;
+    emit->fuse_start = start;
+    emit->fuse_end = emit->bytecode_offset;
+}
+
+// Returns true, and moves back to the start of the instructions to fuse, if
+// the last instructions emitted were of the given kind
+STATIC bool emit_bc_fuse(emit_t *emit, byte kind) {
+    if (emit->fuse_kind != kind || emit->fuse_end != emit->bytecode_offset) {
+        return false;
+    }
+    emit->fuse_kind = FUSE_NONE;
+    emit->bytecode_offset = emit->fuse_start;
+    return true;
+}
+
 void mp_emit_bc_start_pass(emit_t *emit, pass_kind_t pass, scope_t *scope) {
     emit->pass = pass;
     emit->stack_size = 0;
@@ -318,6 +360,7 @@ void mp_emit_bc_start_pass(emit_t *emit, pass_kind_t pass, scope_t *scope) {
     }
     emit->bytecode_offset = 0;
     emit->code_info_offset = 0;
+    emit->fuse_kind = FUSE_NONE;
 
     // Write local state size and exception stack size.
     {
@@ -476,6 +519,7 @@ void mp_emit_bc_set_source_line(emit_t *emit, mp_uint_t source_line) {
         emit_write_code_info_bytes_lines(emit, bytes_to_skip, lines_to_skip);
         emit->last_source_line_offset = emit->bytecode_offset;
         emit->last_source_line = source_line;
+        emit->fuse_kind = FUSE_NONE;
     }
 #else
     (void)emit;
@@ -485,6 +529,7 @@ void mp_emit_bc_set_source_line(emit_t *emit, mp_uint_t source_line) {
 
 void mp_emit_bc_label_assign(emit_t *emit, mp_uint_t l) {
     emit_bc_pre(emit, 0);
+    emit->fuse_kind = FUSE_NONE;
     if (emit->pass == MP_PASS_SCOPE) {
         return;
     }
@@ -530,11 +575,16 @@ void mp_emit_bc_load_const_tok(emit_t *emit, mp_token_kind_t tok) {
 
 void mp_emit_bc_load_const_small_int(emit_t *emit, mp_int_t arg) {
     emit_bc_pre(emit, 1);
+    bool fuse = emit->fuse_kind == FUSE_LOAD_FAST && emit->fuse_end == emit->bytecode_offset;
     if (-16 <= arg && arg <= 47) {
         emit_write_bytecode_byte(emit, MP_BC_LOAD_CONST_SMALL_INT_MULTI + 16 + arg);
     } else {
         emit_write_bytecode_byte_int(emit, MP_BC_LOAD_CONST_SMALL_INT, arg);
     }
+    if (fuse && -128 <= arg && arg <= 127) {
+        emit_bc_fuse_set(emit, FUSE_LOAD_FAST_SMALL_INT, emit->fuse_start);
+        emit->fuse_small_int = arg;
+    }
 }
 
 void mp_emit_bc_load_const_str(emit_t *emit, qstr qst) {
@@ -555,11 +605,16 @@ void mp_emit_bc_load_null(emit_t *emit) {
 void mp_emit_bc_load_fast(emit_t *emit, qstr qst, mp_uint_t local_num) {
     (void)qst;
     emit_bc_pre(emit, 1);
+    size_t start = emit->bytecode_offset;
     if (local_num <= 15) {
         emit_write_bytecode_byte(emit, MP_BC_LOAD_FAST_MULTI + local_num);
     } else {
         emit_write_bytecode_byte_uint(emit, MP_BC_LOAD_FAST_N, local_num);
     }
+    if (local_num <= 255) {
+        emit_bc_fuse_set(emit, FUSE_LOAD_FAST, start);
+        emit->fuse_local = local_num;
+    }
 }
 
 void mp_emit_bc_load_deref(emit_t *emit, qstr qst, mp_uint_t local_num) {
@@ -588,6 +643,11 @@ void mp_emit_bc_load_global(emit_t *emit, qstr qst) {
 
 void mp_emit_bc_load_attr(emit_t *emit, qstr qst) {
     emit_bc_pre(emit, 0);
+    if (!MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE_DYNAMIC && emit_bc_fuse(emit, FUSE_LOAD_FAST)) {
+        emit_write_bytecode_byte_qstr(emit, MP_BC_LOAD_FAST_ATTR, qst);
+        emit_write_bytecode_byte(emit, emit->fuse_local);
+        return;
+    }
     emit_write_bytecode_byte_qstr(emit, MP_BC_LOAD_ATTR, qst);
     if (MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE_DYNAMIC) {
         emit_write_bytecode_byte(emit, 0);
@@ -596,6 +656,11 @@ void mp_emit_bc_load_attr(emit_t *emit, qstr qst) {
 
 void mp_emit_bc_load_method(emit_t *emit, qstr qst, bool is_super) {
     emit_bc_pre(emit, 1 - 2 * is_super);
+    if (!is_super && emit_bc_fuse(emit, FUSE_LOAD_FAST)) {
+        emit_write_bytecode_byte_qstr(emit, MP_BC_LOAD_FAST_METHOD, qst);
+        emit_write_bytecode_byte(emit, emit->fuse_local);
+        return;
+    }
     emit_write_bytecode_byte_qstr(emit, is_super ? MP_BC_LOAD_SUPER_METHOD : MP_BC_LOAD_METHOD, qst);
 }
 
@@ -712,7 +777,10 @@ void mp_emit_bc_jump(emit_t *emit, mp_uint_t label) {
 
 void mp_emit_bc_pop_jump_if(emit_t *emit, bool cond, mp_uint_t label) {
     emit_bc_pre(emit, -1);
-    if (cond) {
+    if (emit_bc_fuse(emit, FUSE_BINARY_OP)) {
+        emit_write_bytecode_byte_signed_label(emit, cond ? MP_BC_BINARY_OP_POP_JUMP_IF_TRUE : MP_BC_BINARY_OP_POP_JUMP_IF_FALSE, label);
+        emit_write_bytecode_byte(emit, emit->fuse_op);
+    } else if (cond) {
         emit_write_bytecode_byte_signed_label(emit, MP_BC_POP_JUMP_IF_TRUE, label);
     } else {
         emit_write_bytecode_byte_signed_label(emit, MP_BC_POP_JUMP_IF_FALSE, label);
@@ -816,10 +884,22 @@ void mp_emit_bc_binary_op(emit_t *emit, mp_binary_op_t op) {
         op = MP_BINARY_OP_IS;
     }
     emit_bc_pre(emit, -1);
+    if (!invert && emit_bc_fuse(emit, FUSE_LOAD_FAST_SMALL_INT)) {
+        byte *c = emit_get_cur_to_write_bytecode(emit, 4);
+        c[0] = MP_BC_BINARY_OP_FAST_SMALL_INT;
+        c[1] = emit->fuse_local;
+        c[2] = emit->fuse_small_int;
+        c[3] = op;
+        return;
+    }
+    size_t start = emit->bytecode_offset;
     emit_write_bytecode_byte(emit, MP_BC_BINARY_OP_MULTI + op);
     if (invert) {
         emit_bc_pre(emit, 0);
         emit_write_bytecode_byte(emit, MP_BC_UNARY_OP_MULTI + MP_UNARY_OP_NOT);
+    } else {
+        emit_bc_fuse_set(emit, FUSE_BINARY_OP, start);
+        emit->fuse_op = op;
     }
 }
 
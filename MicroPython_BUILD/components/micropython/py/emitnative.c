@@ -63,6 +63,7 @@
     || (MICROPY_EMIT_THUMB && N_THUMB) \
     || (MICROPY_EMIT_ARM && N_ARM) \
     || (MICROPY_EMIT_XTENSA && N_XTENSA) \
+    || (MICROPY_EMIT_XTENSAWIN && N_XTENSAWIN) \
 
 // this is defined so that the assembler exports generic assembler API macros
 #define GENERIC_ASM_API (1)
@@ -98,10 +99,8 @@ STATIC byte mp_f_n_args[MP_F_NUMBER_OF] = {
     [MP_F_LIST_APPEND] = 2,
     [MP_F_BUILD_MAP] = 1,
     [MP_F_STORE_MAP] = 3,
-#if MICROPY_PY_BUILTINS_SET
     [MP_F_BUILD_SET] = 2,
     [MP_F_STORE_SET] = 2,
-#endif
     [MP_F_MAKE_FUNCTION_FROM_RAW_CODE] = 3,
     [MP_F_NATIVE_CALL_FUNCTION_N_KW] = 3,
     [MP_F_CALL_METHOD_N_KW] = 3,
@@ -114,9 +113,7 @@ STATIC byte mp_f_n_args[MP_F_NUMBER_OF] = {
     [MP_F_IMPORT_NAME] = 3,
     [MP_F_IMPORT_FROM] = 2,
     [MP_F_IMPORT_ALL] = 1,
-#if MICROPY_PY_BUILTINS_SLICE
     [MP_F_NEW_SLICE] = 3,
-#endif
     [MP_F_UNPACK_SEQUENCE] = 3,
     [MP_F_UNPACK_EX] = 3,
     [MP_F_DELETE_NAME] = 1,
@@ -124,6 +121,7 @@ STATIC byte mp_f_n_args[MP_F_NUMBER_OF] = {
     [MP_F_NEW_CELL] = 1,
     [MP_F_MAKE_CLOSURE_FROM_RAW_CODE] = 3,
     [MP_F_SETUP_CODE_STATE] = 5,
+    [MP_F_SETJMP] = 1,
 };
 
 #include "py/asmx86.h"
@@ -147,12 +145,48 @@ STATIC byte mp_f_n_args[MP_F_NUMBER_OF] = {
 #include "py/asmxtensa.h"
 #define EXPORT_FUN(name) emit_native_xtensa_##name
 
+#elif N_XTENSAWIN
+
+// Xtensa windowed ABI specific stuff
+#define GENERIC_ASM_API_WIN (1)
+#include "py/asmxtensa.h"
+#define EXPORT_FUN(name) emit_native_xtensawin_##name
+
 #else
 
 #error unknown native emitter
 
 #endif
 
+// The registers in which a native function receives its arguments and
+// returns its result; they only differ from REG_ARG_x and REG_RET (used
+// when calling out) for a register-window ABI
+#ifndef REG_PARENT_RET
+#define REG_PARENT_RET REG_RET
+#define REG_PARENT_ARG_1 REG_ARG_1
+#define REG_PARENT_ARG_2 REG_ARG_2
+#define REG_PARENT_ARG_3 REG_ARG_3
+#define REG_PARENT_ARG_4 REG_ARG_4
+#endif
+
+// Native code for the windowed Xtensa ABI can be saved to a .mpy file; every
+// value in it that depends on the firmware is then recorded as a link so the
+// loader can patch it, see emit_native_mov_reg_link
+#define EMIT_NATIVE_LINKS (N_XTENSAWIN && MICROPY_PERSISTENT_CODE_SAVE)
+
+// The size in words of an nlr_buf_t, and the offset of its jmpbuf, on the
+// machine that runs the code.  When cross-compiling for the ESP32 that is
+// the setjmp based nlr_buf_t of the windowed ABI, whose jmp_buf is 17 words.
+#if N_XTENSAWIN && MICROPY_DYNAMIC_COMPILER
+#define NATIVE_NLR_SETJMP (1)
+#define NLR_BUF_NUM_WORDS (2 + 17)
+#define NLR_BUF_JMPBUF_WORD (2)
+#else
+#define NATIVE_NLR_SETJMP (MICROPY_NLR_SETJMP)
+#define NLR_BUF_NUM_WORDS (sizeof(nlr_buf_t) / sizeof(mp_uint_t))
+#define NLR_BUF_JMPBUF_WORD (offsetof(nlr_buf_t, jmpbuf) / sizeof(mp_uint_t))
+#endif
+
 #define EMIT_NATIVE_VIPER_TYPE_ERROR(emit, ...) do { \
         *emit->error_slot = mp_obj_new_exception_msg_varg(&mp_type_ViperTypeError, __VA_ARGS__); \
     } while (0)
@@ -229,6 +263,12 @@ struct _emit_t {
 
     scope_t *scope;
 
+    #if EMIT_NATIVE_LINKS
+    size_t n_link;
+    size_t link_alloc;
+    mp_native_link_t *links;
+    #endif
+
     ASM_T *as;
 };
 
@@ -245,6 +285,9 @@ void EXPORT_FUN(free)(emit_t *emit) {
     m_del_obj(ASM_T, emit->as);
     m_del(vtype_kind_t, emit->local_vtype, emit->local_vtype_alloc);
     m_del(stack_info_t, emit->stack_info, emit->stack_info_alloc);
+    #if EMIT_NATIVE_LINKS
+    m_del(mp_native_link_t, emit->links, emit->link_alloc);
+    #endif
     m_del_obj(emit_t, emit);
 }
 
@@ -282,6 +325,10 @@ STATIC void emit_pre_pop_reg(emit_t *emit, vtype_kind_t *vtype, int reg_dest);
 STATIC void emit_post_push_reg(emit_t *emit, vtype_kind_t vtype, int reg);
 STATIC void emit_native_load_fast(emit_t *emit, qstr qst, mp_uint_t local_num);
 STATIC void emit_native_store_fast(emit_t *emit, qstr qst, mp_uint_t local_num);
+STATIC void emit_native_call_ind(emit_t *emit, mp_fun_kind_t fun_kind);
+#if EMIT_NATIVE_LINKS
+STATIC void emit_native_add_link(emit_t *emit, mp_uint_t offset, mp_native_link_kind_t kind, mp_uint_t arg);
+#endif
 
 #define STATE_START (sizeof(mp_code_state_t) / sizeof(mp_uint_t))
 
@@ -293,6 +340,9 @@ STATIC void emit_native_start_pass(emit_t *emit, pass_kind_t pass, scope_t *scop
     emit->stack_size = 0;
     emit->last_emit_was_return_value = false;
     emit->scope = scope;
+    #if EMIT_NATIVE_LINKS
+    emit->n_link = 0;
+    #endif
 
     // allocate memory for keeping track of the types of locals
     if (emit->local_vtype_alloc < scope->num_locals) {
@@ -379,16 +429,18 @@ STATIC void emit_native_start_pass(emit_t *emit, pass_kind_t pass, scope_t *scop
             }
         }
         #else
-        for (int i = 0; i < scope->num_pos_args; i++) {
+        // go in reverse order because under a register-window ABI the
+        // incoming args may overlap the registers used for locals
+        for (int i = scope->num_pos_args - 1; i >= 0; i--) {
             if (i == 0) {
-                ASM_MOV_REG_REG(emit->as, REG_LOCAL_1, REG_ARG_1);
+                ASM_MOV_REG_REG(emit->as, REG_LOCAL_1, REG_PARENT_ARG_1);
             } else if (i == 1) {
-                ASM_MOV_REG_REG(emit->as, REG_LOCAL_2, REG_ARG_2);
+                ASM_MOV_REG_REG(emit->as, REG_LOCAL_2, REG_PARENT_ARG_2);
             } else if (i == 2) {
-                ASM_MOV_REG_REG(emit->as, REG_LOCAL_3, REG_ARG_3);
+                ASM_MOV_REG_REG(emit->as, REG_LOCAL_3, REG_PARENT_ARG_3);
             } else {
                 assert(i == 3); // should be true; max 4 args is checked above
-                ASM_MOV_REG_TO_LOCAL(emit->as, REG_ARG_4, i - REG_LOCAL_NUM);
+                ASM_MOV_REG_TO_LOCAL(emit->as, REG_PARENT_ARG_4, i - REG_LOCAL_NUM);
             }
         }
         #endif
@@ -417,11 +469,25 @@ STATIC void emit_native_start_pass(emit_t *emit, pass_kind_t pass, scope_t *scop
         #endif
 
         // set code_state.fun_bc
-        ASM_MOV_REG_TO_LOCAL(emit->as, REG_ARG_1, offsetof(mp_code_state_t, fun_bc) / sizeof(uintptr_t));
+        ASM_MOV_REG_TO_LOCAL(emit->as, REG_PARENT_ARG_1, offsetof(mp_code_state_t, fun_bc) / sizeof(uintptr_t));
+
+        #if N_XTENSAWIN
+        // pass n_args, n_kw and args through to mp_setup_code_state
+        ASM_MOV_REG_REG(emit->as, REG_ARG_2, REG_PARENT_ARG_2);
+        ASM_MOV_REG_REG(emit->as, REG_ARG_3, REG_PARENT_ARG_3);
+        ASM_MOV_REG_REG(emit->as, REG_ARG_4, REG_PARENT_ARG_4);
+        #endif
 
         // set code_state.ip (offset from start of this function to prelude info)
         // XXX this encoding may change size
+        #if N_XTENSA || N_XTENSAWIN
+        // the prelude offset comes from the previous pass, so always load it
+        // from the constant table or that table may change size between passes
+        asm_xtensa_mov_reg_const(emit->as, REG_ARG_1, emit->prelude_offset);
+        ASM_MOV_REG_TO_LOCAL(emit->as, REG_ARG_1, offsetof(mp_code_state_t, ip) / sizeof(uintptr_t));
+        #else
         ASM_MOV_IMM_TO_LOCAL_USING(emit->as, emit->prelude_offset, offsetof(mp_code_state_t, ip) / sizeof(uintptr_t), REG_ARG_1);
+        #endif
 
         // put address of code_state into first arg
         ASM_MOV_LOCAL_ADDR_TO_REG(emit->as, 0, REG_ARG_1);
@@ -432,7 +498,7 @@ STATIC void emit_native_start_pass(emit_t *emit, pass_kind_t pass, scope_t *scop
         #elif N_ARM
         asm_arm_bl_ind(emit->as, mp_fun_table[MP_F_SETUP_CODE_STATE], MP_F_SETUP_CODE_STATE, ASM_ARM_REG_R4);
         #else
-        ASM_CALL_IND(emit->as, mp_fun_table[MP_F_SETUP_CODE_STATE], MP_F_SETUP_CODE_STATE);
+        emit_native_call_ind(emit, MP_F_SETUP_CODE_STATE);
         #endif
 
         // cache some locals in registers
@@ -507,6 +573,11 @@ STATIC void emit_native_end_pass(emit_t *emit) {
                     break;
                 }
             }
+            #if EMIT_NATIVE_LINKS
+            if (emit->pass == MP_PASS_EMIT) {
+                emit_native_add_link(emit, mp_asm_base_get_code_pos(&emit->as->base), MP_NATIVE_LINK_QSTR_OBJ, qst);
+            }
+            #endif
             mp_asm_base_data(&emit->as->base, ASM_WORD_SIZE, (mp_uint_t)MP_OBJ_NEW_QSTR(qst));
         }
 
@@ -528,9 +599,23 @@ STATIC void emit_native_end_pass(emit_t *emit) {
             type_sig |= (emit->local_vtype[i] & 0xf) << (i * 4 + 4);
         }
 
+        #if MICROPY_PERSISTENT_CODE_SAVE
+        // the links are kept with the raw code so it can be saved to a .mpy file
+        size_t n_link = 0;
+        mp_native_link_t *links = NULL;
+        #if EMIT_NATIVE_LINKS
+        n_link = emit->n_link;
+        links = m_new(mp_native_link_t, n_link);
+        memcpy(links, emit->links, n_link * sizeof(mp_native_link_t));
+        #endif
+        #endif
+
         mp_emit_glue_assign_native(emit->scope->raw_code,
             emit->do_viper_types ? MP_CODE_NATIVE_VIPER : MP_CODE_NATIVE_PY,
             f, f_len, (mp_uint_t*)((byte*)f + emit->const_table_offset),
+            #if MICROPY_PERSISTENT_CODE_SAVE
+            emit->prelude_offset, n_link, links,
+            #endif
             emit->scope->num_pos_args, emit->scope->scope_flags, type_sig);
     }
 }
@@ -596,6 +681,81 @@ STATIC vtype_kind_t peek_vtype(emit_t *emit, mp_uint_t depth) {
     return peek_stack(emit, depth)->vtype;
 }
 
+#if EMIT_NATIVE_LINKS
+STATIC void emit_native_add_link(emit_t *emit, mp_uint_t offset, mp_native_link_kind_t kind, mp_uint_t arg) {
+    if (emit->n_link >= emit->link_alloc) {
+        emit->links = m_renew(mp_native_link_t, emit->links, emit->link_alloc, emit->link_alloc + 16);
+        emit->link_alloc += 16;
+    }
+    mp_native_link_t *link = &emit->links[emit->n_link++];
+    link->offset = offset;
+    link->kind = kind;
+    link->arg = arg;
+}
+#endif
+
+// Loads val, which depends on the firmware that runs the code: the address
+// of a runtime function or of an object, or a qstr.  When saving native code
+// it always goes in the constant table and is recorded as a link, so the
+// loader of the .mpy file can patch in the value for its own firmware.
+STATIC void emit_native_mov_reg_link(emit_t *emit, int reg_dest, mp_native_link_kind_t kind, mp_uint_t arg, mp_uint_t val) {
+    #if EMIT_NATIVE_LINKS
+    mp_uint_t offset = asm_xtensa_mov_reg_const(emit->as, reg_dest, val);
+    if (emit->pass == MP_PASS_EMIT) {
+        emit_native_add_link(emit, offset, kind, arg);
+    }
+    #else
+    (void)arg;
+    if (kind == MP_NATIVE_LINK_OBJ || kind == MP_NATIVE_LINK_RAW_CODE) {
+        // pointers to the heap are stored aligned so the GC can find them
+        ASM_MOV_ALIGNED_IMM_TO_REG(emit->as, val, reg_dest);
+    } else {
+        ASM_MOV_IMM_TO_REG(emit->as, val, reg_dest);
+    }
+    #endif
+}
+
+STATIC void emit_native_mov_reg_qstr(emit_t *emit, int reg_dest, qstr qst) {
+    emit_native_mov_reg_link(emit, reg_dest, MP_NATIVE_LINK_QSTR, qst, qst);
+}
+
+// loads an object that is known at compile time
+STATIC void emit_native_mov_reg_obj(emit_t *emit, int reg_dest, mp_uint_t obj) {
+    if (MP_OBJ_IS_QSTR((mp_obj_t)obj)) {
+        emit_native_mov_reg_link(emit, reg_dest, MP_NATIVE_LINK_QSTR_OBJ, MP_OBJ_QSTR_VALUE((mp_obj_t)obj), obj);
+    } else if (obj == (mp_uint_t)mp_const_none) {
+        emit_native_mov_reg_link(emit, reg_dest, MP_NATIVE_LINK_CONST, MP_NATIVE_CONST_NONE, obj);
+    } else if (obj == (mp_uint_t)mp_const_false) {
+        emit_native_mov_reg_link(emit, reg_dest, MP_NATIVE_LINK_CONST, MP_NATIVE_CONST_FALSE, obj);
+    } else if (obj == (mp_uint_t)mp_const_true) {
+        emit_native_mov_reg_link(emit, reg_dest, MP_NATIVE_LINK_CONST, MP_NATIVE_CONST_TRUE, obj);
+    } else if (obj == (mp_uint_t)MP_ROM_PTR(&mp_const_ellipsis_obj)) {
+        emit_native_mov_reg_link(emit, reg_dest, MP_NATIVE_LINK_CONST, MP_NATIVE_CONST_ELLIPSIS, obj);
+    } else {
+        // a small int or MP_OBJ_NULL/MP_OBJ_SENTINEL, which don't need a link
+        ASM_MOV_IMM_TO_REG(emit->as, obj, reg_dest);
+    }
+}
+
+// loads the value of a stack entry of kind STACK_IMM
+STATIC void emit_native_mov_reg_stack_imm(emit_t *emit, int reg_dest, stack_info_t *si) {
+    if (si->vtype == VTYPE_PYOBJ) {
+        emit_native_mov_reg_obj(emit, reg_dest, si->data.u_imm);
+    } else {
+        ASM_MOV_IMM_TO_REG(emit->as, si->data.u_imm, reg_dest);
+    }
+}
+
+STATIC void emit_native_call_ind(emit_t *emit, mp_fun_kind_t fun_kind) {
+    #if EMIT_NATIVE_LINKS
+    // as ASM_CALL_IND, but the function address is a link
+    emit_native_mov_reg_link(emit, ASM_XTENSA_REG_A8, MP_NATIVE_LINK_FUN, fun_kind, (mp_uint_t)mp_fun_table[fun_kind]);
+    asm_xtensa_op_callx8(emit->as, ASM_XTENSA_REG_A8);
+    #else
+    ASM_CALL_IND(emit->as, mp_fun_table[fun_kind], fun_kind);
+    #endif
+}
+
 // pos=1 is TOS, pos=2 is next, etc
 // use pos=0 for no skipping
 STATIC void need_reg_single(emit_t *emit, int reg_needed, int skip_stack_pos) {
@@ -636,7 +796,8 @@ STATIC void need_stack_settled(emit_t *emit) {
         if (si->kind == STACK_IMM) {
             DEBUG_printf("    imm(" INT_FMT ") to local(%u)\n", si->data.u_imm, emit->stack_start + i);
             si->kind = STACK_VALUE;
-            ASM_MOV_IMM_TO_LOCAL_USING(emit->as, si->data.u_imm, emit->stack_start + i, REG_TEMP0);
+            emit_native_mov_reg_stack_imm(emit, REG_TEMP0, si);
+            ASM_MOV_REG_TO_LOCAL(emit->as, REG_TEMP0, emit->stack_start + i);
         }
     }
 }
@@ -658,7 +819,7 @@ STATIC void emit_access_stack(emit_t *emit, int pos, vtype_kind_t *vtype, int re
             break;
 
         case STACK_IMM:
-            ASM_MOV_IMM_TO_REG(emit->as, si->data.u_imm, reg_dest);
+            emit_native_mov_reg_stack_imm(emit, reg_dest, si);
             break;
     }
 }
@@ -759,36 +920,42 @@ STATIC void emit_post_push_reg_reg_reg_reg(emit_t *emit, vtype_kind_t vtypea, in
 
 STATIC void emit_call(emit_t *emit, mp_fun_kind_t fun_kind) {
     need_reg_all(emit);
-    ASM_CALL_IND(emit->as, mp_fun_table[fun_kind], fun_kind);
+    emit_native_call_ind(emit, fun_kind);
 }
 
 STATIC void emit_call_with_imm_arg(emit_t *emit, mp_fun_kind_t fun_kind, mp_int_t arg_val, int arg_reg) {
     need_reg_all(emit);
     ASM_MOV_IMM_TO_REG(emit->as, arg_val, arg_reg);
-    ASM_CALL_IND(emit->as, mp_fun_table[fun_kind], fun_kind);
+    emit_native_call_ind(emit, fun_kind);
 }
 
-// the first arg is stored in the code aligned on a mp_uint_t boundary
-STATIC void emit_call_with_imm_arg_aligned(emit_t *emit, mp_fun_kind_t fun_kind, mp_int_t arg_val, int arg_reg) {
+STATIC void emit_call_with_qstr_arg(emit_t *emit, mp_fun_kind_t fun_kind, qstr qst, int arg_reg) {
     need_reg_all(emit);
-    ASM_MOV_ALIGNED_IMM_TO_REG(emit->as, arg_val, arg_reg);
-    ASM_CALL_IND(emit->as, mp_fun_table[fun_kind], fun_kind);
+    emit_native_mov_reg_qstr(emit, arg_reg, qst);
+    emit_native_call_ind(emit, fun_kind);
+}
+
+// the raw code is stored in the code aligned on a mp_uint_t boundary
+STATIC void emit_call_with_raw_code_arg(emit_t *emit, mp_fun_kind_t fun_kind, mp_raw_code_t *rc, int arg_reg) {
+    need_reg_all(emit);
+    emit_native_mov_reg_link(emit, arg_reg, MP_NATIVE_LINK_RAW_CODE, (mp_uint_t)rc, (mp_uint_t)rc);
+    emit_native_call_ind(emit, fun_kind);
 }
 
 STATIC void emit_call_with_2_imm_args(emit_t *emit, mp_fun_kind_t fun_kind, mp_int_t arg_val1, int arg_reg1, mp_int_t arg_val2, int arg_reg2) {
     need_reg_all(emit);
     ASM_MOV_IMM_TO_REG(emit->as, arg_val1, arg_reg1);
     ASM_MOV_IMM_TO_REG(emit->as, arg_val2, arg_reg2);
-    ASM_CALL_IND(emit->as, mp_fun_table[fun_kind], fun_kind);
+    emit_native_call_ind(emit, fun_kind);
 }
 
-// the first arg is stored in the code aligned on a mp_uint_t boundary
-STATIC void emit_call_with_3_imm_args_and_first_aligned(emit_t *emit, mp_fun_kind_t fun_kind, mp_int_t arg_val1, int arg_reg1, mp_int_t arg_val2, int arg_reg2, mp_int_t arg_val3, int arg_reg3) {
+// the raw code is stored in the code aligned on a mp_uint_t boundary
+STATIC void emit_call_with_raw_code_and_2_imm_args(emit_t *emit, mp_fun_kind_t fun_kind, mp_raw_code_t *rc, int arg_reg1, mp_int_t arg_val2, int arg_reg2, mp_int_t arg_val3, int arg_reg3) {
     need_reg_all(emit);
-    ASM_MOV_ALIGNED_IMM_TO_REG(emit->as, arg_val1, arg_reg1);
+    emit_native_mov_reg_link(emit, arg_reg1, MP_NATIVE_LINK_RAW_CODE, (mp_uint_t)rc, (mp_uint_t)rc);
     ASM_MOV_IMM_TO_REG(emit->as, arg_val2, arg_reg2);
     ASM_MOV_IMM_TO_REG(emit->as, arg_val3, arg_reg3);
-    ASM_CALL_IND(emit->as, mp_fun_table[fun_kind], fun_kind);
+    emit_native_call_ind(emit, fun_kind);
 }
 
 // vtype of all n_pop objects is VTYPE_PYOBJ
@@ -807,14 +974,16 @@ STATIC void emit_get_stack_pointer_to_reg_for_pop(emit_t *emit, mp_uint_t reg_de
             si->kind = STACK_VALUE;
             switch (si->vtype) {
                 case VTYPE_PYOBJ:
-                    ASM_MOV_IMM_TO_LOCAL_USING(emit->as, si->data.u_imm, emit->stack_start + emit->stack_size - 1 - i, reg_dest);
+                    emit_native_mov_reg_obj(emit, reg_dest, si->data.u_imm);
+                    ASM_MOV_REG_TO_LOCAL(emit->as, reg_dest, emit->stack_start + emit->stack_size - 1 - i);
                     break;
                 case VTYPE_BOOL:
                     if (si->data.u_imm == 0) {
-                        ASM_MOV_IMM_TO_LOCAL_USING(emit->as, (mp_uint_t)mp_const_false, emit->stack_start + emit->stack_size - 1 - i, reg_dest);
+                        emit_native_mov_reg_obj(emit, reg_dest, (mp_uint_t)mp_const_false);
                     } else {
-                        ASM_MOV_IMM_TO_LOCAL_USING(emit->as, (mp_uint_t)mp_const_true, emit->stack_start + emit->stack_size - 1 - i, reg_dest);
+                        emit_native_mov_reg_obj(emit, reg_dest, (mp_uint_t)mp_const_true);
                     }
+                    ASM_MOV_REG_TO_LOCAL(emit->as, reg_dest, emit->stack_start + emit->stack_size - 1 - i);
                     si->vtype = VTYPE_PYOBJ;
                     break;
                 case VTYPE_INT:
@@ -880,7 +1049,7 @@ STATIC void emit_native_import_name(emit_t *emit, qstr qst) {
         stack_info_t *top = peek_stack(emit, 0);
         if (top->vtype == VTYPE_PTR_NONE) {
             emit_pre_pop_discard(emit);
-            ASM_MOV_IMM_TO_REG(emit->as, (mp_uint_t)mp_const_none, REG_ARG_2);
+            emit_native_mov_reg_obj(emit, REG_ARG_2, (mp_uint_t)mp_const_none);
         } else {
             vtype_kind_t vtype_fromlist;
             emit_pre_pop_reg(emit, &vtype_fromlist, REG_ARG_2);
@@ -901,7 +1070,7 @@ STATIC void emit_native_import_name(emit_t *emit, qstr qst) {
         assert(vtype_level == VTYPE_PYOBJ);
     }
 
-    emit_call_with_imm_arg(emit, MP_F_IMPORT_NAME, qst, REG_ARG_1); // arg1 = import name
+    emit_call_with_qstr_arg(emit, MP_F_IMPORT_NAME, qst, REG_ARG_1); // arg1 = import name
     emit_post_push_reg(emit, VTYPE_PYOBJ, REG_RET);
 }
 
@@ -911,7 +1080,7 @@ STATIC void emit_native_import_from(emit_t *emit, qstr qst) {
     vtype_kind_t vtype_module;
     emit_access_stack(emit, 1, &vtype_module, REG_ARG_1); // arg1 = module
     assert(vtype_module == VTYPE_PYOBJ);
-    emit_call_with_imm_arg(emit, MP_F_IMPORT_FROM, qst, REG_ARG_2); // arg2 = import name
+    emit_call_with_qstr_arg(emit, MP_F_IMPORT_FROM, qst, REG_ARG_2); // arg2 = import name
     emit_post_push_reg(emit, VTYPE_PYOBJ, REG_RET);
 }
 
@@ -980,7 +1149,7 @@ STATIC void emit_native_load_const_str(emit_t *emit, qstr qst) {
 STATIC void emit_native_load_const_obj(emit_t *emit, mp_obj_t obj) {
     emit_native_pre(emit);
     need_reg_single(emit, REG_RET, 0);
-    ASM_MOV_ALIGNED_IMM_TO_REG(emit->as, (mp_uint_t)obj, REG_RET);
+    emit_native_mov_reg_link(emit, REG_RET, MP_NATIVE_LINK_OBJ, (mp_uint_t)obj, (mp_uint_t)obj);
     emit_post_push_reg(emit, VTYPE_PYOBJ, REG_RET);
 }
 
@@ -1028,7 +1197,7 @@ STATIC void emit_native_load_deref(emit_t *emit, qstr qst, mp_uint_t local_num)
 STATIC void emit_native_load_name(emit_t *emit, qstr qst) {
     DEBUG_printf("load_name(%s)\n", qstr_str(qst));
     emit_native_pre(emit);
-    emit_call_with_imm_arg(emit, MP_F_LOAD_NAME, qst, REG_ARG_1);
+    emit_call_with_qstr_arg(emit, MP_F_LOAD_NAME, qst, REG_ARG_1);
     emit_post_push_reg(emit, VTYPE_PYOBJ, REG_RET);
 }
 
@@ -1049,7 +1218,7 @@ STATIC void emit_native_load_global(emit_t *emit, qstr qst) {
     } else if (emit->do_viper_types && qst == MP_QSTR_ptr32) {
         emit_post_push_imm(emit, VTYPE_BUILTIN_CAST, VTYPE_PTR32);
     } else {
-        emit_call_with_imm_arg(emit, MP_F_LOAD_GLOBAL, qst, REG_ARG_1);
+        emit_call_with_qstr_arg(emit, MP_F_LOAD_GLOBAL, qst, REG_ARG_1);
         emit_post_push_reg(emit, VTYPE_PYOBJ, REG_RET);
     }
 }
@@ -1062,7 +1231,7 @@ STATIC void emit_native_load_attr(emit_t *emit, qstr qst) {
     vtype_kind_t vtype_base;
     emit_pre_pop_reg(emit, &vtype_base, REG_ARG_1); // arg1 = base
     assert(vtype_base == VTYPE_PYOBJ);
-    emit_call_with_imm_arg(emit, MP_F_LOAD_ATTR, qst, REG_ARG_2); // arg2 = attribute name
+    emit_call_with_qstr_arg(emit, MP_F_LOAD_ATTR, qst, REG_ARG_2); // arg2 = attribute name
     emit_post_push_reg(emit, VTYPE_PYOBJ, REG_RET);
 }
 
@@ -1070,13 +1239,13 @@ STATIC void emit_native_load_method(emit_t *emit, qstr qst, bool is_super) {
     if (is_super) {
         emit_get_stack_pointer_to_reg_for_pop(emit, REG_ARG_2, 3); // arg2 = dest ptr
         emit_get_stack_pointer_to_reg_for_push(emit, REG_ARG_2, 2); // arg2 = dest ptr
-        emit_call_with_imm_arg(emit, MP_F_LOAD_SUPER_METHOD, qst, REG_ARG_1); // arg1 = method name
+        emit_call_with_qstr_arg(emit, MP_F_LOAD_SUPER_METHOD, qst, REG_ARG_1); // arg1 = method name
     } else {
         vtype_kind_t vtype_base;
         emit_pre_pop_reg(emit, &vtype_base, REG_ARG_1); // arg1 = base
         assert(vtype_base == VTYPE_PYOBJ);
         emit_get_stack_pointer_to_reg_for_push(emit, REG_ARG_3, 2); // arg3 = dest ptr
-        emit_call_with_imm_arg(emit, MP_F_LOAD_METHOD, qst, REG_ARG_2); // arg2 = method name
+        emit_call_with_qstr_arg(emit, MP_F_LOAD_METHOD, qst, REG_ARG_2); // arg2 = method name
     }
 }
 
@@ -1270,7 +1439,7 @@ STATIC void emit_native_store_name(emit_t *emit, qstr qst) {
     vtype_kind_t vtype;
     emit_pre_pop_reg(emit, &vtype, REG_ARG_2);
     assert(vtype == VTYPE_PYOBJ);
-    emit_call_with_imm_arg(emit, MP_F_STORE_NAME, qst, REG_ARG_1); // arg1 = name
+    emit_call_with_qstr_arg(emit, MP_F_STORE_NAME, qst, REG_ARG_1); // arg1 = name
     emit_post(emit);
 }
 
@@ -1283,7 +1452,7 @@ STATIC void emit_native_store_global(emit_t *emit, qstr qst) {
         emit_call_with_imm_arg(emit, MP_F_CONVERT_NATIVE_TO_OBJ, vtype, REG_ARG_2); // arg2 = type
         ASM_MOV_REG_REG(emit->as, REG_ARG_2, REG_RET);
     }
-    emit_call_with_imm_arg(emit, MP_F_STORE_GLOBAL, qst, REG_ARG_1); // arg1 = name
+    emit_call_with_qstr_arg(emit, MP_F_STORE_GLOBAL, qst, REG_ARG_1); // arg1 = name
     emit_post(emit);
 }
 
@@ -1292,7 +1461,7 @@ STATIC void emit_native_store_attr(emit_t *emit, qstr qst) {
     emit_pre_pop_reg_reg(emit, &vtype_base, REG_ARG_1, &vtype_val, REG_ARG_3); // arg1 = base, arg3 = value
     assert(vtype_base == VTYPE_PYOBJ);
     assert(vtype_val == VTYPE_PYOBJ);
-    emit_call_with_imm_arg(emit, MP_F_STORE_ATTR, qst, REG_ARG_2); // arg2 = attribute name
+    emit_call_with_qstr_arg(emit, MP_F_STORE_ATTR, qst, REG_ARG_2); // arg2 = attribute name
     emit_post(emit);
 }
 
@@ -1493,13 +1662,13 @@ STATIC void emit_native_delete_deref(emit_t *emit, qstr qst, mp_uint_t local_num
 
 STATIC void emit_native_delete_name(emit_t *emit, qstr qst) {
     emit_native_pre(emit);
-    emit_call_with_imm_arg(emit, MP_F_DELETE_NAME, qst, REG_ARG_1);
+    emit_call_with_qstr_arg(emit, MP_F_DELETE_NAME, qst, REG_ARG_1);
     emit_post(emit);
 }
 
 STATIC void emit_native_delete_global(emit_t *emit, qstr qst) {
     emit_native_pre(emit);
-    emit_call_with_imm_arg(emit, MP_F_DELETE_GLOBAL, qst, REG_ARG_1);
+    emit_call_with_qstr_arg(emit, MP_F_DELETE_GLOBAL, qst, REG_ARG_1);
     emit_post(emit);
 }
 
@@ -1507,7 +1676,9 @@ STATIC void emit_native_delete_attr(emit_t *emit, qstr qst) {
     vtype_kind_t vtype_base;
     emit_pre_pop_reg(emit, &vtype_base, REG_ARG_1); // arg1 = base
     assert(vtype_base == VTYPE_PYOBJ);
-    emit_call_with_2_imm_args(emit, MP_F_STORE_ATTR, qst, REG_ARG_2, (mp_uint_t)MP_OBJ_NULL, REG_ARG_3); // arg2 = attribute name, arg3 = value (null for delete)
+    need_reg_all(emit);
+    ASM_MOV_IMM_TO_REG(emit->as, (mp_uint_t)MP_OBJ_NULL, REG_ARG_3); // arg3 = value (null for delete)
+    emit_call_with_qstr_arg(emit, MP_F_STORE_ATTR, qst, REG_ARG_2); // arg2 = attribute name
     emit_post(emit);
 }
 
@@ -1622,6 +1793,20 @@ STATIC void emit_native_continue_loop(emit_t *emit, mp_uint_t label, mp_uint_t e
     emit_native_jump(emit, label); // TODO properly
 }
 
+// pushes an nlr_buf_t onto the stack and links it in; REG_RET is non-zero
+// when control returns here because an exception was raised
+STATIC void emit_native_nlr_push(emit_t *emit) {
+    emit_get_stack_pointer_to_reg_for_push(emit, REG_ARG_1, NLR_BUF_NUM_WORDS); // arg1 = pointer to nlr buf
+    emit_call(emit, MP_F_NLR_PUSH);
+    #if NATIVE_NLR_SETJMP
+    // setjmp can't be called through a wrapper so call it from this frame,
+    // with the nlr_buf_t linked in but before anything can raise
+    ASM_MOV_LOCAL_ADDR_TO_REG(emit->as, emit->stack_start + emit->stack_size
+        - NLR_BUF_NUM_WORDS + NLR_BUF_JMPBUF_WORD, REG_ARG_1);
+    emit_call(emit, MP_F_SETJMP);
+    #endif
+}
+
 STATIC void emit_native_setup_with(emit_t *emit, mp_uint_t label) {
     // the context manager is on the top of the stack
     // stack: (..., ctx_mgr)
@@ -1631,7 +1816,7 @@ STATIC void emit_native_setup_with(emit_t *emit, mp_uint_t label) {
     emit_access_stack(emit, 1, &vtype, REG_ARG_1); // arg1 = ctx_mgr
     assert(vtype == VTYPE_PYOBJ);
     emit_get_stack_pointer_to_reg_for_push(emit, REG_ARG_3, 2); // arg3 = dest ptr
-    emit_call_with_imm_arg(emit, MP_F_LOAD_METHOD, MP_QSTR___exit__, REG_ARG_2);
+    emit_call_with_qstr_arg(emit, MP_F_LOAD_METHOD, MP_QSTR___exit__, REG_ARG_2);
     // stack: (..., ctx_mgr, __exit__, self)
 
     emit_pre_pop_reg(emit, &vtype, REG_ARG_3); // self
@@ -1644,7 +1829,7 @@ STATIC void emit_native_setup_with(emit_t *emit, mp_uint_t label) {
 
     // get __enter__ method
     emit_get_stack_pointer_to_reg_for_push(emit, REG_ARG_3, 2); // arg3 = dest ptr
-    emit_call_with_imm_arg(emit, MP_F_LOAD_METHOD, MP_QSTR___enter__, REG_ARG_2); // arg2 = method name
+    emit_call_with_qstr_arg(emit, MP_F_LOAD_METHOD, MP_QSTR___enter__, REG_ARG_2); // arg2 = method name
     // stack: (..., __exit__, self, __enter__, self)
 
     // call __enter__ method
@@ -1655,11 +1840,10 @@ STATIC void emit_native_setup_with(emit_t *emit, mp_uint_t label) {
 
     // need to commit stack because we may jump elsewhere
     need_stack_settled(emit);
-    emit_get_stack_pointer_to_reg_for_push(emit, REG_ARG_1, sizeof(nlr_buf_t) / sizeof(mp_uint_t)); // arg1 = pointer to nlr buf
-    emit_call(emit, MP_F_NLR_PUSH);
+    emit_native_nlr_push(emit);
     ASM_JUMP_IF_REG_NONZERO(emit->as, REG_RET, label);
 
-    emit_access_stack(emit, sizeof(nlr_buf_t) / sizeof(mp_uint_t) + 1, &vtype, REG_RET); // access return value of __enter__
+    emit_access_stack(emit, NLR_BUF_NUM_WORDS + 1, &vtype, REG_RET); // access return value of __enter__
     emit_post_push_reg(emit, VTYPE_PYOBJ, REG_RET); // push return value of __enter__
     // stack: (..., __exit__, self, as_value, nlr_buf, as_value)
 }
@@ -1670,7 +1854,7 @@ STATIC void emit_native_with_cleanup(emit_t *emit, mp_uint_t label) {
     // stack: (..., __exit__, self, as_value, nlr_buf)
     emit_native_pre(emit);
     emit_call(emit, MP_F_NLR_POP);
-    adjust_stack(emit, -(mp_int_t)(sizeof(nlr_buf_t) / sizeof(mp_uint_t)) - 1);
+    adjust_stack(emit, -(mp_int_t)NLR_BUF_NUM_WORDS - 1);
     // stack: (..., __exit__, self)
 
     // call __exit__
@@ -1737,8 +1921,7 @@ STATIC void emit_native_setup_except(emit_t *emit, mp_uint_t label) {
     emit_native_pre(emit);
     // need to commit stack because we may jump elsewhere
     need_stack_settled(emit);
-    emit_get_stack_pointer_to_reg_for_push(emit, REG_ARG_1, sizeof(nlr_buf_t) / sizeof(mp_uint_t)); // arg1 = pointer to nlr buf
-    emit_call(emit, MP_F_NLR_PUSH);
+    emit_native_nlr_push(emit);
     ASM_JUMP_IF_REG_NONZERO(emit->as, REG_RET, label);
     emit_post(emit);
 }
@@ -1798,7 +1981,7 @@ STATIC void emit_native_for_iter_end(emit_t *emit) {
 STATIC void emit_native_pop_block(emit_t *emit) {
     emit_native_pre(emit);
     emit_call(emit, MP_F_NLR_POP);
-    adjust_stack(emit, -(mp_int_t)(sizeof(nlr_buf_t) / sizeof(mp_uint_t)) + 1);
+    adjust_stack(emit, -(mp_int_t)NLR_BUF_NUM_WORDS + 1);
     emit_post(emit);
 }
 
@@ -1933,7 +2116,7 @@ STATIC void emit_native_binary_op(emit_t *emit, mp_binary_op_t op) {
                 ASM_ARM_CC_NE,
             };
             asm_arm_setcc_reg(emit->as, REG_RET, ccs[op - MP_BINARY_OP_LESS]);
-            #elif N_XTENSA
+            #elif N_XTENSA || N_XTENSAWIN
             static uint8_t ccs[6] = {
                 ASM_XTENSA_CC_LT,
                 0x80 | ASM_XTENSA_CC_LT, // for GT we'll swap args
@@ -2031,7 +2214,9 @@ STATIC void emit_native_build_slice(emit_t *emit, mp_uint_t n_args) {
         emit_pre_pop_reg_reg(emit, &vtype_stop, REG_ARG_2, &vtype_start, REG_ARG_1); // arg1 = start, arg2 = stop
         assert(vtype_start == VTYPE_PYOBJ);
         assert(vtype_stop == VTYPE_PYOBJ);
-        emit_call_with_imm_arg(emit, MP_F_NEW_SLICE, (mp_uint_t)mp_const_none, REG_ARG_3); // arg3 = step
+        need_reg_all(emit);
+        emit_native_mov_reg_obj(emit, REG_ARG_3, (mp_uint_t)mp_const_none); // arg3 = step
+        emit_call(emit, MP_F_NEW_SLICE);
         emit_post_push_reg(emit, VTYPE_PYOBJ, REG_RET);
     } else {
         assert(n_args == 3);
@@ -2097,13 +2282,13 @@ STATIC void emit_native_make_function(emit_t *emit, scope_t *scope, mp_uint_t n_
     // call runtime, with type info for args, or don't support dict/default params, or only support Python objects for them
     emit_native_pre(emit);
     if (n_pos_defaults == 0 && n_kw_defaults == 0) {
-        emit_call_with_3_imm_args_and_first_aligned(emit, MP_F_MAKE_FUNCTION_FROM_RAW_CODE, (mp_uint_t)scope->raw_code, REG_ARG_1, (mp_uint_t)MP_OBJ_NULL, REG_ARG_2, (mp_uint_t)MP_OBJ_NULL, REG_ARG_3);
+        emit_call_with_raw_code_and_2_imm_args(emit, MP_F_MAKE_FUNCTION_FROM_RAW_CODE, scope->raw_code, REG_ARG_1, (mp_uint_t)MP_OBJ_NULL, REG_ARG_2, (mp_uint_t)MP_OBJ_NULL, REG_ARG_3);
     } else {
         vtype_kind_t vtype_def_tuple, vtype_def_dict;
         emit_pre_pop_reg_reg(emit, &vtype_def_dict, REG_ARG_3, &vtype_def_tuple, REG_ARG_2);
         assert(vtype_def_tuple == VTYPE_PYOBJ);
         assert(vtype_def_dict == VTYPE_PYOBJ);
-        emit_call_with_imm_arg_aligned(emit, MP_F_MAKE_FUNCTION_FROM_RAW_CODE, (mp_uint_t)scope->raw_code, REG_ARG_1);
+        emit_call_with_raw_code_arg(emit, MP_F_MAKE_FUNCTION_FROM_RAW_CODE, scope->raw_code, REG_ARG_1);
     }
     emit_post_push_reg(emit, VTYPE_PYOBJ, REG_RET);
 }
@@ -2117,8 +2302,8 @@ STATIC void emit_native_make_closure(emit_t *emit, scope_t *scope, mp_uint_t n_c
         emit_get_stack_pointer_to_reg_for_pop(emit, REG_ARG_3, n_closed_over + 2);
         ASM_MOV_IMM_TO_REG(emit->as, 0x100 | n_closed_over, REG_ARG_2);
     }
-    ASM_MOV_ALIGNED_IMM_TO_REG(emit->as, (mp_uint_t)scope->raw_code, REG_ARG_1);
-    ASM_CALL_IND(emit->as, mp_fun_table[MP_F_MAKE_CLOSURE_FROM_RAW_CODE], MP_F_MAKE_CLOSURE_FROM_RAW_CODE);
+    emit_native_mov_reg_link(emit, REG_ARG_1, MP_NATIVE_LINK_RAW_CODE, (mp_uint_t)scope->raw_code, (mp_uint_t)scope->raw_code);
+    emit_native_call_ind(emit, MP_F_MAKE_CLOSURE_FROM_RAW_CODE);
     emit_post_push_reg(emit, VTYPE_PYOBJ, REG_RET);
 }
 
@@ -2196,7 +2381,7 @@ STATIC void emit_native_return_value(emit_t *emit) {
         if (peek_vtype(emit, 0) == VTYPE_PTR_NONE) {
             emit_pre_pop_discard(emit);
             if (emit->return_vtype == VTYPE_PYOBJ) {
-                ASM_MOV_IMM_TO_REG(emit->as, (mp_uint_t)mp_const_none, REG_RET);
+                emit_native_mov_reg_obj(emit, REG_RET, (mp_uint_t)mp_const_none);
             } else {
                 ASM_MOV_IMM_TO_REG(emit->as, 0, REG_RET);
             }
@@ -2214,6 +2399,9 @@ STATIC void emit_native_return_value(emit_t *emit) {
         emit_pre_pop_reg(emit, &vtype, REG_RET);
         assert(vtype == VTYPE_PYOBJ);
     }
+    #if N_XTENSAWIN
+    ASM_MOV_REG_REG(emit->as, REG_PARENT_RET, REG_RET);
+    #endif
     emit->last_emit_was_return_value = true;
     ASM_EXIT(emit->as);
 }
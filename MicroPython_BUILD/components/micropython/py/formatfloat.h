@@ -30,6 +30,9 @@
 
 #if MICROPY_PY_BUILTINS_FLOAT
 int mp_format_float(mp_float_t f, char *buf, size_t bufSize, char fmt, int prec, char sign);
+#if MICROPY_FLOAT_EXACT_CONV
+mp_float_t mp_float_from_decimal(const char *str, const char *top, int exp10);
+#endif
 #endif
 
 #endif // MICROPY_INCLUDED_PY_FORMATFLOAT_H
@@ -33,6 +33,21 @@
 #include "py/obj.h"
 #include "py/runtime.h"
 
+#if MICROPY_GC_NURSERY || MICROPY_GC_INCREMENTAL
+#include "py/mphal.h"
+#endif
+
+#if MICROPY_PY_MICROPYTHON_HEAP_PROFILE
+#include "py/bc.h"
+#endif
+
+#if MICROPY_GC_COMPACT
+#include "py/binary.h"
+#include "py/objarray.h"
+#include "py/objstr.h"
+#include "py/objtype.h"
+#endif
+
 #if MICROPY_ENABLE_GC
 
 #if MICROPY_DEBUG_VERBOSE // print debugging info
@@ -79,8 +94,32 @@
 #define ATB_HEAD_TO_MARK(block) do { MP_STATE_MEM(gc_alloc_table_start)[(block) / BLOCKS_PER_ATB] |= (AT_MARK << BLOCK_SHIFT(block)); } while (0)
 #define ATB_MARK_TO_HEAD(block) do { MP_STATE_MEM(gc_alloc_table_start)[(block) / BLOCKS_PER_ATB] &= (~(AT_TAIL << BLOCK_SHIFT(block))); } while (0)
 
+#if MICROPY_GC_SPLIT_HEAP
+// the blocks of the fast region are numbered after those of the main pool, and
+// runs of blocks never cross from one region into the other
+#define IN_MAIN_POOL(ptr) ((uintptr_t)((byte*)(ptr) - MP_STATE_MEM(gc_pool_start)) < (uintptr_t)(MP_STATE_MEM(gc_pool_end) - MP_STATE_MEM(gc_pool_start)))
+#define IN_FAST_POOL(ptr) ((uintptr_t)((byte*)(ptr) - MP_STATE_MEM(gc_fast_pool_start)) < (uintptr_t)(MP_STATE_MEM(gc_fast_pool_end) - MP_STATE_MEM(gc_fast_pool_start)))
+#define IN_POOL(ptr) (IN_MAIN_POOL(ptr) || IN_FAST_POOL(ptr))
+#define BLOCK_FROM_PTR(ptr) (IN_MAIN_POOL(ptr) \
+    ? (size_t)((byte*)(ptr) - MP_STATE_MEM(gc_pool_start)) / BYTES_PER_BLOCK \
+    : MP_STATE_MEM(gc_fast_block) + (size_t)((byte*)(ptr) - MP_STATE_MEM(gc_fast_pool_start)) / BYTES_PER_BLOCK)
+#define PTR_FROM_BLOCK(block) ((block) < MP_STATE_MEM(gc_fast_block) \
+    ? (block) * BYTES_PER_BLOCK + (uintptr_t)MP_STATE_MEM(gc_pool_start) \
+    : ((block) - MP_STATE_MEM(gc_fast_block)) * BYTES_PER_BLOCK + (uintptr_t)MP_STATE_MEM(gc_fast_pool_start))
+// first block after the region holding block
+#define REGION_END_BLOCK(block) ((block) < MP_STATE_MEM(gc_fast_block) ? MP_STATE_MEM(gc_fast_block) : MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB)
+// index from which to look for free blocks in the region holding block
+#define LAST_FREE_ATB_INDEX(block) (*((block) < MP_STATE_MEM(gc_fast_block) ? &MP_STATE_MEM(gc_last_free_atb_index) : &MP_STATE_MEM(gc_fast_last_free_atb_index)))
+// only small allocations use the free lists, and they go in the fast region
+#define FREE_LIST_FIRST_BLOCK (MP_STATE_MEM(gc_fast_block))
+#else
+#define IN_POOL(ptr) ((byte*)(ptr) >= MP_STATE_MEM(gc_pool_start) && (byte*)(ptr) < MP_STATE_MEM(gc_pool_end))
 #define BLOCK_FROM_PTR(ptr) (((byte*)(ptr) - MP_STATE_MEM(gc_pool_start)) / BYTES_PER_BLOCK)
 #define PTR_FROM_BLOCK(block) (((block) * BYTES_PER_BLOCK + (uintptr_t)MP_STATE_MEM(gc_pool_start)))
+#define REGION_END_BLOCK(block) (MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB)
+#define LAST_FREE_ATB_INDEX(block) (MP_STATE_MEM(gc_last_free_atb_index))
+#define FREE_LIST_FIRST_BLOCK (0)
+#endif
 #define ATB_FROM_BLOCK(bl) ((bl) / BLOCKS_PER_ATB)
 
 #if MICROPY_ENABLE_FINALISER
@@ -94,6 +133,118 @@
 #define FTB_CLEAR(block) do { MP_STATE_MEM(gc_finaliser_table_start)[(block) / BLOCKS_PER_FTB] &= (~(1 << ((block) & 7))); } while (0)
 #endif
 
+#if MICROPY_GC_NURSERY
+// In generational mode a block that survives a collection keeps its mark, so
+// outside of a collection HEAD is a young block and MARK is an old one.  A
+// minor collection only marks and sweeps young blocks; a full collection
+// clears all marks first.
+
+// GTB = generation table byte, same layout as the ATB, only used for heads
+// 0b00 = CLEAN -- all stores into the block are covered by a write barrier
+// 0b01 = REMEMBERED -- must be traced by the next minor collection
+// 0b10 = SCANNED -- already traced by the current minor collection
+// 0b11 = UNKNOWN -- not protected, traced by every minor collection
+
+#define GT_CLEAN (0)
+#define GT_REMEMBERED (1)
+#define GT_SCANNED (2)
+#define GT_UNKNOWN (3)
+
+#define GTB_GET(block) ((MP_STATE_MEM(gc_gen_table_start)[(block) / BLOCKS_PER_ATB] >> BLOCK_SHIFT(block)) & 3)
+#define GTB_SET(block, gt) do { byte *_gtb = &MP_STATE_MEM(gc_gen_table_start)[(block) / BLOCKS_PER_ATB]; *_gtb = (*_gtb & ~(3 << BLOCK_SHIFT(block))) | ((gt) << BLOCK_SHIFT(block)); } while (0)
+
+#define GTB_BITS_PER_ATB (BITS_PER_BYTE)
+
+// GC stack entries with this bit set also push the clean old blocks they point to
+#define GC_STACK_TAG ((size_t)1 << (sizeof(size_t) * BITS_PER_BYTE - 1))
+#else
+#define GTB_BITS_PER_ATB (0)
+#endif
+
+#if MICROPY_GC_COMPACT && !MICROPY_ENABLE_FINALISER
+#error "MICROPY_GC_COMPACT requires MICROPY_ENABLE_FINALISER"
+#endif
+
+#if MICROPY_GC_PARALLEL_MARK
+#if MICROPY_GC_NURSERY || MICROPY_GC_INCREMENTAL
+#error "MICROPY_GC_PARALLEL_MARK can't be used with MICROPY_GC_NURSERY or MICROPY_GC_INCREMENTAL"
+#endif
+#if MICROPY_GC_PARALLEL_CHUNK % 16 != 0
+#error "MICROPY_GC_PARALLEL_CHUNK must be a multiple of 16"
+#endif
+
+// The core which marks a block: the two cores mark alternate runs of blocks,
+// which are whole words of the alloc table.
+#define GC_PAR_OWNER(block) (((block) / MICROPY_GC_PARALLEL_CHUNK) & 1)
+
+// Order the accesses to the queues and flags shared by the two cores: the
+// blocks put in a queue before its head is moved, the blocks taken from it
+// before its tail is moved, and the idle flags with respect to both.
+#define GC_PAR_RELEASE() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define GC_PAR_BARRIER() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+#if MICROPY_GC_INCREMENTAL
+#if MICROPY_GC_NURSERY
+#error "MICROPY_GC_INCREMENTAL and MICROPY_GC_NURSERY can't be used together"
+#endif
+#if !MICROPY_GC_ALLOC_THRESHOLD
+#error "MICROPY_GC_INCREMENTAL requires MICROPY_GC_ALLOC_THRESHOLD"
+#endif
+
+// In incremental mode a cycle marks the roots, then traces the heap in
+// steps between which the program keeps running, then marks the roots again
+// and traces the blocks written to since they were traced, then sweeps the
+// heap in steps too.  Blocks allocated while marking are unmarked, and
+// survive only if they are reachable at the end of the marking; blocks
+// allocated while sweeping, ahead of the sweep, are marked.
+
+// ITB = incremental table byte, same layout as the ATB, only used for heads
+// 0b00 = CLEAN -- all stores into the block are covered by a write barrier
+// 0b01 = GRAY -- marked by the current cycle, but not traced yet
+// 0b10 = DIRTY -- must be traced again at the end of the current cycle
+// 0b11 = UNKNOWN -- not classified yet; objects that aren't protected by a
+//                   write barrier become DIRTY each time they are traced
+
+#define IT_CLEAN (0)
+#define IT_GRAY (1)
+#define IT_DIRTY (2)
+#define IT_UNKNOWN (3)
+
+#define ITB_GET(block) ((MP_STATE_MEM(gc_incr_table_start)[(block) / BLOCKS_PER_ATB] >> BLOCK_SHIFT(block)) & 3)
+#define ITB_SET(block, it) do { byte *_itb = &MP_STATE_MEM(gc_incr_table_start)[(block) / BLOCKS_PER_ATB]; *_itb = (*_itb & ~(3 << BLOCK_SHIFT(block))) | ((it) << BLOCK_SHIFT(block)); } while (0)
+
+// a block that was just marked still has to be traced
+#define ITB_SHADE(block) do { if (ITB_GET(block) == IT_CLEAN) { ITB_SET(block, IT_GRAY); } } while (0)
+
+#define ITB_BITS_PER_ATB (BITS_PER_BYTE)
+
+// GC stack entries with this bit set also trace the marked blocks they point to
+#define GC_STACK_TAG ((size_t)1 << (sizeof(size_t) * BITS_PER_BYTE - 1))
+
+// phases of an incremental cycle
+#define GC_INCR_IDLE (0)
+#define GC_INCR_START (1) // gc_collect() marks the roots without tracing them
+#define GC_INCR_MARK (2) // gc_collect_step() traces the heap
+#define GC_INCR_FINISH (3) // gc_collect() completes the marking
+#define GC_INCR_SWEEP (4) // gc_collect_step() sweeps the heap
+
+// number of blocks traced between checks of the step's time budget
+#define GC_INCR_WORK_CHUNK (32)
+// number of blocks swept between checks of the step's time budget
+#define GC_INCR_SWEEP_CHUNK (1024)
+#else
+#define ITB_BITS_PER_ATB (0)
+#define ITB_SHADE(block) (void)0
+#endif
+
+#if MICROPY_GC_NURSERY || MICROPY_GC_INCREMENTAL
+// blocks can be marked outside of a collection too
+#define ATB_KIND_IS_HEAD(kind) ((kind) == AT_HEAD || (kind) == AT_MARK)
+#else
+#define ATB_KIND_IS_HEAD(kind) ((kind) == AT_HEAD)
+#endif
+
 #if MICROPY_PY_THREAD && !MICROPY_PY_THREAD_GIL
 #define GC_ENTER() mp_thread_mutex_lock(&MP_STATE_MEM(gc_mutex), 1)
 #define GC_EXIT() mp_thread_mutex_unlock(&MP_STATE_MEM(gc_mutex))
@@ -102,22 +253,53 @@
 #define GC_EXIT()
 #endif
 
+#if MICROPY_GC_SPLIT_HEAP
+void gc_init(void *start, void *end) {
+    gc_init_split(start, end, NULL, NULL);
+}
+
+// The GC tables for the blocks of both regions are placed at the start of the
+// main region, so the fast region only holds blocks.
+void gc_init_split(void *start, void *end, void *fast_start, void *fast_end) {
+    // align end pointers on block boundary, and give the fast region a whole
+    // number of ATBs so that no ATB covers blocks of both regions
+    fast_end = (void*)((uintptr_t)fast_end & (~(BYTES_PER_BLOCK - 1)));
+    size_t fast_atb_byte_len = 0;
+    if (fast_end > fast_start) {
+        fast_atb_byte_len = ((byte*)fast_end - (byte*)fast_start) / (BLOCKS_PER_ATB * BYTES_PER_BLOCK);
+    }
+    MP_STATE_MEM(gc_fast_pool_start) = (byte*)fast_end - fast_atb_byte_len * BLOCKS_PER_ATB * BYTES_PER_BLOCK;
+    MP_STATE_MEM(gc_fast_pool_end) = fast_end;
+    DEBUG_printf("Initializing GC fast region: %p..%p\n", MP_STATE_MEM(gc_fast_pool_start), fast_end);
+#else
 // TODO waste less memory; currently requires that all entries in alloc_table have a corresponding block in pool
 void gc_init(void *start, void *end) {
+#endif
     // align end pointer on block boundary
     end = (void*)((uintptr_t)end & (~(BYTES_PER_BLOCK - 1)));
     DEBUG_printf("Initializing GC heap: %p..%p = " UINT_FMT " bytes\n", start, end, (byte*)end - (byte*)start);
 
-    // calculate parameters for GC (T=total, A=alloc table, F=finaliser table, P=pool; all in bytes):
-    // T = A + F + P
+    // calculate parameters for GC (T=total, A=alloc table, F=finaliser table, G=generation table, P=pool; all in bytes):
+    // T = A + F + G + P
     //     F = A * BLOCKS_PER_ATB / BLOCKS_PER_FTB
+    //     G = A (if MICROPY_GC_NURSERY or MICROPY_GC_INCREMENTAL, else 0)
     //     P = A * BLOCKS_PER_ATB * BYTES_PER_BLOCK
-    // => T = A * (1 + BLOCKS_PER_ATB / BLOCKS_PER_FTB + BLOCKS_PER_ATB * BYTES_PER_BLOCK)
+    // => T = A * (1 + BLOCKS_PER_ATB / BLOCKS_PER_FTB + G / A + BLOCKS_PER_ATB * BYTES_PER_BLOCK)
     size_t total_byte_len = (byte*)end - (byte*)start;
+#if MICROPY_GC_SPLIT_HEAP
+    // leave room for the tables of the fast region's blocks
+    total_byte_len -= (fast_atb_byte_len * (BITS_PER_BYTE + BITS_PER_BYTE * BLOCKS_PER_ATB / BLOCKS_PER_FTB + GTB_BITS_PER_ATB + ITB_BITS_PER_ATB) + BITS_PER_BYTE - 1) / BITS_PER_BYTE + 1;
+#endif
 #if MICROPY_ENABLE_FINALISER
-    MP_STATE_MEM(gc_alloc_table_byte_len) = total_byte_len * BITS_PER_BYTE / (BITS_PER_BYTE + BITS_PER_BYTE * BLOCKS_PER_ATB / BLOCKS_PER_FTB + BITS_PER_BYTE * BLOCKS_PER_ATB * BYTES_PER_BLOCK);
+    MP_STATE_MEM(gc_alloc_table_byte_len) = total_byte_len * BITS_PER_BYTE / (BITS_PER_BYTE + BITS_PER_BYTE * BLOCKS_PER_ATB / BLOCKS_PER_FTB + GTB_BITS_PER_ATB + ITB_BITS_PER_ATB + BITS_PER_BYTE * BLOCKS_PER_ATB * BYTES_PER_BLOCK);
 #else
-    MP_STATE_MEM(gc_alloc_table_byte_len) = total_byte_len / (1 + BITS_PER_BYTE / 2 * BYTES_PER_BLOCK);
+    MP_STATE_MEM(gc_alloc_table_byte_len) = total_byte_len * BITS_PER_BYTE / (BITS_PER_BYTE + GTB_BITS_PER_ATB + ITB_BITS_PER_ATB + BITS_PER_BYTE * BLOCKS_PER_ATB * BYTES_PER_BLOCK);
+#endif
+
+    size_t gc_pool_block_len = MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB;
+#if MICROPY_GC_SPLIT_HEAP
+    MP_STATE_MEM(gc_fast_block) = gc_pool_block_len;
+    MP_STATE_MEM(gc_alloc_table_byte_len) += fast_atb_byte_len;
 #endif
 
     MP_STATE_MEM(gc_alloc_table_start) = (byte*)start;
@@ -127,11 +309,30 @@ void gc_init(void *start, void *end) {
     MP_STATE_MEM(gc_finaliser_table_start) = MP_STATE_MEM(gc_alloc_table_start) + MP_STATE_MEM(gc_alloc_table_byte_len);
 #endif
 
-    size_t gc_pool_block_len = MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB;
+#if MICROPY_GC_NURSERY
+    #if MICROPY_ENABLE_FINALISER
+    MP_STATE_MEM(gc_gen_table_start) = MP_STATE_MEM(gc_finaliser_table_start) + gc_finaliser_table_byte_len;
+    #else
+    MP_STATE_MEM(gc_gen_table_start) = MP_STATE_MEM(gc_alloc_table_start) + MP_STATE_MEM(gc_alloc_table_byte_len);
+    #endif
+#endif
+
+#if MICROPY_GC_INCREMENTAL
+    #if MICROPY_ENABLE_FINALISER
+    MP_STATE_MEM(gc_incr_table_start) = MP_STATE_MEM(gc_finaliser_table_start) + gc_finaliser_table_byte_len;
+    #else
+    MP_STATE_MEM(gc_incr_table_start) = MP_STATE_MEM(gc_alloc_table_start) + MP_STATE_MEM(gc_alloc_table_byte_len);
+    #endif
+#endif
+
     MP_STATE_MEM(gc_pool_start) = (byte*)end - gc_pool_block_len * BYTES_PER_BLOCK;
     MP_STATE_MEM(gc_pool_end) = end;
 
-#if MICROPY_ENABLE_FINALISER
+#if MICROPY_GC_NURSERY
+    assert(MP_STATE_MEM(gc_pool_start) >= MP_STATE_MEM(gc_gen_table_start) + MP_STATE_MEM(gc_alloc_table_byte_len));
+#elif MICROPY_GC_INCREMENTAL
+    assert(MP_STATE_MEM(gc_pool_start) >= MP_STATE_MEM(gc_incr_table_start) + MP_STATE_MEM(gc_alloc_table_byte_len));
+#elif MICROPY_ENABLE_FINALISER
     assert(MP_STATE_MEM(gc_pool_start) >= MP_STATE_MEM(gc_finaliser_table_start) + gc_finaliser_table_byte_len);
 #endif
 
@@ -143,8 +344,30 @@ void gc_init(void *start, void *end) {
     memset(MP_STATE_MEM(gc_finaliser_table_start), 0, gc_finaliser_table_byte_len);
 #endif
 
+#if MICROPY_GC_NURSERY
+    // clear GTBs
+    memset(MP_STATE_MEM(gc_gen_table_start), 0, MP_STATE_MEM(gc_alloc_table_byte_len));
+#endif
+
+#if MICROPY_GC_INCREMENTAL
+    // clear ITBs
+    memset(MP_STATE_MEM(gc_incr_table_start), 0, MP_STATE_MEM(gc_alloc_table_byte_len));
+#endif
+
     // set last free ATB index to start of heap
     MP_STATE_MEM(gc_last_free_atb_index) = 0;
+#if MICROPY_GC_SPLIT_HEAP
+    MP_STATE_MEM(gc_fast_last_free_atb_index) = MP_STATE_MEM(gc_fast_block) / BLOCKS_PER_ATB;
+    MP_STATE_MEM(gc_fast_full_blocks) = (size_t)-1;
+#endif
+
+#if MICROPY_GC_FREE_LISTS
+    // the free lists are filled when they are first used
+    memset(MP_STATE_MEM(gc_free_list_len), 0, sizeof(MP_STATE_MEM(gc_free_list_len)));
+    for (size_t c = 0; c < MICROPY_GC_FREE_LIST_CLASSES; c++) {
+        MP_STATE_MEM(gc_free_list_scan)[c] = FREE_LIST_FIRST_BLOCK;
+    }
+#endif
 
     // unlock the GC
     MP_STATE_MEM(gc_lock_depth) = 0;
@@ -158,6 +381,26 @@ void gc_init(void *start, void *end) {
     MP_STATE_MEM(gc_alloc_amount) = 0;
     #endif
 
+    #if MICROPY_GC_NURSERY
+    MP_STATE_MEM(gc_nursery_blocks) = MICROPY_GC_NURSERY_SIZE / BYTES_PER_BLOCK;
+    MP_STATE_MEM(gc_young_blocks) = 0;
+    MP_STATE_MEM(gc_young_start) = MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB;
+    MP_STATE_MEM(gc_young_end) = 0;
+    #endif
+
+    #if MICROPY_GC_INCREMENTAL
+    MP_STATE_MEM(gc_incr_phase) = GC_INCR_IDLE;
+    MP_STATE_MEM(gc_incr_completed) = 0;
+    MP_STATE_MEM(gc_alloc_threshold) = MICROPY_GC_INCREMENTAL_THRESHOLD / BYTES_PER_BLOCK;
+    #endif
+
+    #if MICROPY_GC_COMPACT
+    MP_STATE_MEM(gc_compact_active) = 0;
+    MP_STATE_MEM(gc_compact_wanted) = 0;
+    MP_STATE_MEM(gc_compact_threshold) = MICROPY_GC_COMPACT_THRESHOLD;
+    MP_STATE_MEM(gc_compact_max_free) = (size_t)-1;
+    #endif
+
     #if MICROPY_PY_THREAD
     mp_thread_mutex_init(&MP_STATE_MEM(gc_mutex));
     #endif
@@ -166,8 +409,17 @@ void gc_init(void *start, void *end) {
     DEBUG_printf("  alloc table at %p, length " UINT_FMT " bytes, " UINT_FMT " blocks\n", MP_STATE_MEM(gc_alloc_table_start), MP_STATE_MEM(gc_alloc_table_byte_len), MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB);
 #if MICROPY_ENABLE_FINALISER
     DEBUG_printf("  finaliser table at %p, length " UINT_FMT " bytes, " UINT_FMT " blocks\n", MP_STATE_MEM(gc_finaliser_table_start), gc_finaliser_table_byte_len, gc_finaliser_table_byte_len * BLOCKS_PER_FTB);
+#endif
+#if MICROPY_GC_NURSERY
+    DEBUG_printf("  generation table at %p, length " UINT_FMT " bytes\n", MP_STATE_MEM(gc_gen_table_start), MP_STATE_MEM(gc_alloc_table_byte_len));
+#endif
+#if MICROPY_GC_INCREMENTAL
+    DEBUG_printf("  incremental table at %p, length " UINT_FMT " bytes\n", MP_STATE_MEM(gc_incr_table_start), MP_STATE_MEM(gc_alloc_table_byte_len));
 #endif
     DEBUG_printf("  pool at %p, length " UINT_FMT " bytes, " UINT_FMT " blocks\n", MP_STATE_MEM(gc_pool_start), gc_pool_block_len * BYTES_PER_BLOCK, gc_pool_block_len);
+#if MICROPY_GC_SPLIT_HEAP
+    DEBUG_printf("  fast pool at %p, length " UINT_FMT " bytes, " UINT_FMT " blocks\n", MP_STATE_MEM(gc_fast_pool_start), fast_atb_byte_len * BLOCKS_PER_ATB * BYTES_PER_BLOCK, fast_atb_byte_len * BLOCKS_PER_ATB);
+#endif
 }
 
 void gc_lock(void) {
@@ -187,11 +439,42 @@ bool gc_is_locked(void) {
 }
 
 // ptr should be of type void*
+#if MICROPY_GC_SPLIT_HEAP
+#define VERIFY_PTR(ptr) ( \
+        ((uintptr_t)(ptr) & (BYTES_PER_BLOCK - 1)) == 0      /* must be aligned on a block */ \
+        && IN_POOL(ptr)                                      /* must be within one of the pools */ \
+    )
+#else
 #define VERIFY_PTR(ptr) ( \
         ((uintptr_t)(ptr) & (BYTES_PER_BLOCK - 1)) == 0      /* must be aligned on a block */ \
         && ptr >= (void*)MP_STATE_MEM(gc_pool_start)     /* must be above start of pool */ \
         && ptr < (void*)MP_STATE_MEM(gc_pool_end)        /* must be below end of pool */ \
     )
+#endif
+
+#define GC_PUSH(entry) \
+    do { \
+        if (MP_STATE_MEM(gc_sp) < &MP_STATE_MEM(gc_stack)[MICROPY_ALLOC_GC_STACK_SIZE]) { \
+            *MP_STATE_MEM(gc_sp)++ = (entry); \
+        } else { \
+            MP_STATE_MEM(gc_stack_overflow) = 1; \
+        } \
+    } while (0)
+
+#if MICROPY_GC_INCREMENTAL
+// Push a marked block to be traced along with the marked blocks it points to.
+// If it doesn't fit on the GC stack it's made dirty instead, so that it's
+// found again by gc_incr_trace_pending().
+#define GC_PUSH_TAGGED(block) \
+    do { \
+        if (MP_STATE_MEM(gc_sp) < &MP_STATE_MEM(gc_stack)[MICROPY_ALLOC_GC_STACK_SIZE]) { \
+            *MP_STATE_MEM(gc_sp)++ = (block) | GC_STACK_TAG; \
+        } else { \
+            ITB_SET(block, IT_DIRTY); \
+            MP_STATE_MEM(gc_stack_overflow) = 1; \
+        } \
+    } while (0)
+#endif
 
 // ptr should be of type void*
 #define VERIFY_MARK_AND_PUSH(ptr) \
@@ -202,30 +485,137 @@ bool gc_is_locked(void) {
                 /* an unmarked head, mark it, and push it on gc stack */ \
                 DEBUG_printf("gc_mark(%p)\n", ptr); \
                 ATB_HEAD_TO_MARK(_block); \
-                if (MP_STATE_MEM(gc_sp) < &MP_STATE_MEM(gc_stack)[MICROPY_ALLOC_GC_STACK_SIZE]) { \
-                    *MP_STATE_MEM(gc_sp)++ = _block; \
-                } else { \
-                    MP_STATE_MEM(gc_stack_overflow) = 1; \
-                } \
+                ITB_SHADE(_block); \
+                GC_PUSH(_block); \
             } \
         } \
     } while (0)
 
+#if MICROPY_GC_NURSERY || MICROPY_GC_INCREMENTAL
+// Objects of these types only get heap pointers stored into them while they
+// are being constructed, or on paths covered by MP_GC_WRITE_BARRIER.
+STATIC const mp_obj_type_t *const gc_protected_types[] = {
+    &mp_type_tuple,
+    &mp_type_list,
+    &mp_type_dict,
+    &mp_type_str,
+    &mp_type_bytes,
+    &mp_type_int,
+    &mp_type_type,
+    &mp_type_module,
+    &mp_type_fun_bc,
+    #if MICROPY_PY_BUILTINS_FLOAT
+    &mp_type_float,
+    #endif
+    #if MICROPY_PY_BUILTINS_COMPLEX
+    &mp_type_complex,
+    #endif
+    #if MICROPY_PY_BUILTINS_SET
+    &mp_type_set,
+    #endif
+    #if MICROPY_PY_BUILTINS_FROZENSET
+    &mp_type_frozenset,
+    #endif
+    #if MICROPY_PY_COLLECTIONS_ORDEREDDICT
+    &mp_type_ordereddict,
+    #endif
+    #if MICROPY_PY_BUILTINS_BYTEARRAY
+    &mp_type_bytearray,
+    #endif
+    #if MICROPY_PY_ARRAY
+    &mp_type_array,
+    #endif
+};
+
+STATIC bool gc_is_protected_type(size_t block) {
+    const mp_obj_type_t *type = ((mp_obj_base_t*)PTR_FROM_BLOCK(block))->type;
+    for (size_t i = 0; i < MP_ARRAY_SIZE(gc_protected_types); i++) {
+        if (type == gc_protected_types[i]) {
+            return true;
+        }
+    }
+    // instances of classes defined in Python: their members are only stored
+    // through mp_map_lookup, which has a write barrier
+    if (VERIFY_PTR((void*)type) && ((mp_obj_base_t*)type)->type == &mp_type_type) {
+        return true;
+    }
+    return false;
+}
+#endif
+
 STATIC void gc_drain_stack(void) {
     while (MP_STATE_MEM(gc_sp) > MP_STATE_MEM(gc_stack)) {
+        #if MICROPY_GC_INCREMENTAL
+        bool incr_step = MP_STATE_MEM(gc_incr_phase) == GC_INCR_MARK;
+        if (incr_step && MP_STATE_MEM(gc_incr_work) == 0) {
+            // out of budget, leave the rest for the next step
+            break;
+        }
+        #endif
+
         // pop the next block off the stack
         size_t block = *--MP_STATE_MEM(gc_sp);
 
+        #if MICROPY_GC_NURSERY
+        size_t tagged = block & GC_STACK_TAG;
+        block &= ~GC_STACK_TAG;
+        if (GTB_GET(block) == GT_UNKNOWN && gc_is_protected_type(block)) {
+            GTB_SET(block, GT_CLEAN);
+        }
+        #elif MICROPY_GC_INCREMENTAL
+        size_t tagged = block & GC_STACK_TAG;
+        block &= ~GC_STACK_TAG;
+        switch (ITB_GET(block)) {
+            case IT_GRAY:
+                ITB_SET(block, IT_CLEAN);
+                break;
+            case IT_UNKNOWN:
+                if (gc_is_protected_type(block)) {
+                    ITB_SET(block, IT_CLEAN);
+                } else if (incr_step) {
+                    // the program may store into it before the cycle ends
+                    ITB_SET(block, IT_DIRTY);
+                }
+                break;
+        }
+        #endif
+
         // work out number of consecutive blocks in the chain starting with this one
         size_t n_blocks = 0;
         do {
             n_blocks += 1;
         } while (ATB_GET_KIND(block + n_blocks) == AT_TAIL);
 
+        #if MICROPY_GC_INCREMENTAL
+        if (incr_step) {
+            MP_STATE_MEM(gc_incr_work) -= MIN(MP_STATE_MEM(gc_incr_work), n_blocks);
+        }
+        #endif
+
         // check this block's children
         void **ptrs = (void**)PTR_FROM_BLOCK(block);
         for (size_t i = n_blocks * BYTES_PER_BLOCK / sizeof(void*); i > 0; i--, ptrs++) {
             void *ptr = *ptrs;
+            #if MICROPY_GC_NURSERY
+            if (tagged && VERIFY_PTR(ptr)) {
+                // an old block may be owned by this one and have been written
+                // to through it (eg list items, map tables), so trace it too
+                size_t child = BLOCK_FROM_PTR(ptr);
+                if (ATB_GET_KIND(child) == AT_MARK && GTB_GET(child) == GT_CLEAN) {
+                    GTB_SET(child, GT_SCANNED);
+                    GC_PUSH(child);
+                }
+            }
+            #elif MICROPY_GC_INCREMENTAL
+            if (tagged && VERIFY_PTR(ptr) && ATB_GET_KIND(BLOCK_FROM_PTR(ptr)) == AT_MARK) {
+                // a block owned by this one may have been written to through
+                // it (eg list items, map tables), so trace it again too; it's
+                // left gray if it doesn't fit on the GC stack
+                size_t child = BLOCK_FROM_PTR(ptr);
+                ITB_SHADE(child);
+                GC_PUSH(child);
+            }
+            #endif
             VERIFY_MARK_AND_PUSH(ptr);
         }
     }
@@ -240,6 +630,7 @@ STATIC void gc_deal_with_stack_overflow(void) {
         for (size_t block = 0; block < MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB; block++) {
             // trace (again) if mark bit set
             if (ATB_GET_KIND(block) == AT_MARK) {
+                // in a minor collection this traces all old blocks as well
                 *MP_STATE_MEM(gc_sp)++ = block;
                 gc_drain_stack();
             }
@@ -247,57 +638,951 @@ STATIC void gc_deal_with_stack_overflow(void) {
     }
 }
 
-STATIC void gc_sweep(void) {
-    #if MICROPY_PY_GC_COLLECT_RETVAL
-    MP_STATE_MEM(gc_collected) = 0;
-    #endif
-    // free unmarked heads and their tails
-    int free_tail = 0;
-    for (size_t block = 0; block < MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB; block++) {
-        switch (ATB_GET_KIND(block)) {
-            case AT_HEAD:
-#if MICROPY_ENABLE_FINALISER
-                if (FTB_GET(block)) {
-                    mp_obj_base_t *obj = (mp_obj_base_t*)PTR_FROM_BLOCK(block);
-                    if (obj->type != NULL) {
-                        // if the object has a type then see if it has a __del__ method
-                        mp_obj_t dest[2];
-                        mp_load_method_maybe(MP_OBJ_FROM_PTR(obj), MP_QSTR___del__, dest);
-                        if (dest[0] != MP_OBJ_NULL) {
-                            // load_method returned a method, execute it in a protected environment
-                            #if MICROPY_ENABLE_SCHEDULER
-                            mp_sched_lock();
-                            #endif
-                            mp_call_function_1_protected(dest[0], dest[1]);
-                            #if MICROPY_ENABLE_SCHEDULER
-                            mp_sched_unlock();
-                            #endif
-                        }
-                    }
-                    // clear finaliser flag
-                    FTB_CLEAR(block);
-                }
-#endif
-                free_tail = 1;
-                DEBUG_printf("gc_sweep(%x)\n", PTR_FROM_BLOCK(block));
-                #if MICROPY_PY_GC_COLLECT_RETVAL
-                MP_STATE_MEM(gc_collected)++;
-                #endif
-                // fall through to free the head
-
-            case AT_TAIL:
-                if (free_tail) {
-                    ATB_ANY_TO_FREE(block);
-                }
-                break;
-
-            case AT_MARK:
-                ATB_MARK_TO_HEAD(block);
-                free_tail = 0;
-                break;
-        }
+#if MICROPY_GC_PARALLEL_MARK
+// Mark block, if it's an unmarked head, and push it on core c's GC stack.
+// Only core c may do this while the parallel mark runs.
+STATIC void gc_par_mark_push(size_t c, size_t block) {
+    if (ATB_GET_KIND(block) == AT_HEAD) {
+        ATB_HEAD_TO_MARK(block);
+        if (MP_STATE_MEM(gc_par_sp)[c] < MICROPY_GC_PARALLEL_STACK_SIZE) {
+            MP_STATE_MEM(gc_par_stack)[c][MP_STATE_MEM(gc_par_sp)[c]++] = block;
+        } else {
+            // it's marked, so gc_par_rescan() finds it
+            MP_STATE_MEM(gc_par_overflow)[c] = 1;
+        }
+    }
+}
+
+// Mark the blocks passed to core c by the other core.  Returns false if there
+// were none.
+STATIC bool gc_par_take(size_t c) {
+    size_t tail = MP_STATE_MEM(gc_par_queue_tail)[c];
+    size_t head = MP_STATE_MEM(gc_par_queue_head)[c];
+    if (tail == head) {
+        return false;
+    }
+    MP_STATE_MEM(gc_par_idle)[c] = 0;
+    GC_PAR_BARRIER();
+    do {
+        gc_par_mark_push(c, MP_STATE_MEM(gc_par_queue)[c][tail]);
+        tail = (tail + 1) % MICROPY_GC_PARALLEL_STACK_SIZE;
+    } while (tail != head);
+    GC_PAR_RELEASE();
+    MP_STATE_MEM(gc_par_queue_tail)[c] = tail;
+    return true;
+}
+
+// Trace the blocks on core c's GC stack, passing the children owned by the
+// other core to it.
+STATIC void gc_par_drain(size_t c) {
+    size_t other = c ^ 1;
+    while (MP_STATE_MEM(gc_par_sp)[c] > 0) {
+        size_t block = MP_STATE_MEM(gc_par_stack)[c][--MP_STATE_MEM(gc_par_sp)[c]];
+
+        // work out number of consecutive blocks in the chain starting with this one
+        size_t n_blocks = 0;
+        do {
+            n_blocks += 1;
+        } while (ATB_GET_KIND(block + n_blocks) == AT_TAIL);
+
+        // check this block's children
+        size_t head = MP_STATE_MEM(gc_par_queue_head)[other];
+        void **ptrs = (void**)PTR_FROM_BLOCK(block);
+        for (size_t i = n_blocks * BYTES_PER_BLOCK / sizeof(void*); i > 0; i--, ptrs++) {
+            void *ptr = *ptrs;
+            if (VERIFY_PTR(ptr)) {
+                size_t child = BLOCK_FROM_PTR(ptr);
+                if (GC_PAR_OWNER(child) == c) {
+                    gc_par_mark_push(c, child);
+                } else if (ATB_GET_KIND(child) == AT_HEAD) {
+                    // the other core skips it if it marked it meanwhile
+                    size_t next = (head + 1) % MICROPY_GC_PARALLEL_STACK_SIZE;
+                    while (next == MP_STATE_MEM(gc_par_queue_tail)[other]) {
+                        // wait for room in the queue, taking the blocks
+                        // passed to this core so the other one can't be
+                        // waiting for it too
+                        GC_PAR_RELEASE();
+                        MP_STATE_MEM(gc_par_queue_head)[other] = head;
+                        if (!gc_par_take(c)) {
+                            MICROPY_GC_PARALLEL_IDLE();
+                        }
+                    }
+                    MP_STATE_MEM(gc_par_queue)[other][head] = child;
+                    head = next;
+                }
+            }
+        }
+        if (head != MP_STATE_MEM(gc_par_queue_head)[other]) {
+            GC_PAR_RELEASE();
+            MP_STATE_MEM(gc_par_queue_head)[other] = head;
+        }
+    }
+}
+
+// Trace again the marked blocks owned by core c, after its GC stack
+// overflowed.
+STATIC void gc_par_rescan(size_t c) {
+    size_t end_block = MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB;
+    for (size_t chunk = c * MICROPY_GC_PARALLEL_CHUNK; chunk < end_block; chunk += 2 * MICROPY_GC_PARALLEL_CHUNK) {
+        for (size_t block = chunk; block < MIN(chunk + MICROPY_GC_PARALLEL_CHUNK, end_block); block++) {
+            if (ATB_GET_KIND(block) == AT_MARK) {
+                MP_STATE_MEM(gc_par_stack)[c][MP_STATE_MEM(gc_par_sp)[c]++] = block;
+                gc_par_drain(c);
+            }
+        }
+    }
+}
+
+// Do core c's part of the parallel mark, until both cores run out of work.
+// A core is idle when its GC stack and queue are empty and it has nothing to
+// trace again; it passes no blocks while idle, and clears its idle flag
+// before it takes any, so the work is done once an idle core finds, in this
+// order, the other core's queue empty, the other core idle and its own queue
+// empty.
+STATIC void gc_par_mark(size_t c) {
+    size_t other = c ^ 1;
+    for (;;) {
+        gc_par_drain(c);
+
+        if (gc_par_take(c)) {
+            continue;
+        }
+
+        if (MP_STATE_MEM(gc_par_overflow)[c]) {
+            MP_STATE_MEM(gc_par_overflow)[c] = 0;
+            gc_par_rescan(c);
+            continue;
+        }
+
+        MP_STATE_MEM(gc_par_idle)[c] = 1;
+        GC_PAR_BARRIER();
+        if (MP_STATE_MEM(gc_par_done)) {
+            break;
+        }
+        if (MP_STATE_MEM(gc_par_queue_tail)[other] == MP_STATE_MEM(gc_par_queue_head)[other]) {
+            GC_PAR_BARRIER();
+            if (MP_STATE_MEM(gc_par_idle)[other]) {
+                GC_PAR_BARRIER();
+                if (MP_STATE_MEM(gc_par_queue_tail)[c] == MP_STATE_MEM(gc_par_queue_head)[c]) {
+                    MP_STATE_MEM(gc_par_done) = 1;
+                    break;
+                }
+            }
+        }
+        MICROPY_GC_PARALLEL_IDLE();
+    }
+}
+
+void gc_mark_helper(void) {
+    gc_par_mark(1);
+}
+
+// Trace the heap from the roots marked by gc_collect_root(), on both cores if
+// the port can run the helper, else on this one.
+STATIC void gc_par_mark_all(void) {
+    if (gc_mark_helper_start()) {
+        gc_par_mark(0);
+        gc_mark_helper_wait();
+        return;
+    }
+    for (size_t c = 0; c < 2; c++) {
+        if (MP_STATE_MEM(gc_par_overflow)[c]) {
+            MP_STATE_MEM(gc_stack_overflow) = 1;
+        }
+        while (MP_STATE_MEM(gc_par_sp)[c] > 0) {
+            GC_PUSH(MP_STATE_MEM(gc_par_stack)[c][--MP_STATE_MEM(gc_par_sp)[c]]);
+            gc_drain_stack();
+        }
+    }
+}
+#endif
+
+#if MICROPY_GC_FREE_LISTS
+// the i-th run on the free list of size class c
+#define FREE_LIST_ENTRY(c, i) (MP_STATE_MEM(gc_free_list)[c][(MP_STATE_MEM(gc_free_list_head)[c] + (i)) % MICROPY_GC_FREE_LIST_DEPTH])
+
+// Forget the runs of free blocks from block on, which have changed.  The
+// free lists are filled again from there when they run out.
+STATIC void gc_free_list_reset(size_t block) {
+    block = MAX(block, FREE_LIST_FIRST_BLOCK);
+    for (size_t c = 0; c < MICROPY_GC_FREE_LIST_CLASSES; c++) {
+        while (MP_STATE_MEM(gc_free_list_len)[c] > 0
+            && FREE_LIST_ENTRY(c, MP_STATE_MEM(gc_free_list_len)[c] - 1) >= block) {
+            MP_STATE_MEM(gc_free_list_len)[c]--;
+        }
+        if (MP_STATE_MEM(gc_free_list_scan)[c] > block) {
+            MP_STATE_MEM(gc_free_list_scan)[c] = block;
+        }
+    }
+}
+
+// Add a run of n_blocks free blocks to the free list of its size class, in
+// address order, if it's before where the list was filled up to.
+STATIC void gc_free_list_push(size_t block, size_t n_blocks) {
+    if (block < FREE_LIST_FIRST_BLOCK) {
+        return;
+    }
+    size_t c = MIN(n_blocks, MICROPY_GC_FREE_LIST_CLASSES) - 1;
+    if (block >= MP_STATE_MEM(gc_free_list_scan)[c]) {
+        // the next fill of the list finds it
+        return;
+    }
+    size_t len = MP_STATE_MEM(gc_free_list_len)[c];
+    size_t i = len;
+    while (i > 0 && FREE_LIST_ENTRY(c, i - 1) > block) {
+        i--;
+    }
+    if (len == MICROPY_GC_FREE_LIST_DEPTH) {
+        // keep the lowest runs, the next fill starts from the one left out
+        if (i == len) {
+            MP_STATE_MEM(gc_free_list_scan)[c] = block;
+            return;
+        }
+        MP_STATE_MEM(gc_free_list_scan)[c] = FREE_LIST_ENTRY(c, len - 1);
+        len--;
+    }
+    for (size_t j = len; j > i; j--) {
+        FREE_LIST_ENTRY(c, j) = FREE_LIST_ENTRY(c, j - 1);
+    }
+    FREE_LIST_ENTRY(c, i) = block;
+    MP_STATE_MEM(gc_free_list_len)[c] = len + 1;
+}
+
+// Add the runs of free blocks of size class c found after where its list was
+// filled up to, until the list is full.  The blocks after the sweep in
+// progress are left out, as it may still free more of them.
+STATIC void gc_free_list_fill(size_t c) {
+    size_t total_blocks = MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB;
+    size_t end_block = total_blocks;
+    #if MICROPY_GC_INCREMENTAL
+    if (MP_STATE_MEM(gc_incr_phase) == GC_INCR_SWEEP) {
+        end_block = MP_STATE_MEM(gc_incr_sweep_block);
+    }
+    #endif
+    byte *atb = MP_STATE_MEM(gc_alloc_table_start);
+    size_t block = MP_STATE_MEM(gc_free_list_scan)[c];
+    size_t run = 0;
+    while (block < end_block && MP_STATE_MEM(gc_free_list_len)[c] < MICROPY_GC_FREE_LIST_DEPTH) {
+        if (run == 0 && block % BLOCKS_PER_ATB == 0 && block + BLOCKS_PER_ATB <= end_block) {
+            byte a = atb[block / BLOCKS_PER_ATB];
+            if (((a | (a >> 1)) & 0x55) == 0x55) {
+                // no free blocks in this ATB
+                block += BLOCKS_PER_ATB;
+                continue;
+            }
+        }
+        if (ATB_GET_KIND(block) == AT_FREE) {
+            run++;
+        } else if (run > 0) {
+            if (MIN(run, MICROPY_GC_FREE_LIST_CLASSES) - 1 == c) {
+                FREE_LIST_ENTRY(c, MP_STATE_MEM(gc_free_list_len)[c]++) = block - run;
+            }
+            run = 0;
+        }
+        block++;
+    }
+    if (run > 0) {
+        if (block < total_blocks) {
+            // the run may go on after the sweep, so look at it again
+            block -= run;
+        } else if (MIN(run, MICROPY_GC_FREE_LIST_CLASSES) - 1 == c) {
+            FREE_LIST_ENTRY(c, MP_STATE_MEM(gc_free_list_len)[c]++) = block - run;
+        }
+    }
+    MP_STATE_MEM(gc_free_list_scan)[c] = block;
+}
+
+// Take the lowest run of n_blocks free blocks from the free lists, trying the
+// smallest size class first.  Returns the first block of the run, or
+// (size_t)-1 if there is none.
+STATIC size_t gc_free_list_pop(size_t n_blocks) {
+    size_t total_blocks = MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB;
+    for (size_t c = n_blocks - 1; c < MICROPY_GC_FREE_LIST_CLASSES; c++) {
+        for (;;) {
+            if (MP_STATE_MEM(gc_free_list_len)[c] == 0) {
+                gc_free_list_fill(c);
+                if (MP_STATE_MEM(gc_free_list_len)[c] == 0) {
+                    break;
+                }
+            }
+            size_t block = FREE_LIST_ENTRY(c, 0);
+            MP_STATE_MEM(gc_free_list_head)[c] = (MP_STATE_MEM(gc_free_list_head)[c] + 1) % MICROPY_GC_FREE_LIST_DEPTH;
+            MP_STATE_MEM(gc_free_list_len)[c]--;
+            // the run may have been allocated, or grown into, since it was added
+            size_t n_free = 0;
+            while (n_free < n_blocks && block + n_free < total_blocks && ATB_GET_KIND(block + n_free) == AT_FREE) {
+                n_free++;
+            }
+            if (n_free < n_blocks) {
+                if (n_free > 0) {
+                    gc_free_list_push(block, n_free);
+                }
+                continue;
+            }
+            // what's left of the run goes on the list of its size
+            size_t rest = 0;
+            while (rest < MICROPY_GC_FREE_LIST_CLASSES && block + n_blocks + rest < total_blocks
+                   && ATB_GET_KIND(block + n_blocks + rest) == AT_FREE) {
+                rest++;
+            }
+            if (rest > 0) {
+                gc_free_list_push(block + n_blocks, rest);
+            }
+            return block;
+        }
+    }
+    return (size_t)-1;
+}
+#endif
+
+STATIC void gc_sweep_begin(size_t block) {
+    #if MICROPY_PY_GC_COLLECT_RETVAL
+    MP_STATE_MEM(gc_collected) = 0;
+    #endif
+    #if MICROPY_GC_FREE_LISTS
+    // the runs of free blocks from where the sweep starts grow
+    gc_free_list_reset(block);
+    #else
+    (void)block;
+    #endif
+    #if MICROPY_GC_COMPACT
+    MP_STATE_MEM(gc_compact_run) = 0;
+    MP_STATE_MEM(gc_compact_max_run) = 0;
+    #endif
+}
+
+// Free the unmarked heads from block up to end_block, and their tails.  Once
+// budget blocks have been swept it stops at the next block which isn't a
+// tail, and returns it.
+STATIC size_t gc_sweep_blocks(size_t block, size_t end_block, size_t budget) {
+    int free_tail = 0;
+    size_t stop_block = budget < end_block - block ? block + budget : end_block;
+    #if MICROPY_GC_COMPACT
+    size_t compact_run = MP_STATE_MEM(gc_compact_run);
+    size_t compact_max_run = MP_STATE_MEM(gc_compact_max_run);
+    #endif
+    for (; block < end_block; block++) {
+        if (block >= stop_block && ATB_GET_KIND(block) != AT_TAIL) {
+            break;
+        }
+        switch (ATB_GET_KIND(block)) {
+            case AT_HEAD:
+#if MICROPY_ENABLE_FINALISER
+                if (FTB_GET(block)) {
+                    mp_obj_base_t *obj = (mp_obj_base_t*)PTR_FROM_BLOCK(block);
+                    if (obj->type != NULL) {
+                        // if the object has a type then see if it has a __del__ method
+                        mp_obj_t dest[2];
+                        mp_load_method_maybe(MP_OBJ_FROM_PTR(obj), MP_QSTR___del__, dest);
+                        if (dest[0] != MP_OBJ_NULL) {
+                            // load_method returned a method, execute it in a protected environment
+                            #if MICROPY_ENABLE_SCHEDULER
+                            mp_sched_lock();
+                            #endif
+                            mp_call_function_1_protected(dest[0], dest[1]);
+                            #if MICROPY_ENABLE_SCHEDULER
+                            mp_sched_unlock();
+                            #endif
+                        }
+                    }
+                    // clear finaliser flag
+                    FTB_CLEAR(block);
+                }
+#endif
+                #if MICROPY_GC_NURSERY
+                GTB_SET(block, GT_CLEAN);
+                #elif MICROPY_GC_INCREMENTAL
+                ITB_SET(block, IT_CLEAN);
+                #endif
+                free_tail = 1;
+                DEBUG_printf("gc_sweep(%x)\n", PTR_FROM_BLOCK(block));
+                #if MICROPY_PY_GC_COLLECT_RETVAL
+                MP_STATE_MEM(gc_collected)++;
+                #endif
+                // fall through to free the head
+
+            case AT_TAIL:
+                if (free_tail) {
+                    ATB_ANY_TO_FREE(block);
+                }
+                break;
+
+            case AT_MARK:
+                #if !MICROPY_GC_NURSERY
+                ATB_MARK_TO_HEAD(block);
+                #endif
+                free_tail = 0;
+                break;
+        }
+        #if MICROPY_GC_COMPACT
+        #if MICROPY_GC_SPLIT_HEAP
+        if (block == MP_STATE_MEM(gc_fast_block)) {
+            compact_run = 0;
+        }
+        #endif
+        if (ATB_GET_KIND(block) == AT_FREE) {
+            if (++compact_run > compact_max_run) {
+                compact_max_run = compact_run;
+            }
+        } else {
+            compact_run = 0;
+        }
+        #endif
+    }
+    #if MICROPY_GC_COMPACT
+    MP_STATE_MEM(gc_compact_run) = compact_run;
+    MP_STATE_MEM(gc_compact_max_run) = compact_max_run;
+    #endif
+    return block;
+}
+
+STATIC void gc_sweep_end(void) {
+    #if MICROPY_GC_COMPACT
+    // ask for a compaction if a full sweep finds the free blocks split up
+    // more than the last compaction left them
+    size_t compact_max_run = MP_STATE_MEM(gc_compact_max_run);
+    if (
+        #if MICROPY_GC_NURSERY
+        !MP_STATE_MEM(gc_minor_active) &&
+        #endif
+        compact_max_run * BYTES_PER_BLOCK < MP_STATE_MEM(gc_compact_threshold)
+        && compact_max_run < MP_STATE_MEM(gc_compact_max_free)) {
+        MP_STATE_MEM(gc_compact_wanted) = 1;
+    }
+    #endif
+}
+
+STATIC void gc_sweep(void) {
+    size_t block = 0;
+    size_t end_block = MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB;
+    #if MICROPY_GC_NURSERY
+    if (MP_STATE_MEM(gc_minor_active)) {
+        // all unmarked heads are young, and lie in this range
+        block = MP_STATE_MEM(gc_young_start);
+        end_block = MP_STATE_MEM(gc_young_end);
+    }
+    #endif
+    gc_sweep_begin(block);
+    gc_sweep_blocks(block, end_block, (size_t)-1);
+    gc_sweep_end();
+}
+
+#if MICROPY_GC_INCREMENTAL
+// Sweep about budget blocks, from where the last call left off.  Returns true
+// when the whole heap has been swept, which ends the cycle.
+STATIC bool gc_incr_sweep(size_t budget) {
+    size_t block = MP_STATE_MEM(gc_incr_sweep_block);
+    size_t end_block = MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB;
+    MP_STATE_MEM(gc_incr_sweep_block) = gc_sweep_blocks(block, end_block, budget);
+    // the blocks freed here may be before where the allocator looks from
+    if (block / BLOCKS_PER_ATB < LAST_FREE_ATB_INDEX(block)) {
+        LAST_FREE_ATB_INDEX(block) = block / BLOCKS_PER_ATB;
+    }
+    #if MICROPY_GC_SPLIT_HEAP
+    if (MP_STATE_MEM(gc_incr_sweep_block) > MP_STATE_MEM(gc_fast_block)) {
+        size_t fast_block = MAX(block, MP_STATE_MEM(gc_fast_block));
+        if (fast_block / BLOCKS_PER_ATB < MP_STATE_MEM(gc_fast_last_free_atb_index)) {
+            MP_STATE_MEM(gc_fast_last_free_atb_index) = fast_block / BLOCKS_PER_ATB;
+        }
+        MP_STATE_MEM(gc_fast_full_blocks) = (size_t)-1;
+    }
+    #endif
+    if (MP_STATE_MEM(gc_incr_sweep_block) < end_block) {
+        return false;
+    }
+    gc_sweep_end();
+    MP_STATE_MEM(gc_incr_phase) = GC_INCR_IDLE;
+    MP_STATE_MEM(gc_incr_completed) = 1;
+    return true;
+}
+#endif
+
+#if MICROPY_GC_NURSERY
+// Clear the marks of all old blocks, and forget the remembered set, before a
+// full collection.
+STATIC void gc_unmark_all(void) {
+    byte *atb = MP_STATE_MEM(gc_alloc_table_start);
+    byte *gtb = MP_STATE_MEM(gc_gen_table_start);
+    for (size_t i = 0; i < MP_STATE_MEM(gc_alloc_table_byte_len); i++) {
+        // MARK -> HEAD
+        byte a = atb[i];
+        atb[i] = a & ~((a & (a >> 1) & 0x55) << 1);
+        // REMEMBERED, SCANNED -> CLEAN
+        byte g = gtb[i];
+        gtb[i] = g & ((g & (g >> 1) & 0x55) * 3);
+    }
+}
+
+// Trace the old blocks that a minor collection can't otherwise reach: the
+// remembered ones and the ones which aren't protected by a write barrier.
+STATIC void gc_trace_remembered(void) {
+    byte *gtb = MP_STATE_MEM(gc_gen_table_start);
+    for (size_t i = 0; i < MP_STATE_MEM(gc_alloc_table_byte_len); i++) {
+        if (gtb[i] == 0) {
+            continue;
+        }
+        for (size_t block = i * BLOCKS_PER_ATB; block < (i + 1) * BLOCKS_PER_ATB; block++) {
+            size_t gt = GTB_GET(block);
+            if ((gt == GT_REMEMBERED || gt == GT_UNKNOWN) && ATB_GET_KIND(block) == AT_MARK) {
+                if (gt == GT_REMEMBERED) {
+                    GTB_SET(block, GT_SCANNED);
+                }
+                GC_PUSH(block | GC_STACK_TAG);
+                gc_drain_stack();
+            }
+        }
+    }
+}
+
+// SCANNED -> CLEAN, after a minor collection
+STATIC void gc_clear_scanned(void) {
+    byte *gtb = MP_STATE_MEM(gc_gen_table_start);
+    for (size_t i = 0; i < MP_STATE_MEM(gc_alloc_table_byte_len); i++) {
+        byte g = gtb[i];
+        gtb[i] = g & ~(g & ~(g << 1) & 0xaa);
+    }
+}
+
+// Blocks referenced directly from the roots may be in the middle of being
+// constructed, and the stores that complete them aren't covered by a write
+// barrier.  So they are traced tagged, and remembered so that the next minor
+// collection traces them again.
+STATIC void gc_mark_root(void *ptr) {
+    if (!VERIFY_PTR(ptr)) {
+        return;
+    }
+    size_t block = BLOCK_FROM_PTR(ptr);
+    size_t kind = ATB_GET_KIND(block);
+    size_t gt = GTB_GET(block);
+    bool minor = MP_STATE_MEM(gc_minor_active);
+    bool push;
+    if (kind == AT_HEAD) {
+        DEBUG_printf("gc_mark(%p)\n", ptr);
+        ATB_HEAD_TO_MARK(block);
+        push = true;
+    } else if (kind == AT_MARK) {
+        // an old block, or one already marked by this collection
+        push = minor && (gt == GT_CLEAN || gt == GT_SCANNED);
+    } else {
+        return;
+    }
+    if (gt == GT_UNKNOWN && gc_is_protected_type(block)) {
+        gt = GT_CLEAN;
+    }
+    if (gt != GT_UNKNOWN) {
+        GTB_SET(block, GT_REMEMBERED);
+    }
+    if (push) {
+        GC_PUSH(minor ? block | GC_STACK_TAG : block);
+    }
+}
+#endif
+
+#if MICROPY_GC_INCREMENTAL
+// At the start of a cycle the roots are only marked, and left for the steps
+// to trace.  Objects among them may be in the middle of being constructed,
+// and the stores that complete them aren't covered by a write barrier, so
+// they are traced again at the end of the cycle.  At the end of the cycle
+// all the roots are traced, along with the blocks they own.
+STATIC void gc_incr_mark_root(void *ptr) {
+    if (!VERIFY_PTR(ptr)) {
+        return;
+    }
+    size_t block = BLOCK_FROM_PTR(ptr);
+    size_t kind = ATB_GET_KIND(block);
+    switch (MP_STATE_MEM(gc_incr_phase)) {
+        case GC_INCR_START:
+            if (kind == AT_HEAD) {
+                ATB_HEAD_TO_MARK(block);
+                if (gc_is_protected_type(block)) {
+                    ITB_SET(block, IT_DIRTY);
+                } else {
+                    ITB_SHADE(block);
+                }
+                GC_PUSH(block);
+            }
+            break;
+
+        case GC_INCR_FINISH:
+            if (kind == AT_HEAD) {
+                ATB_HEAD_TO_MARK(block);
+                ITB_SHADE(block);
+            } else if (kind != AT_MARK) {
+                break;
+            }
+            GC_PUSH_TAGGED(block);
+            break;
+
+        default:
+            VERIFY_MARK_AND_PUSH(ptr);
+            break;
+    }
+}
+
+// Trace the blocks which were marked by this cycle and still have to be
+// traced: those that didn't fit on the GC stack, and, at the end of the
+// cycle, the dirty ones.  Returns false if it ran out of work budget.
+STATIC bool gc_incr_trace_pending(void) {
+    byte *itb = MP_STATE_MEM(gc_incr_table_start);
+    bool finish = MP_STATE_MEM(gc_incr_phase) == GC_INCR_FINISH;
+    bool dirty = finish || MP_STATE_MEM(gc_incr_rescan_dirty);
+    size_t i = MP_STATE_MEM(gc_incr_cursor);
+    for (; i < MP_STATE_MEM(gc_alloc_table_byte_len); i++) {
+        if (!finish && (i & 63) == 0) {
+            // scanning the table counts as work too
+            if (MP_STATE_MEM(gc_incr_work) == 0) {
+                MP_STATE_MEM(gc_incr_cursor) = i;
+                return false;
+            }
+            MP_STATE_MEM(gc_incr_work)--;
+        }
+        if (itb[i] == 0) {
+            continue;
+        }
+        bool found = false;
+        for (size_t block = i * BLOCKS_PER_ATB; block < (i + 1) * BLOCKS_PER_ATB; block++) {
+            if (ATB_GET_KIND(block) != AT_MARK) {
+                continue;
+            }
+            size_t it = ITB_GET(block);
+            if (it == IT_DIRTY && dirty) {
+                if (finish) {
+                    // after this cycle it's only dirty if it's not protected
+                    ITB_SET(block, gc_is_protected_type(block) ? IT_CLEAN : IT_UNKNOWN);
+                    GC_PUSH_TAGGED(block);
+                } else if (MP_STATE_MEM(gc_incr_precleaned) && gc_is_protected_type(block)) {
+                    // the write barrier makes it dirty again if it's stored
+                    // into before the end of the cycle
+                    ITB_SET(block, IT_CLEAN);
+                    GC_PUSH_TAGGED(block);
+                } else {
+                    GC_PUSH(block);
+                }
+                found = true;
+            } else if (it == IT_GRAY || it == IT_UNKNOWN) {
+                GC_PUSH(block);
+                found = true;
+            }
+        }
+        if (found) {
+            MP_STATE_MEM(gc_incr_found) = 1;
+            gc_drain_stack();
+            if (!finish && MP_STATE_MEM(gc_incr_work) == 0) {
+                MP_STATE_MEM(gc_incr_cursor) = i + 1;
+                return false;
+            }
+        }
+    }
+    MP_STATE_MEM(gc_incr_cursor) = 0;
+    return true;
+}
+
+// Do up to gc_incr_work blocks of tracing.  Returns true when everything
+// reachable from the blocks marked so far has been traced.
+STATIC bool gc_incr_mark(void) {
+    for (;;) {
+        gc_drain_stack();
+        if (MP_STATE_MEM(gc_incr_work) == 0) {
+            return false;
+        }
+        if (MP_STATE_MEM(gc_incr_cursor) == 0) {
+            // start a pass over the heap, which picks up the blocks that
+            // didn't fit on the GC stack
+            MP_STATE_MEM(gc_incr_found) = 0;
+            MP_STATE_MEM(gc_stack_overflow) = 0;
+        }
+        if (!gc_incr_trace_pending()) {
+            return false;
+        }
+        MP_STATE_MEM(gc_incr_rescan_dirty) = 0;
+        if (!MP_STATE_MEM(gc_incr_found) && !MP_STATE_MEM(gc_stack_overflow)) {
+            return true;
+        }
+    }
+}
+#endif
+
+#if MICROPY_GC_COMPACT
+// Compaction moves the payload of an object -- the data of a bytes, bytearray
+// or array object, or the map table of a dict or instance -- down into free
+// blocks, and updates the object's pointer to it.  The heap is conservative,
+// so a payload is only moved if that pointer is the only reference to it from
+// the roots and the heap, counting pointers into the middle of it.  While
+// compacting, the head of a payload claimed by one object is AT_MARK, and one
+// claimed by several objects also has its FTB set; any other reference turns
+// it back into AT_HEAD.  Payloads never have finalisers.
+
+// If the object at block has a payload, return the address of its pointer to
+// it, and the number of bytes the payload must have.  The checks on the sizes
+// filter out data which just looks like such an object.
+STATIC void **gc_compact_owner_field(size_t block, size_t *n_bytes) {
+    mp_obj_base_t *obj = (mp_obj_base_t*)PTR_FROM_BLOCK(block);
+    const mp_obj_type_t *type = obj->type;
+    #if MICROPY_PY_BUILTINS_BYTEARRAY || MICROPY_PY_ARRAY
+    if (
+        #if MICROPY_PY_BUILTINS_BYTEARRAY
+        type == &mp_type_bytearray ||
+        #endif
+        #if MICROPY_PY_ARRAY
+        type == &mp_type_array ||
+        #endif
+        false) {
+        mp_obj_array_t *o = (mp_obj_array_t*)obj;
+        size_t item_sz = mp_binary_get_size('@', o->typecode, NULL);
+        if (item_sz == 0) {
+            return NULL;
+        }
+        *n_bytes = (o->len + o->free) * item_sz;
+        return &o->items;
+    }
+    #endif
+    if (type == &mp_type_bytes) {
+        mp_obj_str_t *o = (mp_obj_str_t*)obj;
+        // the data is followed by a null byte
+        *n_bytes = o->len + 1;
+        return (void**)&o->data;
+    }
+    mp_map_t *map = NULL;
+    if (type == &mp_type_dict
+        #if MICROPY_PY_COLLECTIONS_ORDEREDDICT
+        || type == &mp_type_ordereddict
+        #endif
+        ) {
+        map = &((mp_obj_dict_t*)obj)->map;
+    } else if (VERIFY_PTR((void*)type) && ((mp_obj_base_t*)type)->type == &mp_type_type
+        && mp_obj_is_instance_type(type)) {
+        map = &((mp_obj_instance_t*)obj)->members;
+    }
+    if (map != NULL && !map->is_fixed && map->used <= map->alloc) {
+        *n_bytes = mp_map_table_bytes(map->alloc, map->is_ordered);
+        return (void**)&map->table;
+    }
+    return NULL;
+}
+
+// Return the payload of the object at block, or (size_t)-1 if it has none.
+STATIC size_t gc_compact_payload(size_t block) {
+    size_t n_bytes;
+    void **field = gc_compact_owner_field(block, &n_bytes);
+    if (field == NULL || !VERIFY_PTR(*field)) {
+        return (size_t)-1;
+    }
+    size_t payload = BLOCK_FROM_PTR(*field);
+    if (payload == block || (void*)PTR_FROM_BLOCK(payload) != *field
+        || ATB_GET_KIND(payload) == AT_FREE || ATB_GET_KIND(payload) == AT_TAIL) {
+        return (size_t)-1;
+    }
+    size_t n_blocks = 1;
+    while (n_blocks * BYTES_PER_BLOCK < n_bytes) {
+        if (ATB_GET_KIND(payload + n_blocks) != AT_TAIL) {
+            return (size_t)-1;
+        }
+        n_blocks++;
+    }
+    return payload;
+}
+
+// Mark the payloads claimed by the objects in the heap.
+STATIC void gc_compact_claim(void) {
+    #if MICROPY_GC_NURSERY
+    // the collection just done left all blocks old
+    gc_unmark_all();
+    #endif
+    size_t end_block = MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB;
+    for (size_t block = 0; block < end_block; block++) {
+        size_t kind = ATB_GET_KIND(block);
+        if (kind != AT_HEAD && kind != AT_MARK) {
+            continue;
+        }
+        size_t payload = gc_compact_payload(block);
+        if (payload == (size_t)-1) {
+            continue;
+        }
+        if (ATB_GET_KIND(payload) == AT_MARK) {
+            FTB_SET(payload);
+        } else if (!FTB_GET(payload)) {
+            ATB_HEAD_TO_MARK(payload);
+        }
+    }
+}
+
+// ptr is a reference from somewhere else than its owner, so if it points into
+// a payload that payload can't be moved.
+STATIC void gc_compact_pin(void *ptr) {
+    if (!IN_POOL(ptr)) {
+        return;
+    }
+    size_t block = BLOCK_FROM_PTR(ptr);
+    if (ATB_GET_KIND(block) == AT_FREE) {
+        return;
+    }
+    while (ATB_GET_KIND(block) == AT_TAIL) {
+        block--;
+    }
+    if (ATB_GET_KIND(block) == AT_MARK) {
+        ATB_MARK_TO_HEAD(block);
+        FTB_CLEAR(block);
+    }
+}
+
+// Pin the payloads referenced from the heap, other than by their owners.
+STATIC void gc_compact_pin_heap(void) {
+    size_t end_block = MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB;
+    for (size_t block = 0; block < end_block; block++) {
+        size_t kind = ATB_GET_KIND(block);
+        if (kind != AT_HEAD && kind != AT_MARK) {
+            continue;
+        }
+        void **owner_field = NULL;
+        if (gc_compact_payload(block) != (size_t)-1) {
+            size_t n_bytes;
+            owner_field = gc_compact_owner_field(block, &n_bytes);
+        }
+        void **ptr = (void**)PTR_FROM_BLOCK(block);
+        do {
+            void **top = (void**)((byte*)ptr + BYTES_PER_BLOCK);
+            for (; ptr < top; ptr++) {
+                if (ptr != owner_field) {
+                    gc_compact_pin(*ptr);
+                }
+            }
+            block++;
+        } while (block < end_block && ATB_GET_KIND(block) == AT_TAIL);
+        block--;
+    }
+}
+
+// Find the lowest run of n_blocks blocks from block from which are either
+// free or part of the run at block; returns block if there is no lower one.
+STATIC size_t gc_compact_find(size_t from, size_t block, size_t n_blocks) {
+    size_t n_free = 0;
+    for (size_t bl = from; bl < block + n_blocks; bl++) {
+        if (bl >= block || ATB_GET_KIND(bl) == AT_FREE) {
+            if (++n_free == n_blocks) {
+                return bl + 1 - n_blocks;
+            }
+        } else {
+            n_free = 0;
+        }
+    }
+    return block;
+}
+
+// Move the payloads which are still marked as far down as they go, in the
+// order of their owners.  Returns the number of blocks moved.
+STATIC size_t gc_compact_move(void) {
+    size_t end_block = MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB;
+    // lowest block which may be free, in each region
+    #if MICROPY_GC_SPLIT_HEAP
+    size_t lowest[2] = { 0, MP_STATE_MEM(gc_fast_block) };
+    #else
+    size_t lowest[1] = { 0 };
+    #endif
+    size_t moved = 0;
+    for (size_t block = 0; block < end_block; block++) {
+        size_t kind = ATB_GET_KIND(block);
+        if (kind != AT_HEAD && kind != AT_MARK) {
+            continue;
+        }
+        size_t payload = gc_compact_payload(block);
+        if (payload == (size_t)-1 || ATB_GET_KIND(payload) != AT_MARK || FTB_GET(payload)) {
+            continue;
+        }
+        ATB_MARK_TO_HEAD(payload);
+        size_t n_blocks = 1;
+        while (payload + n_blocks < end_block && ATB_GET_KIND(payload + n_blocks) == AT_TAIL) {
+            n_blocks++;
+        }
+        #if MICROPY_GC_SPLIT_HEAP
+        size_t *from = &lowest[payload >= MP_STATE_MEM(gc_fast_block)];
+        #else
+        size_t *from = &lowest[0];
+        #endif
+        while (*from < payload && ATB_GET_KIND(*from) != AT_FREE) {
+            *from += 1;
+        }
+        size_t dest = gc_compact_find(*from, payload, n_blocks);
+        if (dest == payload) {
+            continue;
+        }
+
+        // the runs may overlap, so free the old one before taking the new one
+        #if MICROPY_GC_NURSERY
+        size_t gt = GTB_GET(payload);
+        GTB_SET(payload, GT_CLEAN);
+        #elif MICROPY_GC_INCREMENTAL
+        size_t it = ITB_GET(payload);
+        ITB_SET(payload, IT_CLEAN);
+        #endif
+        for (size_t bl = payload; bl < payload + n_blocks; bl++) {
+            ATB_ANY_TO_FREE(bl);
+        }
+        ATB_FREE_TO_HEAD(dest);
+        for (size_t bl = dest + 1; bl < dest + n_blocks; bl++) {
+            ATB_FREE_TO_TAIL(bl);
+        }
+        #if MICROPY_GC_NURSERY
+        GTB_SET(dest, gt);
+        #elif MICROPY_GC_INCREMENTAL
+        ITB_SET(dest, it);
+        #endif
+        memmove((void*)PTR_FROM_BLOCK(dest), (void*)PTR_FROM_BLOCK(payload), n_blocks * BYTES_PER_BLOCK);
+        size_t n_bytes;
+        *gc_compact_owner_field(block, &n_bytes) = (void*)PTR_FROM_BLOCK(dest);
+        moved += n_blocks;
+    }
+
+    // payloads claimed by several objects are left where they are
+    size_t n_free = 0;
+    MP_STATE_MEM(gc_compact_max_free) = 0;
+    for (size_t block = 0; block < end_block; block++) {
+        size_t kind = ATB_GET_KIND(block);
+        if (kind == AT_MARK) {
+            ATB_MARK_TO_HEAD(block);
+            FTB_CLEAR(block);
+        }
+        #if MICROPY_GC_NURSERY
+        if (kind == AT_HEAD || kind == AT_MARK) {
+            // all blocks are old again
+            ATB_HEAD_TO_MARK(block);
+        }
+        #endif
+        #if MICROPY_GC_SPLIT_HEAP
+        if (block == MP_STATE_MEM(gc_fast_block)) {
+            n_free = 0;
+        }
+        #endif
+        if (kind == AT_FREE) {
+            if (++n_free > MP_STATE_MEM(gc_compact_max_free)) {
+                MP_STATE_MEM(gc_compact_max_free) = n_free;
+            }
+        } else {
+            n_free = 0;
+        }
+    }
+    return moved;
+}
+
+size_t gc_compact(void) {
+    GC_ENTER();
+    MP_STATE_MEM(gc_compact_wanted) = 0;
+    if (MP_STATE_MEM(gc_lock_depth) > 0
+        #if MICROPY_GC_INCREMENTAL
+        || MP_STATE_MEM(gc_incr_phase) != GC_INCR_IDLE
+        #endif
+        ) {
+        GC_EXIT();
+        return 0;
     }
+    MP_STATE_MEM(gc_compact_active) = 1;
+    MP_STATE_MEM(gc_compact_moved) = 0;
+    GC_EXIT();
+    // the port's gc_collect() reports the roots, which pin the payloads they
+    // point into, and gc_collect_end() moves the rest
+    gc_collect();
+    return MP_STATE_MEM(gc_compact_moved) * BYTES_PER_BLOCK;
 }
+#endif
 
 void gc_collect_start(void) {
     GC_ENTER();
@@ -307,25 +1592,184 @@ void gc_collect_start(void) {
     #endif
     MP_STATE_MEM(gc_stack_overflow) = 0;
     MP_STATE_MEM(gc_sp) = MP_STATE_MEM(gc_stack);
+    #if MICROPY_GC_PARALLEL_MARK
+    for (size_t c = 0; c < 2; c++) {
+        MP_STATE_MEM(gc_par_sp)[c] = 0;
+        MP_STATE_MEM(gc_par_queue_head)[c] = 0;
+        MP_STATE_MEM(gc_par_queue_tail)[c] = 0;
+        MP_STATE_MEM(gc_par_idle)[c] = 0;
+        MP_STATE_MEM(gc_par_overflow)[c] = 0;
+    }
+    MP_STATE_MEM(gc_par_done) = 0;
+    #endif
+    #if MICROPY_GC_COMPACT
+    if (MP_STATE_MEM(gc_compact_active)) {
+        gc_compact_claim();
+        goto trace_roots;
+    }
+    #endif
+    #if MICROPY_GC_NURSERY
+    MP_STATE_MEM(gc_pause_start_us) = mp_hal_ticks_us();
+    MP_STATE_MEM(gc_minor_active) = MP_STATE_MEM(gc_minor_pending);
+    MP_STATE_MEM(gc_minor_pending) = 0;
+    if (MP_STATE_MEM(gc_minor_active)) {
+        gc_trace_remembered();
+    } else {
+        gc_unmark_all();
+    }
+    #endif
+    #if MICROPY_GC_INCREMENTAL
+    if (MP_STATE_MEM(gc_incr_phase) == GC_INCR_SWEEP) {
+        // the marks ahead of the sweep would keep the garbage they are on
+        gc_incr_sweep((size_t)-1);
+    }
+    if (MP_STATE_MEM(gc_incr_phase) == GC_INCR_MARK) {
+        // finish the marking in progress; the blocks left on the GC stack by
+        // the last step are still gray, so are found again here
+        MP_STATE_MEM(gc_incr_phase) = GC_INCR_FINISH;
+        MP_STATE_MEM(gc_incr_cursor) = 0;
+        gc_incr_trace_pending();
+    }
+    #endif
+    #if MICROPY_GC_COMPACT
+trace_roots:;
+    #endif
     // Trace root pointers.  This relies on the root pointers being organised
     // correctly in the mp_state_ctx structure.  We scan nlr_top, dict_locals,
     // dict_globals, then the root pointer section of mp_state_vm.
     void **ptrs = (void**)(void*)&mp_state_ctx;
     gc_collect_root(ptrs, offsetof(mp_state_ctx_t, vm.qstr_last_chunk) / sizeof(void*));
+    #if MICROPY_ENABLE_SCHEDULER
+    // ISRs queue callbacks without a write barrier, so the scheduler queue
+    // is traced as roots every time
+    if (MP_STATE_VM(sched_queue) != NULL) {
+        gc_collect_root((void**)MP_STATE_VM(sched_queue),
+            MICROPY_SCHEDULER_PRIORITIES * (MP_STATE_VM(sched_mask) + 1) * sizeof(mp_sched_item_t) / sizeof(void*));
+    }
+    #endif
 }
 
 void gc_collect_root(void **ptrs, size_t len) {
+    #if MICROPY_GC_COMPACT
+    if (MP_STATE_MEM(gc_compact_active)) {
+        for (size_t i = 0; i < len; i++) {
+            gc_compact_pin(ptrs[i]);
+            if (((uintptr_t)ptrs[i] & (BYTES_PER_BLOCK - 1)) == 0) {
+                // C code may hold a pointer just past the end of a payload
+                gc_compact_pin((byte*)ptrs[i] - 1);
+            }
+        }
+        return;
+    }
+    #endif
     for (size_t i = 0; i < len; i++) {
         void *ptr = ptrs[i];
+        #if MICROPY_GC_NURSERY
+        gc_mark_root(ptr);
+        #elif MICROPY_GC_INCREMENTAL
+        gc_incr_mark_root(ptr);
+        if (MP_STATE_MEM(gc_incr_phase) == GC_INCR_START) {
+            // tracing is left to gc_collect_step()
+            continue;
+        }
+        #elif MICROPY_GC_PARALLEL_MARK
+        // tracing is left to gc_par_mark_all()
+        if (VERIFY_PTR(ptr)) {
+            size_t block = BLOCK_FROM_PTR(ptr);
+            gc_par_mark_push(GC_PAR_OWNER(block), block);
+        }
+        continue;
+        #else
         VERIFY_MARK_AND_PUSH(ptr);
+        #endif
         gc_drain_stack();
     }
 }
 
 void gc_collect_end(void) {
+    #if MICROPY_GC_COMPACT
+    if (MP_STATE_MEM(gc_compact_active)) {
+        MP_STATE_MEM(gc_compact_active) = 0;
+        gc_compact_pin_heap();
+        MP_STATE_MEM(gc_compact_moved) = gc_compact_move();
+        #if MICROPY_GC_NURSERY
+        // gc_compact_move() left all blocks old
+        MP_STATE_MEM(gc_young_blocks) = 0;
+        MP_STATE_MEM(gc_young_start) = MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB;
+        MP_STATE_MEM(gc_young_end) = 0;
+        #endif
+        #if MICROPY_GC_FREE_LISTS
+        // the free runs have moved
+        gc_free_list_reset(0);
+        #endif
+        goto reset_free;
+    }
+    #endif
+    #if MICROPY_GC_INCREMENTAL
+    if (MP_STATE_MEM(gc_incr_phase) == GC_INCR_START) {
+        // the roots are marked, the first step picks them up from the GC
+        // stack, or from the heap if they didn't fit on it
+        MP_STATE_MEM(gc_incr_phase) = GC_INCR_MARK;
+        MP_STATE_MEM(gc_incr_cursor) = 0;
+        MP_STATE_MEM(gc_incr_rescan_dirty) = MP_STATE_MEM(gc_stack_overflow);
+        MP_STATE_MEM(gc_incr_precleaned) = 0;
+        MP_STATE_MEM(gc_lock_depth)--;
+        GC_EXIT();
+        return;
+    }
+    if (MP_STATE_MEM(gc_incr_phase) == GC_INCR_FINISH) {
+        // the blocks which didn't fit on the GC stack were left gray or
+        // dirty, so there's no need to trace the whole heap again
+        while (MP_STATE_MEM(gc_stack_overflow)) {
+            MP_STATE_MEM(gc_stack_overflow) = 0;
+            MP_STATE_MEM(gc_sp) = MP_STATE_MEM(gc_stack);
+            gc_incr_trace_pending();
+        }
+        if (MP_STATE_MEM(gc_incr_sweep_later)) {
+            // the marking is complete, the following steps sweep
+            gc_sweep_begin(0);
+            MP_STATE_MEM(gc_incr_phase) = GC_INCR_SWEEP;
+            MP_STATE_MEM(gc_incr_sweep_block) = 0;
+            goto reset_free;
+        }
+        // the cycle is ended by this collection
+        MP_STATE_MEM(gc_incr_completed) = 1;
+    }
+    MP_STATE_MEM(gc_incr_phase) = GC_INCR_IDLE;
+    #endif
+    #if MICROPY_GC_PARALLEL_MARK
+    gc_par_mark_all();
+    #endif
     gc_deal_with_stack_overflow();
     gc_sweep();
+    #if MICROPY_GC_NURSERY
+    if (MP_STATE_MEM(gc_minor_active)) {
+        gc_clear_scanned();
+    }
+    MP_STATE_MEM(gc_young_blocks) = 0;
+    MP_STATE_MEM(gc_young_start) = MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB;
+    MP_STATE_MEM(gc_young_end) = 0;
+    uint32_t pause_us = mp_hal_ticks_us() - MP_STATE_MEM(gc_pause_start_us);
+    if (MP_STATE_MEM(gc_minor_active)) {
+        MP_STATE_MEM(gc_minor_count)++;
+        MP_STATE_MEM(gc_minor_last_us) = pause_us;
+    } else {
+        MP_STATE_MEM(gc_major_count)++;
+        MP_STATE_MEM(gc_major_last_us) = pause_us;
+    }
+    if (pause_us > MP_STATE_MEM(gc_max_pause_us)) {
+        MP_STATE_MEM(gc_max_pause_us) = pause_us;
+    }
+    MP_STATE_MEM(gc_minor_active) = 0;
+    #endif
+    #if MICROPY_GC_COMPACT || MICROPY_GC_INCREMENTAL
+reset_free:
+    #endif
     MP_STATE_MEM(gc_last_free_atb_index) = 0;
+    #if MICROPY_GC_SPLIT_HEAP
+    MP_STATE_MEM(gc_fast_last_free_atb_index) = MP_STATE_MEM(gc_fast_block) / BLOCKS_PER_ATB;
+    MP_STATE_MEM(gc_fast_full_blocks) = (size_t)-1;
+    #endif
     MP_STATE_MEM(gc_lock_depth)--;
     GC_EXIT();
 }
@@ -333,6 +1777,10 @@ void gc_collect_end(void) {
 void gc_info(gc_info_t *info) {
     GC_ENTER();
     info->total = MP_STATE_MEM(gc_pool_end) - MP_STATE_MEM(gc_pool_start);
+    #if MICROPY_GC_SPLIT_HEAP
+    info->fast_total = MP_STATE_MEM(gc_fast_pool_end) - MP_STATE_MEM(gc_fast_pool_start);
+    info->total += info->fast_total;
+    #endif
     info->used = 0;
     info->free = 0;
     info->max_free = 0;
@@ -350,6 +1798,9 @@ void gc_info(gc_info_t *info) {
                 break;
 
             case AT_HEAD:
+            #if MICROPY_GC_NURSERY || MICROPY_GC_INCREMENTAL
+            case AT_MARK:
+            #endif
                 info->used += 1;
                 len = 1;
                 break;
@@ -359,19 +1810,31 @@ void gc_info(gc_info_t *info) {
                 len += 1;
                 break;
 
+            #if !MICROPY_GC_NURSERY && !MICROPY_GC_INCREMENTAL
             case AT_MARK:
                 // shouldn't happen
                 break;
+            #endif
         }
 
         block++;
         finish = (block == MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB);
+        #if MICROPY_GC_SPLIT_HEAP
+        if (block == MP_STATE_MEM(gc_fast_block)) {
+            // a free run ends with the main region
+            if (len_free > info->max_free) {
+                info->max_free = len_free;
+            }
+            len_free = 0;
+            info->fast_free = info->free;
+        }
+        #endif
         // Get next block type if possible
         if (!finish) {
             kind = ATB_GET_KIND(block);
         }
 
-        if (finish || kind == AT_FREE || kind == AT_HEAD) {
+        if (finish || kind == AT_FREE || ATB_KIND_IS_HEAD(kind)) {
             if (len == 1) {
                 info->num_1block += 1;
             } else if (len == 2) {
@@ -380,7 +1843,7 @@ void gc_info(gc_info_t *info) {
             if (len > info->max_block) {
                 info->max_block = len;
             }
-            if (finish || kind == AT_HEAD) {
+            if (finish || ATB_KIND_IS_HEAD(kind)) {
                 if (len_free > info->max_free) {
                     info->max_free = len_free;
                 }
@@ -391,9 +1854,79 @@ void gc_info(gc_info_t *info) {
 
     info->used *= BYTES_PER_BLOCK;
     info->free *= BYTES_PER_BLOCK;
+    #if MICROPY_GC_SPLIT_HEAP
+    // fast_free was set to the free blocks of the main region
+    info->fast_free = info->free - info->fast_free * BYTES_PER_BLOCK;
+    info->fast_used = info->fast_total - info->fast_free;
+    #endif
     GC_EXIT();
 }
 
+#if MICROPY_PY_MICROPYTHON_HEAP_PROFILE
+// Count an allocation against the bytecode instruction being run.  Site 0 is
+// for allocations made outside of bytecode, and those which find no free site.
+STATIC void gc_profile_alloc(size_t n_bytes) {
+    mp_heap_profile_site_t *sites = MP_STATE_VM(heap_profile_sites);
+    mp_heap_profile_site_t *site = &sites[0];
+    mp_code_state_t *code_state = MP_STATE_THREAD(current_code_state);
+    if (code_state != NULL) {
+        const byte *ip = code_state->ip;
+        size_t hash = (uintptr_t)ip ^ ((uintptr_t)ip >> 7);
+        for (size_t n = 0; n < MICROPY_PY_MICROPYTHON_HEAP_PROFILE_SITES - 1; n++) {
+            mp_heap_profile_site_t *s = &sites[1 + (hash + n) % (MICROPY_PY_MICROPYTHON_HEAP_PROFILE_SITES - 1)];
+            if (s->n_allocs == 0) {
+                s->bytecode = code_state->fun_bc->bytecode;
+                s->ip = ip;
+                site = s;
+                break;
+            }
+            if (s->ip == ip) {
+                site = s;
+                break;
+            }
+        }
+    }
+    site->n_bytes += n_bytes;
+    site->n_allocs += 1;
+}
+#endif
+
+// Update the state kept about allocations for the blocks from start_block to
+// end_block, just allocated.
+STATIC void gc_alloc_account(size_t start_block, size_t end_block) {
+    size_t n_blocks = end_block - start_block + 1;
+    (void)n_blocks;
+
+    #if MICROPY_GC_ALLOC_THRESHOLD
+    MP_STATE_MEM(gc_alloc_amount) += n_blocks;
+    #endif
+
+    #if MICROPY_GC_INCREMENTAL
+    ITB_SET(start_block, IT_UNKNOWN);
+    if (MP_STATE_MEM(gc_incr_phase) == GC_INCR_SWEEP && start_block >= MP_STATE_MEM(gc_incr_sweep_block)) {
+        // the sweep hasn't got here yet, and it frees the unmarked heads
+        ATB_HEAD_TO_MARK(start_block);
+    }
+    #endif
+
+    #if MICROPY_GC_NURSERY
+    GTB_SET(start_block, GT_UNKNOWN);
+    MP_STATE_MEM(gc_young_blocks) += n_blocks;
+    if (start_block < MP_STATE_MEM(gc_young_start)) {
+        MP_STATE_MEM(gc_young_start) = start_block;
+    }
+    if (end_block >= MP_STATE_MEM(gc_young_end)) {
+        MP_STATE_MEM(gc_young_end) = end_block + 1;
+    }
+    #endif
+
+    #if MICROPY_PY_MICROPYTHON_HEAP_PROFILE
+    if (MP_STATE_VM(heap_profile_enabled)) {
+        gc_profile_alloc(n_blocks * BYTES_PER_BLOCK);
+    }
+    #endif
+}
+
 void *gc_alloc(size_t n_bytes, bool has_finaliser) {
     size_t n_blocks = ((n_bytes + BYTES_PER_BLOCK - 1) & (~(BYTES_PER_BLOCK - 1))) / BYTES_PER_BLOCK;
     DEBUG_printf("gc_alloc(" UINT_FMT " bytes -> " UINT_FMT " blocks)\n", n_bytes, n_blocks);
@@ -414,33 +1947,142 @@ void *gc_alloc(size_t n_bytes, bool has_finaliser) {
     size_t i;
     size_t end_block;
     size_t start_block;
-    size_t n_free = 0;
+    size_t n_free;
     int collected = !MP_STATE_MEM(gc_auto_collect_enabled);
 
     #if MICROPY_GC_ALLOC_THRESHOLD
     if (!collected && MP_STATE_MEM(gc_alloc_amount) >= MP_STATE_MEM(gc_alloc_threshold)) {
+        GC_EXIT();
+        #if MICROPY_GC_INCREMENTAL
+        gc_collect_step(MICROPY_GC_INCREMENTAL_BUDGET_US);
+        #else
+        gc_collect();
+        #endif
+        GC_ENTER();
+    }
+    #endif
+
+    #if MICROPY_GC_COMPACT
+    int compacted = 0;
+    if (!collected && MP_STATE_MEM(gc_compact_wanted)) {
         GC_EXIT();
         gc_collect();
+        gc_compact();
+        GC_ENTER();
+        compacted = 1;
+    }
+    #endif
+
+    #if MICROPY_GC_NURSERY
+    int minor_collected = MP_STATE_MEM(gc_nursery_blocks) == 0;
+    if (!collected && !minor_collected && MP_STATE_MEM(gc_young_blocks) >= MP_STATE_MEM(gc_nursery_blocks)) {
+        GC_EXIT();
+        gc_collect_minor();
         GC_ENTER();
+        minor_collected = 1;
     }
     #endif
 
+    #if MICROPY_GC_SPLIT_HEAP
+    bool small = n_blocks * BYTES_PER_BLOCK <= MICROPY_GC_SPLIT_HEAP_SMALL;
+    #endif
+
     for (;;) {
+        #if MICROPY_GC_FREE_LISTS
+        #if MICROPY_GC_SPLIT_HEAP
+        if (small && n_blocks <= MICROPY_GC_FREE_LIST_CLASSES) {
+        #else
+        if (n_blocks <= MICROPY_GC_FREE_LIST_CLASSES) {
+        #endif
+            start_block = gc_free_list_pop(n_blocks);
+            if (start_block != (size_t)-1) {
+                end_block = start_block + n_blocks - 1;
+                goto found_run;
+            }
+        }
+        #endif
+
+        #if MICROPY_GC_SPLIT_HEAP
+        // look in the region this size belongs to, then in the other one
+        for (int pass = 0; pass < 2; pass++) {
+            bool fast = small == (pass == 0);
+            size_t i_end;
+            if (fast) {
+                if (n_blocks >= MP_STATE_MEM(gc_fast_full_blocks)) {
+                    // don't scan a full fast region for every allocation
+                    continue;
+                }
+                i = MP_STATE_MEM(gc_fast_last_free_atb_index);
+                i_end = MP_STATE_MEM(gc_alloc_table_byte_len);
+            } else {
+                i = MP_STATE_MEM(gc_last_free_atb_index);
+                i_end = MP_STATE_MEM(gc_fast_block) / BLOCKS_PER_ATB;
+            }
+            n_free = 0;
+        #else
+        {
+            size_t i_end = MP_STATE_MEM(gc_alloc_table_byte_len);
+            i = MP_STATE_MEM(gc_last_free_atb_index);
+            n_free = 0;
+        #endif
+
+            // look for a run of n_blocks available blocks
+            for (; i < i_end; i++) {
+                byte a = MP_STATE_MEM(gc_alloc_table_start)[i];
+                if (ATB_0_IS_FREE(a)) { if (++n_free >= n_blocks) { i = i * BLOCKS_PER_ATB + 0; goto found; } } else { n_free = 0; }
+                if (ATB_1_IS_FREE(a)) { if (++n_free >= n_blocks) { i = i * BLOCKS_PER_ATB + 1; goto found; } } else { n_free = 0; }
+                if (ATB_2_IS_FREE(a)) { if (++n_free >= n_blocks) { i = i * BLOCKS_PER_ATB + 2; goto found; } } else { n_free = 0; }
+                if (ATB_3_IS_FREE(a)) { if (++n_free >= n_blocks) { i = i * BLOCKS_PER_ATB + 3; goto found; } } else { n_free = 0; }
+            }
+            #if MICROPY_GC_SPLIT_HEAP
+            if (fast) {
+                MP_STATE_MEM(gc_fast_full_blocks) = n_blocks;
+            }
+            #endif
+        }
 
-        // look for a run of n_blocks available blocks
-        for (i = MP_STATE_MEM(gc_last_free_atb_index); i < MP_STATE_MEM(gc_alloc_table_byte_len); i++) {
-            byte a = MP_STATE_MEM(gc_alloc_table_start)[i];
-            if (ATB_0_IS_FREE(a)) { if (++n_free >= n_blocks) { i = i * BLOCKS_PER_ATB + 0; goto found; } } else { n_free = 0; }
-            if (ATB_1_IS_FREE(a)) { if (++n_free >= n_blocks) { i = i * BLOCKS_PER_ATB + 1; goto found; } } else { n_free = 0; }
-            if (ATB_2_IS_FREE(a)) { if (++n_free >= n_blocks) { i = i * BLOCKS_PER_ATB + 2; goto found; } } else { n_free = 0; }
-            if (ATB_3_IS_FREE(a)) { if (++n_free >= n_blocks) { i = i * BLOCKS_PER_ATB + 3; goto found; } } else { n_free = 0; }
+        #if MICROPY_GC_INCREMENTAL
+        if (MP_STATE_MEM(gc_incr_phase) == GC_INCR_SWEEP) {
+            // free the rest of the garbage found by the last cycle
+            MP_STATE_MEM(gc_lock_depth)++;
+            gc_incr_sweep((size_t)-1);
+            MP_STATE_MEM(gc_lock_depth)--;
+            continue;
         }
+        #endif
 
         GC_EXIT();
         // nothing found!
         if (collected) {
+            #if MICROPY_GC_COMPACT
+            if (!compacted && MP_STATE_MEM(gc_auto_collect_enabled)) {
+                // there may be enough free blocks, just not in one run
+                gc_compact();
+                compacted = 1;
+                GC_ENTER();
+                continue;
+            }
+            #endif
             return NULL;
         }
+        #if MICROPY_GC_NURSERY
+        if (!minor_collected && MP_STATE_MEM(gc_young_blocks) != 0) {
+            // a minor collection is cheap, try it before a full one
+            gc_collect_minor();
+            minor_collected = 1;
+            GC_ENTER();
+            continue;
+        }
+        #endif
+        #if MICROPY_GC_INCREMENTAL
+        if (MP_STATE_MEM(gc_incr_phase) != GC_INCR_IDLE) {
+            // finish the cycle in progress; it keeps the garbage created
+            // since it started, so a full collection may still be needed
+            gc_collect();
+            GC_ENTER();
+            continue;
+        }
+        #endif
         DEBUG_printf("gc_alloc(" UINT_FMT "): no free mem, triggering GC\n", n_bytes);
         gc_collect();
         collected = 1;
@@ -459,9 +2101,13 @@ found:
     // before this one.  Also, whenever we free or shink a block we must check
     // if this index needs adjusting (see gc_realloc and gc_free).
     if (n_free == 1) {
-        MP_STATE_MEM(gc_last_free_atb_index) = (i + 1) / BLOCKS_PER_ATB;
+        LAST_FREE_ATB_INDEX(i) = (i + 1) / BLOCKS_PER_ATB;
     }
 
+    #if MICROPY_GC_FREE_LISTS
+found_run:
+    #endif
+
     // mark first block as used head
     ATB_FREE_TO_HEAD(start_block);
 
@@ -473,12 +2119,10 @@ found:
 
     // get pointer to first block
     // we must create this pointer before unlocking the GC so a collection can find it
-    void *ret_ptr = (void*)(MP_STATE_MEM(gc_pool_start) + start_block * BYTES_PER_BLOCK);
+    void *ret_ptr = (void*)PTR_FROM_BLOCK(start_block);
     DEBUG_printf("gc_alloc(%p)\n", ret_ptr);
 
-    #if MICROPY_GC_ALLOC_THRESHOLD
-    MP_STATE_MEM(gc_alloc_amount) += n_blocks;
-    #endif
+    gc_alloc_account(start_block, end_block);
 
     GC_EXIT();
 
@@ -542,23 +2186,41 @@ void gc_free(void *ptr) {
         // get the GC block number corresponding to this pointer
         assert(VERIFY_PTR(ptr));
         size_t block = BLOCK_FROM_PTR(ptr);
-        assert(ATB_GET_KIND(block) == AT_HEAD);
+        assert(ATB_KIND_IS_HEAD(ATB_GET_KIND(block)));
 
         #if MICROPY_ENABLE_FINALISER
         FTB_CLEAR(block);
         #endif
 
+        #if MICROPY_GC_NURSERY
+        GTB_SET(block, GT_CLEAN);
+        #elif MICROPY_GC_INCREMENTAL
+        ITB_SET(block, IT_CLEAN);
+        #endif
+
         // set the last_free pointer to this block if it's earlier in the heap
-        if (block / BLOCKS_PER_ATB < MP_STATE_MEM(gc_last_free_atb_index)) {
-            MP_STATE_MEM(gc_last_free_atb_index) = block / BLOCKS_PER_ATB;
+        if (block / BLOCKS_PER_ATB < LAST_FREE_ATB_INDEX(block)) {
+            LAST_FREE_ATB_INDEX(block) = block / BLOCKS_PER_ATB;
         }
+        #if MICROPY_GC_SPLIT_HEAP
+        if (block >= MP_STATE_MEM(gc_fast_block)) {
+            MP_STATE_MEM(gc_fast_full_blocks) = (size_t)-1;
+        }
+        #endif
 
         // free head and all of its tail blocks
+        #if MICROPY_GC_FREE_LISTS
+        size_t start_block = block;
+        #endif
         do {
             ATB_ANY_TO_FREE(block);
             block += 1;
         } while (ATB_GET_KIND(block) == AT_TAIL);
 
+        #if MICROPY_GC_FREE_LISTS
+        gc_free_list_push(start_block, block - start_block);
+        #endif
+
         GC_EXIT();
 
         #if EXTENSIVE_HEAP_PROFILING
@@ -571,7 +2233,7 @@ size_t gc_nbytes(const void *ptr) {
     GC_ENTER();
     if (VERIFY_PTR(ptr)) {
         size_t block = BLOCK_FROM_PTR(ptr);
-        if (ATB_GET_KIND(block) == AT_HEAD) {
+        if (ATB_KIND_IS_HEAD(ATB_GET_KIND(block))) {
             // work out number of consecutive blocks in the chain starting with this on
             size_t n_blocks = 0;
             do {
@@ -641,7 +2303,7 @@ void *gc_realloc(void *ptr_in, size_t n_bytes, bool allow_move) {
     GC_ENTER();
 
     // sanity check the ptr is pointing to the head of a block
-    if (ATB_GET_KIND(block) != AT_HEAD) {
+    if (!ATB_KIND_IS_HEAD(ATB_GET_KIND(block))) {
         GC_EXIT();
         return NULL;
     }
@@ -662,7 +2324,7 @@ void *gc_realloc(void *ptr_in, size_t n_bytes, bool allow_move) {
     // efficiently shrink it (see below for shrinking code).
     size_t n_free   = 0;
     size_t n_blocks = 1; // counting HEAD block
-    size_t max_block = MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB;
+    size_t max_block = REGION_END_BLOCK(block);
     for (size_t bl = block + n_blocks; bl < max_block; bl++) {
         byte block_type = ATB_GET_KIND(bl);
         if (block_type == AT_TAIL) {
@@ -692,11 +2354,19 @@ void *gc_realloc(void *ptr_in, size_t n_bytes, bool allow_move) {
         for (size_t bl = block + new_blocks, count = n_blocks - new_blocks; count > 0; bl++, count--) {
             ATB_ANY_TO_FREE(bl);
         }
+        #if MICROPY_GC_FREE_LISTS
+        gc_free_list_push(block + new_blocks, n_blocks - new_blocks);
+        #endif
 
         // set the last_free pointer to end of this block if it's earlier in the heap
-        if ((block + new_blocks) / BLOCKS_PER_ATB < MP_STATE_MEM(gc_last_free_atb_index)) {
-            MP_STATE_MEM(gc_last_free_atb_index) = (block + new_blocks) / BLOCKS_PER_ATB;
+        if ((block + new_blocks) / BLOCKS_PER_ATB < LAST_FREE_ATB_INDEX(block)) {
+            LAST_FREE_ATB_INDEX(block) = (block + new_blocks) / BLOCKS_PER_ATB;
         }
+        #if MICROPY_GC_SPLIT_HEAP
+        if (block >= MP_STATE_MEM(gc_fast_block)) {
+            MP_STATE_MEM(gc_fast_full_blocks) = (size_t)-1;
+        }
+        #endif
 
         GC_EXIT();
 
@@ -715,6 +2385,23 @@ void *gc_realloc(void *ptr_in, size_t n_bytes, bool allow_move) {
             ATB_FREE_TO_TAIL(bl);
         }
 
+        #if MICROPY_GC_NURSERY
+        // the new tail blocks are young; they are swept as part of the chain
+        MP_STATE_MEM(gc_young_blocks) += new_blocks - n_blocks;
+        if (block < MP_STATE_MEM(gc_young_start)) {
+            MP_STATE_MEM(gc_young_start) = block;
+        }
+        if (block + new_blocks > MP_STATE_MEM(gc_young_end)) {
+            MP_STATE_MEM(gc_young_end) = block + new_blocks;
+        }
+        #endif
+
+        #if MICROPY_PY_MICROPYTHON_HEAP_PROFILE
+        if (MP_STATE_VM(heap_profile_enabled)) {
+            gc_profile_alloc((new_blocks - n_blocks) * BYTES_PER_BLOCK);
+        }
+        #endif
+
         GC_EXIT();
 
         #if MICROPY_GC_CONSERVATIVE_CLEAR
@@ -760,6 +2447,141 @@ void *gc_realloc(void *ptr_in, size_t n_bytes, bool allow_move) {
 }
 #endif // Alternative gc_realloc impl
 
+#if MICROPY_GC_NURSERY
+void gc_collect_minor(void) {
+    MP_STATE_MEM(gc_minor_pending) = 1;
+    gc_collect();
+}
+
+void gc_write_barrier(const void *ptr) {
+    if (!IN_POOL(ptr)) {
+        return;
+    }
+    GC_ENTER();
+    // ptr may point into the middle of the object, so find its head
+    size_t block = BLOCK_FROM_PTR(ptr);
+    while (ATB_GET_KIND(block) == AT_TAIL) {
+        block--;
+    }
+    if (ATB_GET_KIND(block) == AT_MARK && GTB_GET(block) == GT_CLEAN) {
+        GTB_SET(block, GT_REMEMBERED);
+    }
+    GC_EXIT();
+}
+
+void gc_set_protected(const void *ptr) {
+    if (!VERIFY_PTR(ptr)) {
+        return;
+    }
+    GC_ENTER();
+    size_t block = BLOCK_FROM_PTR(ptr);
+    size_t kind = ATB_GET_KIND(block);
+    if (kind == AT_HEAD) {
+        // young, so it will be traced in full if it survives
+        if (GTB_GET(block) == GT_UNKNOWN) {
+            GTB_SET(block, GT_CLEAN);
+        }
+    } else if (kind == AT_MARK) {
+        // old, trace it once more to pick up earlier stores
+        if (GTB_GET(block) != GT_REMEMBERED) {
+            GTB_SET(block, GT_REMEMBERED);
+        }
+    }
+    GC_EXIT();
+}
+#endif
+
+#if MICROPY_GC_INCREMENTAL
+// Only the gc_collect() which ends the marking can't be split up.  It traces
+// the roots and the blocks which are still dirty, which are those stored
+// into since the steps traced the dirty ones again, and those not protected
+// by a write barrier, and scans the incremental table for them.  The sweep
+// is done by the following steps.
+bool gc_collect_step(mp_uint_t budget_us) {
+    if (MP_STATE_MEM(gc_lock_depth) > 0) {
+        return false;
+    }
+    mp_uint_t start = mp_hal_ticks_us();
+    if (MP_STATE_MEM(gc_incr_phase) == GC_INCR_IDLE) {
+        // start a new cycle by marking the roots
+        MP_STATE_MEM(gc_incr_phase) = GC_INCR_START;
+        gc_collect();
+    }
+    GC_ENTER();
+    MP_STATE_MEM(gc_lock_depth)++;
+    MP_STATE_MEM(gc_alloc_amount) = 0;
+    bool done;
+    if (MP_STATE_MEM(gc_incr_phase) == GC_INCR_SWEEP) {
+        do {
+            done = gc_incr_sweep(GC_INCR_SWEEP_CHUNK);
+        } while (!done && (mp_uint_t)(mp_hal_ticks_us() - start) < budget_us);
+        MP_STATE_MEM(gc_lock_depth)--;
+        GC_EXIT();
+        return done;
+    }
+    do {
+        MP_STATE_MEM(gc_incr_work) = GC_INCR_WORK_CHUNK;
+        done = gc_incr_mark();
+        if (done && !MP_STATE_MEM(gc_incr_precleaned)) {
+            // trace the dirty blocks once more, so that fewer are left for
+            // the end of the marking
+            MP_STATE_MEM(gc_incr_precleaned) = 1;
+            MP_STATE_MEM(gc_incr_rescan_dirty) = 1;
+            done = false;
+        }
+    } while (!done && (mp_uint_t)(mp_hal_ticks_us() - start) < budget_us);
+    MP_STATE_MEM(gc_lock_depth)--;
+    GC_EXIT();
+    if (done) {
+        // trace the roots and the dirty blocks again
+        MP_STATE_MEM(gc_incr_sweep_later) = 1;
+        gc_collect();
+        MP_STATE_MEM(gc_incr_sweep_later) = 0;
+    }
+    return false;
+}
+
+void gc_collect_poll(void) {
+    if (MP_STATE_MEM(gc_auto_collect_enabled)
+        && (MP_STATE_MEM(gc_incr_phase) != GC_INCR_IDLE
+            || MP_STATE_MEM(gc_alloc_amount) >= MP_STATE_MEM(gc_alloc_threshold))) {
+        gc_collect_step(MICROPY_GC_INCREMENTAL_BUDGET_US);
+    }
+}
+
+void gc_write_barrier(const void *ptr) {
+    if (!IN_POOL(ptr)) {
+        return;
+    }
+    GC_ENTER();
+    // ptr may point into the middle of the object, so find its head
+    size_t block = BLOCK_FROM_PTR(ptr);
+    while (ATB_GET_KIND(block) == AT_TAIL) {
+        block--;
+    }
+    // only blocks traced by the marking in progress are marked and clean
+    if (MP_STATE_MEM(gc_incr_phase) == GC_INCR_MARK
+        && ATB_GET_KIND(block) == AT_MARK && ITB_GET(block) == IT_CLEAN) {
+        ITB_SET(block, IT_DIRTY);
+    }
+    GC_EXIT();
+}
+
+void gc_set_protected(const void *ptr) {
+    if (!VERIFY_PTR(ptr)) {
+        return;
+    }
+    GC_ENTER();
+    size_t block = BLOCK_FROM_PTR(ptr);
+    size_t kind = ATB_GET_KIND(block);
+    if (ATB_KIND_IS_HEAD(kind) && ITB_GET(block) == IT_UNKNOWN) {
+        // if it's marked it still has to be traced by this cycle
+        ITB_SET(block, kind == AT_MARK && MP_STATE_MEM(gc_incr_phase) == GC_INCR_MARK ? IT_GRAY : IT_CLEAN);
+    }
+    GC_EXIT();
+}
+#endif
+
 void gc_dump_info(void) {
     gc_info_t info;
     gc_info(&info);
@@ -767,6 +2589,19 @@ void gc_dump_info(void) {
         (uint)info.total, (uint)info.used, (uint)info.free);
     mp_printf(&mp_plat_print, " No. of 1-blocks: %u, 2-blocks: %u, max blk sz: %u, max free sz: %u\n",
            (uint)info.num_1block, (uint)info.num_2block, (uint)info.max_block, (uint)info.max_free);
+    #if MICROPY_GC_SPLIT_HEAP
+    mp_printf(&mp_plat_print, " Main region: total: %u, used: %u, free: %u\n",
+        (uint)(info.total - info.fast_total), (uint)(info.used - info.fast_used), (uint)(info.free - info.fast_free));
+    mp_printf(&mp_plat_print, " Fast region: total: %u, used: %u, free: %u\n",
+        (uint)info.fast_total, (uint)info.fast_used, (uint)info.fast_free);
+    #endif
+    #if MICROPY_GC_NURSERY
+    mp_printf(&mp_plat_print, " Nursery: %u, minor: %u (last %u us), major: %u (last %u us), max pause: %u us\n",
+        (uint)(MP_STATE_MEM(gc_nursery_blocks) * BYTES_PER_BLOCK),
+        (uint)MP_STATE_MEM(gc_minor_count), (uint)MP_STATE_MEM(gc_minor_last_us),
+        (uint)MP_STATE_MEM(gc_major_count), (uint)MP_STATE_MEM(gc_major_last_us),
+        (uint)MP_STATE_MEM(gc_max_pause_us));
+    #endif
 }
 
 void gc_dump_alloc_table(void) {
@@ -831,8 +2666,11 @@ void gc_dump_alloc_table(void) {
             }
             */
             /* this prints the uPy object type of the head block */
+            #if MICROPY_GC_NURSERY || MICROPY_GC_INCREMENTAL
+            case AT_MARK:
+            #endif
             case AT_HEAD: {
-                void **ptr = (void**)(MP_STATE_MEM(gc_pool_start) + bl * BYTES_PER_BLOCK);
+                void **ptr = (void**)PTR_FROM_BLOCK(bl);
                 if (*ptr == &mp_type_tuple) { c = 'T'; }
                 else if (*ptr == &mp_type_list) { c = 'L'; }
                 else if (*ptr == &mp_type_dict) { c = 'D'; }
@@ -871,7 +2709,9 @@ void gc_dump_alloc_table(void) {
                 break;
             }
             case AT_TAIL: c = '='; break;
+            #if !MICROPY_GC_NURSERY && !MICROPY_GC_INCREMENTAL
             case AT_MARK: c = 'm'; break;
+            #endif
         }
         mp_printf(&mp_plat_print, "%c", c);
     }
@@ -59,6 +59,36 @@ def compute_hash(qstr, bytes_hash):
     # Make sure that valid hash is never zero, zero means "hash not computed"
     return (hash & ((1 << (8 * bytes_hash)) - 1)) or 1
 
+# this must match qstr_index_hash() in qstr.c
+def compute_index_hash(qstr):
+    hash = 5381
+    for b in qstr:
+        hash = (hash * 33) ^ b
+    return ((hash & 0xffffffff) * 0x9e3779b1 & 0xffffffff) >> 16
+
+# Make the hash index of a pool of qstrs, see qstr.c; None entries aren't indexed
+def make_index(qstrs):
+    size = 16
+    while size < 2 * len(qstrs):
+        size *= 2
+    assert len(qstrs) < 0xffff
+    index = [0] * size
+    for i, qbytes in enumerate(qstrs):
+        if qbytes is None:
+            continue
+        pos = compute_index_hash(qbytes) & (size - 1)
+        while index[pos] != 0:
+            pos = (pos + 1) & (size - 1)
+        index[pos] = i + 1
+    return index
+
+def print_index(name, index):
+    print('#define %s_SIZE (%u)' % (name, len(index)))
+    print('#define %s \\' % name)
+    for i in range(0, len(index), 16):
+        print('    %s, \\' % ', '.join(str(n) for n in index[i:i + 16]))
+    print('')
+
 def qstr_escape(qst):
     def esc_char(m):
         c = ord(m.group(0))
@@ -150,6 +180,11 @@ def print_qstr_data(qcfgs, qstrs):
         qbytes = make_bytes(cfg_bytes_len, cfg_bytes_hash, qstr)
         print('QDEF(MP_QSTR_%s, %s)' % (ident, qbytes))
 
+    # print out the hash index of the pool, for MICROPY_OPT_QSTR_INDEX
+    qstr_list = [None] + [bytes_cons(qstr, 'utf8') for order, ident, qstr in sorted(qstrs.values(), key=lambda x: x[0])]
+    print('')
+    print_index('MP_QSTR_CONST_POOL_INDEX', make_index(qstr_list))
+
 def do_work(infiles):
     qcfgs, qstrs = parse_input_headers(infiles)
     print_qstr_data(qcfgs, qstrs)
@@ -33,6 +33,14 @@
 #include "py/misc.h"
 #include "py/runtime0.h"
 #include "py/runtime.h"
+#include "py/gc.h"
+
+#if MICROPY_OPT_INLINE_CACHE
+// The VM's inline cache assumes that the keys of versioned maps don't change
+#define MAP_KEYS_CHANGED(map) do { if ((map)->is_versioned) { ++MP_STATE_VM(inline_cache_epoch); } } while (0)
+#else
+#define MAP_KEYS_CHANGED(map) (void)0
+#endif
 
 // Fixed empty map. Useful when need to call kw-receiving functions
 // without any keywords from C, etc.
@@ -70,18 +78,111 @@ STATIC size_t get_hash_alloc_greater_or_equal_to(size_t x) {
 /******************************************************************************/
 /* map                                                                        */
 
+#if MICROPY_OPT_MAP_CACHED_HASHES
+// A table that isn't fixed is followed by the hashes of its keys, so a probe
+// can pass over keys of a different hash without comparing them, and growing
+// the table needn't hash the keys again.  An ordered table of more than
+// MAP_INDEX_MIN entries is then followed by the number of entries removed
+// from it, and by an index: a hash table of the positions of its entries, as
+// in CPython's compact dict.  An index slot holds 0 if it's empty, else 1 +
+// the position of the entry, in 1, 2 or 4 bytes depending on the size of
+// the table.
+//
+// Removing an entry from an indexed table leaves a hole, with the key
+// MP_OBJ_SENTINEL, which stays in the index.  Entries are added after the
+// holes, so the table is in use up to used + MAP_DELETED, and the holes are
+// squeezed out once there are more of them than entries.
+#define MAP_INDEX_MIN (8)
+#define MAP_HASHES(map) ((mp_uint_t*)&(map)->table[(map)->alloc])
+#define MAP_DELETED(map) (MAP_HASHES(map)[(map)->alloc])
+#define MAP_INDEX(map) ((byte*)&MAP_HASHES(map)[(map)->alloc + 1])
+
+// The size of the index is a power of 2, at least twice the number of entries
+STATIC size_t map_index_size(size_t alloc) {
+    size_t n = 16;
+    while (n < 2 * alloc) {
+        n <<= 1;
+    }
+    return n;
+}
+
+// Bytes per index slot, enough to hold 1 + the last position of the table
+STATIC size_t map_index_width(size_t alloc) {
+    if (alloc < 0xff) {
+        return 1;
+    } else if (alloc < 0xffff) {
+        return 2;
+    } else {
+        return 4;
+    }
+}
+
+STATIC size_t map_index_get(const mp_map_t *map, size_t pos) {
+    byte *index = MAP_INDEX(map);
+    switch (map_index_width(map->alloc)) {
+        case 1: return index[pos];
+        case 2: return ((uint16_t*)index)[pos];
+        default: return ((uint32_t*)index)[pos];
+    }
+}
+
+STATIC void map_index_set(mp_map_t *map, size_t pos, size_t i) {
+    byte *index = MAP_INDEX(map);
+    switch (map_index_width(map->alloc)) {
+        case 1: index[pos] = i; break;
+        case 2: ((uint16_t*)index)[pos] = i; break;
+        default: ((uint32_t*)index)[pos] = i; break;
+    }
+}
+#endif
+
+size_t mp_map_table_bytes(size_t alloc, bool is_ordered) {
+    #if MICROPY_OPT_MAP_CACHED_HASHES
+    size_t n_bytes = alloc * (sizeof(mp_map_elem_t) + sizeof(mp_uint_t));
+    if (is_ordered && alloc > MAP_INDEX_MIN) {
+        n_bytes += sizeof(mp_uint_t) + map_index_size(alloc) * map_index_width(alloc);
+    }
+    return n_bytes;
+    #else
+    (void)is_ordered;
+    return alloc * sizeof(mp_map_elem_t);
+    #endif
+}
+
+STATIC mp_map_elem_t *map_new_table(size_t alloc, bool is_ordered) {
+    mp_map_elem_t *table = (mp_map_elem_t*)m_new0(byte, mp_map_table_bytes(alloc, is_ordered));
+    MP_GC_SET_PROTECTED(table);
+    return table;
+}
+
+STATIC void map_del_table(mp_map_t *map) {
+    m_del(byte, map->table, mp_map_table_bytes(map->alloc, map->is_ordered));
+}
+
+STATIC mp_uint_t map_hash(mp_obj_t index) {
+    // fast path for common case of qstr
+    if (MP_OBJ_IS_QSTR(index)) {
+        return qstr_hash(MP_OBJ_QSTR_VALUE(index));
+    } else {
+        return MP_OBJ_SMALL_INT_VALUE(mp_unary_op(MP_UNARY_OP_HASH, index));
+    }
+}
+
 void mp_map_init(mp_map_t *map, size_t n) {
     if (n == 0) {
         map->alloc = 0;
         map->table = NULL;
     } else {
         map->alloc = n;
-        map->table = m_new0(mp_map_elem_t, map->alloc);
+        map->table = map_new_table(n, false);
     }
     map->used = 0;
     map->all_keys_are_qstrs = 1;
     map->is_fixed = 0;
     map->is_ordered = 0;
+    #if MICROPY_OPT_INLINE_CACHE
+    map->is_versioned = 0;
+    #endif
 }
 
 void mp_map_init_fixed_table(mp_map_t *map, size_t n, const mp_obj_t *table) {
@@ -90,20 +191,44 @@ void mp_map_init_fixed_table(mp_map_t *map, size_t n, const mp_obj_t *table) {
     map->all_keys_are_qstrs = 1;
     map->is_fixed = 1;
     map->is_ordered = 1;
+    #if MICROPY_OPT_INLINE_CACHE
+    map->is_versioned = 0;
+    #endif
     map->table = (mp_map_elem_t*)table;
 }
 
+// Initialise map as a copy of src, which keeps its order but is never fixed
+void mp_map_init_copy(mp_map_t *map, const mp_map_t *src) {
+    mp_map_init(map, 0);
+    map->is_ordered = src->is_ordered;
+    if (src->is_fixed) {
+        // a fixed table has no hashes, so add its entries one by one
+        for (size_t i = 0; i < src->used; i++) {
+            mp_map_lookup(map, src->table[i].key, MP_MAP_LOOKUP_ADD_IF_NOT_FOUND)->value = src->table[i].value;
+        }
+        return;
+    }
+    if (src->alloc != 0) {
+        map->table = map_new_table(src->alloc, src->is_ordered);
+        memcpy(map->table, src->table, mp_map_table_bytes(src->alloc, src->is_ordered));
+    }
+    map->alloc = src->alloc;
+    map->used = src->used;
+    map->all_keys_are_qstrs = src->all_keys_are_qstrs;
+}
+
 // Differentiate from mp_map_clear() - semantics is different
 void mp_map_deinit(mp_map_t *map) {
     if (!map->is_fixed) {
-        m_del(mp_map_elem_t, map->table, map->alloc);
+        map_del_table(map);
     }
     map->used = map->alloc = 0;
 }
 
 void mp_map_clear(mp_map_t *map) {
+    MAP_KEYS_CHANGED(map);
     if (!map->is_fixed) {
-        m_del(mp_map_elem_t, map->table, map->alloc);
+        map_del_table(map);
     }
     map->alloc = 0;
     map->used = 0;
@@ -116,18 +241,149 @@ STATIC void mp_map_rehash(mp_map_t *map) {
     size_t old_alloc = map->alloc;
     size_t new_alloc = get_hash_alloc_greater_or_equal_to(map->alloc + 1);
     mp_map_elem_t *old_table = map->table;
-    mp_map_elem_t *new_table = m_new0(mp_map_elem_t, new_alloc);
+    mp_map_elem_t *new_table = map_new_table(new_alloc, false);
     // If we reach this point, table resizing succeeded, now we can edit the old map.
     map->alloc = new_alloc;
     map->used = 0;
     map->all_keys_are_qstrs = 1;
     map->table = new_table;
+    #if MICROPY_OPT_MAP_CACHED_HASHES
+    mp_uint_t *old_hashes = (mp_uint_t*)&old_table[old_alloc];
+    mp_uint_t *new_hashes = MAP_HASHES(map);
+    #endif
     for (size_t i = 0; i < old_alloc; i++) {
         if (old_table[i].key != MP_OBJ_NULL && old_table[i].key != MP_OBJ_SENTINEL) {
+            #if MICROPY_OPT_MAP_CACHED_HASHES
+            // the keys are known to be distinct, so just find a free slot
+            size_t pos = old_hashes[i] % new_alloc;
+            while (new_table[pos].key != MP_OBJ_NULL) {
+                pos = (pos + 1) % new_alloc;
+            }
+            new_table[pos] = old_table[i];
+            new_hashes[pos] = old_hashes[i];
+            map->used += 1;
+            if (!MP_OBJ_IS_QSTR(old_table[i].key)) {
+                map->all_keys_are_qstrs = 0;
+            }
+            #else
             mp_map_lookup(map, old_table[i].key, MP_MAP_LOOKUP_ADD_IF_NOT_FOUND)->value = old_table[i].value;
+            #endif
         }
     }
-    m_del(mp_map_elem_t, old_table, old_alloc);
+    m_del(byte, old_table, mp_map_table_bytes(old_alloc, false));
+}
+
+#if MICROPY_OPT_MAP_CACHED_HASHES
+STATIC void map_index_add(mp_map_t *map, size_t i) {
+    size_t mask = map_index_size(map->alloc) - 1;
+    size_t pos = MAP_HASHES(map)[i] & mask;
+    while (map_index_get(map, pos) != 0) {
+        pos = (pos + 1) & mask;
+    }
+    map_index_set(map, pos, i + 1);
+}
+
+// Number of positions of an ordered table in use, including holes
+STATIC size_t map_ordered_end(const mp_map_t *map) {
+    if (!map->is_fixed && map->alloc > MAP_INDEX_MIN) {
+        return map->used + MAP_DELETED(map);
+    }
+    return map->used;
+}
+
+// Move the entries of an indexed table down over its holes, and index them
+STATIC void map_compact_ordered(mp_map_t *map) {
+    mp_uint_t *hashes = MAP_HASHES(map);
+    size_t end = map->used + MAP_DELETED(map);
+    size_t n = 0;
+    for (size_t i = 0; i < end; i++) {
+        if (map->table[i].key != MP_OBJ_SENTINEL) {
+            map->table[n] = map->table[i];
+            hashes[n] = hashes[i];
+            n++;
+        }
+    }
+    for (size_t i = n; i < end; i++) {
+        map->table[i].key = MP_OBJ_NULL;
+        map->table[i].value = MP_OBJ_NULL;
+    }
+    MAP_DELETED(map) = 0;
+    memset(MAP_INDEX(map), 0, map_index_size(map->alloc) * map_index_width(map->alloc));
+    for (size_t i = 0; i < n; i++) {
+        map_index_add(map, i);
+    }
+}
+#endif
+
+// Grow an ordered table by a factor rather than a constant, so that filling
+// it takes linear rather than quadratic time.
+STATIC void mp_map_grow_ordered(mp_map_t *map) {
+    size_t old_alloc = map->alloc;
+    size_t new_alloc = old_alloc + old_alloc / 2 + 4;
+    #if MICROPY_OPT_MAP_CACHED_HASHES
+    mp_map_elem_t *old_table = map->table;
+    mp_map_elem_t *new_table = map_new_table(new_alloc, true);
+    // the holes are left behind
+    size_t end = map_ordered_end(map);
+    mp_uint_t *old_hashes = MAP_HASHES(map);
+    mp_uint_t *new_hashes = (mp_uint_t*)&new_table[new_alloc];
+    size_t n = 0;
+    for (size_t i = 0; i < end; i++) {
+        if (old_table[i].key != MP_OBJ_SENTINEL) {
+            new_table[n] = old_table[i];
+            new_hashes[n] = old_hashes[i];
+            n++;
+        }
+    }
+    map->alloc = new_alloc;
+    map->table = new_table;
+    m_del(byte, old_table, mp_map_table_bytes(old_alloc, true));
+    if (new_alloc > MAP_INDEX_MIN) {
+        for (size_t i = 0; i < n; i++) {
+            map_index_add(map, i);
+        }
+    }
+    #else
+    map->table = m_renew(mp_map_elem_t, map->table, old_alloc, new_alloc);
+    map->alloc = new_alloc;
+    mp_seq_clear(map->table, map->used, map->alloc, sizeof(*map->table));
+    MP_GC_SET_PROTECTED(map->table);
+    #endif
+}
+
+// Remove the entry at elem from an ordered table.  An indexed table keeps a
+// hole in its place, which holds the value for the caller.  A small table
+// moves the rest of the entries down, and puts it after the end so the
+// caller can access it.
+STATIC mp_map_elem_t *mp_map_remove_ordered(mp_map_t *map, mp_map_elem_t *elem) {
+    #if MICROPY_OPT_MAP_CACHED_HASHES
+    if (map->alloc > MAP_INDEX_MIN) {
+        elem->key = MP_OBJ_SENTINEL;
+        --map->used;
+        if (++MAP_DELETED(map) > map->used) {
+            mp_obj_t value = elem->value;
+            map_compact_ordered(map);
+            elem = &map->table[map->used];
+            elem->value = value;
+            elem->key = MP_OBJ_NULL;
+        }
+        MAP_KEYS_CHANGED(map);
+        return elem;
+    }
+    #endif
+    mp_obj_t value = elem->value;
+    size_t i = elem - map->table;
+    --map->used;
+    memmove(elem, elem + 1, (map->used - i) * sizeof(*elem));
+    #if MICROPY_OPT_MAP_CACHED_HASHES
+    mp_uint_t *hashes = MAP_HASHES(map);
+    memmove(&hashes[i], &hashes[i + 1], (map->used - i) * sizeof(*hashes));
+    #endif
+    elem = &map->table[map->used];
+    elem->key = MP_OBJ_NULL;
+    elem->value = value;
+    MAP_KEYS_CHANGED(map);
+    return elem;
 }
 
 // MP_MAP_LOOKUP behaviour:
@@ -140,6 +396,11 @@ mp_map_elem_t *mp_map_lookup(mp_map_t *map, mp_obj_t index, mp_map_lookup_kind_t
     // If the map is a fixed array then we must only be called for a lookup
     assert(!map->is_fixed || lookup_kind == MP_MAP_LOOKUP);
 
+    // The caller may store a value into the returned slot
+    if (lookup_kind == MP_MAP_LOOKUP_ADD_IF_NOT_FOUND) {
+        MP_GC_WRITE_BARRIER(map);
+    }
+
     // Work out if we can compare just pointers
     bool compare_only_ptrs = map->all_keys_are_qstrs;
     if (compare_only_ptrs) {
@@ -161,32 +422,68 @@ mp_map_elem_t *mp_map_lookup(mp_map_t *map, mp_obj_t index, mp_map_lookup_kind_t
 
     // if the map is an ordered array then we must do a brute force linear search
     if (map->is_ordered) {
-        for (mp_map_elem_t *elem = &map->table[0], *top = &map->table[map->used]; elem < top; elem++) {
-            if (elem->key == index || (!compare_only_ptrs && mp_obj_equal(elem->key, index))) {
-                if (MP_UNLIKELY(lookup_kind == MP_MAP_LOOKUP_REMOVE_IF_FOUND)) {
-                    // remove the found element by moving the rest of the array down
-                    mp_obj_t value = elem->value;
-                    --map->used;
-                    memmove(elem, elem + 1, (top - elem - 1) * sizeof(*elem));
-                    // put the found element after the end so the caller can access it if needed
-                    elem = &map->table[map->used];
-                    elem->key = MP_OBJ_NULL;
-                    elem->value = value;
+        #if MICROPY_OPT_MAP_CACHED_HASHES
+        mp_uint_t hash = 0;
+        if (!map->is_fixed && map->alloc > MAP_INDEX_MIN) {
+            // unless it is big enough to have an index
+            hash = map_hash(index);
+            mp_uint_t *hashes = MAP_HASHES(map);
+            size_t mask = map_index_size(map->alloc) - 1;
+            for (size_t pos = hash & mask, i; (i = map_index_get(map, pos)) != 0; pos = (pos + 1) & mask) {
+                mp_map_elem_t *elem = &map->table[i - 1];
+                if (elem->key == index || (!compare_only_ptrs && hashes[i - 1] == hash
+                    && elem->key != MP_OBJ_SENTINEL && mp_obj_equal(elem->key, index))) {
+                    if (MP_UNLIKELY(lookup_kind == MP_MAP_LOOKUP_REMOVE_IF_FOUND)) {
+                        elem = mp_map_remove_ordered(map, elem);
+                    }
+                    return elem;
+                }
+            }
+        } else
+        #endif
+        {
+            for (mp_map_elem_t *elem = &map->table[0], *top = &map->table[map->used]; elem < top; elem++) {
+                if (elem->key == index || (!compare_only_ptrs && mp_obj_equal(elem->key, index))) {
+                    if (MP_UNLIKELY(lookup_kind == MP_MAP_LOOKUP_REMOVE_IF_FOUND)) {
+                        elem = mp_map_remove_ordered(map, elem);
+                    }
+                    return elem;
                 }
-                return elem;
             }
+            #if MICROPY_OPT_MAP_CACHED_HASHES
+            if (lookup_kind == MP_MAP_LOOKUP_ADD_IF_NOT_FOUND) {
+                hash = map_hash(index);
+            }
+            #endif
         }
         if (MP_LIKELY(lookup_kind != MP_MAP_LOOKUP_ADD_IF_NOT_FOUND)) {
             return NULL;
         }
+        #if MICROPY_OPT_MAP_CACHED_HASHES
+        if (map_ordered_end(map) == map->alloc) {
+            if (map->alloc > MAP_INDEX_MIN && MAP_DELETED(map) >= map->alloc / 4) {
+                map_compact_ordered(map);
+            } else {
+                mp_map_grow_ordered(map);
+            }
+        }
+        size_t i = map_ordered_end(map);
+        map->used++;
+        #else
         if (map->used == map->alloc) {
-            // TODO: Alloc policy
-            map->alloc += 4;
-            map->table = m_renew(mp_map_elem_t, map->table, map->used, map->alloc);
-            mp_seq_clear(map->table, map->used, map->alloc, sizeof(*map->table));
+            mp_map_grow_ordered(map);
         }
-        mp_map_elem_t *elem = map->table + map->used++;
+        size_t i = map->used++;
+        #endif
+        mp_map_elem_t *elem = &map->table[i];
         elem->key = index;
+        #if MICROPY_OPT_MAP_CACHED_HASHES
+        MAP_HASHES(map)[i] = hash;
+        if (map->alloc > MAP_INDEX_MIN) {
+            map_index_add(map, i);
+        }
+        #endif
+        MAP_KEYS_CHANGED(map);
         if (!MP_OBJ_IS_QSTR(index)) {
             map->all_keys_are_qstrs = 0;
         }
@@ -203,13 +500,7 @@ mp_map_elem_t *mp_map_lookup(mp_map_t *map, mp_obj_t index, mp_map_lookup_kind_t
         }
     }
 
-    // get hash of index, with fast path for common case of qstr
-    mp_uint_t hash;
-    if (MP_OBJ_IS_QSTR(index)) {
-        hash = qstr_hash(MP_OBJ_QSTR_VALUE(index));
-    } else {
-        hash = MP_OBJ_SMALL_INT_VALUE(mp_unary_op(MP_UNARY_OP_HASH, index));
-    }
+    mp_uint_t hash = map_hash(index);
 
     size_t pos = hash % map->alloc;
     size_t start_pos = pos;
@@ -219,16 +510,10 @@ mp_map_elem_t *mp_map_lookup(mp_map_t *map, mp_obj_t index, mp_map_lookup_kind_t
         if (slot->key == MP_OBJ_NULL) {
             // found NULL slot, so index is not in table
             if (lookup_kind == MP_MAP_LOOKUP_ADD_IF_NOT_FOUND) {
-                map->used += 1;
                 if (avail_slot == NULL) {
                     avail_slot = slot;
                 }
-                avail_slot->key = index;
-                avail_slot->value = MP_OBJ_NULL;
-                if (!MP_OBJ_IS_QSTR(index)) {
-                    map->all_keys_are_qstrs = 0;
-                }
-                return avail_slot;
+                break;
             } else {
                 return NULL;
             }
@@ -237,7 +522,11 @@ mp_map_elem_t *mp_map_lookup(mp_map_t *map, mp_obj_t index, mp_map_lookup_kind_t
             if (avail_slot == NULL) {
                 avail_slot = slot;
             }
-        } else if (slot->key == index || (!compare_only_ptrs && mp_obj_equal(slot->key, index))) {
+        } else if (slot->key == index || (!compare_only_ptrs
+            #if MICROPY_OPT_MAP_CACHED_HASHES
+            && MAP_HASHES(map)[pos] == hash
+            #endif
+            && mp_obj_equal(slot->key, index))) {
             // found index
             // Note: CPython does not replace the index; try x={True:'true'};x[1]='one';x
             if (lookup_kind == MP_MAP_LOOKUP_REMOVE_IF_FOUND) {
@@ -249,6 +538,7 @@ mp_map_elem_t *mp_map_lookup(mp_map_t *map, mp_obj_t index, mp_map_lookup_kind_t
                 } else {
                     slot->key = MP_OBJ_SENTINEL;
                 }
+                MAP_KEYS_CHANGED(map);
                 // keep slot->value so that caller can access it if needed
             }
             return slot;
@@ -262,13 +552,7 @@ mp_map_elem_t *mp_map_lookup(mp_map_t *map, mp_obj_t index, mp_map_lookup_kind_t
             if (lookup_kind == MP_MAP_LOOKUP_ADD_IF_NOT_FOUND) {
                 if (avail_slot != NULL) {
                     // there was an available slot, so use that
-                    map->used++;
-                    avail_slot->key = index;
-                    avail_slot->value = MP_OBJ_NULL;
-                    if (!MP_OBJ_IS_QSTR(index)) {
-                        map->all_keys_are_qstrs = 0;
-                    }
-                    return avail_slot;
+                    break;
                 } else {
                     // not enough room in table, rehash it
                     mp_map_rehash(map);
@@ -280,6 +564,19 @@ mp_map_elem_t *mp_map_lookup(mp_map_t *map, mp_obj_t index, mp_map_lookup_kind_t
             }
         }
     }
+
+    // add the index in the available slot
+    map->used++;
+    avail_slot->key = index;
+    avail_slot->value = MP_OBJ_NULL;
+    #if MICROPY_OPT_MAP_CACHED_HASHES
+    MAP_HASHES(map)[avail_slot - map->table] = hash;
+    #endif
+    MAP_KEYS_CHANGED(map);
+    if (!MP_OBJ_IS_QSTR(index)) {
+        map->all_keys_are_qstrs = 0;
+    }
+    return avail_slot;
 }
 
 /******************************************************************************/
@@ -291,6 +588,7 @@ void mp_set_init(mp_set_t *set, size_t n) {
     set->alloc = n;
     set->used = 0;
     set->table = m_new0(mp_obj_t, set->alloc);
+    MP_GC_SET_PROTECTED(set->table);
 }
 
 STATIC void mp_set_rehash(mp_set_t *set) {
@@ -299,6 +597,7 @@ STATIC void mp_set_rehash(mp_set_t *set) {
     set->alloc = get_hash_alloc_greater_or_equal_to(set->alloc + 1);
     set->used = 0;
     set->table = m_new0(mp_obj_t, set->alloc);
+    MP_GC_SET_PROTECTED(set->table);
     for (size_t i = 0; i < old_alloc; i++) {
         if (old_table[i] != MP_OBJ_NULL && old_table[i] != MP_OBJ_SENTINEL) {
             mp_set_lookup(set, old_table[i], MP_MAP_LOOKUP_ADD_IF_NOT_FOUND);
@@ -311,6 +610,10 @@ mp_obj_t mp_set_lookup(mp_set_t *set, mp_obj_t index, mp_map_lookup_kind_t looku
     // Note: lookup_kind can be MP_MAP_LOOKUP_ADD_IF_NOT_FOUND_OR_REMOVE_IF_FOUND which
     // is handled by using bitwise operations.
 
+    if (lookup_kind & MP_MAP_LOOKUP_ADD_IF_NOT_FOUND) {
+        MP_GC_WRITE_BARRIER(set);
+    }
+
     if (set->alloc == 0) {
         if (lookup_kind & MP_MAP_LOOKUP_ADD_IF_NOT_FOUND) {
             mp_set_rehash(set);
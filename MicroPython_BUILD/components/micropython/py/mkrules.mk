@@ -50,7 +50,7 @@ $(BUILD)/%.o: %.c
 # List all native flags since the current build system doesn't have
 # the micropython configuration available. However, these flags are
 # needed to extract all qstrings
-QSTR_GEN_EXTRA_CFLAGS += -DNO_QSTR -DN_X64 -DN_X86 -DN_THUMB -DN_ARM -DN_XTENSA
+QSTR_GEN_EXTRA_CFLAGS += -DNO_QSTR -DN_X64 -DN_X86 -DN_THUMB -DN_ARM -DN_XTENSA -DN_XTENSAWIN
 QSTR_GEN_EXTRA_CFLAGS += -I$(BUILD)/tmp
 QSTR_GEN_EXTRA_CFLAGS += -I$(MP_EXTRA_INC)
 
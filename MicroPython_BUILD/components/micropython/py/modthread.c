@@ -25,7 +25,9 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
 #include "py/runtime.h"
 #include "py/stackctrl.h"
@@ -33,9 +35,63 @@
 #if MICROPY_PY_THREAD
 
 #include "py/mpthread.h"
+#include "py/mphal.h"
+#include "py/gc.h"
+#include "py/objlist.h"
+#include "py/mperrno.h"
 
 extern TaskHandle_t MainTaskHandle;
 
+#if MICROPY_PY_THREAD_GIL && MICROPY_PY_THREAD_GIL_SWITCH_INTERVAL
+/****************************************************************/
+// GIL with a switch interval
+
+// A waiter of priority prio stops waiting.  If it was the most urgent one the
+// priority of any others is not known, so they only get the GIL when the
+// interval is up.  A waiter which raised gil_waiter_prio since is left alone.
+//----------------------------------------
+STATIC void mp_thread_gil_unwait(int prio) {
+    int waiter_prio = __atomic_load_n(&MP_STATE_VM(gil_waiter_prio), __ATOMIC_SEQ_CST);
+    if (__atomic_sub_fetch(&MP_STATE_VM(gil_waiting), 1, __ATOMIC_SEQ_CST) == 0
+        || prio >= waiter_prio) {
+        __atomic_compare_exchange_n(&MP_STATE_VM(gil_waiter_prio), &waiter_prio, INT_MIN,
+            false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    }
+}
+
+//------------------------------
+void mp_thread_gil_enter(void) {
+    int prio = MICROPY_PY_THREAD_GIL_PRIORITY();
+    if (!mp_thread_mutex_lock(&MP_STATE_VM(gil_mutex), 0)) {
+        // let the holder know it should hand the GIL over, then wait for it
+        mp_state_thread_t *ts = mp_thread_get_state();
+        __atomic_add_fetch(&MP_STATE_VM(gil_waiting), 1, __ATOMIC_SEQ_CST);
+        ts->gil_waiting = true;
+        int waiter_prio = __atomic_load_n(&MP_STATE_VM(gil_waiter_prio), __ATOMIC_SEQ_CST);
+        while (prio > waiter_prio
+            && !__atomic_compare_exchange_n(&MP_STATE_VM(gil_waiter_prio), &waiter_prio, prio,
+                true, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        }
+        mp_thread_mutex_lock(&MP_STATE_VM(gil_mutex), 1);
+        ts->gil_waiting = false;
+        mp_thread_gil_unwait(prio);
+    }
+    MP_STATE_VM(gil_holder_prio) = prio;
+    MP_STATE_VM(gil_acquired_us) = mp_hal_ticks_us();
+}
+
+// Called by the port for a thread which is deleted while it may be waiting
+// for the GIL, so that it isn't counted as waiting any more.  Its priority
+// isn't kept, so that of the other waiters is forgotten too.
+//--------------------------------------------------
+void mp_thread_gil_cancel(mp_state_thread_t *ts) {
+    if (ts->gil_waiting) {
+        ts->gil_waiting = false;
+        mp_thread_gil_unwait(INT_MAX);
+    }
+}
+#endif
+
 /****************************************************************/
 // Lock object
 
@@ -126,6 +182,295 @@ STATIC const mp_obj_type_t mp_type_thread_lock = {
     .locals_dict = (mp_obj_dict_t*)&thread_lock_locals_dict,
 };
 
+#if MICROPY_PY_THREAD_CHANNEL
+#if !MICROPY_PY_THREAD_GIL
+#error "_thread.Channel requires MICROPY_PY_THREAD_GIL"
+#endif
+/****************************************************************/
+// Channel object
+//
+// A bounded FIFO of object references for passing data between threads.
+// Only references are queued, so a bytearray or memoryview put by one
+// thread is got by the other without being copied; the sender should not
+// use it any more once it's been put.  The channel is only changed with
+// the GIL held, the GIL is released while waiting on it.
+
+STATIC const mp_obj_type_t mp_type_thread_chan;
+
+// A thread waiting for an item (or for room for one), linked into the
+// channel's list while it sleeps; it lives on the waiting thread's stack
+//------------------------------------
+typedef struct _thread_chan_waiter_t {
+    struct _thread_chan_waiter_t *next;
+    mp_thread_sem_t *sem;
+} thread_chan_waiter_t;
+
+//------------------------------------
+typedef struct _mp_obj_thread_chan_t {
+    mp_obj_base_t base;
+    size_t capacity;
+    size_t len;
+    size_t head;
+    mp_obj_t *items;
+    thread_chan_waiter_t *getters;
+    thread_chan_waiter_t *putters;
+} mp_obj_thread_chan_t;
+
+// The wait a thread is blocked in, pointed to by its state so that it can be
+// undone if the thread is killed before it wakes
+//----------------------------------
+typedef struct _thread_chan_wait_t {
+    size_t n;
+    mp_obj_thread_chan_t **chans;
+    bool put;
+    thread_chan_waiter_t *waiters;
+} thread_chan_wait_t;
+
+//-------------------------------------------------------------------
+STATIC bool thread_chan_ready(mp_obj_thread_chan_t *self, bool put) {
+    return put ? (self->len < self->capacity) : (self->len > 0);
+}
+
+//-----------------------------------------------------------------------------------------
+STATIC void thread_chan_unlink(thread_chan_waiter_t **list, thread_chan_waiter_t *waiter) {
+    for (; *list != NULL; list = &(*list)->next) {
+        if (*list == waiter) {
+            *list = waiter->next;
+            break;
+        }
+    }
+}
+
+//-----------------------------------------------------------
+STATIC void thread_chan_link_wait(thread_chan_wait_t *wait) {
+    for (size_t i = 0; i < wait->n; ++i) {
+        thread_chan_waiter_t **list = wait->put ? &wait->chans[i]->putters : &wait->chans[i]->getters;
+        wait->waiters[i].next = *list;
+        *list = &wait->waiters[i];
+    }
+    MP_STATE_THREAD(chan_wait) = wait;
+}
+
+//----------------------------------------------------------
+STATIC void thread_chan_unlink_wait(mp_state_thread_t *ts) {
+    thread_chan_wait_t *wait = ts->chan_wait;
+    if (wait != NULL) {
+        for (size_t i = 0; i < wait->n; ++i) {
+            thread_chan_unlink(wait->put ? &wait->chans[i]->putters : &wait->chans[i]->getters, &wait->waiters[i]);
+        }
+        ts->chan_wait = NULL;
+    }
+}
+
+// Called by the port, with the GIL held, for a thread that is being killed or
+// deleted at soft reset, as its waiters and semaphore are on its stack
+//-------------------------------------------------
+void mp_thread_chan_cancel(mp_state_thread_t *ts) {
+    thread_chan_unlink_wait(ts);
+    ts->chan_killed = true;
+}
+
+// Every waiter is woken, as one waiting in select() may not take the item
+//--------------------------------------------------------
+STATIC void thread_chan_wake(thread_chan_waiter_t *list) {
+    for (; list != NULL; list = list->next) {
+        mp_thread_sem_post(list->sem);
+    }
+}
+
+// Waits for one of the channels to have an item, or room for one when put,
+// and returns its index; -1 if timeout ms pass first (< 0 waits forever)
+//-----------------------------------------------------------------------------------------------
+STATIC int thread_chan_wait(size_t n, mp_obj_thread_chan_t **chans, bool put, mp_int_t timeout) {
+    for (size_t i = 0; i < n; ++i) {
+        if (thread_chan_ready(chans[i], put)) {
+            return i;
+        }
+    }
+    if (timeout == 0) {
+        return -1;
+    }
+
+    mp_thread_sem_t sem;
+    mp_thread_sem_init(&sem);
+    thread_chan_wait_t wait = { n, chans, put, alloca(n * sizeof(thread_chan_waiter_t)) };
+    for (size_t i = 0; i < n; ++i) {
+        wait.waiters[i].sem = &sem;
+    }
+    mp_uint_t start = mp_hal_ticks_ms();
+    int ready = -1;
+    while (ready < 0) {
+        int ms = -1;
+        if (timeout > 0) {
+            mp_int_t left = timeout - (mp_int_t)(mp_hal_ticks_ms() - start);
+            if (left <= 0) {
+                break;
+            }
+            ms = left;
+        }
+        // a post made before the GIL is released is kept by the semaphore; a
+        // thread being killed isn't linked in again, it waits to be stopped
+        if (MP_STATE_THREAD(chan_killed)) {
+            ms = -1;
+        } else {
+            thread_chan_link_wait(&wait);
+        }
+        MP_THREAD_GIL_EXIT();
+        mp_thread_sem_wait(&sem, ms);
+        MP_THREAD_GIL_ENTER();
+        thread_chan_unlink_wait(mp_thread_get_state());
+        for (size_t i = 0; i < n; ++i) {
+            if (thread_chan_ready(chans[i], put)) {
+                ready = i;
+                break;
+            }
+        }
+    }
+    mp_thread_sem_deinit(&sem);
+    return ready;
+}
+
+//-----------------------------------------------------------
+STATIC mp_obj_t thread_chan_pop(mp_obj_thread_chan_t *self) {
+    mp_obj_t item = self->items[self->head];
+    self->items[self->head] = MP_OBJ_NULL;
+    self->head = (self->head + 1) % self->capacity;
+    self->len--;
+    return item;
+}
+
+//--------------------------------------------------------------------------------------
+STATIC mp_int_t thread_chan_get_timeout(size_t n_args, const mp_obj_t *args, size_t n) {
+    if (n_args > n && args[n] != mp_const_none) {
+        return mp_obj_get_int(args[n]);
+    }
+    return -1;
+}
+
+//-----------------------------------------------------------------------------------------------------------------
+STATIC mp_obj_t thread_chan_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
+    mp_arg_check_num(n_args, n_kw, 1, 1, false);
+    mp_int_t capacity = mp_obj_get_int(args[0]);
+    if (capacity < 1) {
+        mp_raise_ValueError(NULL);
+    }
+    mp_obj_thread_chan_t *self = m_new_obj(mp_obj_thread_chan_t);
+    self->base.type = &mp_type_thread_chan;
+    self->capacity = capacity;
+    self->len = 0;
+    self->head = 0;
+    self->items = m_new0(mp_obj_t, capacity);
+    MP_GC_SET_PROTECTED(self->items);
+    self->getters = NULL;
+    self->putters = NULL;
+    return MP_OBJ_FROM_PTR(self);
+}
+
+// put(obj[, timeout]): queues obj, waiting up to timeout ms for room;
+// returns False if there was none
+//--------------------------------------------------------------------
+STATIC mp_obj_t thread_chan_put(size_t n_args, const mp_obj_t *args) {
+    mp_obj_thread_chan_t *self = MP_OBJ_TO_PTR(args[0]);
+    if (thread_chan_wait(1, &self, true, thread_chan_get_timeout(n_args, args, 2)) < 0) {
+        return mp_const_false;
+    }
+    self->items[(self->head + self->len) % self->capacity] = args[1];
+    self->len++;
+    MP_GC_WRITE_BARRIER(self);
+    thread_chan_wake(self->getters);
+    return mp_const_true;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(thread_chan_put_obj, 2, 3, thread_chan_put);
+
+// get([timeout]): takes the oldest item, waiting up to timeout ms for one;
+// raises OSError(ETIMEDOUT) if none came
+//--------------------------------------------------------------------
+STATIC mp_obj_t thread_chan_get(size_t n_args, const mp_obj_t *args) {
+    mp_obj_thread_chan_t *self = MP_OBJ_TO_PTR(args[0]);
+    if (thread_chan_wait(1, &self, false, thread_chan_get_timeout(n_args, args, 1)) < 0) {
+        mp_raise_OSError(MP_ETIMEDOUT);
+    }
+    mp_obj_t item = thread_chan_pop(self);
+    thread_chan_wake(self->putters);
+    return item;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(thread_chan_get_obj, 1, 2, thread_chan_get);
+
+// get_many(n[, timeout]): waits like get() for the first item, then takes
+// up to n of those queued in one go; returns them as a list, empty if none came
+//-------------------------------------------------------------------------
+STATIC mp_obj_t thread_chan_get_many(size_t n_args, const mp_obj_t *args) {
+    mp_obj_thread_chan_t *self = MP_OBJ_TO_PTR(args[0]);
+    mp_int_t n = mp_obj_get_int(args[1]);
+    if (n < 1 || thread_chan_wait(1, &self, false, thread_chan_get_timeout(n_args, args, 2)) < 0) {
+        return mp_obj_new_list(0, NULL);
+    }
+    if ((size_t)n > self->len) {
+        n = self->len;
+    }
+    mp_obj_list_t *list = MP_OBJ_TO_PTR(mp_obj_new_list(n, NULL));
+    for (mp_int_t i = 0; i < n; ++i) {
+        list->items[i] = thread_chan_pop(self);
+    }
+    thread_chan_wake(self->putters);
+    return MP_OBJ_FROM_PTR(list);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(thread_chan_get_many_obj, 2, 3, thread_chan_get_many);
+
+//------------------------------------------------------------------------
+STATIC mp_obj_t thread_chan_unary_op(mp_unary_op_t op, mp_obj_t self_in) {
+    mp_obj_thread_chan_t *self = MP_OBJ_TO_PTR(self_in);
+    switch (op) {
+        case MP_UNARY_OP_BOOL: return mp_obj_new_bool(self->len != 0);
+        case MP_UNARY_OP_LEN: return MP_OBJ_NEW_SMALL_INT(self->len);
+        default: return MP_OBJ_NULL; // op not supported
+    }
+}
+
+//----------------------------------------------------------------
+STATIC const mp_rom_map_elem_t thread_chan_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_put), MP_ROM_PTR(&thread_chan_put_obj) },
+    { MP_ROM_QSTR(MP_QSTR_get), MP_ROM_PTR(&thread_chan_get_obj) },
+    { MP_ROM_QSTR(MP_QSTR_get_many), MP_ROM_PTR(&thread_chan_get_many_obj) },
+};
+
+STATIC MP_DEFINE_CONST_DICT(thread_chan_locals_dict, thread_chan_locals_dict_table);
+
+//------------------------------------------------
+STATIC const mp_obj_type_t mp_type_thread_chan = {
+    { &mp_type_type },
+    .name = MP_QSTR_Channel,
+    .make_new = thread_chan_make_new,
+    .unary_op = thread_chan_unary_op,
+    .locals_dict = (mp_obj_dict_t*)&thread_chan_locals_dict,
+};
+
+// select(channels[, timeout]): waits up to timeout ms for one of the channels
+// to have an item and returns it, or None; another thread may still get
+// the item first
+//----------------------------------------------------------------------
+STATIC mp_obj_t mod_thread_select(size_t n_args, const mp_obj_t *args) {
+    size_t n;
+    mp_obj_t *items;
+    mp_obj_get_array(args[0], &n, &items);
+    for (size_t i = 0; i < n; ++i) {
+        if (!MP_OBJ_IS_TYPE(items[i], &mp_type_thread_chan)) {
+            mp_raise_TypeError("expecting a Channel");
+        }
+    }
+    mp_obj_thread_chan_t **chans = alloca(n * sizeof(mp_obj_thread_chan_t*));
+    for (size_t i = 0; i < n; ++i) {
+        chans[i] = MP_OBJ_TO_PTR(items[i]);
+    }
+    int ready = thread_chan_wait(n, chans, false, thread_chan_get_timeout(n_args, args, 1));
+    if (ready < 0) {
+        return mp_const_none;
+    }
+    return items[ready];
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_thread_select_obj, 1, 2, mod_thread_select);
+#endif // MICROPY_PY_THREAD_CHANNEL
+
 /****************************************************************/
 // _thread module
 
@@ -179,11 +524,23 @@ STATIC void *thread_entry(void *args_in)
     thread_entry_args_t *args = (thread_entry_args_t*)args_in;
 
     mp_state_thread_t ts;
+    #if MICROPY_PY_THREAD_CHANNEL
+    // before the state can be seen by a thread killing this one
+    ts.chan_wait = NULL;
+    ts.chan_killed = false;
+    #endif
     mp_thread_set_state(&ts);
 
     mp_stack_set_top(&ts + 1); // need to include ts in root-pointer scan
     mp_stack_set_limit(args->stack_size);
 
+    #if MICROPY_PY_MICROPYTHON_HEAP_PROFILE
+    ts.current_code_state = NULL;
+    #endif
+    #if MICROPY_PY_MICROPYTHON_PROFILE
+    ts.profile_inner_ticks = 0;
+    #endif
+
     // set locals and globals from the calling context
     mp_locals_set(args->dict_locals);
     mp_globals_set(args->dict_globals);
@@ -235,7 +592,7 @@ STATIC mp_obj_t mod_thread_start_new_thread(size_t n_args, const mp_obj_t *args)
 
     char *name = NULL;
 	if (MP_OBJ_IS_STR(args[0])) {
-		name = mp_obj_str_get_str(args[0]);
+		name = (char *)mp_obj_str_get_str(args[0]);
 	}
 	else {
         mp_raise_TypeError("expecting a string for thread name argument");
@@ -547,6 +904,10 @@ STATIC const mp_rom_map_elem_t mp_module_thread_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR_list), MP_ROM_PTR(&mod_thread_list_obj) },
     { MP_ROM_QSTR(MP_QSTR_getThreadName), MP_ROM_PTR(&mod_thread_getname_obj) },
     { MP_ROM_QSTR(MP_QSTR_getSelfName), MP_ROM_PTR(&mod_thread_getSelfname_obj) },
+    #if MICROPY_PY_THREAD_CHANNEL
+    { MP_ROM_QSTR(MP_QSTR_Channel), MP_ROM_PTR(&mp_type_thread_chan) },
+    { MP_ROM_QSTR(MP_QSTR_select), MP_ROM_PTR(&mod_thread_select_obj) },
+    #endif
 	// Constants
 	{ MP_ROM_QSTR(MP_QSTR_PAUSE), MP_ROM_INT(THREAD_NOTIFY_PAUSE) },
 	{ MP_ROM_QSTR(MP_QSTR_SUSPEND), MP_ROM_INT(THREAD_NOTIFY_PAUSE) },
@@ -353,6 +353,23 @@ int mp_print_float(const mp_print_t *print, mp_float_t f, char fmt, int flags, c
         sign = ' ';
     }
 
+    #if MICROPY_OPT_STR_FORMAT_CACHE
+    // Without padding the result can be formatted straight into a vstr, as
+    // for str.format() and the % operator.
+    if (width <= 0 && print->print_strn == (mp_print_strn_t)vstr_add_strn) {
+        vstr_t *vstr = print->data;
+        char *s = vstr_add_len(vstr, sizeof(buf));
+        if (s != NULL) {
+            int len = mp_format_float(f, s, sizeof(buf), fmt, prec, sign);
+            if ((flags & PF_FLAG_ADD_PERCENT) && (size_t)(len + 1) < sizeof(buf)) {
+                s[len++] = '%';
+            }
+            vstr_cut_tail_bytes(vstr, sizeof(buf) - len);
+            return len;
+        }
+    }
+    #endif
+
     int len = mp_format_float(f, buf, sizeof(buf), fmt, prec, sign);
 
     char *s = buf;
@@ -46,6 +46,7 @@ typedef struct mp_dynamic_compiler_t {
     uint8_t small_int_bits; // must be <= host small_int_bits
     bool opt_cache_map_lookup_in_bytecode;
     bool py_builtins_str_unicode;
+    uint8_t native_arch; // MP_NATIVE_ARCH_xxx that native code is emitted for
 } mp_dynamic_compiler_t;
 extern mp_dynamic_compiler_t mp_dynamic_compiler;
 #endif
@@ -58,8 +59,72 @@ extern mp_dynamic_compiler_t mp_dynamic_compiler;
 typedef struct _mp_sched_item_t {
     mp_obj_t func;
     mp_obj_t arg;
+    volatile mp_uint_t seq; // queue position the slot is free or full for, see scheduler.c
 } mp_sched_item_t;
 
+#if MICROPY_PY_MICROPYTHON_HEAP_PROFILE
+// Allocations counted by micropython.heap_profile(); a site is a bytecode
+// instruction, or NULL bytecode for allocations made outside of bytecode.
+typedef struct _mp_heap_profile_site_t {
+    const byte *bytecode;
+    const byte *ip;
+    size_t n_bytes;
+    size_t n_allocs;
+} mp_heap_profile_site_t;
+#endif
+
+#if MICROPY_PY_MICROPYTHON_PROFILE
+// Counters of a function profiled by micropython.profile(); NULL bytecode
+// for the functions which found no free entry.
+typedef struct _mp_profile_fun_t {
+    const byte *bytecode;
+    size_t n_calls;
+    uint64_t total_ticks;
+    uint64_t self_ticks;
+} mp_profile_fun_t;
+#endif
+
+#if MICROPY_OPT_INLINE_CACHE
+// An entry of the inline cache of the VM, see vm.c.  It is not scanned for
+// root pointers: the objects it refers to are kept alive by the maps and
+// types it was filled from.
+typedef struct _mp_inline_cache_entry_t {
+    const byte *ip;
+    qstr qst;
+    const void *key;
+    mp_obj_t value;
+    size_t epoch;
+    uint16_t slot;
+    uint8_t kind;
+} mp_inline_cache_entry_t;
+#endif
+
+#if MICROPY_OPT_STR_FORMAT_CACHE
+// A piece of a parsed str.format() template, see objstr.c: a run of literal
+// text, followed by a replacement field unless arg is MP_STR_FORMAT_NO_FIELD.
+typedef struct _mp_str_format_piece_t {
+    uint16_t lit_off;
+    uint16_t lit_len;
+    int16_t width;
+    int16_t precision;
+    uint16_t flags;
+    int8_t arg;
+    char conversion;
+    char fill;
+    char align;
+    char type;
+    bool has_spec;
+} mp_str_format_piece_t;
+
+// A template in the format cache.  It refers to the template only by its qstr,
+// so it needs no scanning for root pointers.
+typedef struct _mp_str_format_cache_entry_t {
+    qstr fmt;
+    uint16_t n_pieces;
+    mp_str_format_piece_t piece[MICROPY_OPT_STR_FORMAT_CACHE_PIECES];
+} mp_str_format_cache_entry_t;
+#endif
+
 // This structure hold information about the memory allocation system.
 typedef struct _mp_state_mem_t {
     #if MICROPY_MEM_STATS
@@ -73,8 +138,20 @@ typedef struct _mp_state_mem_t {
     #if MICROPY_ENABLE_FINALISER
     byte *gc_finaliser_table_start;
     #endif
+    #if MICROPY_GC_NURSERY
+    byte *gc_gen_table_start;
+    #endif
+    #if MICROPY_GC_INCREMENTAL
+    byte *gc_incr_table_start;
+    #endif
     byte *gc_pool_start;
     byte *gc_pool_end;
+    #if MICROPY_GC_SPLIT_HEAP
+    // the fast region's blocks are numbered after those of the main pool
+    byte *gc_fast_pool_start;
+    byte *gc_fast_pool_end;
+    size_t gc_fast_block;
+    #endif
 
     int gc_stack_overflow;
     size_t gc_stack[MICROPY_ALLOC_GC_STACK_SIZE];
@@ -91,7 +168,87 @@ typedef struct _mp_state_mem_t {
     size_t gc_alloc_threshold;
     #endif
 
+    #if MICROPY_GC_COMPACT
+    // set for the collection which does the compaction
+    uint8_t gc_compact_active;
+    // set by a sweep which found the free blocks too fragmented
+    uint8_t gc_compact_wanted;
+    size_t gc_compact_threshold;
+    // largest run of free blocks left by the last compaction
+    size_t gc_compact_max_free;
+    size_t gc_compact_moved;
+    // runs of free blocks seen by the sweep in progress
+    size_t gc_compact_run;
+    size_t gc_compact_max_run;
+    #endif
+
     size_t gc_last_free_atb_index;
+    #if MICROPY_GC_SPLIT_HEAP
+    size_t gc_fast_last_free_atb_index;
+    // smallest number of blocks not found in the fast region since it was
+    // last swept or freed into
+    size_t gc_fast_full_blocks;
+    #endif
+
+    #if MICROPY_GC_NURSERY
+    // Blocks allocated since the last collection lie within
+    // [gc_young_start, gc_young_end); minor collections only sweep that range.
+    size_t gc_nursery_blocks;
+    size_t gc_young_blocks;
+    size_t gc_young_start;
+    size_t gc_young_end;
+    uint16_t gc_minor_pending;
+    uint16_t gc_minor_active;
+    uint32_t gc_pause_start_us;
+    uint32_t gc_minor_count;
+    uint32_t gc_major_count;
+    uint32_t gc_minor_last_us;
+    uint32_t gc_major_last_us;
+    uint32_t gc_max_pause_us;
+    #endif
+
+    #if MICROPY_GC_FREE_LISTS
+    // Start blocks of runs of free blocks, by size class, in address order.
+    // Each list is filled from the allocation table when it runs out, from
+    // gc_free_list_scan on; the runs before that are on the list unless they
+    // have been allocated since, so entries are checked before use.
+    size_t gc_free_list[MICROPY_GC_FREE_LIST_CLASSES][MICROPY_GC_FREE_LIST_DEPTH];
+    uint16_t gc_free_list_head[MICROPY_GC_FREE_LIST_CLASSES];
+    uint16_t gc_free_list_len[MICROPY_GC_FREE_LIST_CLASSES];
+    size_t gc_free_list_scan[MICROPY_GC_FREE_LIST_CLASSES];
+    #endif
+
+    #if MICROPY_GC_INCREMENTAL
+    // State of the incremental cycle, see gc_collect_step().
+    size_t gc_incr_cursor;
+    size_t gc_incr_work;
+    size_t gc_incr_sweep_block;
+    uint16_t gc_incr_phase;
+    uint16_t gc_incr_found;
+    uint16_t gc_incr_rescan_dirty;
+    // set once the dirty blocks have been traced again by the steps
+    uint16_t gc_incr_precleaned;
+    // set for the gc_collect() which ends the marking of a step
+    uint16_t gc_incr_sweep_later;
+    // set when a cycle is completed, by a step or by a gc_collect(), until
+    // gc.collect(budget_us=...) reports it
+    uint16_t gc_incr_completed;
+    #endif
+
+    #if MICROPY_GC_PARALLEL_MARK
+    // State of the parallel mark, by core: the GC stack, whether blocks have
+    // to be traced again after it overflowed, and a queue of blocks passed to
+    // it by the other core, written at the head by that core and read at the
+    // tail by this one.
+    size_t gc_par_stack[2][MICROPY_GC_PARALLEL_STACK_SIZE];
+    size_t gc_par_sp[2];
+    uint8_t gc_par_overflow[2];
+    size_t gc_par_queue[2][MICROPY_GC_PARALLEL_STACK_SIZE];
+    volatile size_t gc_par_queue_head[2];
+    volatile size_t gc_par_queue_tail[2];
+    volatile uint8_t gc_par_idle[2];
+    volatile uint8_t gc_par_done;
+    #endif
 
     #if MICROPY_PY_GC_COLLECT_RETVAL
     size_t gc_collected;
@@ -140,9 +297,15 @@ typedef struct _mp_state_vm_t {
     volatile mp_obj_t mp_pending_exception;
 
     #if MICROPY_ENABLE_SCHEDULER
-    volatile int16_t sched_state;
-    uint16_t sched_sp;
-    mp_sched_item_t sched_stack[MICROPY_SCHEDULER_DEPTH];
+    volatile mp_int_t sched_state;
+    // one ring of sched_mask + 1 items per priority level, NULL while resized
+    mp_sched_item_t *volatile sched_queue;
+    mp_uint_t sched_mask;
+    volatile mp_uint_t sched_head[MICROPY_SCHEDULER_PRIORITIES];
+    volatile mp_uint_t sched_tail[MICROPY_SCHEDULER_PRIORITIES];
+    volatile mp_uint_t sched_producers;
+    volatile mp_uint_t sched_dropped;
+    volatile mp_uint_t sched_max_depth;
     #endif
 
     // current exception being handled, for sys.exc_info()
@@ -181,6 +344,16 @@ typedef struct _mp_state_vm_t {
     struct _mp_vfs_mount_t *vfs_mount_table;
     #endif
 
+    #if MICROPY_PY_MICROPYTHON_HEAP_PROFILE
+    // keeps the bytecode of the sites alive
+    mp_heap_profile_site_t heap_profile_sites[MICROPY_PY_MICROPYTHON_HEAP_PROFILE_SITES];
+    #endif
+
+    #if MICROPY_PY_MICROPYTHON_PROFILE
+    // keeps the bytecode of the profiled functions alive
+    mp_profile_fun_t profile_funs[MICROPY_PY_MICROPYTHON_PROFILE_FUNS];
+    #endif
+
     //
     // END ROOT POINTER SECTION
     ////////////////////////////////////////////////////////////
@@ -206,6 +379,34 @@ typedef struct _mp_state_vm_t {
     #if MICROPY_PY_THREAD_GIL
     // This is a global mutex used to make the VM/runtime thread-safe.
     mp_thread_mutex_t gil_mutex;
+    #if MICROPY_PY_THREAD_GIL_SWITCH_INTERVAL
+    // number of threads blocked on the GIL, the highest priority among them
+    // (if known), and the priority of its holder
+    volatile uint16_t gil_waiting;
+    volatile int gil_waiter_prio;
+    int gil_holder_prio;
+    // when the holder took the GIL, and the interval to keep it for, in us
+    mp_uint_t gil_acquired_us;
+    mp_uint_t gil_switch_interval;
+    #endif
+    #endif
+
+    #if MICROPY_PY_MICROPYTHON_HEAP_PROFILE
+    bool heap_profile_enabled;
+    #endif
+
+    #if MICROPY_PY_MICROPYTHON_PROFILE
+    bool profile_enabled;
+    uint32_t profile_opcodes[256];
+    #endif
+
+    #if MICROPY_OPT_INLINE_CACHE
+    size_t inline_cache_epoch;
+    mp_inline_cache_entry_t inline_cache[MICROPY_OPT_INLINE_CACHE_SIZE];
+    #endif
+
+    #if MICROPY_OPT_STR_FORMAT_CACHE
+    mp_str_format_cache_entry_t str_format_cache[MICROPY_OPT_STR_FORMAT_CACHE_SIZE];
     #endif
 } mp_state_vm_t;
 
@@ -224,6 +425,28 @@ typedef struct _mp_state_thread_t {
     #if MICROPY_STACK_CHECK
     size_t stack_limit;
     #endif
+
+    #if MICROPY_PY_MICROPYTHON_HEAP_PROFILE
+    // the bytecode being run by this thread, NULL if none
+    struct _mp_code_state_t *current_code_state;
+    #endif
+
+    #if MICROPY_PY_MICROPYTHON_PROFILE
+    // cycles spent in the functions called by the one being profiled
+    uint32_t profile_inner_ticks;
+    #endif
+
+    #if MICROPY_PY_THREAD_CHANNEL
+    // the _thread.Channel wait this thread is blocked in, NULL if none, and
+    // whether the thread is being killed
+    struct _thread_chan_wait_t *chan_wait;
+    bool chan_killed;
+    #endif
+
+    #if MICROPY_PY_THREAD_GIL && MICROPY_PY_THREAD_GIL_SWITCH_INTERVAL
+    // whether this thread is counted in gil_waiting
+    volatile bool gil_waiting;
+    #endif
 } mp_state_thread_t;
 
 // This structure combines the above 3 structures.
@@ -98,6 +98,20 @@ void mp_native_raise(mp_obj_t o) {
     }
 }
 
+#if MICROPY_NLR_SETJMP
+// with setjmp-based NLR, nlr_push and nlr_pop are macros; native code links
+// the nlr_buf_t in with this wrapper and then calls setjmp on it directly
+STATIC unsigned int mp_native_nlr_push(nlr_buf_t *nlr) {
+    nlr->prev = MP_STATE_THREAD(nlr_top);
+    MP_STATE_THREAD(nlr_top) = nlr;
+    return 0;
+}
+
+STATIC void mp_native_nlr_pop(void) {
+    nlr_pop();
+}
+#endif
+
 // wrapper that handles iterator buffer
 STATIC mp_obj_t mp_native_getiter(mp_obj_t obj, mp_obj_iter_buf_t *iter) {
     if (iter == NULL) {
@@ -149,6 +163,9 @@ void *const mp_fun_table[MP_F_NUMBER_OF] = {
 #if MICROPY_PY_BUILTINS_SET
     mp_obj_new_set,
     mp_obj_set_store,
+#else
+    NULL,
+    NULL,
 #endif
     mp_make_function_from_raw_code,
     mp_native_call_function_n_kw,
@@ -156,14 +173,21 @@ void *const mp_fun_table[MP_F_NUMBER_OF] = {
     mp_call_method_n_kw_var,
     mp_native_getiter,
     mp_native_iternext,
+#if MICROPY_NLR_SETJMP
+    mp_native_nlr_push,
+    mp_native_nlr_pop,
+#else
     nlr_push,
     nlr_pop,
+#endif
     mp_native_raise,
     mp_import_name,
     mp_import_from,
     mp_import_all,
 #if MICROPY_PY_BUILTINS_SLICE
     mp_obj_new_slice,
+#else
+    NULL,
 #endif
     mp_unpack_sequence,
     mp_unpack_ex,
@@ -172,6 +196,11 @@ void *const mp_fun_table[MP_F_NUMBER_OF] = {
     mp_obj_new_cell,
     mp_make_closure_from_raw_code,
     mp_setup_code_state,
+#if MICROPY_NLR_SETJMP
+    setjmp,
+#else
+    NULL,
+#endif
 };
 
 /*
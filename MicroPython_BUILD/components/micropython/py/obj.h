@@ -357,7 +357,10 @@ typedef struct _mp_map_t {
     size_t all_keys_are_qstrs : 1;
     size_t is_fixed : 1;    // a fixed array that can't be modified; must also be ordered
     size_t is_ordered : 1;  // an ordered array
-    size_t used : (8 * sizeof(size_t) - 3);
+    #if MICROPY_OPT_INLINE_CACHE
+    size_t is_versioned : 1; // adding or removing a key invalidates the inline cache
+    #endif
+    size_t used : (8 * sizeof(size_t) - 3 - MICROPY_OPT_INLINE_CACHE);
     size_t alloc;
     mp_map_elem_t *table;
 } mp_map_t;
@@ -376,6 +379,8 @@ static inline bool MP_MAP_SLOT_IS_FILLED(const mp_map_t *map, size_t pos) { retu
 
 void mp_map_init(mp_map_t *map, size_t n);
 void mp_map_init_fixed_table(mp_map_t *map, size_t n, const mp_obj_t *table);
+void mp_map_init_copy(mp_map_t *map, const mp_map_t *src);
+size_t mp_map_table_bytes(size_t alloc, bool is_ordered);
 mp_map_t *mp_map_new(size_t n);
 void mp_map_deinit(mp_map_t *map);
 void mp_map_free(mp_map_t *map);
@@ -35,6 +35,7 @@
 #include "py/binary.h"
 #include "py/objstr.h"
 #include "py/objarray.h"
+#include "py/gc.h"
 
 #if MICROPY_PY_ARRAY || MICROPY_PY_BUILTINS_BYTEARRAY || MICROPY_PY_BUILTINS_MEMORYVIEW
 
@@ -106,6 +107,7 @@ STATIC mp_obj_array_t *array_new(char typecode, size_t n) {
     o->free = 0;
     o->len = n;
     o->items = m_new(byte, typecode_size * o->len);
+    MP_GC_SET_PROTECTED(o->items);
     return o;
 }
 #endif
@@ -222,6 +224,17 @@ STATIC mp_obj_t memoryview_make_new(const mp_obj_type_t *type_in, size_t n_args,
         bufinfo.len / mp_binary_get_size('@', bufinfo.typecode, NULL),
         bufinfo.buf));
 
+    #if MICROPY_OPT_BYTES_SLICE_VIEW
+    // the data of a bytes view is inside a buffer, so point to its start
+    if (MP_OBJ_IS_TYPE(args[0], &mp_type_bytes)) {
+        const byte *buf = mp_obj_bytes_get_view_buf(args[0]);
+        if (buf != NULL) {
+            self->items = (void*)buf;
+            self->free = (const byte*)bufinfo.buf - buf;
+        }
+    }
+    #endif
+
     // test if the object can be written to
     if (mp_get_buffer(args[0], &bufinfo, MP_BUFFER_RW)) {
         self->typecode |= 0x80; // used to indicate writable buffer
@@ -322,8 +335,10 @@ STATIC mp_obj_t array_append(mp_obj_t self_in, mp_obj_t arg) {
         self->free = 8;
         self->items = m_renew(byte, self->items, item_sz * self->len, item_sz * (self->len + self->free));
         mp_seq_clear(self->items, self->len + 1, self->len + self->free, item_sz);
+        MP_GC_SET_PROTECTED(self->items);
     }
     mp_binary_set_val_array(self->typecode, self->items, self->len, arg);
+    MP_GC_WRITE_BARRIER(self);
     // only update length/free if set succeeded
     self->len++;
     self->free--;
@@ -351,6 +366,7 @@ STATIC mp_obj_t array_extend(mp_obj_t self_in, mp_obj_t arg_in) {
     if (self->free < len) {
         self->items = m_renew(byte, self->items, (self->len + self->free) * sz, (self->len + len) * sz);
         self->free = 0;
+        MP_GC_SET_PROTECTED(self->items);
     } else {
         self->free -= len;
     }
@@ -358,6 +374,7 @@ STATIC mp_obj_t array_extend(mp_obj_t self_in, mp_obj_t arg_in) {
     // extend
     mp_seq_copy((byte*)self->items + self->len * sz, arg_bufinfo.buf, len * sz, byte);
     self->len += len;
+    MP_GC_WRITE_BARRIER(self);
 
     return mp_const_none;
 }
@@ -433,6 +450,7 @@ STATIC mp_obj_t array_subscr(mp_obj_t self_in, mp_obj_t index_in, mp_obj_t value
                         o->items = m_renew(byte, o->items, (o->len + o->free) * item_sz, (o->len + len_adj) * item_sz);
                         o->free = 0;
                         dest_items = o->items;
+                        MP_GC_SET_PROTECTED(o->items);
                     }
                     mp_seq_replace_slice_grow_inplace(dest_items, o->len,
                         slice.start, slice.stop, src_items, src_len, len_adj, item_sz);
@@ -445,6 +463,7 @@ STATIC mp_obj_t array_subscr(mp_obj_t self_in, mp_obj_t index_in, mp_obj_t value
                     // TODO: alloc policy after shrinking
                 }
                 o->len += len_adj;
+                MP_GC_WRITE_BARRIER(o);
                 return mp_const_none;
                 #else
                 return MP_OBJ_NULL; // op not supported
@@ -486,6 +505,7 @@ STATIC mp_obj_t array_subscr(mp_obj_t self_in, mp_obj_t index_in, mp_obj_t value
             } else {
                 // store
                 mp_binary_set_val_array(o->typecode & TYPECODE_MASK, o->items, index, value);
+                MP_GC_WRITE_BARRIER(o);
                 return mp_const_none;
             }
         }
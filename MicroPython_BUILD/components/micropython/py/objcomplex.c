@@ -55,20 +55,26 @@ STATIC void complex_print(const mp_print_t *print, mp_obj_t o_in, mp_print_kind_
     #else
     const int precision = 7;
     #endif
+    const char fmt = 'g';
+#elif MICROPY_FLOAT_EXACT_CONV
+    char buf[32];
+    const char fmt = 'r';
+    const int precision = 0;
 #else
     char buf[32];
+    const char fmt = 'g';
     const int precision = 16;
 #endif
     if (o->real == 0) {
-        mp_format_float(o->imag, buf, sizeof(buf), 'g', precision, '\0');
+        mp_format_float(o->imag, buf, sizeof(buf), fmt, precision, '\0');
         mp_printf(print, "%sj", buf);
     } else {
-        mp_format_float(o->real, buf, sizeof(buf), 'g', precision, '\0');
+        mp_format_float(o->real, buf, sizeof(buf), fmt, precision, '\0');
         mp_printf(print, "(%s", buf);
         if (o->imag >= 0 || isnan(o->imag)) {
             mp_print_str(print, "+");
         }
-        mp_format_float(o->imag, buf, sizeof(buf), 'g', precision, '\0');
+        mp_format_float(o->imag, buf, sizeof(buf), fmt, precision, '\0');
         mp_printf(print, "%sj)", buf);
     }
 }
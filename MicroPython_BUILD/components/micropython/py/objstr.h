@@ -38,11 +38,29 @@ typedef struct _mp_obj_str_t {
 
 #define MP_DEFINE_STR_OBJ(obj_name, str) mp_obj_str_t obj_name = {{&mp_type_str}, 0, sizeof(str) - 1, (const byte*)str}
 
+#if MICROPY_OPT_STR_APPEND
+// A str/bytes whose data may be appended to in place (see str_append in
+// objstr.c) has this bit set in its hash field, with the size of its buffer
+#define MP_OBJ_STR_HASH_APPENDABLE ((mp_uint_t)1 << (8 * sizeof(mp_uint_t) - 1))
+#else
+#define MP_OBJ_STR_HASH_APPENDABLE (0)
+#endif
+#if MICROPY_OPT_BYTES_SLICE_VIEW
+// A bytes sharing the data of the one it was sliced from (see
+// bytes_new_view in objstr.c) has this in its hash field
+#define MP_OBJ_STR_HASH_VIEW ((mp_uint_t)1 << (8 * sizeof(mp_uint_t) - 2))
+#else
+#define MP_OBJ_STR_HASH_VIEW (0)
+#endif
+// Valid hashes never have these bits set
+#define MP_OBJ_STR_HASH_FLAGS (MP_OBJ_STR_HASH_APPENDABLE | MP_OBJ_STR_HASH_VIEW)
+#define MP_OBJ_STR_HASH_VALID(hash) ((hash) & MP_OBJ_STR_HASH_FLAGS ? 0 : (hash))
+
 // use this macro to extract the string hash
 // warning: the hash can be 0, meaning invalid, and must then be explicitly computed from the data
 #define GET_STR_HASH(str_obj_in, str_hash) \
     mp_uint_t str_hash; if (MP_OBJ_IS_QSTR(str_obj_in)) \
-    { str_hash = qstr_hash(MP_OBJ_QSTR_VALUE(str_obj_in)); } else { str_hash = ((mp_obj_str_t*)MP_OBJ_TO_PTR(str_obj_in))->hash; }
+    { str_hash = qstr_hash(MP_OBJ_QSTR_VALUE(str_obj_in)); } else { str_hash = MP_OBJ_STR_HASH_VALID(((mp_obj_str_t*)MP_OBJ_TO_PTR(str_obj_in))->hash); }
 
 // use this macro to extract the string length
 #define GET_STR_LEN(str_obj_in, str_len) \
@@ -63,6 +81,9 @@ const byte *mp_obj_str_get_data_no_check(mp_obj_t self_in, size_t *len);
 
 mp_obj_t mp_obj_str_make_new(const mp_obj_type_t *type_in, size_t n_args, size_t n_kw, const mp_obj_t *args);
 void mp_str_print_json(const mp_print_t *print, const byte *str_data, size_t str_len);
+#if MICROPY_OPT_BYTES_SLICE_VIEW
+const byte *mp_obj_bytes_get_view_buf(mp_obj_t self_in);
+#endif
 mp_obj_t mp_obj_str_format(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs);
 mp_obj_t mp_obj_str_split(size_t n_args, const mp_obj_t *args);
 mp_obj_t mp_obj_new_str_of_type(const mp_obj_type_t *type, const byte* data, size_t len);
@@ -33,13 +33,14 @@
 #include "py/emitglue.h"
 #include "py/persistentcode.h"
 #include "py/bc.h"
+#include "py/runtime0.h"
 
 #if MICROPY_PERSISTENT_CODE_LOAD || MICROPY_PERSISTENT_CODE_SAVE
 
 #include "py/smallint.h"
 
 // The current version of .mpy files
-#define MPY_VERSION (2)
+#define MPY_VERSION (4)
 
 // The feature flags byte encodes the compile-time config options that
 // affect the generate bytecode.
@@ -53,6 +54,14 @@
     | ((MICROPY_PY_BUILTINS_STR_UNICODE_DYNAMIC) << 1) \
     )
 
+// The architecture of native code that can be loaded, which is stored in
+// the upper bits of the feature flags byte.
+#if MICROPY_EMIT_XTENSAWIN
+#define MPY_FEATURE_ARCH (MP_NATIVE_ARCH_XTENSAWIN)
+#else
+#define MPY_FEATURE_ARCH (MP_NATIVE_ARCH_NONE)
+#endif
+
 #if MICROPY_PERSISTENT_CODE_LOAD || (MICROPY_PERSISTENT_CODE_SAVE && !MICROPY_DYNAMIC_COMPILER)
 // The bytecode will depend on the number of bits in a small-int, and
 // this function computes that (could make it a fixed constant, but it
@@ -165,9 +174,118 @@ STATIC void load_bytecode_qstrs(mp_reader_t *reader, byte *ip, byte *ip_top) {
     }
 }
 
+STATIC mp_raw_code_t *load_raw_code(mp_reader_t *reader);
+
+#if MPY_FEATURE_ARCH != MP_NATIVE_ARCH_NONE
+STATIC mp_uint_t load_native_link(mp_reader_t *reader, byte kind) {
+    switch (kind) {
+        case MP_NATIVE_LINK_FUN: {
+            size_t idx = read_uint(reader);
+            if (idx >= MP_F_NUMBER_OF || mp_fun_table[idx] == NULL) {
+                break;
+            }
+            return (mp_uint_t)mp_fun_table[idx];
+        }
+        case MP_NATIVE_LINK_QSTR:
+            return load_qstr(reader);
+        case MP_NATIVE_LINK_QSTR_OBJ:
+            return (mp_uint_t)MP_OBJ_NEW_QSTR(load_qstr(reader));
+        case MP_NATIVE_LINK_CONST:
+            switch (read_byte(reader)) {
+                case MP_NATIVE_CONST_NONE: return (mp_uint_t)mp_const_none;
+                case MP_NATIVE_CONST_FALSE: return (mp_uint_t)mp_const_false;
+                case MP_NATIVE_CONST_TRUE: return (mp_uint_t)mp_const_true;
+                case MP_NATIVE_CONST_ELLIPSIS: return (mp_uint_t)MP_ROM_PTR(&mp_const_ellipsis_obj);
+            }
+            break;
+        case MP_NATIVE_LINK_OBJ:
+            return (mp_uint_t)load_obj(reader);
+        case MP_NATIVE_LINK_RAW_CODE:
+            return (mp_uint_t)(uintptr_t)load_raw_code(reader);
+    }
+    mp_raise_ValueError("incompatible .mpy file");
+}
+
+STATIC mp_raw_code_t *load_raw_code_native(mp_reader_t *reader, mp_raw_code_kind_t kind, size_t fun_data_len) {
+    // load the machine code into memory that it can be run from
+    byte *fun_data;
+    size_t fun_alloc;
+    MP_PLAT_ALLOC_EXEC(fun_data_len, (void**)&fun_data, &fun_alloc);
+    (void)fun_alloc;
+    read_bytes(reader, fun_data, fun_data_len);
+
+    const mp_uint_t *const_table = NULL;
+    mp_uint_t scope_flags;
+    mp_uint_t n_pos_args;
+    mp_uint_t type_sig = 0;
+    if (kind == MP_CODE_NATIVE_PY) {
+        // link the qstrs of the prelude, which is followed by the argument names
+        size_t prelude_offset = read_uint(reader);
+        if (prelude_offset >= fun_data_len) {
+            mp_raise_ValueError("incompatible .mpy file");
+        }
+        const byte *ip = fun_data + prelude_offset;
+        const byte *ip2;
+        bytecode_prelude_t prelude;
+        extract_prelude(&ip, &ip2, &prelude);
+        qstr simple_name = load_qstr(reader);
+        qstr source_file = load_qstr(reader);
+        ((byte*)ip2)[0] = simple_name; ((byte*)ip2)[1] = simple_name >> 8;
+        ((byte*)ip2)[2] = source_file; ((byte*)ip2)[3] = source_file >> 8;
+        const_table = (const mp_uint_t*)(fun_data + ((ip - fun_data + 3) & ~3));
+        scope_flags = prelude.scope_flags;
+        n_pos_args = prelude.n_pos_args;
+    } else {
+        scope_flags = read_uint(reader);
+        n_pos_args = read_uint(reader);
+        type_sig = read_uint(reader);
+    }
+
+    // patch the words that refer to this firmware, which are little endian
+    size_t n_link = read_uint(reader);
+    for (size_t i = 0; i < n_link; ++i) {
+        byte link_kind = read_byte(reader);
+        size_t offset = read_uint(reader);
+        mp_uint_t val = load_native_link(reader, link_kind);
+        if (offset + 4 > fun_data_len) {
+            mp_raise_ValueError("incompatible .mpy file");
+        }
+        fun_data[offset] = val;
+        fun_data[offset + 1] = val >> 8;
+        fun_data[offset + 2] = val >> 16;
+        fun_data[offset + 3] = val >> 24;
+    }
+
+    void *fun = fun_data;
+    #if defined(MP_PLAT_COMMIT_EXEC)
+    fun = MP_PLAT_COMMIT_EXEC(fun_data, fun_data_len);
+    #endif
+
+    mp_raw_code_t *rc = mp_emit_glue_new_raw_code();
+    mp_emit_glue_assign_native(rc, kind, fun, fun_data_len, const_table,
+        #if MICROPY_PERSISTENT_CODE_SAVE
+        0, 0, NULL,
+        #endif
+        n_pos_args, scope_flags, type_sig);
+    return rc;
+}
+#endif
+
 STATIC mp_raw_code_t *load_raw_code(mp_reader_t *reader) {
+    // the kind of code is stored in the low bits of its length
+    size_t kind_len = read_uint(reader);
+    mp_raw_code_kind_t kind = MP_CODE_BYTECODE + (kind_len & 3);
+    if (kind != MP_CODE_BYTECODE) {
+        #if MPY_FEATURE_ARCH != MP_NATIVE_ARCH_NONE
+        if (kind == MP_CODE_NATIVE_PY || kind == MP_CODE_NATIVE_VIPER) {
+            return load_raw_code_native(reader, kind, kind_len >> 2);
+        }
+        #endif
+        mp_raise_ValueError("incompatible .mpy file");
+    }
+
     // load bytecode
-    size_t bc_len = read_uint(reader);
+    size_t bc_len = kind_len >> 2;
     byte *bytecode = m_new(byte, bc_len);
     read_bytes(reader, bytecode, bc_len);
 
@@ -214,7 +332,8 @@ mp_raw_code_t *mp_raw_code_load(mp_reader_t *reader) {
     read_bytes(reader, header, sizeof(header));
     if (header[0] != 'M'
         || header[1] != MPY_VERSION
-        || header[2] != MPY_FEATURE_FLAGS
+        || (header[2] & 3) != MPY_FEATURE_FLAGS
+        || ((header[2] >> 2) != MP_NATIVE_ARCH_NONE && (header[2] >> 2) != MPY_FEATURE_ARCH)
         || header[3] > mp_small_int_bits()) {
         mp_raise_ValueError("incompatible .mpy file");
     }
@@ -241,6 +360,13 @@ mp_raw_code_t *mp_raw_code_load_file(const char *filename) {
 
 #include "py/objstr.h"
 
+// The architecture of the native code that is saved
+#if MICROPY_DYNAMIC_COMPILER
+#define MPY_SAVE_ARCH (mp_dynamic_compiler.native_arch)
+#else
+#define MPY_SAVE_ARCH (MPY_FEATURE_ARCH)
+#endif
+
 STATIC void mp_print_bytes(mp_print_t *print, const byte *data, size_t len) {
     print->print_strn(print->data, (const char*)data, len);
 }
@@ -317,13 +443,76 @@ STATIC void save_bytecode_qstrs(mp_print_t *print, const byte *ip, const byte *i
     }
 }
 
+STATIC void save_raw_code(mp_print_t *print, mp_raw_code_t *rc);
+
+#if MICROPY_EMIT_NATIVE
+STATIC void save_raw_code_native(mp_print_t *print, mp_raw_code_t *rc) {
+    // save machine code
+    const byte *fun_data = rc->data.u_native.fun_data;
+    mp_print_uint(print, (rc->data.u_native.fun_data_len << 2) | (rc->kind - MP_CODE_BYTECODE));
+    mp_print_bytes(print, fun_data, rc->data.u_native.fun_data_len);
+
+    if (rc->kind == MP_CODE_NATIVE_PY) {
+        // save prelude qstrs, the argument names are links
+        const byte *ip = fun_data + rc->data.u_native.prelude_offset;
+        const byte *ip2;
+        bytecode_prelude_t prelude;
+        extract_prelude(&ip, &ip2, &prelude);
+        mp_print_uint(print, rc->data.u_native.prelude_offset);
+        save_qstr(print, ip2[0] | (ip2[1] << 8)); // simple_name
+        save_qstr(print, ip2[2] | (ip2[3] << 8)); // source_file
+    } else {
+        mp_print_uint(print, rc->scope_flags);
+        mp_print_uint(print, rc->n_pos_args);
+        mp_print_uint(print, rc->data.u_native.type_sig);
+    }
+
+    // save links
+    mp_print_uint(print, rc->data.u_native.n_link);
+    for (size_t i = 0; i < rc->data.u_native.n_link; ++i) {
+        const mp_native_link_t *link = &rc->data.u_native.links[i];
+        byte kind = link->kind;
+        mp_print_bytes(print, &kind, 1);
+        mp_print_uint(print, link->offset);
+        switch (kind) {
+            case MP_NATIVE_LINK_FUN:
+                mp_print_uint(print, link->arg);
+                break;
+            case MP_NATIVE_LINK_QSTR:
+            case MP_NATIVE_LINK_QSTR_OBJ:
+                save_qstr(print, link->arg);
+                break;
+            case MP_NATIVE_LINK_CONST: {
+                byte c = link->arg;
+                mp_print_bytes(print, &c, 1);
+                break;
+            }
+            case MP_NATIVE_LINK_OBJ:
+                save_obj(print, (mp_obj_t)link->arg);
+                break;
+            default:
+                assert(kind == MP_NATIVE_LINK_RAW_CODE);
+                save_raw_code(print, (mp_raw_code_t*)(uintptr_t)link->arg);
+                break;
+        }
+    }
+}
+#endif
+
 STATIC void save_raw_code(mp_print_t *print, mp_raw_code_t *rc) {
+    #if MICROPY_EMIT_NATIVE
+    // native code can only be saved if it was emitted with links
+    if ((rc->kind == MP_CODE_NATIVE_PY || rc->kind == MP_CODE_NATIVE_VIPER) && MPY_SAVE_ARCH != MP_NATIVE_ARCH_NONE) {
+        save_raw_code_native(print, rc);
+        return;
+    }
+    #endif
     if (rc->kind != MP_CODE_BYTECODE) {
-        mp_raise_ValueError("can only save bytecode");
+        mp_raise_ValueError("can only save bytecode and native code");
     }
 
     // save bytecode
-    mp_print_uint(print, rc->data.u_byte.bc_len);
+    mp_print_uint(print, rc->data.u_byte.bc_len << 2);
     mp_print_bytes(print, rc->data.u_byte.bytecode, rc->data.u_byte.bc_len);
 
     // extract prelude
@@ -357,9 +546,9 @@ void mp_raw_code_save(mp_raw_code_t *rc, mp_print_t *print) {
     // header contains:
     //  byte  'M'
     //  byte  version
-    //  byte  feature flags
+    //  byte  feature flags, and native architecture in the upper bits
     //  byte  number of bits in a small int
-    byte header[4] = {'M', MPY_VERSION, MPY_FEATURE_FLAGS_DYNAMIC,
+    byte header[4] = {'M', MPY_VERSION, MPY_FEATURE_FLAGS_DYNAMIC | (MPY_SAVE_ARCH << 2),
         #if MICROPY_DYNAMIC_COMPILER
         mp_dynamic_compiler.small_int_bits,
         #else
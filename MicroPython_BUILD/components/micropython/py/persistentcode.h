@@ -30,6 +30,10 @@
 #include "py/reader.h"
 #include "py/emitglue.h"
 
+// The architecture of the native code in a .mpy file, if it has any
+#define MP_NATIVE_ARCH_NONE (0)
+#define MP_NATIVE_ARCH_XTENSAWIN (1)
+
 mp_raw_code_t *mp_raw_code_load(mp_reader_t *reader);
 mp_raw_code_t *mp_raw_code_load_mem(const byte *buf, size_t len);
 mp_raw_code_t *mp_raw_code_load_file(const char *filename);
@@ -93,6 +93,7 @@ PY_O_BASENAME = \
 	emitnarm.o \
 	asmxtensa.o \
 	emitnxtensa.o \
+	emitnxtensawin.o \
 	emitinlinextensa.o \
 	formatfloat.o \
 	parsenumbase.o \
@@ -176,6 +177,7 @@ PY_O_BASENAME = \
 	../extmod/moduzlib.o \
 	../extmod/moduheapq.o \
 	../extmod/modutimeq.o \
+	../extmod/moduasyncio.o \
 	../extmod/moduhashlib.o \
 	../extmod/modubinascii.o \
 	../extmod/virtpin.o \
@@ -264,6 +266,10 @@ $(PY_BUILD)/emitnxtensa.o: CFLAGS += -DN_XTENSA
 $(PY_BUILD)/emitnxtensa.o: py/emitnative.c
 	$(call compile_c)
 
+$(PY_BUILD)/emitnxtensawin.o: CFLAGS += -DN_XTENSAWIN
+$(PY_BUILD)/emitnxtensawin.o: py/emitnative.c
+	$(call compile_c)
+
 # optimising gc for speed; 5ms down to 4ms on pybv2
 $(PY_BUILD)/gc.o: CFLAGS += $(CSUPEROPT)
 
@@ -68,10 +68,22 @@ void mp_handle_pending(void);
 void mp_handle_pending_tail(mp_uint_t atomic_state);
 
 #if MICROPY_ENABLE_SCHEDULER
+void mp_sched_init(size_t depth);
+void mp_sched_resize(size_t depth);
+void mp_sched_deinit(void);
+static inline size_t mp_sched_depth(void) { return MP_STATE_VM(sched_mask) + 1; }
 void mp_sched_lock(void);
 void mp_sched_unlock(void);
-static inline unsigned int mp_sched_num_pending(void) { return MP_STATE_VM(sched_sp); }
-bool mp_sched_schedule(mp_obj_t function, mp_obj_t arg);
+void mp_sched_idle(void);
+unsigned int mp_sched_num_pending(void);
+bool mp_sched_schedule_ex(mp_obj_t function, mp_obj_t arg, unsigned int prio, bool coalesce);
+static inline bool mp_sched_schedule(mp_obj_t function, mp_obj_t arg) { return mp_sched_schedule_ex(function, arg, 0, false); }
+// Producers only ever move the state from idle to pending, so this can't undo
+// a lock; inline so that it can be used from ISRs in IRAM
+static inline void mp_sched_set_pending(void) {
+    mp_int_t idle = MP_SCHED_IDLE;
+    __atomic_compare_exchange_n(&MP_STATE_VM(sched_state), &idle, MP_SCHED_PENDING, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
 #endif
 
 // extra printing method specifically for mp_obj_t's which are integral type
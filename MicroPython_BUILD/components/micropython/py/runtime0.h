@@ -100,6 +100,8 @@ typedef enum {
     MP_BINARY_OP_IS_NOT,
 } mp_binary_op_t;
 
+// The entries don't depend on the config, because native code saved to a .mpy
+// file refers to them by index; those that aren't available are NULL.
 typedef enum {
     MP_F_CONVERT_OBJ_TO_NATIVE = 0,
     MP_F_CONVERT_NATIVE_TO_OBJ,
@@ -121,10 +123,8 @@ typedef enum {
     MP_F_LIST_APPEND,
     MP_F_BUILD_MAP,
     MP_F_STORE_MAP,
-#if MICROPY_PY_BUILTINS_SET
     MP_F_BUILD_SET,
     MP_F_STORE_SET,
-#endif
     MP_F_MAKE_FUNCTION_FROM_RAW_CODE,
     MP_F_NATIVE_CALL_FUNCTION_N_KW,
     MP_F_CALL_METHOD_N_KW,
@@ -137,9 +137,7 @@ typedef enum {
     MP_F_IMPORT_NAME,
     MP_F_IMPORT_FROM,
     MP_F_IMPORT_ALL,
-#if MICROPY_PY_BUILTINS_SLICE
     MP_F_NEW_SLICE,
-#endif
     MP_F_UNPACK_SEQUENCE,
     MP_F_UNPACK_EX,
     MP_F_DELETE_NAME,
@@ -147,6 +145,7 @@ typedef enum {
     MP_F_NEW_CELL,
     MP_F_MAKE_CLOSURE_FROM_RAW_CODE,
     MP_F_SETUP_CODE_STATE,
+    MP_F_SETJMP,
     MP_F_NUMBER_OF,
 } mp_fun_kind_t;
 
@@ -30,6 +30,185 @@
 
 #if MICROPY_ENABLE_SCHEDULER
 
+// Callbacks are queued in a bounded ring per priority level, which ISRs and
+// tasks on either core add to without a lock, and only the thread holding
+// the GIL takes from.  A slot's seq is its position in the ring while it's
+// free and that position + 1 once it's full: a producer claims a free slot
+// by moving sched_tail on with a compare-and-swap, fills it and then updates
+// seq; the consumer empties it and moves seq on by the size of the ring.
+
+#define SCHED_LOAD(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define SCHED_STORE(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_SEQ_CST)
+#define SCHED_CAS(ptr, expected, val) \
+    __atomic_compare_exchange_n((ptr), (expected), (val), false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)
+
+STATIC mp_sched_item_t *sched_alloc(size_t depth) {
+    mp_sched_item_t *queue = m_new_maybe(mp_sched_item_t, MICROPY_SCHEDULER_PRIORITIES * depth);
+    if (queue != NULL) {
+        for (size_t i = 0; i < MICROPY_SCHEDULER_PRIORITIES * depth; ++i) {
+            queue[i].func = MP_OBJ_NULL;
+            queue[i].arg = MP_OBJ_NULL;
+            queue[i].seq = i & (depth - 1);
+        }
+    }
+    return queue;
+}
+
+// Takes the oldest callback from the highest non-empty level, if any
+STATIC bool sched_pop(mp_sched_item_t *queue, mp_uint_t mask, mp_sched_item_t *item) {
+    for (size_t prio = MICROPY_SCHEDULER_PRIORITIES; prio-- > 0;) {
+        mp_uint_t pos = MP_STATE_VM(sched_head)[prio];
+        mp_sched_item_t *slot = &queue[prio * (mask + 1) + (pos & mask)];
+        if (SCHED_LOAD(&slot->seq) == pos + 1) {
+            item->func = slot->func;
+            item->arg = slot->arg;
+            slot->func = MP_OBJ_NULL;
+            slot->arg = MP_OBJ_NULL;
+            SCHED_STORE(&slot->seq, pos + mask + 1);
+            MP_STATE_VM(sched_head)[prio] = pos + 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+STATIC bool sched_ready(void) {
+    mp_sched_item_t *queue = MP_STATE_VM(sched_queue);
+    if (queue == NULL) {
+        return false;
+    }
+    mp_uint_t mask = MP_STATE_VM(sched_mask);
+    for (size_t prio = 0; prio < MICROPY_SCHEDULER_PRIORITIES; ++prio) {
+        mp_uint_t pos = MP_STATE_VM(sched_head)[prio];
+        if (SCHED_LOAD(&queue[prio * (mask + 1) + (pos & mask)].seq) == pos + 1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Looks for the same callback still waiting at this level; one that's been
+// taken off the queue meanwhile may already be running, so isn't a match
+STATIC bool sched_find(mp_sched_item_t *ring, mp_uint_t mask, size_t prio, mp_obj_t function, mp_obj_t arg) {
+    mp_uint_t pos = SCHED_LOAD(&MP_STATE_VM(sched_head)[prio]);
+    mp_uint_t end = SCHED_LOAD(&MP_STATE_VM(sched_tail)[prio]);
+    for (mp_uint_t n = 0; pos != end && n <= mask; ++pos, ++n) {
+        mp_sched_item_t *slot = &ring[pos & mask];
+        if (SCHED_LOAD(&slot->seq) == pos + 1 && slot->func == function && slot->arg == arg
+            && SCHED_LOAD(&slot->seq) == pos + 1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+STATIC size_t sched_round_depth(size_t depth) {
+    size_t n = 2;
+    while (n < depth) {
+        n <<= 1;
+    }
+    return n;
+}
+
+void mp_sched_init(size_t depth) {
+    depth = sched_round_depth(depth);
+    MP_STATE_VM(sched_state) = MP_SCHED_IDLE;
+    for (size_t prio = 0; prio < MICROPY_SCHEDULER_PRIORITIES; ++prio) {
+        MP_STATE_VM(sched_head)[prio] = 0;
+        MP_STATE_VM(sched_tail)[prio] = 0;
+    }
+    MP_STATE_VM(sched_producers) = 0;
+    MP_STATE_VM(sched_dropped) = 0;
+    MP_STATE_VM(sched_max_depth) = 0;
+    MP_STATE_VM(sched_mask) = depth - 1;
+    // if this fails, every callback is dropped until the queue is resized
+    MP_STATE_VM(sched_queue) = sched_alloc(depth);
+}
+
+// Only called with the GIL held, so never runs alongside the consumer
+void mp_sched_resize(size_t depth) {
+    depth = sched_round_depth(depth);
+    mp_sched_item_t *new_queue = sched_alloc(depth);
+    if (new_queue == NULL) {
+        m_malloc_fail(MICROPY_SCHEDULER_PRIORITIES * depth * sizeof(mp_sched_item_t));
+    }
+
+    // detach the old queue, callbacks queued from now on are dropped, then
+    // wait for those being queued already
+    mp_sched_item_t *old_queue = MP_STATE_VM(sched_queue);
+    SCHED_STORE(&MP_STATE_VM(sched_queue), NULL);
+    while (SCHED_LOAD(&MP_STATE_VM(sched_producers)) != 0) {
+        MICROPY_SCHEDULER_RESIZE_WAIT();
+    }
+
+    // move what's pending across, in order, dropping what doesn't fit
+    mp_uint_t old_mask = MP_STATE_VM(sched_mask);
+    for (size_t prio = 0; prio < MICROPY_SCHEDULER_PRIORITIES; ++prio) {
+        mp_uint_t n = 0;
+        while (old_queue != NULL && MP_STATE_VM(sched_head)[prio] != MP_STATE_VM(sched_tail)[prio]) {
+            mp_sched_item_t *slot = &old_queue[prio * (old_mask + 1) + (MP_STATE_VM(sched_head)[prio] & old_mask)];
+            if (n < depth) {
+                new_queue[prio * depth + n].func = slot->func;
+                new_queue[prio * depth + n].arg = slot->arg;
+                new_queue[prio * depth + n].seq = n + 1;
+                ++n;
+            } else {
+                __atomic_add_fetch(&MP_STATE_VM(sched_dropped), 1, __ATOMIC_RELAXED);
+            }
+            ++MP_STATE_VM(sched_head)[prio];
+        }
+        MP_STATE_VM(sched_head)[prio] = 0;
+        MP_STATE_VM(sched_tail)[prio] = n;
+    }
+    MP_STATE_VM(sched_mask) = depth - 1;
+    SCHED_STORE(&MP_STATE_VM(sched_queue), new_queue);
+    if (old_queue != NULL) {
+        m_del(mp_sched_item_t, old_queue, MICROPY_SCHEDULER_PRIORITIES * (old_mask + 1));
+    }
+}
+
+// Called at soft reset, before the heap the queue lives on is reinitialised.
+// Producers are told to drop callbacks before waiting for those already
+// queueing, and the waiting is done with interrupts enabled because the
+// producer being waited for may be a task preempted on this core.
+void mp_sched_deinit(void) {
+    mp_uint_t atomic_state = MICROPY_BEGIN_ATOMIC_SECTION();
+    SCHED_STORE(&MP_STATE_VM(sched_queue), NULL);
+    MICROPY_END_ATOMIC_SECTION(atomic_state);
+    while (SCHED_LOAD(&MP_STATE_VM(sched_producers)) != 0) {
+        MICROPY_SCHEDULER_RESIZE_WAIT();
+    }
+
+    atomic_state = MICROPY_BEGIN_ATOMIC_SECTION();
+    for (size_t prio = 0; prio < MICROPY_SCHEDULER_PRIORITIES; ++prio) {
+        MP_STATE_VM(sched_head)[prio] = 0;
+        MP_STATE_VM(sched_tail)[prio] = 0;
+    }
+    MP_STATE_VM(sched_mask) = 0;
+    MP_STATE_VM(sched_state) = MP_SCHED_IDLE;
+    MICROPY_END_ATOMIC_SECTION(atomic_state);
+}
+
+unsigned int mp_sched_num_pending(void) {
+    unsigned int n = 0;
+    for (size_t prio = 0; prio < MICROPY_SCHEDULER_PRIORITIES; ++prio) {
+        // the head first, so it can't have overtaken the tail read after it
+        mp_uint_t head = SCHED_LOAD(&MP_STATE_VM(sched_head)[prio]);
+        n += SCHED_LOAD(&MP_STATE_VM(sched_tail)[prio]) - head;
+    }
+    return n;
+}
+
+// Goes idle when there's nothing left to do, checking again afterwards for
+// anything that was queued while the state was still pending or locked
+void mp_sched_idle(void) {
+    SCHED_STORE(&MP_STATE_VM(sched_state), MP_SCHED_IDLE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (MP_STATE_VM(mp_pending_exception) != MP_OBJ_NULL || sched_ready()) {
+        mp_sched_set_pending();
+    }
+}
+
 // A variant of this is inlined in the VM at the pending exception check
 void mp_handle_pending(void) {
     if (MP_STATE_VM(sched_state) == MP_SCHED_PENDING) {
@@ -37,9 +216,7 @@ void mp_handle_pending(void) {
         mp_obj_t obj = MP_STATE_VM(mp_pending_exception);
         if (obj != MP_OBJ_NULL) {
             MP_STATE_VM(mp_pending_exception) = MP_OBJ_NULL;
-            if (!mp_sched_num_pending()) {
-                MP_STATE_VM(sched_state) = MP_SCHED_IDLE;
-            }
+            mp_sched_idle();
             MICROPY_END_ATOMIC_SECTION(atomic_state);
             nlr_raise(obj);
         }
@@ -51,8 +228,9 @@ void mp_handle_pending(void) {
 // or by the VM's inlined version of that function.
 void mp_handle_pending_tail(mp_uint_t atomic_state) {
     MP_STATE_VM(sched_state) = MP_SCHED_LOCKED;
-    if (MP_STATE_VM(sched_sp) > 0) {
-        mp_sched_item_t item = MP_STATE_VM(sched_stack)[--MP_STATE_VM(sched_sp)];
+    mp_sched_item_t item;
+    mp_sched_item_t *queue = MP_STATE_VM(sched_queue);
+    if (queue != NULL && sched_pop(queue, MP_STATE_VM(sched_mask), &item)) {
         MICROPY_END_ATOMIC_SECTION(atomic_state);
         mp_call_function_1_protected(item.func, item.arg);
     } else {
@@ -75,31 +253,60 @@ void mp_sched_unlock(void) {
     mp_uint_t atomic_state = MICROPY_BEGIN_ATOMIC_SECTION();
     if (++MP_STATE_VM(sched_state) == 0) {
         // vm became unlocked
-        if (MP_STATE_VM(mp_pending_exception) != MP_OBJ_NULL || mp_sched_num_pending()) {
-            MP_STATE_VM(sched_state) = MP_SCHED_PENDING;
-        } else {
-            MP_STATE_VM(sched_state) = MP_SCHED_IDLE;
-        }
+        mp_sched_idle();
     }
     MICROPY_END_ATOMIC_SECTION(atomic_state);
 }
 
-bool mp_sched_schedule(mp_obj_t function, mp_obj_t arg) {
-    mp_uint_t atomic_state = MICROPY_BEGIN_ATOMIC_SECTION();
-    bool ret;
-    if (MP_STATE_VM(sched_sp) < MICROPY_SCHEDULER_DEPTH) {
-        if (MP_STATE_VM(sched_state) == MP_SCHED_IDLE) {
-            MP_STATE_VM(sched_state) = MP_SCHED_PENDING;
+// Safe to call from ISRs and other tasks on either core
+bool mp_sched_schedule_ex(mp_obj_t function, mp_obj_t arg, unsigned int prio, bool coalesce) {
+    if (prio >= MICROPY_SCHEDULER_PRIORITIES) {
+        prio = MICROPY_SCHEDULER_PRIORITIES - 1;
+    }
+    __atomic_add_fetch(&MP_STATE_VM(sched_producers), 1, __ATOMIC_SEQ_CST);
+    mp_sched_item_t *queue = __atomic_load_n(&MP_STATE_VM(sched_queue), __ATOMIC_SEQ_CST);
+    bool ret = false;
+    if (queue != NULL) {
+        mp_uint_t mask = MP_STATE_VM(sched_mask);
+        mp_sched_item_t *ring = &queue[prio * (mask + 1)];
+        volatile mp_uint_t *tail = &MP_STATE_VM(sched_tail)[prio];
+        if (coalesce && sched_find(ring, mask, prio, function, arg)) {
+            ret = true;
+        } else {
+            mp_uint_t pos = __atomic_load_n(tail, __ATOMIC_RELAXED);
+            for (;;) {
+                mp_sched_item_t *slot = &ring[pos & mask];
+                mp_int_t diff = (mp_int_t)(SCHED_LOAD(&slot->seq) - pos);
+                if (diff == 0) {
+                    if (SCHED_CAS(tail, &pos, pos + 1)) {
+                        slot->func = function;
+                        slot->arg = arg;
+                        SCHED_STORE(&slot->seq, pos + 1);
+                        ret = true;
+                        break;
+                    }
+                } else if (diff < 0) {
+                    // this level is full
+                    break;
+                } else {
+                    // another producer got this slot first
+                    pos = __atomic_load_n(tail, __ATOMIC_RELAXED);
+                }
+            }
+            if (ret) {
+                mp_uint_t depth = mp_sched_num_pending();
+                mp_uint_t max_depth = MP_STATE_VM(sched_max_depth);
+                while (depth > max_depth && !SCHED_CAS(&MP_STATE_VM(sched_max_depth), &max_depth, depth)) {
+                }
+            }
         }
-        MP_STATE_VM(sched_stack)[MP_STATE_VM(sched_sp)].func = function;
-        MP_STATE_VM(sched_stack)[MP_STATE_VM(sched_sp)].arg = arg;
-        ++MP_STATE_VM(sched_sp);
-        ret = true;
+    }
+    if (ret) {
+        mp_sched_set_pending();
     } else {
-        // schedule stack is full
-        ret = false;
+        __atomic_add_fetch(&MP_STATE_VM(sched_dropped), 1, __ATOMIC_RELAXED);
     }
-    MICROPY_END_ATOMIC_SECTION(atomic_state);
+    __atomic_sub_fetch(&MP_STATE_VM(sched_producers), 1, __ATOMIC_SEQ_CST);
     return ret;
 }
 
@@ -57,6 +57,9 @@ static const void *const entry_table[256] = {
     [MP_BC_DELETE_DEREF] = &&entry_MP_BC_DELETE_DEREF,
     [MP_BC_DELETE_NAME] = &&entry_MP_BC_DELETE_NAME,
     [MP_BC_DELETE_GLOBAL] = &&entry_MP_BC_DELETE_GLOBAL,
+    [MP_BC_LOAD_FAST_ATTR] = &&entry_MP_BC_LOAD_FAST_ATTR,
+    [MP_BC_LOAD_FAST_METHOD] = &&entry_MP_BC_LOAD_FAST_METHOD,
+    [MP_BC_BINARY_OP_FAST_SMALL_INT] = &&entry_MP_BC_BINARY_OP_FAST_SMALL_INT,
     [MP_BC_DUP_TOP] = &&entry_MP_BC_DUP_TOP,
     [MP_BC_DUP_TOP_TWO] = &&entry_MP_BC_DUP_TOP_TWO,
     [MP_BC_POP_TOP] = &&entry_MP_BC_POP_TOP,
@@ -67,6 +70,8 @@ static const void *const entry_table[256] = {
     [MP_BC_POP_JUMP_IF_FALSE] = &&entry_MP_BC_POP_JUMP_IF_FALSE,
     [MP_BC_JUMP_IF_TRUE_OR_POP] = &&entry_MP_BC_JUMP_IF_TRUE_OR_POP,
     [MP_BC_JUMP_IF_FALSE_OR_POP] = &&entry_MP_BC_JUMP_IF_FALSE_OR_POP,
+    [MP_BC_BINARY_OP_POP_JUMP_IF_TRUE] = &&entry_MP_BC_BINARY_OP_POP_JUMP_IF_TRUE,
+    [MP_BC_BINARY_OP_POP_JUMP_IF_FALSE] = &&entry_MP_BC_BINARY_OP_POP_JUMP_IF_FALSE,
     [MP_BC_SETUP_WITH] = &&entry_MP_BC_SETUP_WITH,
     [MP_BC_WITH_CLEANUP] = &&entry_MP_BC_WITH_CLEANUP,
     [MP_BC_UNWIND_JUMP] = &&entry_MP_BC_UNWIND_JUMP,
@@ -57,7 +57,7 @@ class FreezeError(Exception):
         return 'error while freezing %s: %s' % (self.rawcode.source_file, self.msg)
 
 class Config:
-    MPY_VERSION = 2
+    MPY_VERSION = 4
     MICROPY_LONGINT_IMPL_NONE = 0
     MICROPY_LONGINT_IMPL_LONGLONG = 1
     MICROPY_LONGINT_IMPL_MPZ = 2
@@ -72,6 +72,12 @@ MP_OPCODE_OFFSET = 3
 MP_BC_MAKE_CLOSURE = 0x62
 MP_BC_MAKE_CLOSURE_DEFARGS = 0x63
 MP_BC_RAISE_VARARGS = 0x5c
+MP_BC_LOAD_FAST_ATTR = 0x2c
+MP_BC_LOAD_FAST_METHOD = 0x2d
+MP_BC_BINARY_OP_POP_JUMP_IF_TRUE = 0x3a
+MP_BC_BINARY_OP_POP_JUMP_IF_FALSE = 0x3b
+# 3 extra bytes:
+MP_BC_BINARY_OP_FAST_SMALL_INT = 0x2e
 # extra byte if caching enabled:
 MP_BC_LOAD_NAME = 0x1c
 MP_BC_LOAD_GLOBAL = 0x1d
@@ -99,10 +105,10 @@ def make_opcode_format():
     OC4(B, B, V, V), # 0x20-0x23
     OC4(Q, Q, Q, B), # 0x24-0x27
     OC4(V, V, Q, Q), # 0x28-0x2b
-    OC4(U, U, U, U), # 0x2c-0x2f
+    OC4(Q, Q, B, U), # 0x2c-0x2f
     OC4(B, B, B, B), # 0x30-0x33
     OC4(B, O, O, O), # 0x34-0x37
-    OC4(O, O, U, U), # 0x38-0x3b
+    OC4(O, O, O, O), # 0x38-0x3b
     OC4(U, O, B, O), # 0x3c-0x3f
     OC4(O, B, B, O), # 0x40-0x43
     OC4(B, B, O, U), # 0x44-0x47
@@ -167,11 +173,17 @@ def mp_opcode_format(bytecode, ip, opcode_format=make_opcode_format()):
     f = (opcode_format[opcode >> 2] >> (2 * (opcode & 3))) & 3
     if f == MP_OPCODE_QSTR:
         ip += 3
+        if opcode == MP_BC_LOAD_FAST_ATTR or opcode == MP_BC_LOAD_FAST_METHOD:
+            ip += 1
+    elif opcode == MP_BC_BINARY_OP_FAST_SMALL_INT:
+        ip += 4
     else:
         extra_byte = (
             opcode == MP_BC_RAISE_VARARGS
             or opcode == MP_BC_MAKE_CLOSURE
             or opcode == MP_BC_MAKE_CLOSURE_DEFARGS
+            or opcode == MP_BC_BINARY_OP_POP_JUMP_IF_TRUE
+            or opcode == MP_BC_BINARY_OP_POP_JUMP_IF_FALSE
             or config.MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE and (
                 opcode == MP_BC_LOAD_NAME
                 or opcode == MP_BC_LOAD_GLOBAL
@@ -426,7 +438,10 @@ def read_bytecode_qstrs(file, bytecode, ip):
         ip += sz
 
 def read_raw_code(f):
-    bc_len = read_uint(f)
+    kind_len = read_uint(f)
+    if kind_len & 3:
+        raise Exception('native code in .mpy files can not be frozen')
+    bc_len = kind_len >> 2
     bytecode = bytearray(f.read(bc_len))
     ip, ip2, prelude = extract_prelude(bytecode)
     read_qstr_and_pack(f, bytecode, ip2) # simple_name
@@ -514,6 +529,14 @@ def freeze_mpy(base_qstrs, raw_codes):
             print('    MP_QSTR_%s,' % new[i][1])
     print('};')
 
+    print()
+    qstr_index = qstrutil.make_index([bytes_cons(qstr, 'utf8') for _, _, qstr in new])
+    print('#if MICROPY_OPT_QSTR_INDEX')
+    print('STATIC const uint16_t mp_qstr_frozen_const_pool_index[] = {')
+    for i in range(0, len(qstr_index), 16):
+        print('    %s,' % ', '.join(str(n) for n in qstr_index[i:i + 16]))
+    print('};')
+    print('#endif')
     print()
     print('extern const qstr_pool_t mp_qstr_const_pool;');
     print('const qstr_pool_t mp_qstr_frozen_const_pool = {')
@@ -521,6 +544,10 @@ def freeze_mpy(base_qstrs, raw_codes):
     print('    MP_QSTRnumber_of, // previous pool size')
     print('    %u, // allocated entries' % len(new))
     print('    %u, // used entries' % len(new))
+    print('    #if MICROPY_OPT_QSTR_INDEX')
+    print('    mp_qstr_frozen_const_pool_index,')
+    print('    %u, // index size' % len(qstr_index))
+    print('    #endif')
     print('    {')
     for _, _, qstr in new:
         print('        %s,'
@@ -0,0 +1,514 @@
+/*
+ * This file is part of the MicroPython project, http://micropython.org/
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 MicroPython_ESP32_psRAM_LoBo contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "py/runtime.h"
+#include "py/smallint.h"
+#include "py/stream.h"
+#include "py/mphal.h"
+#include "py/gc.h"
+#include "extmod/modutimeq.h"
+#include "extmod/moduselect.h"
+
+#if MICROPY_PY_UASYNCIO
+
+#if !MICROPY_PY_UTIMEQ || !MICROPY_PY_USELECT
+#error _uasyncio requires MICROPY_PY_UTIMEQ and MICROPY_PY_USELECT
+#endif
+
+/// \module _uasyncio - core of an asyncio-style event loop
+///
+/// A Loop runs generator based coroutines (tasks) and plain callbacks.
+/// A task tells the loop what it waits for by what it yields:
+///
+///   yield             run again after the other ready tasks
+///   yield ms          sleep for ms milliseconds
+///   yield loop.wait_read(stream), yield loop.wait_write(stream)
+///                     sleep until the stream is ready; the stream must
+///                     support the poll ioctl, like sockets and uarts do
+///
+/// sleep_ms(), wait_read() and wait_write() can also be awaited from
+/// async def coroutines.  Sleeping tasks wait in a utimeq, tasks waiting
+/// for streams in a poll map (see moduselect.c), so nothing is polled in
+/// Python.  When no task is ready the loop sleeps, with the GIL released,
+/// until the first timer is due or one of the streams gets ready; it only
+/// has to poll while it waits on a stream without a file descriptor.
+/// Callbacks scheduled by interrupts run when it next wakes.
+
+#define LOOP_TICKS() (mp_hal_ticks_ms() & (MICROPY_PY_UTIME_TICKS_PERIOD - 1))
+#define LOOP_TICKS_DIFF(end, start) ((mp_int_t)((((end) - (start) + MICROPY_PY_UTIME_TICKS_PERIOD / 2) \
+    & (MICROPY_PY_UTIME_TICKS_PERIOD - 1)) - MICROPY_PY_UTIME_TICKS_PERIOD / 2))
+
+typedef struct _mp_obj_loop_t {
+    mp_obj_base_t base;
+    mp_obj_t *runq;         // ring of (callback, args) pairs ready to run
+    size_t runq_alloc;      // in pairs
+    size_t runq_head;
+    size_t runq_len;
+    mp_obj_t waitq;         // utimeq of sleeping tasks and delayed callbacks
+    size_t waitq_alloc;
+    mp_map_t poll_map;      // streams waited on
+    mp_map_t readers;       // mp_obj_id(stream) -> task waiting to read it
+    mp_map_t writers;       // mp_obj_id(stream) -> task waiting to write it
+    mp_obj_t cur_task;      // task being resumed, MP_OBJ_NULL outside of one
+    mp_obj_t main_task;     // coroutine of run_until_complete()
+    mp_obj_t main_ret;
+    bool stopped;
+} mp_obj_loop_t;
+
+// What sleep_ms(), wait_read() and wait_write() return: an iterator that
+// yields value to the loop once, so it works with both yield and await
+typedef struct _mp_obj_loop_yield_t {
+    mp_obj_base_t base;
+    mp_obj_t value;
+} mp_obj_loop_yield_t;
+
+STATIC mp_obj_t loop_yield_iternext(mp_obj_t self_in) {
+    mp_obj_loop_yield_t *self = MP_OBJ_TO_PTR(self_in);
+    mp_obj_t value = self->value;
+    if (value == MP_OBJ_NULL) {
+        return MP_OBJ_STOP_ITERATION;
+    }
+    self->value = MP_OBJ_NULL;
+    return value;
+}
+
+STATIC const mp_obj_type_t loop_yield_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_generator,
+    .getiter = mp_identity_getiter,
+    .iternext = loop_yield_iternext,
+};
+
+STATIC mp_obj_t loop_yield_new(mp_obj_t value) {
+    mp_obj_loop_yield_t *o = m_new_obj(mp_obj_loop_yield_t);
+    o->base.type = &loop_yield_type;
+    o->value = value;
+    return MP_OBJ_FROM_PTR(o);
+}
+
+STATIC void loop_push_run(mp_obj_loop_t *self, mp_obj_t callback, mp_obj_t args) {
+    if (self->runq_len == self->runq_alloc) {
+        // grow the ring, unwrapping it so the new space follows the tail
+        size_t alloc = self->runq_alloc * 2;
+        mp_obj_t *runq = m_new0(mp_obj_t, alloc * 2);
+        for (size_t i = 0; i < self->runq_len; ++i) {
+            size_t j = (self->runq_head + i) % self->runq_alloc;
+            runq[2 * i] = self->runq[2 * j];
+            runq[2 * i + 1] = self->runq[2 * j + 1];
+        }
+        m_del(mp_obj_t, self->runq, self->runq_alloc * 2);
+        self->runq = runq;
+        MP_GC_SET_PROTECTED(self->runq);
+        self->runq_alloc = alloc;
+        self->runq_head = 0;
+    }
+    size_t i = (self->runq_head + self->runq_len) % self->runq_alloc;
+    self->runq[2 * i] = callback;
+    self->runq[2 * i + 1] = args;
+    self->runq_len++;
+    MP_GC_WRITE_BARRIER(self);
+}
+
+STATIC void loop_pop_run(mp_obj_loop_t *self, mp_obj_t *callback, mp_obj_t *args) {
+    size_t i = self->runq_head;
+    *callback = self->runq[2 * i];
+    *args = self->runq[2 * i + 1];
+    // so we don't retain a pointer
+    self->runq[2 * i] = MP_OBJ_NULL;
+    self->runq[2 * i + 1] = MP_OBJ_NULL;
+    self->runq_head = (i + 1) % self->runq_alloc;
+    self->runq_len--;
+}
+
+STATIC void loop_push_wait(mp_obj_loop_t *self, mp_int_t delay, mp_obj_t callback, mp_obj_t args) {
+    if (mp_utimeq_len(self->waitq) == self->waitq_alloc) {
+        // utimeq can't grow, so move the entries to a bigger one, in order
+        mp_obj_t waitq = mp_utimeq_new(self->waitq_alloc * 2);
+        while (mp_utimeq_len(self->waitq) > 0) {
+            mp_uint_t time = mp_utimeq_peektime(self->waitq);
+            mp_obj_t cb, cb_args;
+            mp_utimeq_pop(self->waitq, &cb, &cb_args);
+            mp_utimeq_push(waitq, time, cb, cb_args);
+        }
+        self->waitq = waitq;
+        self->waitq_alloc *= 2;
+        MP_GC_WRITE_BARRIER(self);
+    }
+    // keep the wake up time within the half of the ticks period utimeq can order
+    if (delay < 0) {
+        delay = 0;
+    } else if (delay >= MICROPY_PY_UTIME_TICKS_PERIOD / 2) {
+        delay = MICROPY_PY_UTIME_TICKS_PERIOD / 2 - 1;
+    }
+    mp_utimeq_push(self->waitq, (LOOP_TICKS() + delay) & (MICROPY_PY_UTIME_TICKS_PERIOD - 1), callback, args);
+}
+
+// Resumes a task, or calls a callback with its tuple of args, and
+// queues the task again according to what it yielded
+STATIC void loop_run_one(mp_obj_loop_t *self, mp_obj_t callback, mp_obj_t args) {
+    if (!MP_OBJ_IS_TYPE(callback, &mp_type_gen_instance)) {
+        size_t n_args = 0;
+        mp_obj_t *items = NULL;
+        if (args != mp_const_none) {
+            mp_obj_tuple_get(args, &n_args, &items);
+        }
+        mp_call_function_n_kw(callback, n_args, 0, items);
+        return;
+    }
+
+    mp_obj_t ret;
+    self->cur_task = callback;
+    mp_vm_return_kind_t kind = mp_resume(callback, args, MP_OBJ_NULL, &ret);
+    self->cur_task = MP_OBJ_NULL;
+
+    if (kind == MP_VM_RETURN_YIELD && MP_OBJ_IS_TYPE(ret, &loop_yield_type)) {
+        // yielded rather than awaited, so take the value it holds
+        ret = loop_yield_iternext(ret);
+    }
+
+    if (kind == MP_VM_RETURN_NORMAL) {
+        if (callback == self->main_task) {
+            self->main_ret = ret;
+            self->stopped = true;
+        }
+    } else if (kind == MP_VM_RETURN_EXCEPTION) {
+        nlr_raise(ret);
+    } else if (ret == mp_const_none) {
+        loop_push_run(self, callback, mp_const_none);
+    } else if (MP_OBJ_IS_SMALL_INT(ret)) {
+        loop_push_wait(self, MP_OBJ_SMALL_INT_VALUE(ret), callback, mp_const_none);
+    } else if (ret != MP_OBJ_FROM_PTR(self)) {
+        // the loop itself is what a task waiting on a stream yields
+        mp_raise_TypeError("task yielded unsupported value");
+    }
+}
+
+// Queues the task waiting in map for the stream with the given id
+STATIC void loop_wake(mp_obj_loop_t *self, mp_map_t *map, mp_obj_t id, poll_obj_t *poll_obj, mp_uint_t flag) {
+    mp_map_elem_t *elem = mp_map_lookup(map, id, MP_MAP_LOOKUP_REMOVE_IF_FOUND);
+    if (elem != NULL) {
+        loop_push_run(self, elem->value, mp_const_none);
+    }
+    poll_obj->flags &= ~flag;
+}
+
+// Polls the streams tasks wait on, without blocking, and queues the
+// tasks of those which are ready
+STATIC void loop_poll_io(mp_obj_loop_t *self) {
+    if (self->poll_map.used == 0 || mp_poll_map_poll(&self->poll_map, NULL) == 0) {
+        return;
+    }
+    for (size_t i = 0; i < self->poll_map.alloc; ++i) {
+        if (!MP_MAP_SLOT_IS_FILLED(&self->poll_map, i)) {
+            continue;
+        }
+        mp_obj_t id = self->poll_map.table[i].key;
+        poll_obj_t *poll_obj = MP_OBJ_TO_PTR(self->poll_map.table[i].value);
+        mp_uint_t flags_ret = poll_obj->flags_ret;
+        // errors and hang ups wake both sides, their next call will see them
+        if (flags_ret & (MP_STREAM_POLL_RD | MP_STREAM_POLL_ERR | MP_STREAM_POLL_HUP)) {
+            loop_wake(self, &self->readers, id, poll_obj, MP_STREAM_POLL_RD);
+        }
+        if (flags_ret & (MP_STREAM_POLL_WR | MP_STREAM_POLL_ERR | MP_STREAM_POLL_HUP)) {
+            loop_wake(self, &self->writers, id, poll_obj, MP_STREAM_POLL_WR);
+        }
+        if (poll_obj->flags == 0) {
+            mp_map_lookup(&self->poll_map, id, MP_MAP_LOOKUP_REMOVE_IF_FOUND);
+        }
+    }
+}
+
+/// \class Loop - an event loop
+///
+/// Loop([runq_len[, waitq_len]]): the queues start with room for the given
+/// number of tasks, 16 by default, and grow as needed
+
+STATIC mp_obj_t loop_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
+    mp_arg_check_num(n_args, n_kw, 0, 2, false);
+    mp_int_t runq_len = n_args > 0 ? mp_obj_get_int(args[0]) : 16;
+    mp_int_t waitq_len = n_args > 1 ? mp_obj_get_int(args[1]) : 16;
+    if (runq_len < 1 || waitq_len < 1) {
+        mp_raise_ValueError(NULL);
+    }
+    mp_obj_loop_t *self = m_new_obj(mp_obj_loop_t);
+    self->base.type = type;
+    self->runq = m_new0(mp_obj_t, runq_len * 2);
+    MP_GC_SET_PROTECTED(self->runq);
+    self->runq_alloc = runq_len;
+    self->runq_head = 0;
+    self->runq_len = 0;
+    self->waitq = mp_utimeq_new(waitq_len);
+    self->waitq_alloc = waitq_len;
+    mp_map_init(&self->poll_map, 0);
+    mp_map_init(&self->readers, 0);
+    mp_map_init(&self->writers, 0);
+    self->cur_task = MP_OBJ_NULL;
+    self->main_task = MP_OBJ_NULL;
+    self->main_ret = mp_const_none;
+    self->stopped = false;
+    return MP_OBJ_FROM_PTR(self);
+}
+
+/// \method create_task(coro)
+/// Schedules the coroutine to run; returns it.
+STATIC mp_obj_t loop_create_task(mp_obj_t self_in, mp_obj_t coro) {
+    mp_obj_loop_t *self = MP_OBJ_TO_PTR(self_in);
+    if (!MP_OBJ_IS_TYPE(coro, &mp_type_gen_instance)) {
+        mp_raise_TypeError("expecting a coroutine");
+    }
+    loop_push_run(self, coro, mp_const_none);
+    return coro;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(loop_create_task_obj, loop_create_task);
+
+/// \method call_soon(callback, *args)
+/// Schedules callback(*args), or a coroutine given without args, to run.
+STATIC mp_obj_t loop_call_soon(size_t n_args, const mp_obj_t *args) {
+    mp_obj_loop_t *self = MP_OBJ_TO_PTR(args[0]);
+    loop_push_run(self, args[1], n_args > 2 ? mp_obj_new_tuple(n_args - 2, args + 2) : mp_const_none);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR(loop_call_soon_obj, 2, loop_call_soon);
+
+/// \method call_later_ms(delay, callback, *args)
+/// Schedules callback(*args), or a coroutine given without args, to run
+/// in delay milliseconds.
+STATIC mp_obj_t loop_call_later_ms(size_t n_args, const mp_obj_t *args) {
+    mp_obj_loop_t *self = MP_OBJ_TO_PTR(args[0]);
+    loop_push_wait(self, mp_obj_get_int(args[1]), args[2],
+        n_args > 3 ? mp_obj_new_tuple(n_args - 3, args + 3) : mp_const_none);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR(loop_call_later_ms_obj, 3, loop_call_later_ms);
+
+STATIC mp_obj_t loop_wait_io(mp_obj_t self_in, mp_obj_t stream, mp_map_t *map, mp_uint_t flag) {
+    mp_obj_loop_t *self = MP_OBJ_TO_PTR(self_in);
+    if (self->cur_task == MP_OBJ_NULL) {
+        mp_raise_msg(&mp_type_RuntimeError, "not in a task");
+    }
+    mp_obj_t id = mp_obj_id(stream);
+    mp_map_elem_t *elem = mp_map_lookup(map, id, MP_MAP_LOOKUP);
+    if (elem != NULL && elem->value != self->cur_task) {
+        mp_raise_msg(&mp_type_RuntimeError, "stream busy");
+    }
+    // raises if the stream can't be polled
+    mp_poll_map_add(&self->poll_map, &stream, 1, flag, true);
+    mp_map_lookup(map, id, MP_MAP_LOOKUP_ADD_IF_NOT_FOUND)->value = self->cur_task;
+    return loop_yield_new(self_in);
+}
+
+/// \method wait_read(stream)
+/// To be yielded or awaited by the running task, which then sleeps until
+/// stream can be read.
+STATIC mp_obj_t loop_wait_read(mp_obj_t self_in, mp_obj_t stream) {
+    mp_obj_loop_t *self = MP_OBJ_TO_PTR(self_in);
+    return loop_wait_io(self_in, stream, &self->readers, MP_STREAM_POLL_RD);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(loop_wait_read_obj, loop_wait_read);
+
+/// \method wait_write(stream)
+/// To be yielded or awaited by the running task, which then sleeps until
+/// stream can be written.
+STATIC mp_obj_t loop_wait_write(mp_obj_t self_in, mp_obj_t stream) {
+    mp_obj_loop_t *self = MP_OBJ_TO_PTR(self_in);
+    return loop_wait_io(self_in, stream, &self->writers, MP_STREAM_POLL_WR);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(loop_wait_write_obj, loop_wait_write);
+
+STATIC void loop_remove_io(mp_obj_loop_t *self, mp_obj_t stream, mp_map_t *map, mp_uint_t flag) {
+    mp_obj_t id = mp_obj_id(stream);
+    mp_map_lookup(map, id, MP_MAP_LOOKUP_REMOVE_IF_FOUND);
+    mp_map_elem_t *elem = mp_map_lookup(&self->poll_map, id, MP_MAP_LOOKUP);
+    if (elem != NULL) {
+        poll_obj_t *poll_obj = MP_OBJ_TO_PTR(elem->value);
+        poll_obj->flags &= ~flag;
+        if (poll_obj->flags == 0) {
+            mp_map_lookup(&self->poll_map, id, MP_MAP_LOOKUP_REMOVE_IF_FOUND);
+        }
+    }
+}
+
+/// \method remove_reader(stream)
+/// Drops the task waiting to read stream, if any; it is not resumed again.
+STATIC mp_obj_t loop_remove_reader(mp_obj_t self_in, mp_obj_t stream) {
+    mp_obj_loop_t *self = MP_OBJ_TO_PTR(self_in);
+    loop_remove_io(self, stream, &self->readers, MP_STREAM_POLL_RD);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(loop_remove_reader_obj, loop_remove_reader);
+
+/// \method remove_writer(stream)
+/// Drops the task waiting to write stream, if any; it is not resumed again.
+STATIC mp_obj_t loop_remove_writer(mp_obj_t self_in, mp_obj_t stream) {
+    mp_obj_loop_t *self = MP_OBJ_TO_PTR(self_in);
+    loop_remove_io(self, stream, &self->writers, MP_STREAM_POLL_WR);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(loop_remove_writer_obj, loop_remove_writer);
+
+/// \method run_forever()
+/// Runs until stop() is called or there is nothing left to wait for.
+/// An exception raised by a task or callback is propagated from here.
+STATIC mp_obj_t loop_run_forever(mp_obj_t self_in) {
+    mp_obj_loop_t *self = MP_OBJ_TO_PTR(self_in);
+    self->stopped = false;
+    self->cur_task = MP_OBJ_NULL;
+    while (!self->stopped) {
+        // queue the sleepers whose time has come
+        mp_uint_t now = LOOP_TICKS();
+        while (mp_utimeq_len(self->waitq) > 0
+            && LOOP_TICKS_DIFF(mp_utimeq_peektime(self->waitq), now) <= 0) {
+            mp_obj_t callback, args;
+            mp_utimeq_pop(self->waitq, &callback, &args);
+            loop_push_run(self, callback, args);
+        }
+
+        loop_poll_io(self);
+
+        if (self->runq_len == 0) {
+            if (mp_utimeq_len(self->waitq) == 0 && self->poll_map.used == 0) {
+                break;
+            }
+            #if MICROPY_ENABLE_SCHEDULER
+            // scheduled callbacks may queue tasks
+            mp_handle_pending();
+            if (self->runq_len > 0) {
+                continue;
+            }
+            #endif
+            // nothing to do until a timer expires or a stream gets ready
+            mp_int_t timeout = -1;
+            if (mp_utimeq_len(self->waitq) > 0) {
+                timeout = LOOP_TICKS_DIFF(mp_utimeq_peektime(self->waitq), LOOP_TICKS());
+                if (timeout < 0) {
+                    timeout = 0;
+                }
+            }
+            if (self->poll_map.used == 0) {
+                mp_hal_delay_ms(timeout);
+            } else if (!mp_poll_map_wait(&self->poll_map, timeout)) {
+                // a stream without a file descriptor has to be polled
+                MICROPY_EVENT_POLL_HOOK
+            }
+            continue;
+        }
+
+        // run what is ready now; what that queues runs on the next pass,
+        // after timers and streams have been checked again
+        for (size_t n = self->runq_len; n > 0 && !self->stopped; --n) {
+            mp_obj_t callback, args;
+            loop_pop_run(self, &callback, &args);
+            loop_run_one(self, callback, args);
+        }
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(loop_run_forever_obj, loop_run_forever);
+
+/// \method run_until_complete(coro)
+/// Runs the loop until coro returns; returns its return value.
+STATIC mp_obj_t loop_run_until_complete(mp_obj_t self_in, mp_obj_t coro) {
+    mp_obj_loop_t *self = MP_OBJ_TO_PTR(self_in);
+    loop_create_task(self_in, coro);
+    self->main_task = coro;
+    self->main_ret = mp_const_none;
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        loop_run_forever(self_in);
+        nlr_pop();
+    } else {
+        self->main_task = MP_OBJ_NULL;
+        nlr_jump(nlr.ret_val);
+    }
+    self->main_task = MP_OBJ_NULL;
+    mp_obj_t ret = self->main_ret;
+    self->main_ret = mp_const_none;
+    return ret;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(loop_run_until_complete_obj, loop_run_until_complete);
+
+/// \method stop()
+/// Makes run_forever() return once the running task yields.
+STATIC mp_obj_t loop_stop(mp_obj_t self_in) {
+    mp_obj_loop_t *self = MP_OBJ_TO_PTR(self_in);
+    self->stopped = true;
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(loop_stop_obj, loop_stop);
+
+/// \method time()
+/// Returns the loop's clock, in utime.ticks_ms() units.
+STATIC mp_obj_t loop_time(mp_obj_t self_in) {
+    (void)self_in;
+    return MP_OBJ_NEW_SMALL_INT(LOOP_TICKS());
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(loop_time_obj, loop_time);
+
+STATIC const mp_rom_map_elem_t loop_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_create_task), MP_ROM_PTR(&loop_create_task_obj) },
+    { MP_ROM_QSTR(MP_QSTR_call_soon), MP_ROM_PTR(&loop_call_soon_obj) },
+    { MP_ROM_QSTR(MP_QSTR_call_later_ms), MP_ROM_PTR(&loop_call_later_ms_obj) },
+    { MP_ROM_QSTR(MP_QSTR_wait_read), MP_ROM_PTR(&loop_wait_read_obj) },
+    { MP_ROM_QSTR(MP_QSTR_wait_write), MP_ROM_PTR(&loop_wait_write_obj) },
+    { MP_ROM_QSTR(MP_QSTR_remove_reader), MP_ROM_PTR(&loop_remove_reader_obj) },
+    { MP_ROM_QSTR(MP_QSTR_remove_writer), MP_ROM_PTR(&loop_remove_writer_obj) },
+    { MP_ROM_QSTR(MP_QSTR_run_forever), MP_ROM_PTR(&loop_run_forever_obj) },
+    { MP_ROM_QSTR(MP_QSTR_run_until_complete), MP_ROM_PTR(&loop_run_until_complete_obj) },
+    { MP_ROM_QSTR(MP_QSTR_stop), MP_ROM_PTR(&loop_stop_obj) },
+    { MP_ROM_QSTR(MP_QSTR_time), MP_ROM_PTR(&loop_time_obj) },
+};
+
+STATIC MP_DEFINE_CONST_DICT(loop_locals_dict, loop_locals_dict_table);
+
+STATIC const mp_obj_type_t loop_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_Loop,
+    .make_new = loop_make_new,
+    .locals_dict = (void*)&loop_locals_dict,
+};
+
+/// \function sleep_ms(ms)
+/// To be yielded or awaited by the running task, which then sleeps for
+/// ms milliseconds.
+STATIC mp_obj_t mod_uasyncio_sleep_ms(mp_obj_t ms_in) {
+    return loop_yield_new(MP_OBJ_NEW_SMALL_INT(mp_obj_get_int(ms_in)));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_uasyncio_sleep_ms_obj, mod_uasyncio_sleep_ms);
+
+STATIC const mp_rom_map_elem_t mp_module_uasyncio_globals_table[] = {
+    { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR__uasyncio) },
+    { MP_ROM_QSTR(MP_QSTR_Loop), MP_ROM_PTR(&loop_type) },
+    { MP_ROM_QSTR(MP_QSTR_sleep_ms), MP_ROM_PTR(&mod_uasyncio_sleep_ms_obj) },
+};
+
+STATIC MP_DEFINE_CONST_DICT(mp_module_uasyncio_globals, mp_module_uasyncio_globals_table);
+
+const mp_obj_module_t mp_module_uasyncio = {
+    .base = { &mp_type_module },
+    .globals = (mp_obj_dict_t*)&mp_module_uasyncio_globals,
+};
+
+#endif // MICROPY_PY_UASYNCIO
@@ -0,0 +1,228 @@
+/*
+ * This file is part of the MicroPython project, http://micropython.org/
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 MicroPython_ESP32_psRAM_LoBo contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "py/compile.h"
+#include "py/runtime.h"
+#include "py/gc.h"
+#include "py/stackctrl.h"
+#include "py/mphal.h"
+#include "py/mpthread.h"
+#include "py/mperrno.h"
+
+// Heap size of GC heap, larger on a 64 bit machine because pointers are larger
+STATIC long heap_size = 1024 * 1024 * (sizeof(mp_uint_t) / 4);
+
+// Size of the fast region of a split heap, given by -X fastheap; without
+// MICROPY_GC_SPLIT_HEAP it is added to the heap
+STATIC long fast_heap_size = 0;
+
+void mp_hal_stdout_tx_strn(const char *str, size_t len) {
+    fwrite(str, 1, len, stdout);
+}
+
+void mp_hal_stdout_tx_strn_cooked(const char *str, size_t len) {
+    mp_hal_stdout_tx_strn(str, len);
+}
+
+void mp_hal_stdout_tx_str(const char *str) {
+    mp_hal_stdout_tx_strn(str, strlen(str));
+}
+
+STATIC uint64_t ticks_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+mp_uint_t mp_hal_ticks_ms(void) {
+    return ticks_ns() / 1000000;
+}
+
+mp_uint_t mp_hal_ticks_us(void) {
+    return ticks_ns() / 1000;
+}
+
+mp_uint_t mp_hal_ticks_cpu(void) {
+    return ticks_ns();
+}
+
+// other threads run while this one sleeps, and it may be killed
+void mp_hal_delay_us(mp_uint_t us) {
+    MP_THREAD_GIL_EXIT();
+    #if MICROPY_PY_THREAD
+    int cancel;
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &cancel);
+    usleep(us);
+    pthread_setcancelstate(cancel, NULL);
+    #else
+    usleep(us);
+    #endif
+    MP_THREAD_GIL_ENTER();
+}
+
+void mp_hal_delay_ms(mp_uint_t ms) {
+    mp_hal_delay_us(ms * 1000);
+}
+
+STATIC int usage(char **argv) {
+    printf("usage: %s [-X heapsize=<n>[k|m]] [-X fastheap=<n>[k|m]] <file.py> [args...]\n", argv[0]);
+    return 1;
+}
+
+// parse the size of an -X option, with an optional k or m suffix
+STATIC long parse_size(const char *str) {
+    char *end;
+    long size = strtol(str, &end, 0);
+    if (*end == 'k') {
+        size *= 1024;
+    } else if (*end == 'm') {
+        size *= 1024 * 1024;
+    }
+    return size;
+}
+
+STATIC int run_file(const char *file) {
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        mp_lexer_t *lex = mp_lexer_new_from_file(file);
+        qstr source_name = lex->source_name;
+        #if MICROPY_PY___FILE__
+        mp_store_global(MP_QSTR___file__, MP_OBJ_NEW_QSTR(source_name));
+        #endif
+        mp_parse_tree_t parse_tree = mp_parse(lex, MP_PARSE_FILE_INPUT);
+        mp_obj_t module_fun = mp_compile(&parse_tree, source_name, MP_EMIT_OPT_NONE, false);
+        mp_call_function_0(module_fun);
+        nlr_pop();
+        return 0;
+    } else {
+        mp_obj_t exc = MP_OBJ_FROM_PTR(nlr.ret_val);
+        if (mp_obj_is_subclass_fast(MP_OBJ_FROM_PTR(mp_obj_get_type(exc)), MP_OBJ_FROM_PTR(&mp_type_SystemExit))) {
+            mp_obj_t exit_val = mp_obj_exception_get_value(exc);
+            mp_int_t val = 0;
+            if (exit_val != mp_const_none && !mp_obj_get_int_maybe(exit_val, &val)) {
+                val = 1;
+            }
+            return val & 0xff;
+        }
+        mp_obj_print_exception(&mp_plat_print, exc);
+        return 1;
+    }
+}
+
+MP_NOINLINE int main_(int argc, char **argv) {
+    mp_stack_set_limit(40000 * (sizeof(void*) / 4));
+
+    int a = 1;
+    while (a + 1 < argc && strcmp(argv[a], "-X") == 0) {
+        if (strncmp(argv[a + 1], "heapsize=", sizeof("heapsize=") - 1) == 0) {
+            heap_size = parse_size(argv[a + 1] + sizeof("heapsize=") - 1);
+        } else if (strncmp(argv[a + 1], "fastheap=", sizeof("fastheap=") - 1) == 0) {
+            fast_heap_size = parse_size(argv[a + 1] + sizeof("fastheap=") - 1);
+        } else {
+            return usage(argv);
+        }
+        a += 2;
+    }
+    if (a >= argc) {
+        return usage(argv);
+    }
+
+    #if MICROPY_PY_THREAD
+    mp_thread_init();
+    #endif
+
+    #if MICROPY_GC_SPLIT_HEAP
+    char *heap = malloc(heap_size);
+    char *fast_heap = malloc(fast_heap_size);
+    gc_init_split(heap, heap + heap_size, fast_heap, fast_heap + fast_heap_size);
+    #else
+    heap_size += fast_heap_size;
+    char *heap = malloc(heap_size);
+    gc_init(heap, heap + heap_size);
+    #endif
+
+    mp_init();
+    mp_obj_list_init(MP_OBJ_TO_PTR(mp_sys_path), 0);
+    mp_obj_list_append(mp_sys_path, MP_OBJ_NEW_QSTR(MP_QSTR_));
+    mp_obj_list_init(MP_OBJ_TO_PTR(mp_sys_argv), 0);
+    for (int i = a; i < argc; i++) {
+        mp_obj_list_append(mp_sys_argv, MP_OBJ_NEW_QSTR(qstr_from_str(argv[i])));
+    }
+
+    int ret = run_file(argv[a]);
+    fflush(stdout);
+
+    #if MICROPY_PY_THREAD
+    mp_thread_deinit();
+    #endif
+    mp_deinit();
+    free(heap);
+    #if MICROPY_GC_SPLIT_HEAP
+    free(fast_heap);
+    #endif
+
+    return ret;
+}
+
+int main(int argc, char **argv) {
+    #if MICROPY_PY_THREAD
+    mp_thread_set_state(&mp_state_ctx.thread);
+    #endif
+    mp_stack_ctrl_init();
+    return main_(argc, argv);
+}
+
+mp_import_stat_t mp_import_stat(const char *path) {
+    struct stat st;
+    if (stat(path, &st) == 0) {
+        if (S_ISDIR(st.st_mode)) {
+            return MP_IMPORT_STAT_DIR;
+        } else if (S_ISREG(st.st_mode)) {
+            return MP_IMPORT_STAT_FILE;
+        }
+    }
+    return MP_IMPORT_STAT_NO_EXIST;
+}
+
+mp_obj_t mp_builtin_open(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs) {
+    (void)n_args;
+    (void)args;
+    (void)kwargs;
+    mp_raise_OSError(MP_ENOENT);
+}
+MP_DEFINE_CONST_FUN_OBJ_KW(mp_builtin_open_obj, 1, mp_builtin_open);
+
+void nlr_jump_fail(void *val) {
+    fprintf(stderr, "FATAL: uncaught NLR %p\n", val);
+    exit(1);
+}
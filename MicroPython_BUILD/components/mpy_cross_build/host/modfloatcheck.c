@@ -0,0 +1,157 @@
+/*
+ * This file is part of the MicroPython project, http://micropython.org/
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 MicroPython_ESP32_psRAM_LoBo contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Checks the float formatter and parser against the C library, which on the
+// host is correctly rounded: floatcheck.roundtrip(n, seed) runs n random
+// doubles and n random decimal strings through them and returns how many
+// disagreed, printing the first few.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "py/runtime.h"
+#include "py/parsenum.h"
+#include "py/formatfloat.h"
+
+#if MICROPY_FLOAT_EXACT_CONV
+
+#define FLOATCHECK_MAX_REPORT (8)
+
+typedef union _floatcheck_bits_t {
+    double f;
+    uint64_t u;
+} floatcheck_bits_t;
+
+// xorshift64*, so that a seed gives the same values on every host
+STATIC uint64_t floatcheck_next(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * UINT64_C(0x2545F4914F6CDD1D);
+}
+
+STATIC bool floatcheck_same(double a, double b) {
+    floatcheck_bits_t fa = {a}, fb = {b};
+    return fa.u == fb.u;
+}
+
+STATIC double floatcheck_parse(const char *str) {
+    return mp_obj_get_float(mp_parse_num_decimal(str, strlen(str), false, false, NULL));
+}
+
+STATIC void floatcheck_fail(size_t *n_fail, const char *what, double d, const char *got, const char *want) {
+    if (++*n_fail <= FLOATCHECK_MAX_REPORT) {
+        floatcheck_bits_t fb = {d};
+        mp_printf(&mp_plat_print, "%s: 0x%08x%08x: got %s, want %s\n", what,
+            (unsigned)(fb.u >> 32), (unsigned)fb.u, got, want);
+    }
+}
+
+// one double: repr must read back exactly, and the fixed precision formats
+// must match printf digit for digit
+STATIC void floatcheck_double(size_t *n_fail, double d) {
+    char buf[48], want[48], got[48];
+
+    mp_format_float(d, buf, sizeof(buf), 'r', 0, '\0');
+    if (!floatcheck_same(strtod(buf, NULL), d)) {
+        snprintf(want, sizeof(want), "%.17g", d);
+        floatcheck_fail(n_fail, "repr", d, buf, want);
+    }
+    if (!floatcheck_same(floatcheck_parse(buf), d)) {
+        snprintf(got, sizeof(got), "%.17g", floatcheck_parse(buf));
+        floatcheck_fail(n_fail, "parse repr", d, got, buf);
+    }
+
+    snprintf(want, sizeof(want), "%.17g", d);
+    mp_format_float(d, buf, sizeof(buf), 'g', 17, '\0');
+    if (strcmp(buf, want) != 0) {
+        floatcheck_fail(n_fail, "%.17g", d, buf, want);
+    }
+    if (!floatcheck_same(floatcheck_parse(want), d)) {
+        snprintf(got, sizeof(got), "%.17g", floatcheck_parse(want));
+        floatcheck_fail(n_fail, "parse %.17g", d, got, want);
+    }
+
+    snprintf(want, sizeof(want), "%.6e", d);
+    mp_format_float(d, buf, sizeof(buf), 'e', 6, '\0');
+    if (strcmp(buf, want) != 0) {
+        floatcheck_fail(n_fail, "%.6e", d, buf, want);
+    }
+}
+
+// one decimal string of up to 40 digits, which needn't be near a double
+STATIC void floatcheck_decimal(size_t *n_fail, uint64_t *state) {
+    char str[64], got[32], want[32];
+    uint64_t r = floatcheck_next(state);
+    int n_dig = 1 + r % 40;
+    int exp10 = (int)((r >> 8) % 700) - 350;
+    char *s = str;
+    for (int i = 0; i < n_dig; i++) {
+        *s++ = '0' + floatcheck_next(state) % 10;
+    }
+    snprintf(s, str + sizeof(str) - s, "e%d", exp10);
+
+    double d = floatcheck_parse(str);
+    double ref = strtod(str, NULL);
+    if (!floatcheck_same(d, ref)) {
+        snprintf(got, sizeof(got), "%.17g", d);
+        snprintf(want, sizeof(want), "%.17g", ref);
+        floatcheck_fail(n_fail, str, ref, got, want);
+    }
+}
+
+STATIC mp_obj_t floatcheck_roundtrip(mp_obj_t n_in, mp_obj_t seed_in) {
+    mp_int_t n = mp_obj_get_int(n_in);
+    uint64_t state = mp_obj_get_int(seed_in) | 1;
+    size_t n_fail = 0;
+    for (mp_int_t i = 0; i < n; i++) {
+        floatcheck_bits_t fb;
+        fb.u = floatcheck_next(&state);
+        if ((fb.u & (UINT64_C(0x7ff) << 52)) != (UINT64_C(0x7ff) << 52)) {
+            floatcheck_double(&n_fail, fb.f);
+        }
+        floatcheck_decimal(&n_fail, &state);
+    }
+    return MP_OBJ_NEW_SMALL_INT(n_fail);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(floatcheck_roundtrip_obj, floatcheck_roundtrip);
+
+STATIC const mp_rom_map_elem_t floatcheck_module_globals_table[] = {
+    { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_floatcheck) },
+    { MP_ROM_QSTR(MP_QSTR_roundtrip), MP_ROM_PTR(&floatcheck_roundtrip_obj) },
+};
+
+STATIC MP_DEFINE_CONST_DICT(floatcheck_module_globals, floatcheck_module_globals_table);
+
+const mp_obj_module_t floatcheck_module = {
+    .base = { &mp_type_module },
+    .globals = (mp_obj_dict_t*)&floatcheck_module_globals,
+};
+
+#endif // MICROPY_FLOAT_EXACT_CONV
@@ -0,0 +1,193 @@
+/*
+ * This file is part of the MicroPython project, http://micropython.org/
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 MicroPython_ESP32_psRAM_LoBo contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Streams over file descriptors, for tests of the code that waits on them:
+// hostio.pipe() returns the read and write ends of a non-blocking pipe.
+// They poll like sockets and give their descriptor with
+// MP_STREAM_GET_FILENO, so uselect and _uasyncio can block on them.
+// hostio.pipe(True) returns blocking ends instead, which wait in read and
+// write without the GIL, like the drivers of the esp32 port.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "py/runtime.h"
+#include "py/stream.h"
+#include "py/mperrno.h"
+#include "py/mpthread.h"
+
+#if MICROPY_PY_USELECT_SELECT_FD
+
+typedef struct _hostio_fd_obj_t {
+    mp_obj_base_t base;
+    int fd;
+    bool blocking;
+} hostio_fd_obj_t;
+
+STATIC const mp_obj_type_t hostio_fd_type;
+
+STATIC mp_uint_t hostio_fd_read(mp_obj_t self_in, void *buf, mp_uint_t size, int *errcode) {
+    hostio_fd_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    ssize_t r;
+    if (self->blocking) {
+        MP_THREAD_PIN(buf);
+        MP_THREAD_GIL_EXIT();
+        r = read(self->fd, buf, size);
+        MP_THREAD_GIL_ENTER();
+        MP_THREAD_UNPIN();
+    } else {
+        r = read(self->fd, buf, size);
+    }
+    if (r < 0) {
+        *errcode = errno;
+        return MP_STREAM_ERROR;
+    }
+    return r;
+}
+
+STATIC mp_uint_t hostio_fd_write(mp_obj_t self_in, const void *buf, mp_uint_t size, int *errcode) {
+    hostio_fd_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    ssize_t r;
+    if (self->blocking) {
+        MP_THREAD_PIN(buf);
+        MP_THREAD_GIL_EXIT();
+        r = write(self->fd, buf, size);
+        MP_THREAD_GIL_ENTER();
+        MP_THREAD_UNPIN();
+    } else {
+        r = write(self->fd, buf, size);
+    }
+    if (r < 0) {
+        *errcode = errno;
+        return MP_STREAM_ERROR;
+    }
+    return r;
+}
+
+STATIC mp_uint_t hostio_fd_ioctl(mp_obj_t self_in, mp_uint_t request, uintptr_t arg, int *errcode) {
+    hostio_fd_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    if (request == MP_STREAM_POLL) {
+        struct pollfd pfd = { .fd = self->fd, .events = 0 };
+        if (arg & MP_STREAM_POLL_RD) {
+            pfd.events |= POLLIN;
+        }
+        if (arg & MP_STREAM_POLL_WR) {
+            pfd.events |= POLLOUT;
+        }
+        if (poll(&pfd, 1, 0) < 0) {
+            *errcode = errno;
+            return MP_STREAM_ERROR;
+        }
+        mp_uint_t ret = 0;
+        if (pfd.revents & POLLIN) {
+            ret |= MP_STREAM_POLL_RD;
+        }
+        if (pfd.revents & POLLOUT) {
+            ret |= MP_STREAM_POLL_WR;
+        }
+        if (pfd.revents & POLLERR) {
+            ret |= MP_STREAM_POLL_ERR;
+        }
+        if (pfd.revents & POLLHUP) {
+            ret |= MP_STREAM_POLL_HUP;
+        }
+        return ret;
+    }
+    if (request == MP_STREAM_GET_FILENO) {
+        return self->fd;
+    }
+    *errcode = MP_EINVAL;
+    return MP_STREAM_ERROR;
+}
+
+STATIC mp_obj_t hostio_fd_close(mp_obj_t self_in) {
+    hostio_fd_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    if (self->fd >= 0) {
+        close(self->fd);
+        self->fd = -1;
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(hostio_fd_close_obj, hostio_fd_close);
+
+STATIC const mp_rom_map_elem_t hostio_fd_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_read), MP_ROM_PTR(&mp_stream_read_obj) },
+    { MP_ROM_QSTR(MP_QSTR_write), MP_ROM_PTR(&mp_stream_write_obj) },
+    { MP_ROM_QSTR(MP_QSTR_close), MP_ROM_PTR(&hostio_fd_close_obj) },
+};
+
+STATIC MP_DEFINE_CONST_DICT(hostio_fd_locals_dict, hostio_fd_locals_dict_table);
+
+STATIC const mp_stream_p_t hostio_fd_stream_p = {
+    .read = hostio_fd_read,
+    .write = hostio_fd_write,
+    .ioctl = hostio_fd_ioctl,
+};
+
+STATIC const mp_obj_type_t hostio_fd_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_FdStream,
+    .protocol = &hostio_fd_stream_p,
+    .locals_dict = (mp_obj_dict_t*)&hostio_fd_locals_dict,
+};
+
+STATIC mp_obj_t hostio_fd_new(int fd, bool blocking) {
+    if (!blocking) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+    hostio_fd_obj_t *o = m_new_obj(hostio_fd_obj_t);
+    o->base.type = &hostio_fd_type;
+    o->fd = fd;
+    o->blocking = blocking;
+    return MP_OBJ_FROM_PTR(o);
+}
+
+STATIC mp_obj_t hostio_pipe(size_t n_args, const mp_obj_t *args) {
+    bool blocking = n_args > 0 && mp_obj_is_true(args[0]);
+    int fds[2];
+    if (pipe(fds) != 0) {
+        mp_raise_OSError(errno);
+    }
+    mp_obj_t ends[2] = { hostio_fd_new(fds[0], blocking), hostio_fd_new(fds[1], blocking) };
+    return mp_obj_new_tuple(2, ends);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(hostio_pipe_obj, 0, 1, hostio_pipe);
+
+STATIC const mp_rom_map_elem_t hostio_module_globals_table[] = {
+    { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_hostio) },
+    { MP_ROM_QSTR(MP_QSTR_pipe), MP_ROM_PTR(&hostio_pipe_obj) },
+};
+
+STATIC MP_DEFINE_CONST_DICT(hostio_module_globals, hostio_module_globals_table);
+
+const mp_obj_module_t hostio_module = {
+    .base = { &mp_type_module },
+    .globals = (mp_obj_dict_t*)&hostio_module_globals,
+};
+
+#endif // MICROPY_PY_USELECT_SELECT_FD
@@ -0,0 +1,64 @@
+/*
+ * This file is part of the MicroPython project, http://micropython.org/
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 MicroPython_ESP32_psRAM_LoBo contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Priorities of the calling thread, for tests and benchmarks of the GIL
+// handover: threadprio.set(n) makes the GIL go to the thread straight away
+// when a lower one holds it, like a higher FreeRTOS task priority, and
+// returns whether the thread also got real-time priority n from the OS.
+
+#include "py/runtime.h"
+#include "py/mpthread.h"
+
+#if MICROPY_PY_THREAD
+
+STATIC mp_obj_t threadprio_set(mp_obj_t priority_in) {
+    mp_int_t priority = mp_obj_get_int(priority_in);
+    if (priority < 0 || priority > 30) {
+        mp_raise_ValueError("priority must be 0-30");
+    }
+    return mp_obj_new_bool(mp_thread_set_priority(priority));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(threadprio_set_obj, threadprio_set);
+
+STATIC mp_obj_t threadprio_get(void) {
+    return MP_OBJ_NEW_SMALL_INT(mp_thread_priority());
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(threadprio_get_obj, threadprio_get);
+
+STATIC const mp_rom_map_elem_t threadprio_module_globals_table[] = {
+    { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_threadprio) },
+    { MP_ROM_QSTR(MP_QSTR_set), MP_ROM_PTR(&threadprio_set_obj) },
+    { MP_ROM_QSTR(MP_QSTR_get), MP_ROM_PTR(&threadprio_get_obj) },
+};
+
+STATIC MP_DEFINE_CONST_DICT(threadprio_module_globals, threadprio_module_globals_table);
+
+const mp_obj_module_t threadprio_module = {
+    .base = { &mp_type_module },
+    .globals = (mp_obj_dict_t*)&threadprio_module_globals,
+};
+
+#endif // MICROPY_PY_THREAD
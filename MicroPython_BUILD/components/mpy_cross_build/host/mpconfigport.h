@@ -0,0 +1,232 @@
+/*
+ * This file is part of the MicroPython project, http://micropython.org/
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 MicroPython_ESP32_psRAM_LoBo contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Options for the host build of the runtime, which runs the benchmarks and
+// tests under ../tests.  The optimisations follow esp32/mpconfigport.h, and
+// each can be switched off with CFLAGS_EXTRA to compare, see the Makefile.
+
+#include <errno.h>
+#include <stdint.h>
+#include <alloca.h>
+
+// object representation and NLR handling
+#define MICROPY_OBJ_REPR                    (MICROPY_OBJ_REPR_A)
+#define MICROPY_NLR_SETJMP                  (1)
+
+// memory allocation policies
+#define MICROPY_ALLOC_PATH_MAX              (256)
+
+// emitters
+#define MICROPY_PERSISTENT_CODE_LOAD        (1)
+
+// compiler configuration
+#define MICROPY_COMP_MODULE_CONST           (1)
+#define MICROPY_COMP_TRIPLE_TUPLE_ASSIGN    (1)
+
+// optimisations
+#define MICROPY_OPT_COMPUTED_GOTO           (1)
+#define MICROPY_OPT_MPZ_BITWISE             (1)
+#ifndef MICROPY_OPT_MPZ_KARATSUBA
+#define MICROPY_OPT_MPZ_KARATSUBA           (1)
+#endif
+#ifndef MICROPY_OPT_MPZ_POW3
+#define MICROPY_OPT_MPZ_POW3                (1)
+#endif
+#ifndef MICROPY_OPT_INLINE_CACHE
+#define MICROPY_OPT_INLINE_CACHE            (1)
+#endif
+#ifndef MICROPY_OPT_MAP_CACHED_HASHES
+#define MICROPY_OPT_MAP_CACHED_HASHES       (1)
+#endif
+#ifndef MICROPY_OPT_QSTR_INDEX
+#define MICROPY_OPT_QSTR_INDEX              (1)
+#endif
+#ifndef MICROPY_OPT_STR_APPEND
+#define MICROPY_OPT_STR_APPEND              (1)
+#endif
+#ifndef MICROPY_OPT_STR_FORMAT_CACHE
+#define MICROPY_OPT_STR_FORMAT_CACHE        (1)
+#endif
+
+// Python internal features
+#define MICROPY_READER_POSIX                (1)
+#define MICROPY_HELPER_LEXER_UNIX           (1)
+#define MICROPY_ENABLE_GC                   (1)
+#define MICROPY_ENABLE_FINALISER            (1)
+#ifndef MICROPY_GC_FREE_LISTS
+#define MICROPY_GC_FREE_LISTS               (1)
+#endif
+#if MICROPY_GC_PARALLEL_MARK
+// the helper is a thread, which may share a CPU with the main one
+#include <sched.h>
+#define MICROPY_GC_PARALLEL_IDLE()          sched_yield()
+#endif
+#define MICROPY_STACK_CHECK                 (1)
+#define MICROPY_ENABLE_EMERGENCY_EXCEPTION_BUF (1)
+#define MICROPY_EMERGENCY_EXCEPTION_BUF_SIZE (256)
+#define MICROPY_KBD_EXCEPTION               (1)
+#define MICROPY_LONGINT_IMPL                (MICROPY_LONGINT_IMPL_MPZ)
+#define MICROPY_ENABLE_SOURCE_LINE          (1)
+#define MICROPY_ERROR_REPORTING             (MICROPY_ERROR_REPORTING_NORMAL)
+#define MICROPY_WARNINGS                    (1)
+#define MICROPY_FLOAT_IMPL                  (MICROPY_FLOAT_IMPL_DOUBLE)
+#define MICROPY_FLOAT_EXACT_CONV            (1)
+#define MICROPY_PY_BUILTINS_COMPLEX         (1)
+#define MICROPY_CPYTHON_COMPAT              (1)
+#define MICROPY_STREAMS_NON_BLOCK           (1)
+#define MICROPY_MODULE_BUILTIN_INIT         (1)
+#define MICROPY_MODULE_WEAK_LINKS           (1)
+#define MICROPY_CAN_OVERRIDE_BUILTINS       (1)
+#define MICROPY_USE_INTERNAL_ERRNO          (1)
+#define MICROPY_USE_INTERNAL_PRINTF         (0)
+#define MICROPY_PY_SYS_EXC_INFO             (1)
+#define MICROPY_ENABLE_SCHEDULER            (1)
+#define MICROPY_SCHEDULER_DEPTH             (16)
+#define MICROPY_SCHEDULER_PRIORITIES        (2)
+
+// threads, as on the esp32
+#define MICROPY_PY_THREAD                   (1)
+#define MICROPY_PY_THREAD_GIL               (1)
+#define MICROPY_PY_THREAD_GIL_VM_DIVISOR    (32)
+#ifndef MICROPY_PY_THREAD_GIL_SWITCH_INTERVAL
+#define MICROPY_PY_THREAD_GIL_SWITCH_INTERVAL (5000)
+#endif
+#if MICROPY_PY_THREAD_GIL_SWITCH_INTERVAL
+#define MICROPY_PY_THREAD_GIL_PRIORITY()    mp_thread_priority()
+#define MICROPY_PY_THREAD_GIL_YIELD()       mp_thread_yield()
+#endif
+#define MICROPY_PY_THREAD_CHANNEL           (1)
+
+// control over Python builtins
+#define MICROPY_PY_FUNCTION_ATTRS           (1)
+#define MICROPY_PY_BUILTINS_STR_UNICODE     (1)
+#define MICROPY_PY_BUILTINS_STR_CENTER      (1)
+#define MICROPY_PY_BUILTINS_STR_PARTITION   (1)
+#define MICROPY_PY_BUILTINS_STR_SPLITLINES  (1)
+#define MICROPY_PY_BUILTINS_BYTEARRAY       (1)
+#define MICROPY_PY_BUILTINS_MEMORYVIEW      (1)
+#define MICROPY_PY_BUILTINS_SET             (1)
+#define MICROPY_PY_BUILTINS_SLICE           (1)
+#define MICROPY_PY_BUILTINS_SLICE_ATTRS     (1)
+#define MICROPY_PY_BUILTINS_FROZENSET       (1)
+#define MICROPY_PY_BUILTINS_PROPERTY        (1)
+#define MICROPY_PY_BUILTINS_RANGE_ATTRS     (1)
+#define MICROPY_PY_BUILTINS_TIMEOUTERROR    (1)
+#define MICROPY_PY_ALL_SPECIAL_METHODS      (1)
+#define MICROPY_PY_BUILTINS_COMPILE         (1)
+#define MICROPY_PY_BUILTINS_ENUMERATE       (1)
+#define MICROPY_PY_BUILTINS_EXECFILE        (1)
+#define MICROPY_PY_BUILTINS_FILTER          (1)
+#define MICROPY_PY_BUILTINS_REVERSED        (1)
+#define MICROPY_PY_BUILTINS_NOTIMPLEMENTED  (1)
+#define MICROPY_PY_BUILTINS_MIN_MAX         (1)
+#define MICROPY_PY_BUILTINS_POW3            (1)
+#define MICROPY_PY___FILE__                 (1)
+#define MICROPY_PY_MICROPYTHON_MEM_INFO     (1)
+#define MICROPY_PY_MICROPYTHON_PROFILE      (1)
+#define MICROPY_PY_ARRAY                    (1)
+#define MICROPY_PY_ARRAY_SLICE_ASSIGN       (1)
+#define MICROPY_PY_ATTRTUPLE                (1)
+#define MICROPY_PY_COLLECTIONS              (1)
+#define MICROPY_PY_COLLECTIONS_ORDEREDDICT  (1)
+#define MICROPY_PY_MATH                     (1)
+#define MICROPY_PY_MATH_SPECIAL_FUNCTIONS   (1)
+#define MICROPY_PY_CMATH                    (1)
+#define MICROPY_PY_GC                       (1)
+#define MICROPY_PY_IO                       (1)
+#define MICROPY_PY_STRUCT                   (1)
+#define MICROPY_PY_USELECT                  (1)
+#define MICROPY_PY_USELECT_SELECT_FD        (1)
+#define MICROPY_PY_UTIMEQ                   (1)
+#define MICROPY_PY_UASYNCIO                 (1)
+#define MICROPY_PY_SYS                      (1)
+#define MICROPY_PY_SYS_MAXSIZE              (1)
+#define MICROPY_PY_SYS_MODULES              (1)
+#define MICROPY_PY_SYS_EXIT                 (1)
+#define MICROPY_PY_UERRNO                   (1)
+#define MICROPY_PY_UTIME_MP_HAL             (1)
+
+// extended modules
+#define MICROPY_PY_UCTYPES                  (1)
+#define MICROPY_PY_UZLIB                    (1)
+#define MICROPY_PY_UJSON                    (1)
+#define MICROPY_PY_UHEAPQ                   (1)
+#define MICROPY_PY_UTIMEQ                   (1)
+#define MICROPY_PY_UBINASCII                (1)
+#define MICROPY_PY_URANDOM                  (1)
+#define MICROPY_PY_URANDOM_EXTRA_FUNCS      (1)
+
+// extra built in modules to add to the list of known ones
+extern const struct _mp_obj_module_t utime_module;
+extern const struct _mp_obj_module_t floatcheck_module;
+extern const struct _mp_obj_module_t threadprio_module;
+extern const struct _mp_obj_module_t hostio_module;
+
+#if MICROPY_FLOAT_EXACT_CONV
+#define BUILTIN_MODULE_FLOATCHECK { MP_OBJ_NEW_QSTR(MP_QSTR_floatcheck), (mp_obj_t)&floatcheck_module },
+#else
+#define BUILTIN_MODULE_FLOATCHECK
+#endif
+
+#define MICROPY_PORT_BUILTIN_MODULES \
+    { MP_OBJ_NEW_QSTR(MP_QSTR_utime), (mp_obj_t)&utime_module }, \
+    BUILTIN_MODULE_FLOATCHECK \
+    { MP_OBJ_NEW_QSTR(MP_QSTR_threadprio), (mp_obj_t)&threadprio_module }, \
+    { MP_OBJ_NEW_QSTR(MP_QSTR_hostio), (mp_obj_t)&hostio_module }, \
+
+#define MICROPY_PORT_BUILTIN_MODULE_WEAK_LINKS \
+    { MP_OBJ_NEW_QSTR(MP_QSTR_collections), (mp_obj_t)&mp_module_collections }, \
+    { MP_OBJ_NEW_QSTR(MP_QSTR_time), (mp_obj_t)&utime_module }, \
+
+#define MICROPY_PORT_BUILTINS \
+    { MP_OBJ_NEW_QSTR(MP_QSTR_open), (mp_obj_t)&mp_builtin_open_obj },
+
+#define MICROPY_PORT_ROOT_POINTERS \
+    const char *readline_hist[8];
+
+// type definitions for the specific machine
+#define MICROPY_MAKE_POINTER_CALLABLE(p) ((void*)((mp_uint_t)(p)))
+#define MP_PLAT_PRINT_STRN(str, len) mp_hal_stdout_tx_strn_cooked(str, len)
+#define MICROPY_PY_SYS_PLATFORM "host"
+
+#define MICROPY_EVENT_POLL_HOOK \
+    do { \
+        extern void mp_handle_pending(void); \
+        mp_handle_pending(); \
+    } while (0);
+
+// there are no interrupt handlers on the host
+#define MICROPY_BEGIN_ATOMIC_SECTION() (0)
+#define MICROPY_END_ATOMIC_SECTION(state) (void)(state)
+
+#ifdef __LP64__
+typedef long mp_int_t; // must be pointer size
+typedef unsigned long mp_uint_t; // must be pointer size
+#else
+typedef int mp_int_t; // must be pointer size
+typedef unsigned int mp_uint_t; // must be pointer size
+#endif
+typedef long mp_off_t;
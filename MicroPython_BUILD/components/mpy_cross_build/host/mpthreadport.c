@@ -0,0 +1,489 @@
+/*
+ * This file is part of the MicroPython project, http://micropython.org/
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 MicroPython_ESP32_psRAM_LoBo contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// for pthread_getattr_np()
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+
+#include "py/runtime.h"
+#include "py/gc.h"
+#include "py/mpthread.h"
+#include "py/stackctrl.h"
+
+#if MICROPY_PY_THREAD
+
+TaskHandle_t MainTaskHandle = NULL;
+
+// this structure forms a linked list, one node per active thread
+//========================
+typedef struct _thread_t {
+    pthread_t id;						// system id of thread
+    int ready;							// whether the thread is ready and running
+    void *arg;							// thread Python args, a GC root pointer
+    void *stack_lo;						// the part of the stack to scan
+    void *stack_hi;
+    mp_state_thread_t *state;			// NULL until the thread has started
+    char name[THREAD_NAME_MAX_SIZE];	// thread name
+    uint32_t type;
+    struct _thread_t *next;
+} thread_t;
+
+// the mutex controls access to the linked list
+STATIC mp_thread_mutex_t thread_mutex;
+STATIC thread_t thread_entry0;
+STATIC thread_t *thread; // root pointer, handled by mp_thread_gc_others
+
+STATIC __thread mp_state_thread_t *thread_state;
+STATIC __thread int thread_priority;
+
+// Python threads may only be cancelled (killed) while they wait on a
+// semaphore or sleep without the GIL, so they never die holding it
+//----------------------------------------
+STATIC int thread_cancel_enable(int enable) {
+    int old;
+    pthread_setcancelstate(enable ? PTHREAD_CANCEL_ENABLE : PTHREAD_CANCEL_DISABLE, &old);
+    return old;
+}
+
+//-------------------------
+void mp_thread_init(void) {
+    mp_thread_set_state(&mp_state_ctx.thread);
+    mp_thread_mutex_init(&thread_mutex);
+    // the main thread's stack is scanned down to its limit, so make sure
+    // that all of it is mapped
+    size_t len = MP_STATE_THREAD(stack_limit) + 4096;
+    volatile char *probe = alloca(len);
+    for (size_t i = 0; i < len; i += 1024) {
+        probe[i] = 0;
+    }
+    thread = &thread_entry0;
+    thread->id = pthread_self();
+    thread->ready = 1;
+    thread->arg = NULL;
+    // stack_top is the address of a local, so round the part to scan out to
+    // whole words or the pointers in it are not seen
+    uintptr_t top = ((uintptr_t)MP_STATE_THREAD(stack_top) + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+    thread->stack_lo = (char*)top - len;
+    thread->stack_hi = (char*)top;
+    thread->state = &mp_state_ctx.thread;
+    sprintf(thread->name, "MainThread");
+    thread->type = THREAD_TYPE_MAIN;
+    thread->next = NULL;
+    MainTaskHandle = (TaskHandle_t)(uintptr_t)thread->id;
+}
+
+//------------------------------
+void mp_thread_gc_others(void) {
+    mp_thread_mutex_lock(&thread_mutex, 1);
+    for (thread_t *th = thread; th != NULL; th = th->next) {
+        gc_collect_root((void**)&th, 1);
+        gc_collect_root(&th->arg, 1);
+        if (pthread_equal(th->id, pthread_self())) {
+            continue;
+        }
+        if (!th->ready) {
+            continue;
+        }
+        gc_collect_root(th->stack_lo, ((char*)th->stack_hi - (char*)th->stack_lo) / sizeof(void*));
+    }
+    mp_thread_mutex_unlock(&thread_mutex);
+}
+
+//--------------------------------------------
+mp_state_thread_t *mp_thread_get_state(void) {
+    return thread_state;
+}
+
+//-------------------------------------
+void mp_thread_set_state(void *state) {
+    thread_state = state;
+}
+
+//--------------------------
+void mp_thread_start(void) {
+    pthread_attr_t attr;
+    void *addr;
+    size_t size;
+    pthread_getattr_np(pthread_self(), &attr);
+    pthread_attr_getstack(&attr, &addr, &size);
+    pthread_attr_destroy(&attr);
+
+    mp_thread_mutex_lock(&thread_mutex, 1);
+    for (thread_t *th = thread; th != NULL; th = th->next) {
+        if (pthread_equal(th->id, pthread_self())) {
+            th->stack_lo = addr;
+            th->stack_hi = (char*)addr + size;
+            th->state = thread_state;
+            th->ready = 1;
+            break;
+        }
+    }
+    mp_thread_mutex_unlock(&thread_mutex);
+}
+
+typedef struct _thread_start_t {
+    void *(*entry)(void*);
+    void *arg;
+    int priority;
+} thread_start_t;
+
+//-------------------------------------
+STATIC void *pthread_entry(void *arg) {
+    thread_start_t start = *(thread_start_t*)arg;
+    free(arg);
+    thread_cancel_enable(0);
+    thread_priority = start.priority;
+    return start.entry(start.arg);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+TaskHandle_t mp_thread_create_ex(void *(*entry)(void*), void *arg, size_t *stack_size, int priority, char *name)
+{
+    // Check thread stack size
+    if (*stack_size == 0) {
+    	*stack_size = MP_THREAD_DEFAULT_STACK_SIZE; //use default stack size
+    }
+    else {
+        if (*stack_size < MP_THREAD_MIN_STACK_SIZE) *stack_size = MP_THREAD_MIN_STACK_SIZE;
+        else if (*stack_size > MP_THREAD_MAX_STACK_SIZE) *stack_size = MP_THREAD_MAX_STACK_SIZE;
+    }
+
+    thread_t *th = m_new_obj(thread_t);
+    thread_start_t *start = malloc(sizeof(thread_start_t));
+    if (start == NULL) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "can't create thread"));
+    }
+    start->entry = entry;
+    start->arg = arg;
+    start->priority = priority;
+
+    // the stack limit is checked against stack_size, leave room to recover
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, *stack_size + 16 * 1024);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    mp_thread_mutex_lock(&thread_mutex, 1);
+
+    pthread_t id;
+    if (pthread_create(&id, &attr, pthread_entry, start) != 0) {
+        mp_thread_mutex_unlock(&thread_mutex);
+        pthread_attr_destroy(&attr);
+        free(start);
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "can't create thread"));
+    }
+    pthread_attr_destroy(&attr);
+
+    // add thread to linked list of all threads
+    th->id = id;
+    th->ready = 0;
+    th->arg = arg;
+    th->stack_lo = NULL;
+    th->stack_hi = NULL;
+    th->state = NULL;
+    th->next = thread;
+    snprintf(th->name, THREAD_NAME_MAX_SIZE, "%s", name);
+    th->type = THREAD_TYPE_PYTHON;
+    thread = th;
+
+    mp_thread_mutex_unlock(&thread_mutex);
+    return (TaskHandle_t)(uintptr_t)id;
+}
+
+//----------------------------------------------------------------------------------------
+void *mp_thread_create(void *(*entry)(void*), void *arg, size_t *stack_size, char *name) {
+    return mp_thread_create_ex(entry, arg, stack_size, thread_priority, name);
+}
+
+// Unlinks a thread which has finished or is stopped, the thread_mutex is held
+//---------------------------------------
+STATIC void mp_clean_thread(thread_t *th)
+{
+    #if MICROPY_PY_THREAD_CHANNEL
+    // take it off any channel it waits on, its stack is going; one that is
+    // finishing, or deinitialising the rest, isn't waiting
+    if (th->state != NULL && !pthread_equal(th->id, pthread_self())) {
+        mp_thread_chan_cancel(th->state);
+    }
+    #endif
+    #if MICROPY_PY_THREAD_GIL && MICROPY_PY_THREAD_GIL_SWITCH_INTERVAL
+    // nor counted as waiting for the GIL
+    if (th->state != NULL && !pthread_equal(th->id, pthread_self())) {
+        mp_thread_gil_cancel(th->state);
+    }
+    #endif
+    for (thread_t **p = &thread; *p != NULL; p = &(*p)->next) {
+        if (*p == th) {
+            *p = th->next;
+            break;
+        }
+    }
+    th->ready = 0;
+}
+
+//---------------------------
+void mp_thread_finish(void) {
+    mp_thread_mutex_lock(&thread_mutex, 1);
+    for (thread_t *th = thread; th != NULL; th = th->next) {
+        if (pthread_equal(th->id, pthread_self())) {
+        	mp_clean_thread(th);
+            break;
+        }
+    }
+    mp_thread_mutex_unlock(&thread_mutex);
+}
+
+//---------------------------------------------------
+void mp_thread_mutex_init(mp_thread_mutex_t *mutex) {
+    pthread_mutex_init(&mutex->handle, NULL);
+}
+
+//------------------------------------------------------------
+int mp_thread_mutex_lock(mp_thread_mutex_t *mutex, int wait) {
+    if (wait) {
+        return pthread_mutex_lock(&mutex->handle) == 0;
+    }
+    return pthread_mutex_trylock(&mutex->handle) == 0;
+}
+
+//-----------------------------------------------------
+void mp_thread_mutex_unlock(mp_thread_mutex_t *mutex) {
+    pthread_mutex_unlock(&mutex->handle);
+}
+
+//---------------------------------------------
+void mp_thread_sem_init(mp_thread_sem_t *sem) {
+    pthread_mutex_init(&sem->mutex, NULL);
+    pthread_cond_init(&sem->cond, NULL);
+    sem->posted = 0;
+}
+
+//-------------------------------------------
+STATIC void sem_cancel_cleanup(void *mutex) {
+    pthread_mutex_unlock(mutex);
+}
+
+// Returns 1 once the semaphore is posted, 0 if it wasn't within timeout_ms;
+// a negative timeout waits forever
+//------------------------------------------------------------
+int mp_thread_sem_wait(mp_thread_sem_t *sem, int timeout_ms) {
+    struct timespec until;
+    if (timeout_ms >= 0) {
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += timeout_ms / 1000;
+        until.tv_nsec += (timeout_ms % 1000) * 1000000L;
+        if (until.tv_nsec >= 1000000000L) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000L;
+        }
+    }
+    int res;
+    int cancel = thread_cancel_enable(1);
+    pthread_mutex_lock(&sem->mutex);
+    pthread_cleanup_push(sem_cancel_cleanup, &sem->mutex);
+    int err = 0;
+    while (!sem->posted && err != ETIMEDOUT) {
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&sem->cond, &sem->mutex);
+        } else {
+            err = pthread_cond_timedwait(&sem->cond, &sem->mutex, &until);
+        }
+    }
+    res = sem->posted;
+    sem->posted = 0;
+    pthread_cleanup_pop(1);
+    thread_cancel_enable(cancel == PTHREAD_CANCEL_ENABLE);
+    return res;
+}
+
+//---------------------------------------------
+void mp_thread_sem_post(mp_thread_sem_t *sem) {
+    pthread_mutex_lock(&sem->mutex);
+    sem->posted = 1;
+    pthread_cond_signal(&sem->cond);
+    pthread_mutex_unlock(&sem->mutex);
+}
+
+//-----------------------------------------------
+void mp_thread_sem_deinit(mp_thread_sem_t *sem) {
+    pthread_cond_destroy(&sem->cond);
+    pthread_mutex_destroy(&sem->mutex);
+}
+
+// Priority of the calling thread, for the GIL handover
+//----------------------------
+int mp_thread_priority(void) {
+    return thread_priority;
+}
+
+// Sets the priority of the calling thread for the GIL handover; above 0 it
+// also asks for that real-time priority, which preempts like a FreeRTOS
+// one, and returns whether it got it
+//----------------------------------------
+int mp_thread_set_priority(int priority) {
+    thread_priority = priority;
+    struct sched_param param = { .sched_priority = 0 };
+    if (priority == 0) {
+        return pthread_setschedparam(pthread_self(), SCHED_OTHER, &param) == 0;
+    }
+    param.sched_priority = sched_get_priority_min(SCHED_RR) - 1 + priority;
+    return pthread_setschedparam(pthread_self(), SCHED_RR, &param) == 0;
+}
+
+// Let a thread of the same priority which is waiting for the just released
+// GIL run
+//--------------------------
+void mp_thread_yield(void) {
+    sched_yield();
+}
+
+//---------------------------
+void mp_thread_deinit(void) {
+    mp_thread_mutex_lock(&thread_mutex, 1);
+    while (thread != NULL) {
+        thread_t *th = thread;
+        mp_clean_thread(th);
+        // don't cancel the current thread
+        if (!pthread_equal(th->id, pthread_self())) {
+            pthread_cancel(th->id);
+        }
+    }
+    mp_thread_mutex_unlock(&thread_mutex);
+}
+
+//--------------------------------------
+void mp_thread_allowsuspend(int allow) {
+    (void)allow;
+}
+
+//--------------------------------------
+int mp_thread_suspend(TaskHandle_t id) {
+    (void)id;
+    return 0;
+}
+
+//-------------------------------------
+int mp_thread_resume(TaskHandle_t id) {
+    (void)id;
+    return 0;
+}
+
+// The thread stops when it next waits on a semaphore or sleeps
+//-----------------------------------
+int mp_thread_stop(TaskHandle_t id) {
+	int res = 0;
+    mp_thread_mutex_lock(&thread_mutex, 1);
+    for (thread_t *th = thread; th != NULL; th = th->next) {
+        // don't stop the current thread
+        if (pthread_equal(th->id, pthread_self())) {
+            continue;
+        }
+        if (pthread_equal(th->id, (pthread_t)(uintptr_t)id)) {
+        	mp_clean_thread(th);
+            pthread_cancel(th->id);
+            res = 1;
+            break;
+        }
+    }
+    mp_thread_mutex_unlock(&thread_mutex);
+    return res;
+}
+
+//-----------------------------------------------------
+int mp_thread_notify(TaskHandle_t id, uint32_t value) {
+    (void)id;
+    (void)value;
+    return 0;
+}
+
+//------------------------------
+uint32_t mp_thread_getnotify() {
+    return 0;
+}
+
+//------------------------------
+uint32_t mp_thread_getSelfID() {
+    return (uint32_t)pthread_self();
+}
+
+//-------------------------------------
+int mp_thread_getSelfname(char *name) {
+    return mp_thread_getname((TaskHandle_t)(uintptr_t)pthread_self(), name);
+}
+
+//--------------------------------------------------
+int mp_thread_getname(TaskHandle_t id, char *name) {
+	int res = 0;
+    mp_thread_mutex_lock(&thread_mutex, 1);
+    for (thread_t *th = thread; th != NULL; th = th->next) {
+        if (pthread_equal(th->id, (pthread_t)(uintptr_t)id)) {
+            strcpy(name, th->name);
+        	res = 1;
+			break;
+        }
+    }
+    mp_thread_mutex_unlock(&thread_mutex);
+    return res;
+}
+
+//-------------------------------------------------------------------------------------------------
+int mp_thread_semdmsg(TaskHandle_t id, int type, uint32_t msg_int, uint8_t *buf, uint32_t buflen) {
+    (void)id;
+    (void)type;
+    (void)msg_int;
+    (void)buf;
+    (void)buflen;
+    return 0;
+}
+
+//------------------------------------------------------------------------------------------
+int mp_thread_getmsg(uint32_t *msg_int, uint8_t **buf, uint32_t *buflen, uint32_t *sender) {
+    (void)msg_int;
+    (void)buf;
+    (void)buflen;
+    (void)sender;
+    return THREAD_MSG_TYPE_NONE;
+}
+
+//---------------------------------------
+int mp_thread_list(thread_list_t *list) {
+    (void)list;
+    return 0;
+}
+
+//------------------------------------------
+int mp_thread_replAcceptMsg(int8_t accept) {
+    (void)accept;
+    return 0;
+}
+
+#endif // MICROPY_PY_THREAD
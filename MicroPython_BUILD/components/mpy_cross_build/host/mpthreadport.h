@@ -0,0 +1,116 @@
+/*
+ * This file is part of the MicroPython project, http://micropython.org/
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 MicroPython_ESP32_psRAM_LoBo contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __MICROPY_INCLUDED_HOST_MPTHREADPORT_H__
+#define __MICROPY_INCLUDED_HOST_MPTHREADPORT_H__
+
+// Threads of the host build are POSIX threads.  It offers the same interface
+// as esp32/mpthreadport.h so that py/modthread.c builds unchanged; messages,
+// notifications and suspending threads aren't supported.
+
+#include <stdint.h>
+#include <pthread.h>
+
+typedef void *TaskHandle_t;
+
+// Thread types
+#define THREAD_TYPE_MAIN		1
+#define THREAD_TYPE_PYTHON		2
+#define THREAD_TYPE_SERVICE		3
+
+// Reserved thread notification constants
+#define THREAD_NOTIFY_PAUSE		70001
+#define THREAD_NOTIFY_RESUME	70002
+#define THREAD_NOTIFY_EXIT		70003
+#define THREAD_NOTIFY_STATUS	70004
+#define THREAD_NOTIFY_RESET		70005
+
+#define MP_THREAD_PRIORITY	0
+
+#define MP_THREAD_MIN_STACK_SIZE			(16 * 1024)
+#define MP_THREAD_DEFAULT_STACK_SIZE		(64 * 1024)
+#define MP_THREAD_MAX_STACK_SIZE			(1024 * 1024)
+
+typedef struct _mp_thread_mutex_t {
+    pthread_mutex_t handle;
+} mp_thread_mutex_t;
+
+// binary semaphore, which any thread may post
+typedef struct _mp_thread_sem_t {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int posted;
+} mp_thread_sem_t;
+
+#define THREAD_NAME_MAX_SIZE		16
+#define THREAD_MSG_TYPE_NONE		0
+#define THREAD_MSG_TYPE_INTEGER		1
+#define THREAD_MSG_TYPE_STRING		2
+
+typedef struct _thread_listitem_t {
+    uint32_t id;						// thread id
+    char name[THREAD_NAME_MAX_SIZE];	// thread name
+    uint8_t suspended;
+    uint8_t type;
+    uint32_t stack_len;
+    uint32_t stack_max;
+} threadlistitem_t;
+
+typedef struct _thread_list_t {
+    int nth;						// number of active threads
+    threadlistitem_t *threads;		// pointer to thread info
+} thread_list_t;
+
+void mp_thread_init(void);
+void mp_thread_gc_others(void);
+void mp_thread_deinit(void);
+
+TaskHandle_t mp_thread_create_ex(void *(*entry)(void*), void *arg, size_t *stack_size, int priority, char *name);
+
+void mp_thread_sem_init(mp_thread_sem_t *sem);
+int mp_thread_sem_wait(mp_thread_sem_t *sem, int timeout_ms);
+void mp_thread_sem_post(mp_thread_sem_t *sem);
+void mp_thread_sem_deinit(mp_thread_sem_t *sem);
+
+int mp_thread_priority(void);
+int mp_thread_set_priority(int priority);
+void mp_thread_yield(void);
+void mp_thread_allowsuspend(int allow);
+int mp_thread_suspend(TaskHandle_t id);
+int mp_thread_resume(TaskHandle_t id);
+int mp_thread_stop(TaskHandle_t id);
+int mp_thread_notify(TaskHandle_t id, uint32_t value);
+uint32_t mp_thread_getnotify();
+int mp_thread_semdmsg(TaskHandle_t id, int type, uint32_t msg_int, uint8_t *buf, uint32_t buflen);
+int mp_thread_getmsg(uint32_t *msg_int, uint8_t **buf, uint32_t *buflen, uint32_t *sender);
+
+uint32_t mp_thread_getSelfID();
+int mp_thread_getSelfname(char *name);
+int mp_thread_getname(TaskHandle_t id, char *name);
+int mp_thread_list(thread_list_t *list);
+int mp_thread_replAcceptMsg(int8_t accept);
+
+#endif // __MICROPY_INCLUDED_HOST_MPTHREADPORT_H__
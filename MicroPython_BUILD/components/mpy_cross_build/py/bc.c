@@ -72,6 +72,58 @@ const byte *mp_decode_uint_skip(const byte *ptr) {
     return ptr;
 }
 
+// Look up the instruction at ip in the line number info of the given bytecode.
+// Returns its source line, and sets *bc_offset to its offset from the end of
+// the code info, which the line number info counts from.
+size_t mp_bytecode_get_source_line(const byte *bytecode, const byte *ip_in, qstr *block_name, qstr *source_file, size_t *bc_offset) {
+    const byte *ip = bytecode;
+    ip = mp_decode_uint_skip(ip); // skip n_state
+    ip = mp_decode_uint_skip(ip); // skip n_exc_stack
+    ip++; // skip scope_params
+    ip++; // skip n_pos_args
+    ip++; // skip n_kwonly_args
+    ip++; // skip n_def_pos_args
+    size_t bc = ip_in - ip;
+    size_t code_info_size = mp_decode_uint_value(ip);
+    ip = mp_decode_uint_skip(ip); // skip code_info_size
+    bc -= code_info_size;
+    *bc_offset = bc;
+    #if MICROPY_PERSISTENT_CODE
+    *block_name = ip[0] | (ip[1] << 8);
+    *source_file = ip[2] | (ip[3] << 8);
+    ip += 4;
+    #else
+    *block_name = mp_decode_uint_value(ip);
+    ip = mp_decode_uint_skip(ip);
+    *source_file = mp_decode_uint_value(ip);
+    ip = mp_decode_uint_skip(ip);
+    #endif
+    size_t source_line = 1;
+    size_t c;
+    while ((c = *ip)) {
+        size_t b, l;
+        if ((c & 0x80) == 0) {
+            // 0b0LLBBBBB encoding
+            b = c & 0x1f;
+            l = c >> 5;
+            ip += 1;
+        } else {
+            // 0b1LLLBBBB 0bLLLLLLLL encoding (l's LSB in second byte)
+            b = c & 0xf;
+            l = ((c << 4) & 0x700) | ip[1];
+            ip += 2;
+        }
+        if (bc >= b) {
+            bc -= b;
+            source_line += l;
+        } else {
+            // found source line corresponding to bytecode offset
+            break;
+        }
+    }
+    return source_line;
+}
+
 STATIC NORETURN void fun_pos_args_mismatch(mp_obj_fun_bc_t *f, size_t expected, size_t given) {
 #if MICROPY_ERROR_REPORTING == MICROPY_ERROR_REPORTING_TERSE
     // generic message, used also for other argument issues
@@ -289,10 +341,15 @@ continue2:;
 #if MICROPY_PERSISTENT_CODE_LOAD || MICROPY_PERSISTENT_CODE_SAVE
 
 // The following table encodes the number of bytes that a specific opcode
-// takes up.  There are 3 special opcodes that always have an extra byte:
+// takes up.  There are 7 special opcodes that always have an extra byte:
 //     MP_BC_MAKE_CLOSURE
 //     MP_BC_MAKE_CLOSURE_DEFARGS
 //     MP_BC_RAISE_VARARGS
+//     MP_BC_LOAD_FAST_ATTR
+//     MP_BC_LOAD_FAST_METHOD
+//     MP_BC_BINARY_OP_POP_JUMP_IF_TRUE
+//     MP_BC_BINARY_OP_POP_JUMP_IF_FALSE
+// and MP_BC_BINARY_OP_FAST_SMALL_INT has 3 extra bytes.
 // There are 4 special opcodes that have an extra byte only when
 // MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE is enabled:
 //     MP_BC_LOAD_NAME
@@ -317,10 +374,10 @@ STATIC const byte opcode_format_table[64] = {
     OC4(B, B, V, V), // 0x20-0x23
     OC4(Q, Q, Q, B), // 0x24-0x27
     OC4(V, V, Q, Q), // 0x28-0x2b
-    OC4(U, U, U, U), // 0x2c-0x2f
+    OC4(Q, Q, B, U), // 0x2c-0x2f
     OC4(B, B, B, B), // 0x30-0x33
     OC4(B, O, O, O), // 0x34-0x37
-    OC4(O, O, U, U), // 0x38-0x3b
+    OC4(O, O, O, O), // 0x38-0x3b
     OC4(U, O, B, O), // 0x3c-0x3f
     OC4(O, B, B, O), // 0x40-0x43
     OC4(B, B, O, U), // 0x44-0x47
@@ -388,12 +445,16 @@ uint mp_opcode_format(const byte *ip, size_t *opcode_size) {
     uint f = (opcode_format_table[*ip >> 2] >> (2 * (*ip & 3))) & 3;
     const byte *ip_start = ip;
     if (f == MP_OPCODE_QSTR) {
-        ip += 3;
+        ip += 3 + (*ip == MP_BC_LOAD_FAST_ATTR || *ip == MP_BC_LOAD_FAST_METHOD);
+    } else if (*ip == MP_BC_BINARY_OP_FAST_SMALL_INT) {
+        ip += 4;
     } else {
         int extra_byte = (
             *ip == MP_BC_RAISE_VARARGS
             || *ip == MP_BC_MAKE_CLOSURE
             || *ip == MP_BC_MAKE_CLOSURE_DEFARGS
+            || *ip == MP_BC_BINARY_OP_POP_JUMP_IF_TRUE
+            || *ip == MP_BC_BINARY_OP_POP_JUMP_IF_FALSE
             #if MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE
             || *ip == MP_BC_LOAD_NAME
             || *ip == MP_BC_LOAD_GLOBAL
@@ -31,6 +31,7 @@
 #include "py/compile.h"
 #include "py/runtime.h"
 #include "py/builtin.h"
+#include "py/gc.h"
 
 #if MICROPY_PY_BUILTINS_COMPILE
 
@@ -56,6 +57,7 @@ STATIC mp_obj_t code_execute(mp_obj_code_t *self, mp_obj_dict_t *globals, mp_obj
     if (MP_OBJ_IS_TYPE(self->module_fun, &mp_type_fun_bc)) {
         mp_obj_fun_bc_t *fun_bc = MP_OBJ_TO_PTR(self->module_fun);
         fun_bc->globals = globals;
+        MP_GC_WRITE_BARRIER(fun_bc);
     }
 
     // execute code
@@ -39,6 +39,30 @@ typedef enum {
     MP_CODE_NATIVE_ASM,
 } mp_raw_code_kind_t;
 
+// Native code that is saved to a .mpy file refers to qstrs, objects and
+// runtime functions through 32-bit words in the code, which are recorded as
+// links and patched when the code is loaded.
+typedef enum {
+    MP_NATIVE_LINK_FUN = 'f', // arg is an index into mp_fun_table
+    MP_NATIVE_LINK_QSTR = 'q', // arg is a qstr
+    MP_NATIVE_LINK_QSTR_OBJ = 'Q', // arg is a qstr, the word is its object
+    MP_NATIVE_LINK_CONST = 'c', // arg is one of MP_NATIVE_CONST_xxx
+    MP_NATIVE_LINK_OBJ = 'o', // arg is a constant object
+    MP_NATIVE_LINK_RAW_CODE = 'r', // arg is the raw code of a child function
+} mp_native_link_kind_t;
+
+// the constant objects that a MP_NATIVE_LINK_CONST refers to
+#define MP_NATIVE_CONST_NONE (0)
+#define MP_NATIVE_CONST_FALSE (1)
+#define MP_NATIVE_CONST_TRUE (2)
+#define MP_NATIVE_CONST_ELLIPSIS (3)
+
+typedef struct _mp_native_link_t {
+    uint32_t offset; // of the word, from the start of the code
+    uint32_t kind; // one of mp_native_link_kind_t
+    mp_uint_t arg;
+} mp_native_link_t;
+
 typedef struct _mp_raw_code_t {
     mp_raw_code_kind_t kind : 3;
     mp_uint_t scope_flags : 7;
@@ -57,6 +81,12 @@ typedef struct _mp_raw_code_t {
             void *fun_data;
             const mp_uint_t *const_table;
             mp_uint_t type_sig; // for viper, compressed as 2-bit types; ret is MSB, then arg0, arg1, etc
+            #if MICROPY_PERSISTENT_CODE_SAVE
+            mp_uint_t fun_data_len;
+            mp_uint_t prelude_offset;
+            size_t n_link;
+            const mp_native_link_t *links;
+            #endif
         } u_native;
     } data;
 } mp_raw_code_t;
@@ -69,7 +99,11 @@ void mp_emit_glue_assign_bytecode(mp_raw_code_t *rc, const byte *code, mp_uint_t
     uint16_t n_obj, uint16_t n_raw_code,
     #endif
     mp_uint_t scope_flags);
-void mp_emit_glue_assign_native(mp_raw_code_t *rc, mp_raw_code_kind_t kind, void *fun_data, mp_uint_t fun_len, const mp_uint_t *const_table, mp_uint_t n_pos_args, mp_uint_t scope_flags, mp_uint_t type_sig);
+void mp_emit_glue_assign_native(mp_raw_code_t *rc, mp_raw_code_kind_t kind, void *fun_data, mp_uint_t fun_len, const mp_uint_t *const_table,
+    #if MICROPY_PERSISTENT_CODE_SAVE
+    mp_uint_t prelude_offset, size_t n_link, const mp_native_link_t *links,
+    #endif
+    mp_uint_t n_pos_args, mp_uint_t scope_flags, mp_uint_t type_sig);
 
 mp_obj_t mp_make_function_from_raw_code(const mp_raw_code_t *rc, mp_obj_t def_args, mp_obj_t def_kw_args);
 mp_obj_t mp_make_closure_from_raw_code(const mp_raw_code_t *rc, mp_uint_t n_closed_over, const mp_obj_t *args);
@@ -32,6 +32,9 @@
 #include "py/misc.h"
 
 void gc_init(void *start, void *end);
+#if MICROPY_GC_SPLIT_HEAP
+void gc_init_split(void *start, void *end, void *fast_start, void *fast_end);
+#endif
 
 // These lock/unlock functions can be nested.
 // They can be used to prevent the GC from allocating/freeing.
@@ -45,11 +48,61 @@ void gc_collect_start(void);
 void gc_collect_root(void **ptrs, size_t len);
 void gc_collect_end(void);
 
+#if MICROPY_GC_COMPACT
+// Move data to join up the free blocks, to be called just after a full
+// collection.  Returns the number of bytes moved.
+size_t gc_compact(void);
+#endif
+
+#if MICROPY_GC_PARALLEL_MARK
+// To be implemented by the port: have gc_mark_helper() called on the second
+// core, returning false if it can't be, and wait for it to return.
+bool gc_mark_helper_start(void);
+void gc_mark_helper_wait(void);
+// Do the second core's part of the mark phase of gc_collect_end().
+void gc_mark_helper(void);
+#endif
+
 void *gc_alloc(size_t n_bytes, bool has_finaliser);
 void gc_free(void *ptr); // does not call finaliser
 size_t gc_nbytes(const void *ptr);
 void *gc_realloc(void *ptr, size_t n_bytes, bool allow_move);
 
+#if MICROPY_GC_NURSERY
+// Run a minor collection (implemented on top of the port's gc_collect).
+void gc_collect_minor(void);
+// Must be called after a heap pointer is stored into an object that may have
+// survived a collection; ptr may point anywhere inside the object.
+void gc_write_barrier(const void *ptr);
+// Declare that all stores into this (freshly allocated) block are covered by
+// a write barrier on the block or on its owner, so minor collections only
+// need to trace it when the owner is traced.
+void gc_set_protected(const void *ptr);
+#define MP_GC_WRITE_BARRIER(ptr) gc_write_barrier(ptr)
+#define MP_GC_SET_PROTECTED(ptr) gc_set_protected(ptr)
+#elif MICROPY_GC_INCREMENTAL
+// Do up to budget_us of incremental marking work, starting a new cycle if
+// none is in progress.  Returns true if the cycle was completed (and swept)
+// by this step; gc_incr_completed is also set by the steps run on allocation
+// and by a gc_collect() which ends a cycle.
+bool gc_collect_step(mp_uint_t budget_us);
+// Run a step if a cycle is in progress or the allocation threshold was
+// reached; called from MICROPY_EVENT_POLL_HOOK.
+void gc_collect_poll(void);
+// Must be called after a heap pointer is stored into an object, once it's
+// constructed; ptr may point anywhere inside the object.
+void gc_write_barrier(const void *ptr);
+// Declare that all stores into this (freshly allocated) block are covered by
+// a write barrier on the block or on its owner, so the end of an incremental
+// cycle only needs to trace it again when the owner is traced again.
+void gc_set_protected(const void *ptr);
+#define MP_GC_WRITE_BARRIER(ptr) gc_write_barrier(ptr)
+#define MP_GC_SET_PROTECTED(ptr) gc_set_protected(ptr)
+#else
+#define MP_GC_WRITE_BARRIER(ptr) (void)0
+#define MP_GC_SET_PROTECTED(ptr) (void)0
+#endif
+
 typedef struct _gc_info_t {
     size_t total;
     size_t used;
@@ -58,6 +111,11 @@ typedef struct _gc_info_t {
     size_t num_1block;
     size_t num_2block;
     size_t max_block;
+    #if MICROPY_GC_SPLIT_HEAP
+    size_t fast_total;
+    size_t fast_used;
+    size_t fast_free;
+    #endif
 } gc_info_t;
 
 void gc_info(gc_info_t *info);
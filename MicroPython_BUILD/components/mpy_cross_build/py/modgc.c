@@ -27,19 +27,46 @@
 #include "py/mpstate.h"
 #include "py/obj.h"
 #include "py/gc.h"
+#include "py/runtime.h"
 
 #if MICROPY_PY_GC && MICROPY_ENABLE_GC
 
+#if MICROPY_GC_INCREMENTAL
+// collect(budget_us=-1): run a garbage collection, or with a budget, run one
+// step of an incremental collection and return whether it was completed
+STATIC mp_obj_t py_gc_collect(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_budget_us, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = -1} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+    if (args[0].u_int >= 0) {
+        // the cycle may also have been completed since the last call, by the
+        // steps run on allocation or by a collection when the heap was full
+        gc_collect_step(args[0].u_int);
+        bool done = MP_STATE_MEM(gc_incr_completed);
+        MP_STATE_MEM(gc_incr_completed) = 0;
+        return mp_obj_new_bool(done);
+    }
+#else
 // collect(): run a garbage collection
 STATIC mp_obj_t py_gc_collect(void) {
+#endif
     gc_collect();
+#if MICROPY_GC_INCREMENTAL
+    MP_STATE_MEM(gc_incr_completed) = 0;
+#endif
 #if MICROPY_PY_GC_COLLECT_RETVAL
     return MP_OBJ_NEW_SMALL_INT(MP_STATE_MEM(gc_collected));
 #else
     return mp_const_none;
 #endif
 }
+#if MICROPY_GC_INCREMENTAL
+MP_DEFINE_CONST_FUN_OBJ_KW(gc_collect_obj, 0, py_gc_collect);
+#else
 MP_DEFINE_CONST_FUN_OBJ_0(gc_collect_obj, py_gc_collect);
+#endif
 
 // disable(): disable the garbage collector
 STATIC mp_obj_t gc_disable(void) {
@@ -76,6 +103,31 @@ STATIC mp_obj_t gc_mem_alloc(void) {
 }
 MP_DEFINE_CONST_FUN_OBJ_0(gc_mem_alloc_obj, gc_mem_alloc);
 
+#if MICROPY_GC_SPLIT_HEAP
+// mem_regions(): return ((total, used, free) of the main region,
+// (total, used, free) of the fast region), in bytes
+STATIC mp_obj_t gc_mem_regions(void) {
+    gc_info_t info;
+    gc_info(&info);
+    mp_obj_t main_items[] = {
+        mp_obj_new_int_from_uint(info.total - info.fast_total),
+        mp_obj_new_int_from_uint(info.used - info.fast_used),
+        mp_obj_new_int_from_uint(info.free - info.fast_free),
+    };
+    mp_obj_t fast_items[] = {
+        mp_obj_new_int_from_uint(info.fast_total),
+        mp_obj_new_int_from_uint(info.fast_used),
+        mp_obj_new_int_from_uint(info.fast_free),
+    };
+    mp_obj_t items[] = {
+        mp_obj_new_tuple(MP_ARRAY_SIZE(main_items), main_items),
+        mp_obj_new_tuple(MP_ARRAY_SIZE(fast_items), fast_items),
+    };
+    return mp_obj_new_tuple(MP_ARRAY_SIZE(items), items);
+}
+MP_DEFINE_CONST_FUN_OBJ_0(gc_mem_regions_obj, gc_mem_regions);
+#endif
+
 #if MICROPY_GC_ALLOC_THRESHOLD
 STATIC mp_obj_t gc_threshold(size_t n_args, const mp_obj_t *args) {
     if (n_args == 0) {
@@ -95,6 +147,71 @@ STATIC mp_obj_t gc_threshold(size_t n_args, const mp_obj_t *args) {
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(gc_threshold_obj, 0, 1, gc_threshold);
 #endif
 
+#if MICROPY_GC_COMPACT
+// compact(): collect, then move data to join up the free blocks; return
+// (bytes moved, largest free run before, largest free run after), in bytes
+STATIC mp_obj_t gc_compact_(void) {
+    gc_collect();
+    gc_info_t info;
+    gc_info(&info);
+    size_t max_free_before = info.max_free;
+    size_t moved = gc_compact();
+    gc_info(&info);
+    mp_obj_t items[] = {
+        mp_obj_new_int_from_uint(moved),
+        mp_obj_new_int_from_uint(max_free_before * MICROPY_BYTES_PER_GC_BLOCK),
+        mp_obj_new_int_from_uint(info.max_free * MICROPY_BYTES_PER_GC_BLOCK),
+    };
+    return mp_obj_new_tuple(MP_ARRAY_SIZE(items), items);
+}
+MP_DEFINE_CONST_FUN_OBJ_0(gc_compact_obj, gc_compact_);
+
+// compact_threshold([size]): get or set the largest free run, in bytes, below
+// which a collection asks for a compaction; 0 turns this off
+STATIC mp_obj_t gc_compact_threshold(size_t n_args, const mp_obj_t *args) {
+    if (n_args == 0) {
+        return mp_obj_new_int_from_uint(MP_STATE_MEM(gc_compact_threshold));
+    }
+    mp_int_t val = mp_obj_get_int(args[0]);
+    if (val < 0) {
+        mp_raise_ValueError(NULL);
+    }
+    MP_STATE_MEM(gc_compact_threshold) = val;
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(gc_compact_threshold_obj, 0, 1, gc_compact_threshold);
+#endif
+
+#if MICROPY_GC_NURSERY
+// nursery([size]): get or set the number of bytes allocated between minor collections
+STATIC mp_obj_t gc_nursery(size_t n_args, const mp_obj_t *args) {
+    if (n_args == 0) {
+        return mp_obj_new_int(MP_STATE_MEM(gc_nursery_blocks) * MICROPY_BYTES_PER_GC_BLOCK);
+    }
+    mp_int_t val = mp_obj_get_int(args[0]);
+    if (val < 0) {
+        mp_raise_ValueError(NULL);
+    }
+    MP_STATE_MEM(gc_nursery_blocks) = val / MICROPY_BYTES_PER_GC_BLOCK;
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(gc_nursery_obj, 0, 1, gc_nursery);
+
+// mem_info(): return (minor collections, major collections, last minor pause,
+// last major pause, max pause), pauses are in microseconds
+STATIC mp_obj_t gc_mem_info(void) {
+    mp_obj_t items[] = {
+        mp_obj_new_int_from_uint(MP_STATE_MEM(gc_minor_count)),
+        mp_obj_new_int_from_uint(MP_STATE_MEM(gc_major_count)),
+        mp_obj_new_int_from_uint(MP_STATE_MEM(gc_minor_last_us)),
+        mp_obj_new_int_from_uint(MP_STATE_MEM(gc_major_last_us)),
+        mp_obj_new_int_from_uint(MP_STATE_MEM(gc_max_pause_us)),
+    };
+    return mp_obj_new_tuple(MP_ARRAY_SIZE(items), items);
+}
+MP_DEFINE_CONST_FUN_OBJ_0(gc_mem_info_obj, gc_mem_info);
+#endif
+
 STATIC const mp_rom_map_elem_t mp_module_gc_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_gc) },
     { MP_ROM_QSTR(MP_QSTR_collect), MP_ROM_PTR(&gc_collect_obj) },
@@ -103,9 +220,20 @@ STATIC const mp_rom_map_elem_t mp_module_gc_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR_isenabled), MP_ROM_PTR(&gc_isenabled_obj) },
     { MP_ROM_QSTR(MP_QSTR_mem_free), MP_ROM_PTR(&gc_mem_free_obj) },
     { MP_ROM_QSTR(MP_QSTR_mem_alloc), MP_ROM_PTR(&gc_mem_alloc_obj) },
+    #if MICROPY_GC_SPLIT_HEAP
+    { MP_ROM_QSTR(MP_QSTR_mem_regions), MP_ROM_PTR(&gc_mem_regions_obj) },
+    #endif
     #if MICROPY_GC_ALLOC_THRESHOLD
     { MP_ROM_QSTR(MP_QSTR_threshold), MP_ROM_PTR(&gc_threshold_obj) },
     #endif
+    #if MICROPY_GC_COMPACT
+    { MP_ROM_QSTR(MP_QSTR_compact), MP_ROM_PTR(&gc_compact_obj) },
+    { MP_ROM_QSTR(MP_QSTR_compact_threshold), MP_ROM_PTR(&gc_compact_threshold_obj) },
+    #endif
+    #if MICROPY_GC_NURSERY
+    { MP_ROM_QSTR(MP_QSTR_nursery), MP_ROM_PTR(&gc_nursery_obj) },
+    { MP_ROM_QSTR(MP_QSTR_mem_info), MP_ROM_PTR(&gc_mem_info_obj) },
+    #endif
 };
 
 STATIC MP_DEFINE_CONST_DICT(mp_module_gc_globals, mp_module_gc_globals_table);
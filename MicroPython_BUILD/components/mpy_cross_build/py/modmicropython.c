@@ -25,6 +25,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "py/mpstate.h"
 #include "py/builtin.h"
@@ -32,6 +33,7 @@
 #include "py/runtime.h"
 #include "py/gc.h"
 #include "py/mphal.h"
+#include "py/bc.h"
 
 // Various builtins specific to MicroPython runtime,
 // living in micropython module
@@ -127,6 +129,146 @@ STATIC mp_obj_t mp_micropython_heap_unlock(void) {
 STATIC MP_DEFINE_CONST_FUN_OBJ_0(mp_micropython_heap_unlock_obj, mp_micropython_heap_unlock);
 #endif
 
+#if MICROPY_PY_MICROPYTHON_HEAP_PROFILE
+// heap_profile(on): clear the counts and start counting, or stop counting
+// heap_profile(): return a list of (function, file, line, bytecode offset,
+// bytes, allocations) for each site, largest first; the site with function
+// None counts the allocations made outside of bytecode
+STATIC mp_obj_t mp_micropython_heap_profile(size_t n_args, const mp_obj_t *args) {
+    mp_heap_profile_site_t *sites = MP_STATE_VM(heap_profile_sites);
+    if (n_args == 1) {
+        if (mp_obj_is_true(args[0])) {
+            memset(sites, 0, sizeof(MP_STATE_VM(heap_profile_sites)));
+            MP_STATE_VM(heap_profile_enabled) = true;
+        } else {
+            MP_STATE_VM(heap_profile_enabled) = false;
+        }
+        return mp_const_none;
+    }
+
+    // sort the sites by bytes, without allocating
+    uint16_t order[MICROPY_PY_MICROPYTHON_HEAP_PROFILE_SITES];
+    size_t n = 0;
+    for (size_t i = 0; i < MICROPY_PY_MICROPYTHON_HEAP_PROFILE_SITES; i++) {
+        if (sites[i].n_allocs == 0) {
+            continue;
+        }
+        size_t j = n++;
+        for (; j > 0 && sites[order[j - 1]].n_bytes < sites[i].n_bytes; j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = i;
+    }
+
+    // building the list allocates, so don't count it
+    bool enabled = MP_STATE_VM(heap_profile_enabled);
+    MP_STATE_VM(heap_profile_enabled) = false;
+    mp_obj_t list = mp_obj_new_list(0, NULL);
+    for (size_t i = 0; i < n; i++) {
+        mp_heap_profile_site_t *site = &sites[order[i]];
+        mp_obj_t items[6] = { mp_const_none, mp_const_none, MP_OBJ_NEW_SMALL_INT(0), MP_OBJ_NEW_SMALL_INT(0) };
+        if (site->bytecode != NULL) {
+            qstr block_name, source_file;
+            size_t bc_offset;
+            size_t line = mp_bytecode_get_source_line(site->bytecode, site->ip, &block_name, &source_file, &bc_offset);
+            items[0] = MP_OBJ_NEW_QSTR(block_name);
+            items[1] = MP_OBJ_NEW_QSTR(source_file);
+            items[2] = MP_OBJ_NEW_SMALL_INT(line);
+            items[3] = MP_OBJ_NEW_SMALL_INT(bc_offset);
+        }
+        items[4] = mp_obj_new_int_from_uint(site->n_bytes);
+        items[5] = mp_obj_new_int_from_uint(site->n_allocs);
+        mp_obj_list_append(list, mp_obj_new_tuple(6, items));
+    }
+    MP_STATE_VM(heap_profile_enabled) = enabled;
+    return list;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_micropython_heap_profile_obj, 0, 1, mp_micropython_heap_profile);
+#endif
+
+#if MICROPY_PY_MICROPYTHON_PROFILE
+// profile(on): clear the counts and start counting, or stop counting
+// profile(): return a tuple of a list of (opcode, count) for the opcodes run,
+// most run first, and a list of (function, file, line, calls, total cycles,
+// self cycles) for the functions run, most total cycles first; the function
+// None counts those which didn't fit in the table
+STATIC mp_obj_t mp_micropython_profile(size_t n_args, const mp_obj_t *args) {
+    uint32_t *opcodes = MP_STATE_VM(profile_opcodes);
+    mp_profile_fun_t *funs = MP_STATE_VM(profile_funs);
+    if (n_args == 1) {
+        if (mp_obj_is_true(args[0])) {
+            memset(opcodes, 0, sizeof(MP_STATE_VM(profile_opcodes)));
+            memset(funs, 0, sizeof(MP_STATE_VM(profile_funs)));
+            MP_STATE_VM(profile_enabled) = true;
+        } else {
+            MP_STATE_VM(profile_enabled) = false;
+        }
+        return mp_const_none;
+    }
+
+    // sort the opcodes and functions by count, without allocating
+    uint8_t op_order[256];
+    size_t n = 0;
+    for (size_t i = 0; i < 256; i++) {
+        if (opcodes[i] == 0) {
+            continue;
+        }
+        size_t j = n++;
+        for (; j > 0 && opcodes[op_order[j - 1]] < opcodes[i]; j--) {
+            op_order[j] = op_order[j - 1];
+        }
+        op_order[j] = i;
+    }
+    mp_obj_t op_list = mp_obj_new_list(0, NULL);
+    for (size_t i = 0; i < n; i++) {
+        mp_obj_t items[2] = { MP_OBJ_NEW_SMALL_INT(op_order[i]), mp_obj_new_int_from_uint(opcodes[op_order[i]]) };
+        mp_obj_list_append(op_list, mp_obj_new_tuple(2, items));
+    }
+
+    uint16_t fun_order[MICROPY_PY_MICROPYTHON_PROFILE_FUNS];
+    n = 0;
+    for (size_t i = 0; i < MICROPY_PY_MICROPYTHON_PROFILE_FUNS; i++) {
+        if (funs[i].n_calls == 0 && funs[i].total_ticks == 0) {
+            continue;
+        }
+        size_t j = n++;
+        for (; j > 0 && funs[fun_order[j - 1]].total_ticks < funs[i].total_ticks; j--) {
+            fun_order[j] = fun_order[j - 1];
+        }
+        fun_order[j] = i;
+    }
+    mp_obj_t fun_list = mp_obj_new_list(0, NULL);
+    for (size_t i = 0; i < n; i++) {
+        mp_profile_fun_t *f = &funs[fun_order[i]];
+        mp_obj_t items[6] = { mp_const_none, mp_const_none, MP_OBJ_NEW_SMALL_INT(0) };
+        if (f->bytecode != NULL) {
+            // find the first opcode, to get the line the code starts on
+            const byte *ip = f->bytecode;
+            ip = mp_decode_uint_skip(ip); // skip n_state
+            ip = mp_decode_uint_skip(ip); // skip n_exc_stack
+            ip += 4; // skip scope_params, n_pos_args, n_kwonly_args, n_def_pos_args
+            ip += mp_decode_uint_value(ip); // skip code_info
+            while (*ip++ != 255) { // skip the closed over locals
+            }
+            qstr block_name, source_file;
+            size_t bc_offset;
+            size_t line = mp_bytecode_get_source_line(f->bytecode, ip, &block_name, &source_file, &bc_offset);
+            items[0] = MP_OBJ_NEW_QSTR(block_name);
+            items[1] = MP_OBJ_NEW_QSTR(source_file);
+            items[2] = MP_OBJ_NEW_SMALL_INT(line);
+        }
+        items[3] = mp_obj_new_int_from_uint(f->n_calls);
+        items[4] = mp_obj_new_int_from_ull(f->total_ticks);
+        items[5] = mp_obj_new_int_from_ull(f->self_ticks);
+        mp_obj_list_append(fun_list, mp_obj_new_tuple(6, items));
+    }
+
+    mp_obj_t report[2] = { op_list, fun_list };
+    return mp_obj_new_tuple(2, report);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_micropython_profile_obj, 0, 1, mp_micropython_profile);
+#endif
+
 #if MICROPY_ENABLE_EMERGENCY_EXCEPTION_BUF && (MICROPY_EMERGENCY_EXCEPTION_BUF_SIZE == 0)
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_alloc_emergency_exception_buf_obj, mp_alloc_emergency_exception_buf);
 #endif
@@ -140,13 +282,51 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_micropython_kbd_intr_obj, mp_micropython_kbd
 #endif
 
 #if MICROPY_ENABLE_SCHEDULER
-STATIC mp_obj_t mp_micropython_schedule(mp_obj_t function, mp_obj_t arg) {
-    if (!mp_sched_schedule(function, arg)) {
-        mp_raise_msg(&mp_type_RuntimeError, "schedule stack full");
+STATIC mp_obj_t mp_micropython_schedule(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    enum { ARG_function, ARG_arg, ARG_priority, ARG_coalesce };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_function, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+        { MP_QSTR_arg, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+        { MP_QSTR_priority, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0} },
+        { MP_QSTR_coalesce, MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    if (args[ARG_priority].u_int < 0 || args[ARG_priority].u_int >= MICROPY_SCHEDULER_PRIORITIES) {
+        mp_raise_ValueError("priority out of range");
+    }
+    if (!mp_sched_schedule_ex(args[ARG_function].u_obj, args[ARG_arg].u_obj,
+        args[ARG_priority].u_int, args[ARG_coalesce].u_bool)) {
+        mp_raise_msg(&mp_type_RuntimeError, "schedule queue full");
     }
     return mp_const_none;
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_2(mp_micropython_schedule_obj, mp_micropython_schedule);
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mp_micropython_schedule_obj, 2, mp_micropython_schedule);
+
+STATIC mp_obj_t mp_micropython_schedule_depth(size_t n_args, const mp_obj_t *args) {
+    if (n_args == 0) {
+        return MP_OBJ_NEW_SMALL_INT(mp_sched_depth());
+    }
+    mp_int_t depth = mp_obj_get_int(args[0]);
+    if (depth < 1 || depth > 1024) {
+        mp_raise_ValueError("depth out of range");
+    }
+    mp_sched_resize(depth);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_micropython_schedule_depth_obj, 0, 1, mp_micropython_schedule_depth);
+
+// Returns (pending, max_depth, dropped)
+STATIC mp_obj_t mp_micropython_schedule_stats(void) {
+    mp_obj_t tuple[3] = {
+        mp_obj_new_int_from_uint(mp_sched_num_pending()),
+        mp_obj_new_int_from_uint(MP_STATE_VM(sched_max_depth)),
+        mp_obj_new_int_from_uint(MP_STATE_VM(sched_dropped)),
+    };
+    return mp_obj_new_tuple(3, tuple);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(mp_micropython_schedule_stats_obj, mp_micropython_schedule_stats);
 #endif
 
 STATIC const mp_rom_map_elem_t mp_module_micropython_globals_table[] = {
@@ -172,11 +352,19 @@ STATIC const mp_rom_map_elem_t mp_module_micropython_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR_heap_lock), MP_ROM_PTR(&mp_micropython_heap_lock_obj) },
     { MP_ROM_QSTR(MP_QSTR_heap_unlock), MP_ROM_PTR(&mp_micropython_heap_unlock_obj) },
     #endif
+    #if MICROPY_PY_MICROPYTHON_HEAP_PROFILE
+    { MP_ROM_QSTR(MP_QSTR_heap_profile), MP_ROM_PTR(&mp_micropython_heap_profile_obj) },
+    #endif
+    #if MICROPY_PY_MICROPYTHON_PROFILE
+    { MP_ROM_QSTR(MP_QSTR_profile), MP_ROM_PTR(&mp_micropython_profile_obj) },
+    #endif
     #if MICROPY_KBD_EXCEPTION
     { MP_ROM_QSTR(MP_QSTR_kbd_intr), MP_ROM_PTR(&mp_micropython_kbd_intr_obj) },
     #endif
     #if MICROPY_ENABLE_SCHEDULER
     { MP_ROM_QSTR(MP_QSTR_schedule), MP_ROM_PTR(&mp_micropython_schedule_obj) },
+    { MP_ROM_QSTR(MP_QSTR_schedule_depth), MP_ROM_PTR(&mp_micropython_schedule_depth_obj) },
+    { MP_ROM_QSTR(MP_QSTR_schedule_stats), MP_ROM_PTR(&mp_micropython_schedule_stats_obj) },
     #endif
 };
 
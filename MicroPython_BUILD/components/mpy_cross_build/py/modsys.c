@@ -148,6 +148,24 @@ STATIC mp_obj_t mp_sys_getsizeof(mp_obj_t obj) {
 }
 MP_DEFINE_CONST_FUN_OBJ_1(mp_sys_getsizeof_obj, mp_sys_getsizeof);
 
+#if MICROPY_PY_THREAD_GIL && MICROPY_PY_THREAD_GIL_SWITCH_INTERVAL && MICROPY_PY_BUILTINS_FLOAT
+STATIC mp_obj_t mp_sys_getswitchinterval(void) {
+    return mp_obj_new_float((mp_float_t)MP_STATE_VM(gil_switch_interval) / 1000000);
+}
+MP_DEFINE_CONST_FUN_OBJ_0(mp_sys_getswitchinterval_obj, mp_sys_getswitchinterval);
+
+STATIC mp_obj_t mp_sys_setswitchinterval(mp_obj_t interval_in) {
+    mp_float_t interval = mp_obj_get_float(interval_in);
+    if (interval <= 0) {
+        mp_raise_ValueError("switch interval must be positive");
+    }
+    mp_uint_t us = (mp_uint_t)(interval * 1000000 + MICROPY_FLOAT_CONST(0.5));
+    MP_STATE_VM(gil_switch_interval) = us == 0 ? 1 : us;
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_1(mp_sys_setswitchinterval_obj, mp_sys_setswitchinterval);
+#endif
+
 STATIC const mp_rom_map_elem_t mp_module_sys_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_sys) },
 
@@ -197,6 +215,10 @@ STATIC const mp_rom_map_elem_t mp_module_sys_globals_table[] = {
     #if MICROPY_PY_SYS_GETSIZEOF
     { MP_ROM_QSTR(MP_QSTR_getsizeof), MP_ROM_PTR(&mp_sys_getsizeof_obj) },
     #endif
+    #if MICROPY_PY_THREAD_GIL && MICROPY_PY_THREAD_GIL_SWITCH_INTERVAL && MICROPY_PY_BUILTINS_FLOAT
+    { MP_ROM_QSTR(MP_QSTR_getswitchinterval), MP_ROM_PTR(&mp_sys_getswitchinterval_obj) },
+    { MP_ROM_QSTR(MP_QSTR_setswitchinterval), MP_ROM_PTR(&mp_sys_setswitchinterval_obj) },
+    #endif
 
     /*
      * Extensions to CPython
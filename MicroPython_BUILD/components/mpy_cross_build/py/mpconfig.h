@@ -122,6 +122,121 @@
 #define MICROPY_GC_ALLOC_THRESHOLD (1)
 #endif
 
+// Support generational collection: blocks that survive a collection stay
+// marked and are only traced again by a full collection, while a minor
+// collection traces and sweeps just the blocks allocated since the previous
+// collection.  Stores of heap pointers into surviving objects must be
+// covered by MP_GC_WRITE_BARRIER.  Costs 2 bits of heap per GC block and
+// requires mp_hal_ticks_us for the pause statistics.
+#ifndef MICROPY_GC_NURSERY
+#define MICROPY_GC_NURSERY (0)
+#endif
+
+// Default number of bytes that may be allocated before a minor collection
+// is run, configurable by gc.nursery().  0 disables minor collections.
+#ifndef MICROPY_GC_NURSERY_SIZE
+#define MICROPY_GC_NURSERY_SIZE (32 * 1024)
+#endif
+
+// Whether gc_alloc keeps lists of runs of free blocks, by size and in address
+// order, to serve small allocations from without scanning the heap.  A list
+// that runs out is filled again from where it was filled up to last time.
+#ifndef MICROPY_GC_FREE_LISTS
+#define MICROPY_GC_FREE_LISTS (0)
+#endif
+
+// Number of size classes of the free lists: runs of 1 to N-1 blocks, and of
+// N blocks or more.  Allocations of up to N blocks use the free lists.
+#ifndef MICROPY_GC_FREE_LIST_CLASSES
+#define MICROPY_GC_FREE_LIST_CLASSES (8)
+#endif
+
+// Maximum number of runs kept in each free list
+#ifndef MICROPY_GC_FREE_LIST_DEPTH
+#define MICROPY_GC_FREE_LIST_DEPTH (32)
+#endif
+
+// Whether the heap can be split over two memory regions, see gc_init_split():
+// a large main region, which also holds the GC tables, and a small fast one
+// (eg internal RAM next to external psRAM).  Allocations of up to
+// MICROPY_GC_SPLIT_HEAP_SMALL bytes (floats, tuples, bound methods, small
+// instances) are placed in the fast region, larger ones (buffers, array and
+// string data) in the main region, each spilling into the other region when
+// its own is full.  With free lists, these only hold runs of the fast region.
+#ifndef MICROPY_GC_SPLIT_HEAP
+#define MICROPY_GC_SPLIT_HEAP (0)
+#endif
+
+// Largest allocation, in bytes, placed in the fast region of a split heap
+#ifndef MICROPY_GC_SPLIT_HEAP_SMALL
+#define MICROPY_GC_SPLIT_HEAP_SMALL (64)
+#endif
+
+// Support compaction of the heap, see gc_compact(): the data of bytes,
+// bytearray and array objects and the tables of dicts and instances are
+// moved down to join up the free blocks, when the only reference to them is
+// from their object.  It runs from gc.compact(), when an allocation fails
+// after a collection, and after a collection which finds the largest free
+// block smaller than gc.compact_threshold().  C code must not keep pointers
+// to such data outside of the heap and the stacks.  Requires
+// MICROPY_ENABLE_FINALISER.
+#ifndef MICROPY_GC_COMPACT
+#define MICROPY_GC_COMPACT (0)
+#endif
+
+// Default for gc.compact_threshold(), in bytes; 0 disables it
+#ifndef MICROPY_GC_COMPACT_THRESHOLD
+#define MICROPY_GC_COMPACT_THRESHOLD (0)
+#endif
+
+// Whether the mark and sweep phases of the GC can be split into time-sliced
+// steps that interleave with the program, see gc_collect_step().  Stores into
+// objects that were already traced are caught by MP_GC_WRITE_BARRIER.  Costs
+// 2 bits of heap per GC block, requires MICROPY_GC_ALLOC_THRESHOLD and
+// mp_hal_ticks_us, and can't be used together with MICROPY_GC_NURSERY.
+#ifndef MICROPY_GC_INCREMENTAL
+#define MICROPY_GC_INCREMENTAL (0)
+#endif
+
+// Default time in microseconds that one incremental GC step may take
+#ifndef MICROPY_GC_INCREMENTAL_BUDGET_US
+#define MICROPY_GC_INCREMENTAL_BUDGET_US (500)
+#endif
+
+// Default gc.threshold() in incremental mode: an incremental step is run
+// each time this many bytes have been allocated.
+#ifndef MICROPY_GC_INCREMENTAL_THRESHOLD
+#define MICROPY_GC_INCREMENTAL_THRESHOLD (8 * 1024)
+#endif
+
+// Whether a full collection traces the heap on two cores at once.  Each core
+// marks the blocks of every other run of MICROPY_GC_PARALLEL_CHUNK blocks
+// and passes the pointers it finds into the other core's runs to that core,
+// so the alloc table is only written to by plain byte stores.  The port
+// provides gc_mark_helper_start() and gc_mark_helper_wait(), which run
+// gc_mark_helper() on the second core.  Can't be used together with
+// MICROPY_GC_NURSERY or MICROPY_GC_INCREMENTAL.
+#ifndef MICROPY_GC_PARALLEL_MARK
+#define MICROPY_GC_PARALLEL_MARK (0)
+#endif
+
+// Number of GC blocks in each run that one core marks, a multiple of 16
+#ifndef MICROPY_GC_PARALLEL_CHUNK
+#define MICROPY_GC_PARALLEL_CHUNK (64)
+#endif
+
+// Number of words allocated (in BSS) to each core's GC stack and to the
+// queue of blocks passed to it, for the parallel mark
+#ifndef MICROPY_GC_PARALLEL_STACK_SIZE
+#define MICROPY_GC_PARALLEL_STACK_SIZE (256)
+#endif
+
+// Hook called while a core waits for work from the other one in the
+// parallel mark
+#ifndef MICROPY_GC_PARALLEL_IDLE
+#define MICROPY_GC_PARALLEL_IDLE()
+#endif
+
 // Number of bytes to allocate initially when creating new chunks to store
 // interned string data.  Smaller numbers lead to more chunks being needed
 // and more wastage at the end of the chunk.  Larger numbers lead to wasted
@@ -292,13 +407,18 @@
 #define MICROPY_EMIT_XTENSA (0)
 #endif
 
+// Whether to emit Xtensa native code for the windowed ABI (ESP32)
+#ifndef MICROPY_EMIT_XTENSAWIN
+#define MICROPY_EMIT_XTENSAWIN (0)
+#endif
+
 // Whether to enable the Xtensa inline assembler
 #ifndef MICROPY_EMIT_INLINE_XTENSA
 #define MICROPY_EMIT_INLINE_XTENSA (0)
 #endif
 
 // Convenience definition for whether any native emitter is enabled
-#define MICROPY_EMIT_NATIVE (MICROPY_EMIT_X64 || MICROPY_EMIT_X86 || MICROPY_EMIT_THUMB || MICROPY_EMIT_ARM || MICROPY_EMIT_XTENSA)
+#define MICROPY_EMIT_NATIVE (MICROPY_EMIT_X64 || MICROPY_EMIT_X86 || MICROPY_EMIT_THUMB || MICROPY_EMIT_ARM || MICROPY_EMIT_XTENSA || MICROPY_EMIT_XTENSAWIN)
 
 // Convenience definition for whether any inline assembler emitter is enabled
 #define MICROPY_EMIT_INLINE_ASM (MICROPY_EMIT_INLINE_THUMB || MICROPY_EMIT_INLINE_XTENSA)
@@ -394,12 +514,107 @@
 #define MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE (0)
 #endif
 
+// Whether to cache the result of LOAD_NAME, LOAD_GLOBAL, LOAD_ATTR, LOAD_METHOD
+// and STORE_ATTR in a side table indexed by the address of the opcode, instead
+// of in the bytecode.  Does not change the bytecode, and costs a fixed
+// MICROPY_OPT_INLINE_CACHE_SIZE entries of RAM (each 6 words), so it suits
+// bytecode kept in slow or read-only memory.
+#ifndef MICROPY_OPT_INLINE_CACHE
+#define MICROPY_OPT_INLINE_CACHE (0)
+#endif
+
+// Number of entries in the inline cache; must be a power of 2
+#ifndef MICROPY_OPT_INLINE_CACHE_SIZE
+#define MICROPY_OPT_INLINE_CACHE_SIZE (128)
+#endif
+
+// Whether the bytecode emitter fuses common sequences of instructions into
+// superinstructions, see emitbc.c.  The VM runs them either way, so this only
+// changes the bytecode that is compiled.
+#ifndef MICROPY_OPT_FUSE_BYTECODE
+#define MICROPY_OPT_FUSE_BYTECODE (1)
+#endif
+
+// Whether maps keep the hash of each key next to the table, so lookups compare
+// only the keys of equal hash and growing a map doesn't hash its keys again,
+// and whether large ordered maps (OrderedDict) get a hash index instead of
+// being searched linearly.  Costs 1 word of RAM per entry of a dict, and
+// about 2 more per entry of a large ordered map.
+#ifndef MICROPY_OPT_MAP_CACHED_HASHES
+#define MICROPY_OPT_MAP_CACHED_HASHES (0)
+#endif
+
+// Whether each qstr pool has a hash index, so that interning a string or
+// finding an attribute by a dynamic name doesn't search the pools linearly.
+// Costs about 4 bytes of ROM per constant qstr, and of RAM per dynamic one.
+#ifndef MICROPY_OPT_QSTR_INDEX
+#define MICROPY_OPT_QSTR_INDEX (0)
+#endif
+
+// Whether `s += t` on a str or bytes leaves spare room after the result, so
+// that appending to it again copies only t rather than the whole string.  The
+// room is used by whichever str reached the end of the buffer last, so older
+// values are never changed.  Costs up to half as much RAM again as the string
+// being built, plus a word per buffer.
+#ifndef MICROPY_OPT_STR_APPEND
+#define MICROPY_OPT_STR_APPEND (0)
+#endif
+
+// Whether slicing a bytes object gives a view sharing its data instead of a
+// copy, for slices of at least MICROPY_BYTES_SLICE_VIEW_MIN bytes.  A view
+// keeps all of the original data alive, and costs a word more than a bytes.
+#ifndef MICROPY_OPT_BYTES_SLICE_VIEW
+#define MICROPY_OPT_BYTES_SLICE_VIEW (0)
+#endif
+
+#ifndef MICROPY_BYTES_SLICE_VIEW_MIN
+#define MICROPY_BYTES_SLICE_VIEW_MIN (64)
+#endif
+
+// Whether str.format() keeps the parsed form of recently used constant format
+// strings, so that formatting with the same template again doesn't parse it.
+// Costs a fixed MICROPY_OPT_STR_FORMAT_CACHE_SIZE entries of RAM, each of 8
+// bytes plus 16 per piece.
+#ifndef MICROPY_OPT_STR_FORMAT_CACHE
+#define MICROPY_OPT_STR_FORMAT_CACHE (0)
+#endif
+
+// Number of entries in the format cache; must be a power of 2
+#ifndef MICROPY_OPT_STR_FORMAT_CACHE_SIZE
+#define MICROPY_OPT_STR_FORMAT_CACHE_SIZE (8)
+#endif
+
+// Maximum number of pieces (replacement fields, and literal text after the
+// last one) a template may have to be cached
+#ifndef MICROPY_OPT_STR_FORMAT_CACHE_PIECES
+#define MICROPY_OPT_STR_FORMAT_CACHE_PIECES (8)
+#endif
+
 // Whether to use fast versions of bitwise operations (and, or, xor) when the
 // arguments are both positive.  Increases Thumb2 code size by about 250 bytes.
 #ifndef MICROPY_OPT_MPZ_BITWISE
 #define MICROPY_OPT_MPZ_BITWISE (0)
 #endif
 
+// Whether mpz multiplication switches to Karatsuba's algorithm when both
+// operands have at least MICROPY_MPZ_KARATSUBA_THRESHOLD digits.  Costs some
+// temporary heap while multiplying, about 4 times the size of the product.
+#ifndef MICROPY_OPT_MPZ_KARATSUBA
+#define MICROPY_OPT_MPZ_KARATSUBA (0)
+#endif
+
+// Number of digits below which Karatsuba falls back to long multiplication
+#ifndef MICROPY_MPZ_KARATSUBA_THRESHOLD
+#define MICROPY_MPZ_KARATSUBA_THRESHOLD (32)
+#endif
+
+// Whether pow(a, b, m) uses sliding-window exponentiation, with Montgomery
+// reduction instead of a long division per step when m is odd.  Costs up to
+// 16 precomputed powers of a, each the size of m, while computing.
+#ifndef MICROPY_OPT_MPZ_POW3
+#define MICROPY_OPT_MPZ_POW3 (0)
+#endif
+
 /*****************************************************************************/
 /* Python internal features                                                  */
 
@@ -558,6 +773,14 @@ typedef double mp_float_t;
 #define MICROPY_PY_BUILTINS_COMPLEX (MICROPY_PY_BUILTINS_FLOAT)
 #endif
 
+// Whether to convert floats to and from decimal exactly: repr() gives the
+// shortest digits that read back as the same float, other formats round
+// correctly and parsing gives the nearest float.  Needs double precision and
+// adds about 12k of tables and code.
+#ifndef MICROPY_FLOAT_EXACT_CONV
+#define MICROPY_FLOAT_EXACT_CONV (0)
+#endif
+
 // Whether to provide a high-quality hash for float and complex numbers.
 // Otherwise the default is a very simple but correct hashing function.
 #ifndef MICROPY_FLOAT_HIGH_QUALITY_HASH
@@ -646,11 +869,23 @@ typedef double mp_float_t;
 #define MICROPY_ENABLE_SCHEDULER (0)
 #endif
 
-// Maximum number of entries in the scheduler
+// Initial number of entries per priority level in the scheduler, rounded up
+// to a power of 2; can be changed at runtime with micropython.schedule_depth()
 #ifndef MICROPY_SCHEDULER_DEPTH
 #define MICROPY_SCHEDULER_DEPTH (4)
 #endif
 
+// Number of scheduler priority levels, the highest non-empty one runs first
+#ifndef MICROPY_SCHEDULER_PRIORITIES
+#define MICROPY_SCHEDULER_PRIORITIES (1)
+#endif
+
+// Wait while a callback is being queued by another core or task; used by
+// micropython.schedule_depth() when it swaps the queue
+#ifndef MICROPY_SCHEDULER_RESIZE_WAIT
+#define MICROPY_SCHEDULER_RESIZE_WAIT()
+#endif
+
 // Support for generic VFS sub-system
 #ifndef MICROPY_VFS
 #define MICROPY_VFS (0)
@@ -837,6 +1072,37 @@ typedef double mp_float_t;
 #define MICROPY_PY_MICROPYTHON_MEM_INFO (0)
 #endif
 
+// Whether to provide micropython.heap_profile(), which counts the heap
+// allocations made by each bytecode instruction while it is switched on
+#ifndef MICROPY_PY_MICROPYTHON_HEAP_PROFILE
+#define MICROPY_PY_MICROPYTHON_HEAP_PROFILE (0)
+#endif
+
+// Number of allocation sites heap_profile() can tell apart; must be a power
+// of 2.  Allocations from further sites are counted with those made outside
+// of bytecode.
+#ifndef MICROPY_PY_MICROPYTHON_HEAP_PROFILE_SITES
+#define MICROPY_PY_MICROPYTHON_HEAP_PROFILE_SITES (64)
+#endif
+
+// Whether to provide micropython.profile(), which counts the opcodes run by
+// the VM and the calls and cycles spent in each function while it is
+// switched on.  When switched off it costs one test per opcode.
+#ifndef MICROPY_PY_MICROPYTHON_PROFILE
+#define MICROPY_PY_MICROPYTHON_PROFILE (0)
+#endif
+
+// Number of functions profile() can tell apart; must be a power of 2.
+// Further functions are counted together.
+#ifndef MICROPY_PY_MICROPYTHON_PROFILE_FUNS
+#define MICROPY_PY_MICROPYTHON_PROFILE_FUNS (32)
+#endif
+
+// Cycle counter used by profile(); only differences of its low 32 bits are used
+#ifndef MICROPY_PY_MICROPYTHON_PROFILE_TICKS
+#define MICROPY_PY_MICROPYTHON_PROFILE_TICKS() mp_hal_ticks_cpu()
+#endif
+
 // Whether to provide "array" module. Note that large chunk of the
 // underlying code is shared with "bytearray" builtin type, so to
 // get real savings, it should be disabled too.
@@ -980,6 +1246,17 @@ typedef double mp_float_t;
 #define MICROPY_PY_USELECT (0)
 #endif
 
+// Whether mp_poll_map_wait() may block in select() on the file descriptors
+// of the streams it waits on, which they give with MP_STREAM_GET_FILENO
+#ifndef MICROPY_PY_USELECT_SELECT_FD
+#define MICROPY_PY_USELECT_SELECT_FD (0)
+#endif
+
+// The header that declares select() and fd_set for it
+#ifndef MICROPY_PY_USELECT_SELECT_FD_H
+#define MICROPY_PY_USELECT_SELECT_FD_H <sys/select.h>
+#endif
+
 // Whether to provide "utime" module functions implementation
 // in terms of mp_hal_* functions.
 #ifndef MICROPY_PY_UTIME_MP_HAL
@@ -1013,6 +1290,32 @@ typedef double mp_float_t;
 #define MICROPY_PY_THREAD_GIL_VM_DIVISOR (32)
 #endif
 
+// Default time in microseconds a thread keeps the GIL for, from when it took
+// it, before handing it over in a VM jump-loop; the handover is only done if
+// another thread is waiting, and sooner if that one has a higher priority.
+// Can be changed with sys.setswitchinterval().  Set this to 0 to use
+// MICROPY_PY_THREAD_GIL_VM_DIVISOR instead.
+#ifndef MICROPY_PY_THREAD_GIL_SWITCH_INTERVAL
+#define MICROPY_PY_THREAD_GIL_SWITCH_INTERVAL (0)
+#endif
+
+// Hooks for the GIL switch interval: the priority of the calling thread (higher
+// is more urgent), and letting a waiting thread of the same priority run after
+// the GIL is released (a mutex handover may not switch threads by itself).
+#ifndef MICROPY_PY_THREAD_GIL_PRIORITY
+#define MICROPY_PY_THREAD_GIL_PRIORITY() (0)
+#endif
+#ifndef MICROPY_PY_THREAD_GIL_YIELD
+#define MICROPY_PY_THREAD_GIL_YIELD()
+#endif
+
+// Whether to provide _thread.Channel and _thread.select(), for passing
+// objects between threads without copying them.  Needs the GIL and the port
+// to implement mp_thread_sem_t.
+#ifndef MICROPY_PY_THREAD_CHANNEL
+#define MICROPY_PY_THREAD_CHANNEL (0)
+#endif
+
 // Extended modules
 
 #ifndef MICROPY_PY_UCTYPES
@@ -1040,6 +1343,12 @@ typedef double mp_float_t;
 #define MICROPY_PY_UTIMEQ (0)
 #endif
 
+// Event loop for generator based coroutines (_uasyncio module), built on
+// utimeq and uselect, so it requires both
+#ifndef MICROPY_PY_UASYNCIO
+#define MICROPY_PY_UASYNCIO (0)
+#endif
+
 #ifndef MICROPY_PY_UHASHLIB
 #define MICROPY_PY_UHASHLIB (0)
 #endif
@@ -46,16 +46,35 @@ void mp_thread_finish(void);
 void mp_thread_mutex_init(mp_thread_mutex_t *mutex);
 int mp_thread_mutex_lock(mp_thread_mutex_t *mutex, int wait);
 void mp_thread_mutex_unlock(mp_thread_mutex_t *mutex);
+#if MICROPY_PY_THREAD_CHANNEL
+void mp_thread_chan_cancel(struct _mp_state_thread_t *ts);
+#endif
+#if MICROPY_PY_THREAD_GIL && MICROPY_PY_THREAD_GIL_SWITCH_INTERVAL
+void mp_thread_gil_cancel(struct _mp_state_thread_t *ts);
+#endif
 
 #endif // MICROPY_PY_THREAD
 
 #if MICROPY_PY_THREAD && MICROPY_PY_THREAD_GIL
 #include "py/mpstate.h"
+#if MICROPY_PY_THREAD_GIL_SWITCH_INTERVAL
+void mp_thread_gil_enter(void);
+#define MP_THREAD_GIL_ENTER() mp_thread_gil_enter()
+#else
 #define MP_THREAD_GIL_ENTER() mp_thread_mutex_lock(&MP_STATE_VM(gil_mutex), 1)
+#endif
 #define MP_THREAD_GIL_EXIT() mp_thread_mutex_unlock(&MP_STATE_VM(gil_mutex))
+// While a thread runs without the GIL (possibly on the other core) its live
+// registers are not seen by a collection started by another thread, so a heap
+// buffer that is only referenced from a register must be pinned to the stack
+// across the MP_THREAD_GIL_EXIT/MP_THREAD_GIL_ENTER pair.
+#define MP_THREAD_PIN(ptr) void *volatile _mp_thread_pin = (void*)(ptr)
+#define MP_THREAD_UNPIN() (void)_mp_thread_pin
 #else
 #define MP_THREAD_GIL_ENTER()
 #define MP_THREAD_GIL_EXIT()
+#define MP_THREAD_PIN(ptr)
+#define MP_THREAD_UNPIN()
 #endif
 
 #endif // MICROPY_INCLUDED_PY_MPTHREAD_H
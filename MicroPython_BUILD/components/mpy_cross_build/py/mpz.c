@@ -449,6 +449,146 @@ STATIC size_t mpn_mul(mpz_dig_t *idig, mpz_dig_t *jdig, size_t jlen, mpz_dig_t *
     return ilen;
 }
 
+#if MICROPY_OPT_MPZ_KARATSUBA
+
+// below 4 digits the sums of the halves are as long as the operands
+#define KARATSUBA_THRESHOLD (MICROPY_MPZ_KARATSUBA_THRESHOLD < 4 ? 4 : MICROPY_MPZ_KARATSUBA_THRESHOLD)
+
+/* computes i += j
+   assumes jlen <= ilen and that the sum fits in ilen digits
+*/
+STATIC void mpn_add_inpl(mpz_dig_t *idig, size_t ilen, const mpz_dig_t *jdig, size_t jlen) {
+    mpz_dbl_dig_t carry = 0;
+
+    ilen -= jlen;
+
+    for (; jlen > 0; --jlen, ++idig, ++jdig) {
+        carry += (mpz_dbl_dig_t)*idig + (mpz_dbl_dig_t)*jdig;
+        *idig = carry & DIG_MASK;
+        carry >>= DIG_SIZE;
+    }
+
+    for (; carry != 0 && ilen > 0; --ilen, ++idig) {
+        carry += *idig;
+        *idig = carry & DIG_MASK;
+        carry >>= DIG_SIZE;
+    }
+}
+
+/* computes i -= j
+   assumes jlen <= ilen and i >= j
+*/
+STATIC void mpn_sub_inpl(mpz_dig_t *idig, size_t ilen, const mpz_dig_t *jdig, size_t jlen) {
+    mpz_dbl_dig_signed_t borrow = 0;
+
+    ilen -= jlen;
+
+    for (; jlen > 0; --jlen, ++idig, ++jdig) {
+        borrow += (mpz_dbl_dig_t)*idig - (mpz_dbl_dig_t)*jdig;
+        *idig = borrow & DIG_MASK;
+        borrow >>= DIG_SIZE;
+    }
+
+    for (; borrow != 0 && ilen > 0; --ilen, ++idig) {
+        borrow += *idig;
+        *idig = borrow & DIG_MASK;
+        borrow >>= DIG_SIZE;
+    }
+}
+
+/* returns the number of scratch digits that mpn_mul_karatsuba needs for
+   operands of the given lengths; must split the operands the same way
+*/
+STATIC size_t mpn_karatsuba_scratch(size_t jlen, size_t klen) {
+    if (jlen < klen) {
+        size_t t = jlen; jlen = klen; klen = t;
+    }
+    if (klen < KARATSUBA_THRESHOLD) {
+        return 0;
+    }
+    if (jlen >= 2 * klen) {
+        size_t need = mpn_karatsuba_scratch(klen, klen);
+        size_t rest = mpn_karatsuba_scratch(klen, jlen % klen);
+        return 2 * klen + (need > rest ? need : rest);
+    }
+    size_t m = jlen / 2;
+    size_t hj = jlen - m + 1;
+    size_t hk = (klen - m > m ? klen - m : m) + 1;
+    size_t need = mpn_karatsuba_scratch(m, m);
+    size_t n = mpn_karatsuba_scratch(jlen - m, klen - m);
+    if (n > need) {
+        need = n;
+    }
+    n = mpn_karatsuba_scratch(hj, hk);
+    if (n > need) {
+        need = n;
+    }
+    return 2 * (hj + hk) + need;
+}
+
+/* computes i = j * k using Karatsuba's algorithm, splitting the longer operand
+   in half and doing 3 half-sized products instead of 4
+   assumes i has jlen + klen digits and is zeroed; j, k need not be normalised
+   assumes scratch has mpn_karatsuba_scratch(jlen, klen) digits
+   can have j, k point to same memory
+*/
+STATIC void mpn_mul_karatsuba(mpz_dig_t *idig, mpz_dig_t *jdig, size_t jlen, mpz_dig_t *kdig, size_t klen, mpz_dig_t *scratch) {
+    if (jlen < klen) {
+        mpz_dig_t *t = jdig; jdig = kdig; kdig = t;
+        size_t tl = jlen; jlen = klen; klen = tl;
+    }
+
+    if (klen < KARATSUBA_THRESHOLD) {
+        mpn_mul(idig, jdig, jlen, kdig, klen);
+        return;
+    }
+
+    if (jlen >= 2 * klen) {
+        // very unbalanced: multiply k by slices of j the length of k, and
+        // accumulate the partial products
+        mpz_dig_t *t = scratch;
+        for (size_t off = 0; off < jlen; off += klen) {
+            size_t len = jlen - off < klen ? jlen - off : klen;
+            memset(t, 0, (len + klen) * sizeof(mpz_dig_t));
+            mpn_mul_karatsuba(t, jdig + off, len, kdig, klen, scratch + 2 * klen);
+            mpn_add_inpl(idig + off, jlen + klen - off, t, len + klen);
+        }
+        return;
+    }
+
+    // split j = j1 * B^m + j0 and k = k1 * B^m + k0; since klen > jlen / 2
+    // both high halves are non-empty
+    size_t m = jlen / 2;
+
+    // z0 = j0 * k0 and z2 = j1 * k1 go straight into the low and high parts of i
+    mpn_mul_karatsuba(idig, jdig, m, kdig, m, scratch);
+    mpn_mul_karatsuba(idig + 2 * m, jdig + m, jlen - m, kdig + m, klen - m, scratch);
+
+    // z1 = (j0 + j1) * (k0 + k1) - z0 - z2
+    size_t hj = jlen - m + 1;
+    size_t hk = (klen - m > m ? klen - m : m) + 1;
+    mpz_dig_t *sj = scratch;
+    mpz_dig_t *sk = sj + hj;
+    mpz_dig_t *t = sk + hk;
+    memset(sj, 0, (2 * (hj + hk)) * sizeof(mpz_dig_t));
+    mpn_add(sj, jdig + m, jlen - m, jdig, m);
+    if (klen - m >= m) {
+        mpn_add(sk, kdig + m, klen - m, kdig, m);
+    } else {
+        mpn_add(sk, kdig, m, kdig + m, klen - m);
+    }
+    size_t tlen = hj + hk;
+    mpn_mul_karatsuba(t, sj, hj, sk, hk, t + tlen);
+    mpn_sub_inpl(t, tlen, idig, 2 * m);
+    mpn_sub_inpl(t, tlen, idig + 2 * m, jlen + klen - 2 * m);
+    tlen = mpn_remove_trailing_zeros(t, t + tlen);
+
+    // i += z1 * B^m
+    mpn_add_inpl(idig + m, jlen + klen - m, t, tlen);
+}
+
+#endif // MICROPY_OPT_MPZ_KARATSUBA
+
 /* natural_div - quo * den + new_num = old_num (ie num is replaced with rem)
    assumes den != 0
    assumes num_dig has enough memory to be extended by 1 digit
@@ -519,8 +659,13 @@ STATIC void mpn_div(mpz_dig_t *num_dig, size_t *num_len, const mpz_dig_t *den_di
     while (*num_len > den_len) {
         mpz_dbl_dig_t quo = ((mpz_dbl_dig_t)*num_dig << DIG_SIZE) | num_dig[-1];
 
-        // get approximate quotient
+        // get approximate quotient; it can be a digit too big when the leading
+        // digits of the numerator and denominator are equal, and is then at
+        // most 2 too big like the others
         quo /= lead_den_digit;
+        if (quo > DIG_MASK) {
+            quo = DIG_MASK;
+        }
 
         // Multiply quo by den and subtract from num to get remainder.
         // We have different code here to handle different compile-time
@@ -1341,7 +1486,18 @@ void mpz_mul_inpl(mpz_t *dest, const mpz_t *lhs, const mpz_t *rhs) {
 
     mpz_need_dig(dest, lhs->len + rhs->len); // min mem l+r-1, max mem l+r
     memset(dest->dig, 0, dest->alloc * sizeof(mpz_dig_t));
-    dest->len = mpn_mul(dest->dig, lhs->dig, lhs->len, rhs->dig, rhs->len);
+    #if MICROPY_OPT_MPZ_KARATSUBA
+    if (lhs->len >= KARATSUBA_THRESHOLD && rhs->len >= KARATSUBA_THRESHOLD) {
+        size_t scratch_len = mpn_karatsuba_scratch(lhs->len, rhs->len);
+        mpz_dig_t *scratch = m_new(mpz_dig_t, scratch_len);
+        mpn_mul_karatsuba(dest->dig, lhs->dig, lhs->len, rhs->dig, rhs->len, scratch);
+        m_del(mpz_dig_t, scratch, scratch_len);
+        dest->len = mpn_remove_trailing_zeros(dest->dig, dest->dig + lhs->len + rhs->len);
+    } else
+    #endif
+    {
+        dest->len = mpn_mul(dest->dig, lhs->dig, lhs->len, rhs->dig, rhs->len);
+    }
 
     if (lhs->neg == rhs->neg) {
         dest->neg = 0;
@@ -1386,20 +1542,211 @@ void mpz_pow_inpl(mpz_t *dest, const mpz_t *lhs, const mpz_t *rhs) {
     mpz_free(n);
 }
 
+#if MICROPY_OPT_MPZ_POW3
+
+// state for multiplying numbers modulo m during pow3
+typedef struct _mpz_modmul_t {
+    const mpz_t *mod;
+    mpz_dig_t minv; // -1/m mod DIG_BASE for Montgomery reduction, or 0 to divide
+    mpz_t prod;
+    mpz_t quo;
+} mpz_modmul_t;
+
+/* computes dest = lhs * rhs * R^-1 % m, with R = DIG_BASE ** m->len, if using
+   Montgomery reduction, else dest = lhs * rhs % m
+   assumes 0 <= lhs, rhs < m
+   can have dest, lhs, rhs the same
+*/
+STATIC void mpz_modmul(mpz_modmul_t *mm, mpz_t *dest, const mpz_t *lhs, const mpz_t *rhs) {
+    if (mm->minv == 0) {
+        mpz_mul_inpl(&mm->prod, lhs, rhs);
+        mpz_divmod_inpl(&mm->quo, dest, &mm->prod, mm->mod);
+        return;
+    }
+
+    if (lhs->len == 0 || rhs->len == 0) {
+        mpz_set_from_int(dest, 0);
+        return;
+    }
+
+    // the product fits in 2n digits, and adding multiples of m below needs
+    // one more; mpz_mul_inpl zeroes all of prod that it doesn't use
+    const mpz_t *mod = mm->mod;
+    size_t n = mod->len;
+    mpz_mul_inpl(&mm->prod, lhs, rhs);
+
+    // add multiples of m to clear the low n digits of the product, one digit
+    // at a time, so the quotient by R is exact
+    mpz_dig_t *td = mm->prod.dig;
+    for (size_t i = 0; i < n; ++i, ++td) {
+        mpz_dig_t u = ((mpz_dbl_dig_t)td[0] * mm->minv) & DIG_MASK;
+        mpz_dbl_dig_t carry = 0;
+        for (size_t j = 0; j < n; ++j) {
+            carry += (mpz_dbl_dig_t)td[j] + (mpz_dbl_dig_t)u * (mpz_dbl_dig_t)mod->dig[j]; // will never overflow so long as DIG_SIZE <= 8*sizeof(mpz_dbl_dig_t)/2
+            td[j] = carry & DIG_MASK;
+            carry >>= DIG_SIZE;
+        }
+        for (mpz_dig_t *d = td + n; carry != 0; ++d) {
+            carry += *d;
+            *d = carry & DIG_MASK;
+            carry >>= DIG_SIZE;
+        }
+    }
+
+    // the result is now in the high n + 1 digits, and is less than 2m
+    size_t len = mpn_remove_trailing_zeros(td, td + n + 1);
+    if (mpn_cmp(td, len, mod->dig, n) >= 0) {
+        len = mpn_sub(td, td, len, mod->dig, n);
+    }
+    mpz_need_dig(dest, len);
+    dest->neg = 0;
+    dest->len = len;
+    memcpy(dest->dig, td, len * sizeof(mpz_dig_t));
+}
+
+#define MPZ_POW3_MAX_WINDOW (5)
+
+/* computes dest = (lhs ** rhs) % mod with left-to-right sliding-window
+   exponentiation, for a positive mod
+   can have dest, lhs, rhs the same; mod can't be the same as dest
+*/
+STATIC void mpz_pow3_window(mpz_t *dest, const mpz_t *lhs, const mpz_t *rhs, const mpz_t *mod) {
+    mpz_modmul_t mm;
+    mm.mod = mod;
+    mm.minv = 0;
+    mpz_init_zero(&mm.prod);
+    mpz_init_zero(&mm.quo);
+
+    // table of the odd powers lhs, lhs^3, lhs^5, ... reduced modulo mod
+    mpz_t pow[1 << (MPZ_POW3_MAX_WINDOW - 1)];
+    mpz_init_zero(&pow[0]);
+    mpz_divmod_inpl(&mm.quo, &pow[0], lhs, mod);
+
+    if ((mod->dig[0] & 1) != 0) {
+        // compute 1/m mod DIG_BASE by Newton's iteration; an odd m is its own
+        // inverse modulo 8, and each step doubles the number of correct bits
+        mpz_dbl_dig_t inv = mod->dig[0];
+        for (int bits = 3; bits < DIG_SIZE; bits *= 2) {
+            inv = (inv * ((2 - (mpz_dbl_dig_t)mod->dig[0] * inv) & DIG_MASK)) & DIG_MASK;
+        }
+        mm.minv = (DIG_BASE - inv) & DIG_MASK;
+
+        // convert the base to Montgomery form, lhs * R % m
+        mpz_shl_inpl(&mm.prod, &pow[0], mod->len * DIG_SIZE);
+        mpz_divmod_inpl(&mm.quo, &pow[0], &mm.prod, mod);
+        mpz_need_dig(&mm.prod, 2 * mod->len + 1);
+    }
+
+    // choose the window size from the number of bits in the exponent
+    size_t nbits = (rhs->len - 1) * DIG_SIZE;
+    for (mpz_dig_t d = rhs->dig[rhs->len - 1]; d != 0; d >>= 1) {
+        ++nbits;
+    }
+    size_t window = nbits > 239 ? 5 : nbits > 79 ? 4 : nbits > 23 ? 3 : nbits > 7 ? 2 : 1;
+    if (window > MPZ_POW3_MAX_WINDOW) {
+        window = MPZ_POW3_MAX_WINDOW;
+    }
+
+    size_t npow = (size_t)1 << (window - 1);
+    if (npow > 1) {
+        mpz_t sq;
+        mpz_init_zero(&sq);
+        mpz_modmul(&mm, &sq, &pow[0], &pow[0]);
+        for (size_t i = 1; i < npow; ++i) {
+            mpz_init_zero(&pow[i]);
+            mpz_modmul(&mm, &pow[i], &pow[i - 1], &sq);
+        }
+        mpz_deinit(&sq);
+    }
+
+    #define EXP_BIT(i) ((rhs->dig[(i) / DIG_SIZE] >> ((i) % DIG_SIZE)) & 1)
+
+    // scan the exponent from the top, squaring for each bit and multiplying
+    // by a table entry for each window of up to "window" bits that starts and
+    // ends with a 1; the accumulator starts as the first window's power
+    mpz_t acc;
+    mpz_init_zero(&acc);
+    bool acc_set = false;
+    for (size_t i = nbits; i > 0;) {
+        if (EXP_BIT(i - 1) == 0) {
+            mpz_modmul(&mm, &acc, &acc, &acc);
+            --i;
+            continue;
+        }
+        size_t lo = i > window ? i - window : 0;
+        while (EXP_BIT(lo) == 0) {
+            ++lo;
+        }
+        size_t val = 0;
+        for (size_t b = i; b > lo; --b) {
+            val = val << 1 | EXP_BIT(b - 1);
+            if (acc_set) {
+                mpz_modmul(&mm, &acc, &acc, &acc);
+            }
+        }
+        if (acc_set) {
+            mpz_modmul(&mm, &acc, &acc, &pow[val >> 1]);
+        } else {
+            mpz_set(&acc, &pow[val >> 1]);
+            acc_set = true;
+        }
+        i = lo;
+    }
+
+    #undef EXP_BIT
+
+    if (mm.minv != 0) {
+        // convert back from Montgomery form
+        mpz_t one;
+        mpz_dig_t one_dig[MPZ_NUM_DIG_FOR_INT];
+        mpz_init_fixed_from_int(&one, one_dig, MPZ_NUM_DIG_FOR_INT, 1);
+        mpz_modmul(&mm, dest, &acc, &one);
+    } else {
+        mpz_set(dest, &acc);
+    }
+
+    mpz_deinit(&acc);
+    for (size_t i = 0; i < npow; ++i) {
+        mpz_deinit(&pow[i]);
+    }
+    mpz_deinit(&mm.quo);
+    mpz_deinit(&mm.prod);
+}
+
+#endif // MICROPY_OPT_MPZ_POW3
+
 /* computes dest = (lhs ** rhs) % mod
    can have dest, lhs, rhs the same; mod can't be the same as dest
 */
 void mpz_pow3_inpl(mpz_t *dest, const mpz_t *lhs, const mpz_t *rhs, const mpz_t *mod) {
-    if (lhs->len == 0 || rhs->neg != 0) {
+    if (rhs->neg != 0) {
         mpz_set_from_int(dest, 0);
         return;
     }
 
     if (rhs->len == 0) {
-        mpz_set_from_int(dest, 1);
+        // 1 % mod, which is 0 for a mod of 1 or -1
+        mpz_t one;
+        mpz_dig_t one_dig[MPZ_NUM_DIG_FOR_INT];
+        mpz_init_fixed_from_int(&one, one_dig, MPZ_NUM_DIG_FOR_INT, 1);
+        mpz_t quo; mpz_init_zero(&quo);
+        mpz_divmod_inpl(&quo, dest, &one, mod);
+        mpz_deinit(&quo);
         return;
     }
 
+    if (lhs->len == 0) {
+        mpz_set_from_int(dest, 0);
+        return;
+    }
+
+    #if MICROPY_OPT_MPZ_POW3
+    if (!mod->neg && mod->len > 0) {
+        mpz_pow3_window(dest, lhs, rhs, mod);
+        return;
+    }
+    #endif
+
     mpz_t *x = mpz_clone(lhs);
     mpz_t *n = mpz_clone(rhs);
     mpz_t quo; mpz_init_zero(&quo);
@@ -242,14 +242,10 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_1(dict_clear_obj, dict_clear);
 STATIC mp_obj_t dict_copy(mp_obj_t self_in) {
     mp_check_self(MP_OBJ_IS_DICT_TYPE(self_in));
     mp_obj_dict_t *self = MP_OBJ_TO_PTR(self_in);
-    mp_obj_t other_out = mp_obj_new_dict(self->map.alloc);
+    mp_obj_t other_out = mp_obj_new_dict(0);
     mp_obj_dict_t *other = MP_OBJ_TO_PTR(other_out);
     other->base.type = self->base.type;
-    other->map.used = self->map.used;
-    other->map.all_keys_are_qstrs = self->map.all_keys_are_qstrs;
-    other->map.is_fixed = 0;
-    other->map.is_ordered = self->map.is_ordered;
-    memcpy(other->map.table, self->map.table, self->map.alloc * sizeof(mp_map_elem_t));
+    mp_map_init_copy(&other->map, &self->map);
     return other_out;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(dict_copy_obj, dict_copy);
@@ -334,10 +330,9 @@ STATIC mp_obj_t dict_popitem(mp_obj_t self_in) {
     if (next == NULL) {
         mp_raise_msg(&mp_type_KeyError, "popitem(): dictionary is empty");
     }
-    self->map.used--;
     mp_obj_t items[] = {next->key, next->value};
-    next->key = MP_OBJ_SENTINEL; // must mark key as sentinel to indicate that it was deleted
-    next->value = MP_OBJ_NULL;
+    // removing through the map keeps the index of an ordered table up to date
+    mp_map_lookup(&self->map, next->key, MP_MAP_LOOKUP_REMOVE_IF_FOUND);
     mp_obj_t tuple = mp_obj_new_tuple(2, items);
 
     return tuple;
@@ -118,11 +118,17 @@ STATIC void float_print(const mp_print_t *print, mp_obj_t o_in, mp_print_kind_t
     #else
     const int precision = 7;
     #endif
+    const char fmt = 'g';
+#elif MICROPY_FLOAT_EXACT_CONV
+    char buf[32];
+    const char fmt = 'r';
+    const int precision = 0;
 #else
     char buf[32];
+    const char fmt = 'g';
     const int precision = 16;
 #endif
-    mp_format_float(o_val, buf, sizeof(buf), 'g', precision, '\0');
+    mp_format_float(o_val, buf, sizeof(buf), fmt, precision, '\0');
     mp_print_str(print, buf);
     if (strchr(buf, '.') == NULL && strchr(buf, 'e') == NULL && strchr(buf, 'n') == NULL) {
         // Python floats always have decimal point (unless inf or nan)
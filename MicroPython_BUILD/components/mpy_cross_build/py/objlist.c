@@ -32,6 +32,7 @@
 #include "py/runtime0.h"
 #include "py/runtime.h"
 #include "py/stackctrl.h"
+#include "py/gc.h"
 
 STATIC mp_obj_t mp_obj_new_list_iterator(mp_obj_t list, size_t cur, mp_obj_iter_buf_t *iter_buf);
 STATIC mp_obj_list_t *list_new(size_t n);
@@ -212,6 +213,7 @@ STATIC mp_obj_t list_subscr(mp_obj_t self_in, mp_obj_t index, mp_obj_t value) {
                     // be grown inplace or not
                     self->items = m_renew(mp_obj_t, self->items, self->alloc, self->len + len_adj);
                     self->alloc = self->len + len_adj;
+                    MP_GC_SET_PROTECTED(self->items);
                 }
                 mp_seq_replace_slice_grow_inplace(self->items, self->len,
                     slice_out.start, slice_out.stop, value_items, value_len, len_adj, sizeof(*self->items));
@@ -223,6 +225,7 @@ STATIC mp_obj_t list_subscr(mp_obj_t self_in, mp_obj_t index, mp_obj_t value) {
                 // TODO: apply allocation policy re: alloc_size
             }
             self->len += len_adj;
+            MP_GC_WRITE_BARRIER(self);
             return mp_const_none;
         }
 #endif
@@ -242,8 +245,10 @@ mp_obj_t mp_obj_list_append(mp_obj_t self_in, mp_obj_t arg) {
         self->items = m_renew(mp_obj_t, self->items, self->alloc, self->alloc * 2);
         self->alloc *= 2;
         mp_seq_clear(self->items, self->len + 1, self->alloc, sizeof(*self->items));
+        MP_GC_SET_PROTECTED(self->items);
     }
     self->items[self->len++] = arg;
+    MP_GC_WRITE_BARRIER(self);
     return mp_const_none; // return None, as per CPython
 }
 
@@ -258,10 +263,12 @@ STATIC mp_obj_t list_extend(mp_obj_t self_in, mp_obj_t arg_in) {
             self->items = m_renew(mp_obj_t, self->items, self->alloc, self->len + arg->len + 4);
             self->alloc = self->len + arg->len + 4;
             mp_seq_clear(self->items, self->len + arg->len, self->alloc, sizeof(*self->items));
+            MP_GC_SET_PROTECTED(self->items);
         }
 
         memcpy(self->items + self->len, arg->items, sizeof(mp_obj_t) * arg->len);
         self->len += arg->len;
+        MP_GC_WRITE_BARRIER(self);
     } else {
         list_extend_from_iter(self_in, arg_in);
     }
@@ -287,35 +294,282 @@ STATIC mp_obj_t list_pop(size_t n_args, const mp_obj_t *args) {
     return ret;
 }
 
-STATIC void mp_quicksort(mp_obj_t *head, mp_obj_t *tail, mp_obj_t key_fn, mp_obj_t binop_less_result) {
-    MP_STACK_CHECK();
-    while (head < tail) {
-        mp_obj_t *h = head - 1;
-        mp_obj_t *t = tail;
-        mp_obj_t v = key_fn == MP_OBJ_NULL ? tail[0] : mp_call_function_1(key_fn, tail[0]); // get pivot using key_fn
-        for (;;) {
-            do ++h; while (h < t && mp_binary_op(MP_BINARY_OP_LESS, key_fn == MP_OBJ_NULL ? h[0] : mp_call_function_1(key_fn, h[0]), v) == binop_less_result);
-            do --t; while (h < t && mp_binary_op(MP_BINARY_OP_LESS, v, key_fn == MP_OBJ_NULL ? t[0] : mp_call_function_1(key_fn, t[0])) == binop_less_result);
-            if (h >= t) break;
-            mp_obj_t x = h[0];
-            h[0] = t[0];
-            t[0] = x;
+// Stable adaptive merge sort, after CPython's Timsort.  It finds the runs
+// that are already in order (reversing descending ones), extends short runs
+// with a binary insertion sort, and merges them pairwise, keeping the run
+// lengths balanced.  An element is 1 object, or with a key function 2 (the
+// key then the item) so that the key is computed once per element.  Merges
+// set the shorter run aside in a buffer on the heap.
+
+// Enough for any number of elements that fits in memory
+#define SORT_MAX_RUNS (10 * sizeof(size_t) + 2)
+
+typedef struct _sort_run_t {
+    mp_obj_t *base;
+    size_t len;
+} sort_run_t;
+
+typedef struct _sort_t {
+    size_t width; // objects per element
+    mp_obj_t *tmp;
+    size_t tmp_alloc; // in elements
+    // while merging, the objects from tmp_lo to tmp_hi belong at dest
+    mp_obj_t *dest;
+    mp_obj_t *tmp_lo;
+    mp_obj_t *tmp_hi;
+    size_t n_runs;
+    sort_run_t runs[SORT_MAX_RUNS];
+} sort_t;
+
+STATIC bool sort_less(const mp_obj_t *a, const mp_obj_t *b) {
+    if (MP_OBJ_IS_SMALL_INT(a[0]) && MP_OBJ_IS_SMALL_INT(b[0])) {
+        return MP_OBJ_SMALL_INT_VALUE(a[0]) < MP_OBJ_SMALL_INT_VALUE(b[0]);
+    }
+    return mp_obj_is_true(mp_binary_op(MP_BINARY_OP_LESS, a[0], b[0]));
+}
+
+static inline void sort_copy(mp_obj_t *dest, const mp_obj_t *src, size_t width) {
+    dest[0] = src[0];
+    if (width == 2) {
+        dest[1] = src[1];
+    }
+}
+
+STATIC void sort_reverse(mp_obj_t *lo, mp_obj_t *hi, size_t width) {
+    mp_obj_t x[2];
+    for (hi -= width; lo < hi; lo += width, hi -= width) {
+        sort_copy(x, lo, width);
+        sort_copy(lo, hi, width);
+        sort_copy(hi, x, width);
+    }
+}
+
+// Return the length of the run starting at lo, after putting it in order
+STATIC size_t sort_count_run(sort_t *s, mp_obj_t *lo, mp_obj_t *hi) {
+    size_t w = s->width;
+    mp_obj_t *p = lo + w;
+    if (p == hi) {
+        return 1;
+    }
+    if (sort_less(p, lo)) {
+        // only a strictly descending run can be reversed without losing stability
+        for (p += w; p < hi && sort_less(p, p - w); p += w) {
+        }
+        sort_reverse(lo, p, w);
+    } else {
+        for (p += w; p < hi && !sort_less(p, p - w); p += w) {
+        }
+    }
+    return (p - lo) / w;
+}
+
+// Sort lo..hi, of which lo..start is already sorted
+STATIC void sort_binary_insertion(sort_t *s, mp_obj_t *lo, mp_obj_t *hi, mp_obj_t *start) {
+    size_t w = s->width;
+    for (; start < hi; start += w) {
+        // insert after the elements equal to it, to keep the sort stable
+        mp_obj_t *l = lo;
+        mp_obj_t *r = start;
+        while (l < r) {
+            mp_obj_t *m = l + (r - l) / w / 2 * w;
+            if (sort_less(start, m)) {
+                r = m;
+            } else {
+                l = m + w;
+            }
         }
-        mp_obj_t x = h[0];
-        h[0] = tail[0];
-        tail[0] = x;
-        // do the smaller recursive call first, to keep stack within O(log(N))
-        if (t - head < tail - h - 1) {
-            mp_quicksort(head, t, key_fn, binop_less_result);
-            head = h + 1;
+        mp_obj_t x[2];
+        sort_copy(x, start, w);
+        memmove(l + w, l, (start - l) * sizeof(mp_obj_t));
+        sort_copy(l, x, w);
+    }
+}
+
+// Return the number of elements of the run at base that are less than key,
+// or if or_equal is set, not greater than key
+STATIC size_t sort_search(const mp_obj_t *key, const mp_obj_t *base, size_t len, size_t width, bool or_equal) {
+    size_t l = 0;
+    while (len > 0) {
+        size_t half = len / 2;
+        const mp_obj_t *m = base + (l + half) * width;
+        if (or_equal ? !sort_less(key, m) : sort_less(m, key)) {
+            l += half + 1;
+            len -= half + 1;
+        } else {
+            len = half;
+        }
+    }
+    return l;
+}
+
+STATIC mp_obj_t *sort_get_tmp(sort_t *s, size_t n) {
+    if (n > s->tmp_alloc) {
+        m_del(mp_obj_t, s->tmp, s->tmp_alloc * s->width);
+        s->tmp = NULL;
+        s->tmp_alloc = 0;
+        s->tmp = m_new(mp_obj_t, n * s->width);
+        s->tmp_alloc = n;
+    }
+    return s->tmp;
+}
+
+// Merge the runs a and b, which follow each other, where a is the shorter
+STATIC void sort_merge_lo(sort_t *s, mp_obj_t *a, size_t na, mp_obj_t *b, size_t nb) {
+    size_t w = s->width;
+    mp_obj_t *b_end = b + nb * w;
+    mp_obj_t *tmp = sort_get_tmp(s, na);
+    memcpy(tmp, a, na * w * sizeof(mp_obj_t));
+    s->dest = a;
+    s->tmp_lo = tmp;
+    s->tmp_hi = tmp + na * w;
+    while (s->tmp_lo < s->tmp_hi && b < b_end) {
+        if (sort_less(b, s->tmp_lo)) {
+            sort_copy(s->dest, b, w);
+            b += w;
+        } else {
+            sort_copy(s->dest, s->tmp_lo, w);
+            s->tmp_lo += w;
+        }
+        s->dest += w;
+    }
+    // what is left of b is already in place
+    memcpy(s->dest, s->tmp_lo, (s->tmp_hi - s->tmp_lo) * sizeof(mp_obj_t));
+    s->tmp_lo = s->tmp_hi;
+}
+
+// Merge the runs a and b, which follow each other, where b is the shorter
+STATIC void sort_merge_hi(sort_t *s, mp_obj_t *a, size_t na, mp_obj_t *b, size_t nb) {
+    size_t w = s->width;
+    mp_obj_t *dest = b + nb * w;
+    mp_obj_t *tmp = sort_get_tmp(s, nb);
+    memcpy(tmp, b, nb * w * sizeof(mp_obj_t));
+    s->dest = a + na * w; // the end of what is left of a
+    s->tmp_lo = tmp;
+    s->tmp_hi = tmp + nb * w;
+    while (s->dest > a && s->tmp_hi > s->tmp_lo) {
+        dest -= w;
+        if (sort_less(s->tmp_hi - w, s->dest - w)) {
+            s->dest -= w;
+            sort_copy(dest, s->dest, w);
         } else {
-            mp_quicksort(h + 1, tail, key_fn, binop_less_result);
-            tail = t;
+            s->tmp_hi -= w;
+            sort_copy(dest, s->tmp_hi, w);
         }
     }
+    // what is left of a is already in place
+    memcpy(s->dest, s->tmp_lo, (s->tmp_hi - s->tmp_lo) * sizeof(mp_obj_t));
+    s->tmp_lo = s->tmp_hi;
+}
+
+// Merge runs i and i + 1
+STATIC void sort_merge_at(sort_t *s, size_t i) {
+    size_t w = s->width;
+    mp_obj_t *a = s->runs[i].base;
+    size_t na = s->runs[i].len;
+    mp_obj_t *b = s->runs[i + 1].base;
+    size_t nb = s->runs[i + 1].len;
+    s->runs[i].len = na + nb;
+    if (i + 3 == s->n_runs) {
+        s->runs[i + 1] = s->runs[i + 2];
+    }
+    s->n_runs -= 1;
+
+    // the elements of a before the first of b, and the elements of b after
+    // the last of a, are already in place
+    size_t k = sort_search(b, a, na, w, true);
+    a += k * w;
+    na -= k;
+    if (na == 0) {
+        return;
+    }
+    nb = sort_search(a + (na - 1) * w, b, nb, w, false);
+    if (nb == 0) {
+        return;
+    }
+    if (na <= nb) {
+        sort_merge_lo(s, a, na, b, nb);
+    } else {
+        sort_merge_hi(s, a, na, b, nb);
+    }
+}
+
+// Merge runs until the lengths of the last three decrease faster than the
+// Fibonacci numbers, which keeps merges balanced and the stack of runs short
+STATIC void sort_merge_collapse(sort_t *s) {
+    sort_run_t *r = s->runs;
+    while (s->n_runs > 1) {
+        size_t n = s->n_runs - 2;
+        if ((n > 0 && r[n - 1].len <= r[n].len + r[n + 1].len)
+            || (n > 1 && r[n - 2].len <= r[n - 1].len + r[n].len)) {
+            if (r[n - 1].len < r[n + 1].len) {
+                n--;
+            }
+        } else if (r[n].len > r[n + 1].len) {
+            break;
+        }
+        sort_merge_at(s, n);
+    }
+}
+
+STATIC void sort_run(sort_t *s, mp_obj_t *lo, size_t n) {
+    size_t w = s->width;
+
+    // runs shorter than min_run are extended, where min_run is chosen so
+    // that n / min_run is a power of 2 or just below one
+    size_t min_run = n;
+    size_t r = 0;
+    while (min_run >= 32) {
+        r |= min_run & 1;
+        min_run >>= 1;
+    }
+    min_run += r;
+
+    mp_obj_t *hi = lo + n * w;
+    while (lo < hi) {
+        size_t len = sort_count_run(s, lo, hi);
+        if (len < min_run) {
+            size_t left = (hi - lo) / w;
+            size_t force = min_run < left ? min_run : left;
+            sort_binary_insertion(s, lo, lo + force * w, lo + len * w);
+            len = force;
+        }
+        assert(s->n_runs < SORT_MAX_RUNS);
+        s->runs[s->n_runs].base = lo;
+        s->runs[s->n_runs].len = len;
+        s->n_runs += 1;
+        sort_merge_collapse(s);
+        lo += len * w;
+    }
+
+    while (s->n_runs > 1) {
+        size_t k = s->n_runs - 2;
+        if (k > 0 && s->runs[k - 1].len < s->runs[k + 1].len) {
+            k--;
+        }
+        sort_merge_at(s, k);
+    }
+}
+
+STATIC void mp_sort(mp_obj_t *elems, size_t n, size_t width) {
+    sort_t s;
+    s.width = width;
+    s.tmp = NULL;
+    s.tmp_alloc = 0;
+    s.dest = s.tmp_lo = s.tmp_hi = NULL;
+    s.n_runs = 0;
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        sort_run(&s, elems, n);
+        nlr_pop();
+    } else {
+        // a comparison raised, so put back the elements set aside for a
+        // merge, leaving all the elements in the list in some order
+        memcpy(s.dest, s.tmp_lo, (s.tmp_hi - s.tmp_lo) * sizeof(mp_obj_t));
+        nlr_jump(nlr.ret_val);
+    }
+    m_del(mp_obj_t, s.tmp, s.tmp_alloc * width);
 }
 
-// TODO Python defines sort to be stable but ours is not
 mp_obj_t mp_obj_list_sort(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
     static const mp_arg_t allowed_args[] = {
         { MP_QSTR_key, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
@@ -332,10 +586,39 @@ mp_obj_t mp_obj_list_sort(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_
     mp_check_self(MP_OBJ_IS_TYPE(pos_args[0], &mp_type_list));
     mp_obj_list_t *self = MP_OBJ_TO_PTR(pos_args[0]);
 
-    if (self->len > 1) {
-        mp_quicksort(self->items, self->items + self->len - 1,
-                     args.key.u_obj == mp_const_none ? MP_OBJ_NULL : args.key.u_obj,
-                     args.reverse.u_bool ? mp_const_false : mp_const_true);
+    size_t n = self->len;
+    if (n > 1) {
+        mp_obj_t *elems = self->items;
+        size_t width = 1;
+        if (args.key.u_obj != mp_const_none) {
+            // sort (key, item) pairs, calling the key function once per item
+            width = 2;
+            elems = m_new(mp_obj_t, 2 * n);
+            for (size_t i = 0; i < n; i++) {
+                elems[2 * i] = mp_call_function_1(args.key.u_obj, self->items[i]);
+                elems[2 * i + 1] = self->items[i];
+            }
+        }
+
+        // a reverse sort is stable if it sorts the reversed list
+        if (args.reverse.u_bool) {
+            sort_reverse(elems, elems + n * width, width);
+        }
+        mp_sort(elems, n, width);
+        if (args.reverse.u_bool) {
+            sort_reverse(elems, elems + n * width, width);
+        }
+
+        if (width == 2) {
+            if (self->len != n) {
+                mp_raise_ValueError("list modified during sort");
+            }
+            for (size_t i = 0; i < n; i++) {
+                self->items[i] = elems[2 * i + 1];
+            }
+            m_del(mp_obj_t, elems, 2 * n);
+        }
+        MP_GC_WRITE_BARRIER(self);
     }
 
     return mp_const_none;
@@ -390,6 +673,7 @@ STATIC mp_obj_t list_insert(mp_obj_t self_in, mp_obj_t idx, mp_obj_t obj) {
          self->items[i] = self->items[i-1];
     }
     self->items[index] = obj;
+    MP_GC_WRITE_BARRIER(self);
 
     return mp_const_none;
 }
@@ -463,6 +747,7 @@ void mp_obj_list_init(mp_obj_list_t *o, size_t n) {
     o->len = n;
     o->items = m_new(mp_obj_t, o->alloc);
     mp_seq_clear(o->items, n, o->alloc, sizeof(*o->items));
+    MP_GC_SET_PROTECTED(o->items);
 }
 
 STATIC mp_obj_list_t *list_new(size_t n) {
@@ -498,6 +783,7 @@ void mp_obj_list_store(mp_obj_t self_in, mp_obj_t index, mp_obj_t value) {
     mp_obj_list_t *self = MP_OBJ_TO_PTR(self_in);
     size_t i = mp_get_index(self->base.type, self->len, index, false);
     self->items[i] = value;
+    MP_GC_WRITE_BARRIER(self);
 }
 
 /******************************************************************************/
@@ -35,6 +35,7 @@
 #include "py/runtime0.h"
 #include "py/runtime.h"
 #include "py/stackctrl.h"
+#include "py/gc.h"
 
 STATIC mp_obj_t str_modulo_format(mp_obj_t pattern, size_t n_args, const mp_obj_t *args, mp_obj_t dict);
 
@@ -157,6 +158,12 @@ mp_obj_t mp_obj_str_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_
             // TODO: validate 2nd/3rd args
             if (MP_OBJ_IS_TYPE(args[0], &mp_type_bytes)) {
                 GET_STR_DATA_LEN(args[0], str_data, str_len);
+                #if MICROPY_OPT_BYTES_SLICE_VIEW
+                if (mp_obj_bytes_get_view_buf(args[0]) != NULL) {
+                    // a str can't keep the buffer of a view alive
+                    return mp_obj_new_str((const char*)str_data, str_len, false);
+                }
+                #endif
                 GET_STR_HASH(args[0], str_hash);
                 if (str_hash == 0) {
                     str_hash = qstr_compute_hash(str_data, str_len);
@@ -277,6 +284,75 @@ const byte *find_subbytes(const byte *haystack, size_t hlen, const byte *needle,
     return NULL;
 }
 
+#if (MICROPY_OPT_STR_APPEND || MICROPY_OPT_BYTES_SLICE_VIEW) && MICROPY_QSTR_BYTES_IN_HASH >= 4
+#error "MICROPY_OPT_STR_APPEND and MICROPY_OPT_BYTES_SLICE_VIEW need spare bits in the str hash"
+#endif
+
+#if MICROPY_OPT_STR_APPEND
+
+// The data of a str/bytes made by `+=` is given room to grow: its hash field
+// holds MP_OBJ_STR_HASH_APPENDABLE and the size of the room, alloc, and the
+// word after the room holds the length of the longest str sharing the buffer.
+// Only that str may append in place; the shorter ones are prefixes of it and
+// are left as they are, except that their terminating null byte is
+// overwritten.  The data has to stay at the start of its GC block, and the
+// buffer is never resized, so that alloc stays valid for all of them.
+#define STR_APPEND_USED(data, alloc) (*(size_t*)((byte*)(data) + (alloc)))
+
+// Returns lhs + rhs, appending rhs to the buffer of lhs when it can, or
+// MP_OBJ_NULL if the caller should make an exact copy instead.
+STATIC mp_obj_t str_append(const mp_obj_type_t *type, mp_obj_t lhs_in, const byte *lhs_data, size_t lhs_len,
+    const byte *rhs_data, size_t rhs_len, bool inplace) {
+    byte *buf = NULL;
+    size_t alloc = 0;
+    bool grow = inplace;
+    if (!MP_OBJ_IS_QSTR(lhs_in)) {
+        mp_uint_t hash = ((mp_obj_str_t*)MP_OBJ_TO_PTR(lhs_in))->hash;
+        if (hash & MP_OBJ_STR_HASH_APPENDABLE) {
+            // keep growing, even for `s = s + t`
+            grow = true;
+            alloc = hash & ~MP_OBJ_STR_HASH_APPENDABLE;
+            if (STR_APPEND_USED(lhs_data, alloc) == lhs_len) {
+                buf = (byte*)lhs_data;
+            }
+        }
+    }
+    if (!grow) {
+        // `a + b` doesn't leave spare room unless it extends such a buffer
+        return MP_OBJ_NULL;
+    }
+
+    size_t len = lhs_len + rhs_len;
+    if (buf == NULL || len >= alloc) {
+        // a new buffer, with room for the null byte and the used word after it
+        alloc = (len + len / 2 + sizeof(size_t)) & ~(sizeof(size_t) - 1);
+        if (alloc & MP_OBJ_STR_HASH_FLAGS) {
+            return MP_OBJ_NULL;
+        }
+        buf = NULL;
+    }
+
+    // allocate the str first, so the buffer isn't changed if that fails
+    mp_obj_str_t *o = m_new_obj(mp_obj_str_t);
+    if (buf == NULL) {
+        buf = m_new(byte, alloc + sizeof(size_t));
+        memcpy(buf, lhs_data, lhs_len);
+        MP_GC_SET_PROTECTED(buf);
+    }
+    // rhs may be in the buffer too (s += s), but it doesn't reach past used
+    memcpy(buf + lhs_len, rhs_data, rhs_len);
+    buf[len] = '\0';
+    STR_APPEND_USED(buf, alloc) = len;
+
+    o->base.type = type;
+    o->hash = MP_OBJ_STR_HASH_APPENDABLE | alloc;
+    o->len = len;
+    o->data = buf;
+    return MP_OBJ_FROM_PTR(o);
+}
+
+#endif
+
 // Note: this function is used to check if an object is a str or bytes, which
 // works because both those types use it as their binary_op method.  Revisit
 // MP_OBJ_IS_STR_OR_BYTES if this fact changes.
@@ -362,6 +438,14 @@ mp_obj_t mp_obj_str_binary_op(mp_binary_op_t op, mp_obj_t lhs_in, mp_obj_t rhs_i
                 return lhs_in;
             }
 
+            #if MICROPY_OPT_STR_APPEND
+            mp_obj_t res = str_append(lhs_type, lhs_in, lhs_data, lhs_len, rhs_data, rhs_len,
+                op == MP_BINARY_OP_INPLACE_ADD);
+            if (res != MP_OBJ_NULL) {
+                return res;
+            }
+            #endif
+
             vstr_t vstr;
             vstr_init_len(&vstr, lhs_len + rhs_len);
             memcpy(vstr.buf, lhs_data, lhs_len);
@@ -395,6 +479,43 @@ const byte *str_index_to_ptr(const mp_obj_type_t *type, const byte *self_data, s
 }
 #endif
 
+#if MICROPY_OPT_BYTES_SLICE_VIEW
+
+// A slice of a bytes object which shares its data.  The data may start
+// anywhere in the buffer, but only a pointer to the start of a GC block keeps
+// the block alive, so the view holds one to the start of the buffer as well.
+typedef struct _mp_obj_bytes_view_t {
+    mp_obj_str_t str;
+    const byte *buf;
+} mp_obj_bytes_view_t;
+
+STATIC mp_obj_t bytes_new_view(mp_obj_t self_in, const byte *data, size_t len) {
+    mp_obj_str_t *self = MP_OBJ_TO_PTR(self_in);
+    const byte *buf = mp_obj_bytes_get_view_buf(self_in);
+    if (buf == NULL) {
+        buf = self->data;
+    }
+    mp_obj_bytes_view_t *o = m_new_obj(mp_obj_bytes_view_t);
+    o->str.base.type = &mp_type_bytes;
+    o->str.hash = MP_OBJ_STR_HASH_VIEW;
+    o->str.len = len;
+    o->str.data = data;
+    o->buf = buf;
+    return MP_OBJ_FROM_PTR(o);
+}
+
+// Returns the start of the buffer that the data of a view is in, or NULL if
+// self_in isn't a view.
+const byte *mp_obj_bytes_get_view_buf(mp_obj_t self_in) {
+    mp_obj_str_t *self = MP_OBJ_TO_PTR(self_in);
+    if (self->hash & MP_OBJ_STR_HASH_VIEW) {
+        return ((mp_obj_bytes_view_t*)self)->buf;
+    }
+    return NULL;
+}
+
+#endif
+
 // This is used for both bytes and 8-bit strings. This is not used for unicode strings.
 STATIC mp_obj_t bytes_subscr(mp_obj_t self_in, mp_obj_t index, mp_obj_t value) {
     mp_obj_type_t *type = mp_obj_get_type(self_in);
@@ -407,6 +528,11 @@ STATIC mp_obj_t bytes_subscr(mp_obj_t self_in, mp_obj_t index, mp_obj_t value) {
             if (!mp_seq_get_fast_slice_indexes(self_len, index, &slice)) {
                 mp_raise_NotImplementedError("only slices with step=1 (aka None) are supported");
             }
+            #if MICROPY_OPT_BYTES_SLICE_VIEW
+            if (type == &mp_type_bytes && slice.stop - slice.start >= MICROPY_BYTES_SLICE_VIEW_MIN) {
+                return bytes_new_view(self_in, self_data + slice.start, slice.stop - slice.start);
+            }
+            #endif
             return mp_obj_new_str_of_type(type, self_data + slice.start, slice.stop - slice.start);
         }
 #endif
@@ -913,6 +1039,308 @@ STATIC NORETURN void terse_str_format_value_error(void) {
 #define terse_str_format_value_error()
 #endif
 
+// A parsed format specifier, see str_format_parse_spec().  fill and align are
+// '\0' when not given.
+typedef struct _str_format_spec_t {
+    char fill;
+    char align;
+    char type;
+    int flags;
+    int width;
+    int precision;
+} str_format_spec_t;
+
+// Parses the format specifier from s to top, returning false if it's invalid.
+STATIC bool str_format_parse_spec(const char *s, const char *top, str_format_spec_t *spec) {
+    // The format specifier (from http://docs.python.org/2/library/string.html#formatspec)
+    //
+    // [[fill]align][sign][#][0][width][,][.precision][type]
+    // fill        ::=  <any character>
+    // align       ::=  "<" | ">" | "=" | "^"
+    // sign        ::=  "+" | "-" | " "
+    // width       ::=  integer
+    // precision   ::=  integer
+    // type        ::=  "b" | "c" | "d" | "e" | "E" | "f" | "F" | "g" | "G" | "n" | "o" | "s" | "x" | "X" | "%"
+
+    spec->fill = '\0';
+    spec->align = '\0';
+    spec->type = '\0';
+    spec->flags = 0;
+    spec->width = -1;
+    spec->precision = -1;
+
+    if (s < top && isalignment(*s)) {
+        spec->align = *s++;
+    } else if (top - s >= 2 && isalignment(s[1])) {
+        spec->fill = *s++;
+        spec->align = *s++;
+    }
+    if (s < top && (*s == '+' || *s == '-' || *s == ' ')) {
+        if (*s == '+') {
+            spec->flags |= PF_FLAG_SHOW_SIGN;
+        } else if (*s == ' ') {
+            spec->flags |= PF_FLAG_SPACE_SIGN;
+        }
+        s++;
+    }
+    if (s < top && *s == '#') {
+        spec->flags |= PF_FLAG_SHOW_PREFIX;
+        s++;
+    }
+    if (s < top && *s == '0') {
+        if (!spec->align) {
+            spec->align = '=';
+        }
+        if (!spec->fill) {
+            spec->fill = '0';
+        }
+    }
+    s = str_to_int(s, top, &spec->width);
+    if (s < top && *s == ',') {
+        spec->flags |= PF_FLAG_SHOW_COMMA;
+        s++;
+    }
+    if (s < top && *s == '.') {
+        s++;
+        s = str_to_int(s, top, &spec->precision);
+    }
+    if (s < top && istype(*s)) {
+        spec->type = *s++;
+    }
+    return s == top;
+}
+
+// Formats one replacement field into print.  spec is NULL if the field has no
+// format specifier, and conversion is '\0' if it has no conversion.
+STATIC void str_format_field(const mp_print_t *print, mp_obj_t arg, char conversion, const str_format_spec_t *spec) {
+    if (!spec && !conversion) {
+        conversion = 's';
+    }
+    if (conversion) {
+        mp_print_kind_t print_kind;
+        if (conversion == 's') {
+            print_kind = PRINT_STR;
+        } else {
+            assert(conversion == 'r');
+            print_kind = PRINT_REPR;
+        }
+        if (!spec) {
+            // nothing to pad or truncate, so print straight into the result
+            mp_obj_print_helper(print, arg, print_kind);
+            return;
+        }
+        vstr_t arg_vstr;
+        mp_print_t arg_print;
+        vstr_init_print(&arg_vstr, 16, &arg_print);
+        mp_obj_print_helper(&arg_print, arg, print_kind);
+        arg = mp_obj_new_str_from_vstr(&mp_type_str, &arg_vstr);
+    }
+
+    char fill = spec->fill;
+    char align = spec->align;
+    int width = spec->width;
+    int precision = spec->precision;
+    char type = spec->type;
+    int flags = spec->flags;
+
+    if (!align) {
+        if (arg_looks_numeric(arg)) {
+            align = '>';
+        } else {
+            align = '<';
+        }
+    }
+    if (!fill) {
+        fill = ' ';
+    }
+
+    if (flags & (PF_FLAG_SHOW_SIGN | PF_FLAG_SPACE_SIGN)) {
+        if (type == 's') {
+            if (MICROPY_ERROR_REPORTING == MICROPY_ERROR_REPORTING_TERSE) {
+                terse_str_format_value_error();
+            } else {
+                mp_raise_ValueError("sign not allowed in string format specifier");
+            }
+        }
+        if (type == 'c') {
+            if (MICROPY_ERROR_REPORTING == MICROPY_ERROR_REPORTING_TERSE) {
+                terse_str_format_value_error();
+            } else {
+                mp_raise_ValueError(
+                    "sign not allowed with integer format specifier 'c'");
+            }
+        }
+    }
+
+    switch (align) {
+        case '<': flags |= PF_FLAG_LEFT_ADJUST;     break;
+        case '=': flags |= PF_FLAG_PAD_AFTER_SIGN;  break;
+        case '^': flags |= PF_FLAG_CENTER_ADJUST;   break;
+    }
+
+    if (arg_looks_integer(arg)) {
+        switch (type) {
+            case 'b':
+                mp_print_mp_int(print, arg, 2, 'a', flags, fill, width, 0);
+                return;
+
+            case 'c':
+            {
+                char ch = mp_obj_get_int(arg);
+                mp_print_strn(print, &ch, 1, flags, fill, width);
+                return;
+            }
+
+            case '\0':  // No explicit format type implies 'd'
+            case 'n':   // I don't think we support locales in uPy so use 'd'
+            case 'd':
+                mp_print_mp_int(print, arg, 10, 'a', flags, fill, width, 0);
+                return;
+
+            case 'o':
+                if (flags & PF_FLAG_SHOW_PREFIX) {
+                    flags |= PF_FLAG_SHOW_OCTAL_LETTER;
+                }
+
+                mp_print_mp_int(print, arg, 8, 'a', flags, fill, width, 0);
+                return;
+
+            case 'X':
+            case 'x':
+                mp_print_mp_int(print, arg, 16, type - ('X' - 'A'), flags, fill, width, 0);
+                return;
+
+            case 'e':
+            case 'E':
+            case 'f':
+            case 'F':
+            case 'g':
+            case 'G':
+            case '%':
+                // The floating point formatters all work with anything that
+                // looks like an integer
+                break;
+
+            default:
+                if (MICROPY_ERROR_REPORTING == MICROPY_ERROR_REPORTING_TERSE) {
+                    terse_str_format_value_error();
+                } else {
+                    nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError,
+                        "unknown format code '%c' for object of type '%s'",
+                        type, mp_obj_get_type_str(arg)));
+                }
+        }
+    }
+
+    // NOTE: no else here. We need the e, f, g etc formats for integer
+    //       arguments (from above if) to take this if.
+    if (arg_looks_numeric(arg)) {
+        if (!type) {
+
+            // Even though the docs say that an unspecified type is the same
+            // as 'g', there is one subtle difference, when the exponent
+            // is one less than the precision.
+            //
+            // '{:10.1}'.format(0.0) ==> '0e+00'
+            // '{:10.1g}'.format(0.0) ==> '0'
+            //
+            // TODO: Figure out how to deal with this.
+            //
+            // A proper solution would involve adding a special flag
+            // or something to format_float, and create a format_double
+            // to deal with doubles. In order to fix this when using
+            // sprintf, we'd need to use the e format and tweak the
+            // returned result to strip trailing zeros like the g format
+            // does.
+            //
+            // {:10.3} and {:10.2e} with 1.23e2 both produce 1.23e+02
+            // but with 1.e2 you get 1e+02 and 1.00e+02
+            //
+            // Stripping the trailing 0's (like g) does would make the
+            // e format give us the right format.
+            //
+            // CPython sources say:
+            //   Omitted type specifier.  Behaves in the same way as repr(x)
+            //   and str(x) if no precision is given, else like 'g', but with
+            //   at least one digit after the decimal point. */
+
+            type = 'g';
+        }
+        if (type == 'n') {
+            type = 'g';
+        }
+
+        switch (type) {
+#if MICROPY_PY_BUILTINS_FLOAT
+            case 'e':
+            case 'E':
+            case 'f':
+            case 'F':
+            case 'g':
+            case 'G':
+                mp_print_float(print, mp_obj_get_float(arg), type, flags, fill, width, precision);
+                break;
+
+            case '%':
+                flags |= PF_FLAG_ADD_PERCENT;
+                #if MICROPY_FLOAT_IMPL == MICROPY_FLOAT_IMPL_FLOAT
+                #define F100 100.0F
+                #else
+                #define F100 100.0
+                #endif
+                mp_print_float(print, mp_obj_get_float(arg) * F100, 'f', flags, fill, width, precision);
+                #undef F100
+                break;
+#endif
+
+            default:
+                if (MICROPY_ERROR_REPORTING == MICROPY_ERROR_REPORTING_TERSE) {
+                    terse_str_format_value_error();
+                } else {
+                    nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError,
+                        "unknown format code '%c' for object of type 'float'",
+                        type, mp_obj_get_type_str(arg)));
+                }
+        }
+    } else {
+        // arg doesn't look like a number
+
+        if (align == '=') {
+            if (MICROPY_ERROR_REPORTING == MICROPY_ERROR_REPORTING_TERSE) {
+                terse_str_format_value_error();
+            } else {
+                mp_raise_ValueError(
+                    "'=' alignment not allowed in string format specifier");
+            }
+        }
+
+        switch (type) {
+            case '\0': // no explicit format type implies 's'
+            case 's': {
+                size_t slen;
+                const char *s = mp_obj_str_get_data(arg, &slen);
+                if (precision < 0) {
+                    precision = slen;
+                }
+                if (slen > (size_t)precision) {
+                    slen = precision;
+                }
+                mp_print_strn(print, s, slen, flags, fill, width);
+                break;
+            }
+
+            default:
+                if (MICROPY_ERROR_REPORTING == MICROPY_ERROR_REPORTING_TERSE) {
+                    terse_str_format_value_error();
+                } else {
+                    nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError,
+                        "unknown format code '%c' for object of type 'str'",
+                        type, mp_obj_get_type_str(arg)));
+                }
+        }
+    }
+}
+
 STATIC vstr_t mp_obj_str_format_helper(const char *str, const char *top, int *arg_i, size_t n_args, const mp_obj_t *args, mp_map_t *kwargs) {
     vstr_t vstr;
     mp_print_t print;
@@ -1064,298 +1492,211 @@ STATIC vstr_t mp_obj_str_format_helper(const char *str, const char *top, int *ar
             arg = args[(*arg_i) + 1];
             (*arg_i)++;
         }
-        if (!format_spec && !conversion) {
-            conversion = 's';
-        }
-        if (conversion) {
-            mp_print_kind_t print_kind;
-            if (conversion == 's') {
-                print_kind = PRINT_STR;
-            } else {
-                assert(conversion == 'r');
-                print_kind = PRINT_REPR;
-            }
-            vstr_t arg_vstr;
-            mp_print_t arg_print;
-            vstr_init_print(&arg_vstr, 16, &arg_print);
-            mp_obj_print_helper(&arg_print, arg, print_kind);
-            arg = mp_obj_new_str_from_vstr(&mp_type_str, &arg_vstr);
-        }
-
-        char fill = '\0';
-        char align = '\0';
-        int width = -1;
-        int precision = -1;
-        char type = '\0';
-        int flags = 0;
-
         if (format_spec) {
-            // The format specifier (from http://docs.python.org/2/library/string.html#formatspec)
-            //
-            // [[fill]align][sign][#][0][width][,][.precision][type]
-            // fill        ::=  <any character>
-            // align       ::=  "<" | ">" | "=" | "^"
-            // sign        ::=  "+" | "-" | " "
-            // width       ::=  integer
-            // precision   ::=  integer
-            // type        ::=  "b" | "c" | "d" | "e" | "E" | "f" | "F" | "g" | "G" | "n" | "o" | "s" | "x" | "X" | "%"
-
-            // recursively call the formatter to format any nested specifiers
-            MP_STACK_CHECK();
-            vstr_t format_spec_vstr = mp_obj_str_format_helper(format_spec, str, arg_i, n_args, args, kwargs);
-            const char *s = vstr_null_terminated_str(&format_spec_vstr);
-            const char *stop = s + format_spec_vstr.len;
-            if (isalignment(*s)) {
-                align = *s++;
-            } else if (*s && isalignment(s[1])) {
-                fill = *s++;
-                align = *s++;
-            }
-            if (*s == '+' || *s == '-' || *s == ' ') {
-                if (*s == '+') {
-                    flags |= PF_FLAG_SHOW_SIGN;
-                } else if (*s == ' ') {
-                    flags |= PF_FLAG_SPACE_SIGN;
-                }
-                s++;
-            }
-            if (*s == '#') {
-                flags |= PF_FLAG_SHOW_PREFIX;
-                s++;
-            }
-            if (*s == '0') {
-                if (!align) {
-                    align = '=';
-                }
-                if (!fill) {
-                    fill = '0';
-                }
-            }
-            s = str_to_int(s, stop, &width);
-            if (*s == ',') {
-                flags |= PF_FLAG_SHOW_COMMA;
-                s++;
-            }
-            if (*s == '.') {
-                s++;
-                s = str_to_int(s, stop, &precision);
-            }
-            if (istype(*s)) {
-                type = *s++;
+            str_format_spec_t spec;
+            bool valid;
+            if (memchr(format_spec, '{', str - format_spec) == NULL) {
+                valid = str_format_parse_spec(format_spec, str, &spec);
+            } else {
+                // recursively call the formatter to format any nested specifiers
+                MP_STACK_CHECK();
+                vstr_t format_spec_vstr = mp_obj_str_format_helper(format_spec, str, arg_i, n_args, args, kwargs);
+                valid = str_format_parse_spec(format_spec_vstr.buf, format_spec_vstr.buf + format_spec_vstr.len, &spec);
+                vstr_clear(&format_spec_vstr);
             }
-            if (*s) {
+            if (!valid) {
                 if (MICROPY_ERROR_REPORTING == MICROPY_ERROR_REPORTING_TERSE) {
                     terse_str_format_value_error();
                 } else {
                     mp_raise_ValueError("invalid format specifier");
                 }
             }
-            vstr_clear(&format_spec_vstr);
-        }
-        if (!align) {
-            if (arg_looks_numeric(arg)) {
-                align = '>';
-            } else {
-                align = '<';
-            }
-        }
-        if (!fill) {
-            fill = ' ';
+            str_format_field(&print, arg, conversion, &spec);
+        } else {
+            str_format_field(&print, arg, conversion, NULL);
         }
+    }
 
-        if (flags & (PF_FLAG_SHOW_SIGN | PF_FLAG_SPACE_SIGN)) {
-            if (type == 's') {
-                if (MICROPY_ERROR_REPORTING == MICROPY_ERROR_REPORTING_TERSE) {
-                    terse_str_format_value_error();
-                } else {
-                    mp_raise_ValueError("sign not allowed in string format specifier");
-                }
-            }
-            if (type == 'c') {
-                if (MICROPY_ERROR_REPORTING == MICROPY_ERROR_REPORTING_TERSE) {
-                    terse_str_format_value_error();
-                } else {
-                    mp_raise_ValueError(
-                        "sign not allowed with integer format specifier 'c'");
-                }
-            }
-        }
+    return vstr;
+}
 
-        switch (align) {
-            case '<': flags |= PF_FLAG_LEFT_ADJUST;     break;
-            case '=': flags |= PF_FLAG_PAD_AFTER_SIGN;  break;
-            case '^': flags |= PF_FLAG_CENTER_ADJUST;   break;
-        }
+#if MICROPY_OPT_STR_FORMAT_CACHE
 
-        if (arg_looks_integer(arg)) {
-            switch (type) {
-                case 'b':
-                    mp_print_mp_int(&print, arg, 2, 'a', flags, fill, width, 0);
-                    continue;
+#define MP_STR_FORMAT_NO_FIELD (-2)
+#define MP_STR_FORMAT_AUTO_FIELD (-1)
 
-                case 'c':
-                {
-                    char ch = mp_obj_get_int(arg);
-                    mp_print_strn(&print, &ch, 1, flags, fill, width);
-                    continue;
-                }
+// n_pieces of an entry whose template can't be cached: it has more pieces than
+// fit, keyword or nested fields, or an error that the full parser must report
+#define STR_FORMAT_UNCACHEABLE (0xffff)
 
-                case '\0':  // No explicit format type implies 'd'
-                case 'n':   // I don't think we support locales in uPy so use 'd'
-                case 'd':
-                    mp_print_mp_int(&print, arg, 10, 'a', flags, fill, width, 0);
-                    continue;
+// Adds a piece to a parsed template, returning NULL if it's full.
+STATIC mp_str_format_piece_t *str_format_add_piece(mp_str_format_cache_entry_t *e, const char *fmt, const char *lit, const char *lit_top) {
+    if (e->n_pieces >= MICROPY_OPT_STR_FORMAT_CACHE_PIECES) {
+        return NULL;
+    }
+    mp_str_format_piece_t *p = &e->piece[e->n_pieces++];
+    p->lit_off = lit - fmt;
+    p->lit_len = lit_top - lit;
+    p->arg = MP_STR_FORMAT_NO_FIELD;
+    return p;
+}
 
-                case 'o':
-                    if (flags & PF_FLAG_SHOW_PREFIX) {
-                        flags |= PF_FLAG_SHOW_OCTAL_LETTER;
-                    }
+// Parses the template fmt into e.  Only positional fields without attributes
+// or nested fields are handled, anything else is left to the full parser by
+// marking e as uncacheable.
+STATIC void str_format_compile(qstr fmt, mp_str_format_cache_entry_t *e) {
+    size_t len;
+    const char *start = (const char*)qstr_data(fmt, &len);
+    const char *str = start;
+    const char *top = start + len;
+    const char *lit = start;
+    int numbering = 0; // then MP_STR_FORMAT_AUTO_FIELD, or 1 if manual
+    mp_str_format_piece_t *p;
 
-                    mp_print_mp_int(&print, arg, 8, 'a', flags, fill, width, 0);
-                    continue;
-
-                case 'X':
-                case 'x':
-                    mp_print_mp_int(&print, arg, 16, type - ('X' - 'A'), flags, fill, width, 0);
-                    continue;
-
-                case 'e':
-                case 'E':
-                case 'f':
-                case 'F':
-                case 'g':
-                case 'G':
-                case '%':
-                    // The floating point formatters all work with anything that
-                    // looks like an integer
-                    break;
+    e->fmt = fmt;
+    e->n_pieces = 0;
+    if (len > 0xffff) {
+        goto uncacheable;
+    }
 
-                default:
-                    if (MICROPY_ERROR_REPORTING == MICROPY_ERROR_REPORTING_TERSE) {
-                        terse_str_format_value_error();
-                    } else {
-                        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError,
-                            "unknown format code '%c' for object of type '%s'",
-                            type, mp_obj_get_type_str(arg)));
-                    }
+    while (str < top) {
+        if (*str != '{' && *str != '}') {
+            str++;
+            continue;
+        }
+        if (top - str >= 2 && str[1] == *str) {
+            // an escaped brace: the literal run ends with one of the pair
+            if (str_format_add_piece(e, start, lit, str + 1) == NULL) {
+                goto uncacheable;
             }
+            str += 2;
+            lit = str;
+            continue;
         }
+        if (*str == '}' || (p = str_format_add_piece(e, start, lit, str)) == NULL) {
+            goto uncacheable;
+        }
+        str++;
 
-        // NOTE: no else here. We need the e, f, g etc formats for integer
-        //       arguments (from above if) to take this if.
-        if (arg_looks_numeric(arg)) {
-            if (!type) {
-
-                // Even though the docs say that an unspecified type is the same
-                // as 'g', there is one subtle difference, when the exponent
-                // is one less than the precision.
-                //
-                // '{:10.1}'.format(0.0) ==> '0e+00'
-                // '{:10.1g}'.format(0.0) ==> '0'
-                //
-                // TODO: Figure out how to deal with this.
-                //
-                // A proper solution would involve adding a special flag
-                // or something to format_float, and create a format_double
-                // to deal with doubles. In order to fix this when using
-                // sprintf, we'd need to use the e format and tweak the
-                // returned result to strip trailing zeros like the g format
-                // does.
-                //
-                // {:10.3} and {:10.2e} with 1.23e2 both produce 1.23e+02
-                // but with 1.e2 you get 1e+02 and 1.00e+02
-                //
-                // Stripping the trailing 0's (like g) does would make the
-                // e format give us the right format.
-                //
-                // CPython sources say:
-                //   Omitted type specifier.  Behaves in the same way as repr(x)
-                //   and str(x) if no precision is given, else like 'g', but with
-                //   at least one digit after the decimal point. */
-
-                type = 'g';
+        if (str < top && unichar_isdigit(*str)) {
+            int index = 0;
+            str = str_to_int(str, top, &index);
+            if (index > 127 || numbering == MP_STR_FORMAT_AUTO_FIELD) {
+                goto uncacheable;
             }
-            if (type == 'n') {
-                type = 'g';
+            p->arg = index;
+            numbering = 1;
+        } else {
+            if (numbering == 1 || (str < top && *str != '}' && *str != '!' && *str != ':')) {
+                // keyword field, or switch to automatic numbering
+                goto uncacheable;
             }
+            p->arg = MP_STR_FORMAT_AUTO_FIELD;
+            numbering = MP_STR_FORMAT_AUTO_FIELD;
+        }
 
-            switch (type) {
-#if MICROPY_PY_BUILTINS_FLOAT
-                case 'e':
-                case 'E':
-                case 'f':
-                case 'F':
-                case 'g':
-                case 'G':
-                    mp_print_float(&print, mp_obj_get_float(arg), type, flags, fill, width, precision);
-                    break;
-
-                case '%':
-                    flags |= PF_FLAG_ADD_PERCENT;
-                    #if MICROPY_FLOAT_IMPL == MICROPY_FLOAT_IMPL_FLOAT
-                    #define F100 100.0F
-                    #else
-                    #define F100 100.0
-                    #endif
-                    mp_print_float(&print, mp_obj_get_float(arg) * F100, 'f', flags, fill, width, precision);
-                    #undef F100
-                    break;
-#endif
-
-                default:
-                    if (MICROPY_ERROR_REPORTING == MICROPY_ERROR_REPORTING_TERSE) {
-                        terse_str_format_value_error();
-                    } else {
-                        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError,
-                            "unknown format code '%c' for object of type 'float'",
-                            type, mp_obj_get_type_str(arg)));
-                    }
+        p->conversion = '\0';
+        if (str < top && *str == '!') {
+            str++;
+            if (str < top && (*str == 'r' || *str == 's')) {
+                p->conversion = *str++;
+            } else {
+                goto uncacheable;
             }
-        } else {
-            // arg doesn't look like a number
+        }
 
-            if (align == '=') {
-                if (MICROPY_ERROR_REPORTING == MICROPY_ERROR_REPORTING_TERSE) {
-                    terse_str_format_value_error();
-                } else {
-                    mp_raise_ValueError(
-                        "'=' alignment not allowed in string format specifier");
-                }
+        const char *format_spec = NULL;
+        if (str < top && *str == ':') {
+            format_spec = ++str;
+            while (str < top && *str != '{' && *str != '}') {
+                str++;
             }
+        }
+        if (str >= top || *str != '}') {
+            goto uncacheable;
+        }
 
-            switch (type) {
-                case '\0': // no explicit format type implies 's'
-                case 's': {
-                    size_t slen;
-                    const char *s = mp_obj_str_get_data(arg, &slen);
-                    if (precision < 0) {
-                        precision = slen;
-                    }
-                    if (slen > (size_t)precision) {
-                        slen = precision;
-                    }
-                    mp_print_strn(&print, s, slen, flags, fill, width);
-                    break;
-                }
-
-                default:
-                    if (MICROPY_ERROR_REPORTING == MICROPY_ERROR_REPORTING_TERSE) {
-                        terse_str_format_value_error();
-                    } else {
-                        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError,
-                            "unknown format code '%c' for object of type 'str'",
-                            type, mp_obj_get_type_str(arg)));
-                    }
+        // {:} is the same as {}, see mp_obj_str_format_helper()
+        p->has_spec = format_spec != NULL && format_spec != str;
+        if (p->has_spec) {
+            str_format_spec_t spec;
+            if (!str_format_parse_spec(format_spec, str, &spec)
+                || spec.width > INT16_MAX || spec.precision > INT16_MAX) {
+                goto uncacheable;
             }
+            p->fill = spec.fill;
+            p->align = spec.align;
+            p->type = spec.type;
+            p->flags = spec.flags;
+            p->width = spec.width;
+            p->precision = spec.precision;
         }
+        str++;
+        lit = str;
+    }
+    if (lit < top && str_format_add_piece(e, start, lit, top) == NULL) {
+        goto uncacheable;
     }
+    return;
 
-    return vstr;
+uncacheable:
+    e->n_pieces = STR_FORMAT_UNCACHEABLE;
+}
+
+// Formats with the template fmt from the format cache, parsing it into the
+// cache first if needed.  Returns false if the template can't be cached.
+STATIC bool str_format_cached(qstr fmt, size_t n_args, const mp_obj_t *args, vstr_t *vstr) {
+    mp_str_format_cache_entry_t *slot = &MP_STATE_VM(str_format_cache)[fmt & (MICROPY_OPT_STR_FORMAT_CACHE_SIZE - 1)];
+    if (slot->fmt != fmt) {
+        str_format_compile(fmt, slot);
+    }
+    if (slot->n_pieces == STR_FORMAT_UNCACHEABLE) {
+        return false;
+    }
+
+    // Work on a copy, because formatting an argument may run Python code that
+    // formats with another template using the same slot.
+    mp_str_format_cache_entry_t e = *slot;
+    size_t len;
+    const char *str = (const char*)qstr_data(fmt, &len);
+    mp_print_t print;
+    vstr_init_print(vstr, len + 16, &print);
+    size_t arg_i = 0;
+
+    for (size_t i = 0; i < e.n_pieces; i++) {
+        const mp_str_format_piece_t *p = &e.piece[i];
+        vstr_add_strn(vstr, str + p->lit_off, p->lit_len);
+        if (p->arg == MP_STR_FORMAT_NO_FIELD) {
+            continue;
+        }
+        size_t index = p->arg == MP_STR_FORMAT_AUTO_FIELD ? arg_i++ : (size_t)p->arg;
+        if (index >= n_args - 1) {
+            mp_raise_msg(&mp_type_IndexError, "tuple index out of range");
+        }
+        if (p->has_spec) {
+            str_format_spec_t spec = {p->fill, p->align, p->type, p->flags, p->width, p->precision};
+            str_format_field(&print, args[index + 1], p->conversion, &spec);
+        } else {
+            str_format_field(&print, args[index + 1], p->conversion, NULL);
+        }
+    }
+    return true;
 }
 
+#endif
+
 mp_obj_t mp_obj_str_format(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs) {
     mp_check_self(MP_OBJ_IS_STR_OR_BYTES(args[0]));
 
+    #if MICROPY_OPT_STR_FORMAT_CACHE
+    if (MP_OBJ_IS_QSTR(args[0])) {
+        vstr_t vstr;
+        if (str_format_cached(MP_OBJ_QSTR_VALUE(args[0]), n_args, args, &vstr)) {
+            return mp_obj_new_str_from_vstr(&mp_type_str, &vstr);
+        }
+    }
+    #endif
+
     GET_STR_DATA_LEN(args[0], str, len);
     int arg_i = 0;
     vstr_t vstr = mp_obj_str_format_helper((const char*)str, (const char*)str + len, &arg_i, n_args, args, kwargs);
@@ -1514,15 +1855,20 @@ not_enough_args:
             case 'r':
             case 's':
             {
-                vstr_t arg_vstr;
-                mp_print_t arg_print;
-                vstr_init_print(&arg_vstr, 16, &arg_print);
                 mp_print_kind_t print_kind = (*str == 'r' ? PRINT_REPR : PRINT_STR);
                 if (print_kind == PRINT_STR && is_bytes && MP_OBJ_IS_TYPE(arg, &mp_type_bytes)) {
                     // If we have something like b"%s" % b"1", bytes arg should be
                     // printed undecorated.
                     print_kind = PRINT_RAW;
                 }
+                if (prec < 0 && width <= 0) {
+                    // nothing to pad or truncate, so print straight into the result
+                    mp_obj_print_helper(&print, arg, print_kind);
+                    break;
+                }
+                vstr_t arg_vstr;
+                mp_print_t arg_print;
+                vstr_init_print(&arg_vstr, 16, &arg_print);
                 mp_obj_print_helper(&arg_print, arg, print_kind);
                 uint vlen = arg_vstr.len;
                 if (prec < 0) {
@@ -1977,6 +2323,7 @@ mp_obj_t mp_obj_new_str_of_type(const mp_obj_type_t *type, const byte* data, siz
     if (data) {
         o->hash = qstr_compute_hash(data, len);
         byte *p = m_new(byte, len + 1);
+        MP_GC_SET_PROTECTED(p);
         o->data = p;
         memcpy(p, data, len * sizeof(byte));
         p[len] = '\0'; // for now we add null for compatibility with C ASCIIZ strings
@@ -2009,6 +2356,7 @@ mp_obj_t mp_obj_new_str_from_vstr(const mp_obj_type_t *type, vstr_t *vstr) {
         o->data = (byte*)m_renew(char, vstr->buf, vstr->alloc, vstr->len + 1);
     }
     ((byte*)o->data)[o->len] = '\0'; // add null byte
+    MP_GC_SET_PROTECTED(o->data);
     vstr->buf = NULL;
     vstr->alloc = 0;
     return MP_OBJ_FROM_PTR(o);
@@ -2087,7 +2435,25 @@ qstr mp_obj_str_get_qstr(mp_obj_t self_in) {
 const char *mp_obj_str_get_str(mp_obj_t self_in) {
     if (MP_OBJ_IS_STR_OR_BYTES(self_in)) {
         GET_STR_DATA_LEN(self_in, s, l);
+        #if MICROPY_OPT_STR_APPEND || MICROPY_OPT_BYTES_SLICE_VIEW
+        if (s[l] != '\0') {
+            // a longer str was appended to the buffer this one shares, or
+            // it's a slice, so give it a terminated copy of its own
+            mp_obj_str_t *self = MP_OBJ_TO_PTR(self_in);
+            byte *data = m_new(byte, l + 1);
+            memcpy(data, s, l);
+            data[l] = '\0';
+            MP_GC_SET_PROTECTED(data);
+            if (self->hash & MP_OBJ_STR_HASH_FLAGS) {
+                self->hash = qstr_compute_hash(data, l);
+            }
+            self->data = data;
+            MP_GC_WRITE_BARRIER(self);
+            s = data;
+        }
+        #else
         (void)l; // len unused
+        #endif
         return (const char*)s;
     } else {
         bad_implicit_conversion(self_in);
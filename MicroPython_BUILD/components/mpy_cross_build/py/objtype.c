@@ -34,6 +34,7 @@
 #include "py/objtype.h"
 #include "py/runtime0.h"
 #include "py/runtime.h"
+#include "py/gc.h"
 
 #if MICROPY_DEBUG_VERBOSE // print debugging info
 #define DEBUG_PRINT (1)
@@ -53,6 +54,8 @@ STATIC mp_obj_t mp_obj_new_instance(const mp_obj_type_t *class, size_t subobjs)
     o->base.type = class;
     mp_map_init(&o->members, 0);
     mp_seq_clear(o->subobj, 0, subobjs, sizeof(*o->subobj));
+    // members are only stored via mp_map_lookup, which has a write barrier
+    MP_GC_SET_PROTECTED(o);
     return MP_OBJ_FROM_PTR(o);
 }
 
@@ -719,6 +722,52 @@ STATIC bool mp_obj_instance_store_attr(mp_obj_t self_in, qstr attr, mp_obj_t val
     }
 }
 
+#if MICROPY_OPT_INLINE_CACHE
+// Whether storing attr on the instance goes straight to its members, as
+// mp_obj_instance_store_attr would do it: the class has no property or data
+// descriptor of that name and no __setattr__.  The answer holds until the
+// inline cache epoch changes, which it does when a class attribute is stored.
+bool mp_obj_instance_store_is_direct(mp_obj_t self_in, qstr attr) {
+    mp_obj_instance_t *self = MP_OBJ_TO_PTR(self_in);
+    #if MICROPY_PY_BUILTINS_PROPERTY || MICROPY_PY_DESCRIPTORS
+    mp_obj_t member[2] = {MP_OBJ_NULL};
+    struct class_lookup_data lookup = {
+        .obj = self,
+        .attr = attr,
+        .meth_offset = 0,
+        .dest = member,
+        .is_type = false,
+    };
+    mp_obj_class_lookup(&lookup, self->base.type);
+    if (member[0] != MP_OBJ_NULL) {
+        #if MICROPY_PY_BUILTINS_PROPERTY
+        if (MP_OBJ_IS_TYPE(member[0], &mp_type_property)) {
+            return false;
+        }
+        #endif
+        #if MICROPY_PY_DESCRIPTORS
+        mp_obj_t attr_set_method[2];
+        mp_load_method_maybe(member[0], MP_QSTR___set__, attr_set_method);
+        if (attr_set_method[0] != MP_OBJ_NULL) {
+            return false;
+        }
+        #endif
+    }
+    #else
+    (void)self;
+    (void)attr;
+    #endif
+    #if MICROPY_PY_DELATTR_SETATTR
+    mp_obj_t attr_setattr_method[2];
+    mp_load_method_maybe(self_in, MP_QSTR___setattr__, attr_setattr_method);
+    if (attr_setattr_method[0] != MP_OBJ_NULL) {
+        return false;
+    }
+    #endif
+    return true;
+}
+#endif
+
 void mp_obj_instance_attr(mp_obj_t self_in, qstr attr, mp_obj_t *dest) {
     if (dest[0] == MP_OBJ_NULL) {
         mp_obj_instance_load_attr(self_in, attr, dest);
@@ -943,6 +992,10 @@ STATIC void type_attr(mp_obj_t self_in, qstr attr, mp_obj_t *dest) {
                 if (elem != NULL) {
                     elem->value = dest[1];
                     dest[0] = MP_OBJ_NULL; // indicate success
+                    #if MICROPY_OPT_INLINE_CACHE
+                    // the VM may have cached the old value as a method
+                    ++MP_STATE_VM(inline_cache_epoch);
+                    #endif
                 }
             }
         }
@@ -1013,6 +1066,13 @@ mp_obj_t mp_obj_new_type(qstr name, mp_obj_t bases_tuple, mp_obj_t locals_dict)
 
     o->locals_dict = MP_OBJ_TO_PTR(locals_dict);
 
+    #if MICROPY_OPT_INLINE_CACHE
+    // a freed type may have had the same address, and the inline cache keys
+    // methods by type
+    o->locals_dict->map.is_versioned = 1;
+    ++MP_STATE_VM(inline_cache_epoch);
+    #endif
+
     const mp_obj_type_t *native_base;
     size_t num_native_bases = instance_count_native_bases(o, &native_base);
     if (num_native_bases > 1) {
@@ -1026,6 +1086,7 @@ mp_obj_t mp_obj_new_type(qstr name, mp_obj_t bases_tuple, mp_obj_t locals_dict)
         if (MP_OBJ_IS_FUN(elem->value)) {
             // __new__ is a function, wrap it in a staticmethod decorator
             elem->value = static_class_method_make_new(&mp_type_staticmethod, 1, 0, &elem->value);
+            MP_GC_WRITE_BARRIER(locals_map);
         }
     }
 
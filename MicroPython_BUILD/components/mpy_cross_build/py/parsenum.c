@@ -34,6 +34,7 @@
 
 #if MICROPY_PY_BUILTINS_FLOAT
 #include <math.h>
+#include "py/formatfloat.h"
 #endif
 
 STATIC NORETURN void raise_exc(mp_obj_t exc, mp_lexer_t *lex) {
@@ -214,24 +215,43 @@ mp_obj_t mp_parse_num_decimal(const char *str, size_t len, bool allow_imag, bool
         // string should be a decimal number
         parse_dec_in_t in = PARSE_DEC_IN_INTG;
         bool exp_neg = false;
+        #if MICROPY_FLOAT_EXACT_CONV
+        // the digits are converted all at once, from str_val_start to mant_top
+        const char *mant_top = str;
+        #else
         mp_float_t frac_mult = 0.1;
+        #endif
         mp_int_t exp_val = 0;
         while (str < top) {
             mp_uint_t dig = *str++;
             if ('0' <= dig && dig <= '9') {
                 dig -= '0';
                 if (in == PARSE_DEC_IN_EXP) {
+                    #if MICROPY_FLOAT_EXACT_CONV
+                    // any bigger exponent overflows or underflows all the same
+                    if (exp_val < 100000) {
+                        exp_val = 10 * exp_val + dig;
+                    }
+                    #else
                     exp_val = 10 * exp_val + dig;
+                    #endif
                 } else {
+                    #if MICROPY_FLOAT_EXACT_CONV
+                    mant_top = str;
+                    #else
                     if (in == PARSE_DEC_IN_FRAC) {
                         dec_val += dig * frac_mult;
                         frac_mult *= MICROPY_FLOAT_CONST(0.1);
                     } else {
                         dec_val = 10 * dec_val + dig;
                     }
+                    #endif
                 }
             } else if (in == PARSE_DEC_IN_INTG && dig == '.') {
                 in = PARSE_DEC_IN_FRAC;
+                #if MICROPY_FLOAT_EXACT_CONV
+                mant_top = str;
+                #endif
             } else if (in != PARSE_DEC_IN_EXP && ((dig | 0x20) == 'e')) {
                 in = PARSE_DEC_IN_EXP;
                 if (str < top) {
@@ -261,7 +281,11 @@ mp_obj_t mp_parse_num_decimal(const char *str, size_t len, bool allow_imag, bool
         }
 
         // apply the exponent
+        #if MICROPY_FLOAT_EXACT_CONV
+        dec_val = mp_float_from_decimal(str_val_start, mant_top, exp_val);
+        #else
         dec_val *= MICROPY_FLOAT_C_FUN(pow)(10, exp_val);
+        #endif
     }
 
     // negate value if needed
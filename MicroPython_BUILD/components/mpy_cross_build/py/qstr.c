@@ -32,9 +32,16 @@
 #include "py/qstr.h"
 #include "py/gc.h"
 
-// NOTE: we are using linear arrays to store and search for qstr's (unique strings, interned strings)
-// ultimately we will replace this with a static hash table of some kind
+// NOTE: we are using linear arrays to store qstr's (unique strings, interned strings)
 // also probably need to include the length in the string data, to allow null bytes in the string
+//
+// With MICROPY_OPT_QSTR_INDEX each pool also has an open-addressed hash index,
+// so that finding a qstr doesn't compare it against every entry of every pool.
+// An index has a power of 2 number of slots, at least twice the pool's
+// entries, each holding 0 if it's empty, else 1 + the position of a qstr in
+// the pool.  The indexes of the ROM pools are made by makeqstrdata.py and
+// mpy-tool.py; a dynamic pool is allocated with its index and fills it as
+// qstrs are added.
 
 #if MICROPY_DEBUG_VERBOSE // print debugging info
 #define DEBUG_printf DEBUG_printf
@@ -80,14 +87,38 @@
 #define QSTR_EXIT()
 #endif
 
-// this must match the equivalent function in makeqstrdata.py
-mp_uint_t qstr_compute_hash(const byte *data, size_t len) {
+STATIC mp_uint_t qstr_compute_djb2(const byte *data, size_t len) {
     // djb2 algorithm; see http://www.cse.yorku.ca/~oz/hash.html
     mp_uint_t hash = 5381;
     for (const byte *top = data + len; data < top; data++) {
         hash = ((hash << 5) + hash) ^ (*data); // hash * 33 ^ data
     }
-    hash &= Q_HASH_MASK;
+    return hash;
+}
+
+#if MICROPY_OPT_QSTR_INDEX
+// The stored hash may be only 8 bits, so the index is addressed by the full
+// djb2 hash, with its low 32 bits mixed so the low bits of the result are good.
+// This must match compute_index_hash in makeqstrdata.py.
+STATIC size_t qstr_index_hash(mp_uint_t djb2) {
+    return (uint32_t)((uint32_t)djb2 * 0x9e3779b1u) >> 16;
+}
+
+STATIC void qstr_index_add(qstr_pool_t *pool, size_t n) {
+    const byte *q = pool->qstrs[n];
+    uint16_t *index = (uint16_t*)pool->index;
+    size_t mask = pool->index_size - 1;
+    size_t pos = qstr_index_hash(qstr_compute_djb2(Q_GET_DATA(q), Q_GET_LENGTH(q))) & mask;
+    while (index[pos] != 0) {
+        pos = (pos + 1) & mask;
+    }
+    index[pos] = n + 1;
+}
+#endif
+
+// this must match the equivalent function in makeqstrdata.py
+mp_uint_t qstr_compute_hash(const byte *data, size_t len) {
+    mp_uint_t hash = qstr_compute_djb2(data, len) & Q_HASH_MASK;
     // Make sure that valid hash is never zero, zero means "hash not computed"
     if (hash == 0) {
         hash++;
@@ -95,11 +126,24 @@ mp_uint_t qstr_compute_hash(const byte *data, size_t len) {
     return hash;
 }
 
+#if MICROPY_OPT_QSTR_INDEX && !defined(NO_QSTR)
+STATIC const uint16_t mp_qstr_const_pool_index[] = {
+    MP_QSTR_CONST_POOL_INDEX
+};
+#endif
+
 const qstr_pool_t mp_qstr_const_pool = {
     NULL,               // no previous pool
     0,                  // no previous pool
     10,                 // set so that the first dynamically allocated pool is twice this size; must be <= the len (just below)
     MP_QSTRnumber_of,   // corresponds to number of strings in array just below
+    #if MICROPY_OPT_QSTR_INDEX && !defined(NO_QSTR)
+    mp_qstr_const_pool_index,
+    MP_QSTR_CONST_POOL_INDEX_SIZE,
+    #elif MICROPY_OPT_QSTR_INDEX
+    NULL,
+    0,
+    #endif
     {
 #ifndef NO_QSTR
 #define QDEF(id, str) str,
@@ -143,21 +187,39 @@ STATIC qstr qstr_add(const byte *q_ptr) {
 
     // make sure we have room in the pool for a new qstr
     if (MP_STATE_VM(last_pool)->len >= MP_STATE_VM(last_pool)->alloc) {
-        qstr_pool_t *pool = m_new_obj_var_maybe(qstr_pool_t, const char*, MP_STATE_VM(last_pool)->alloc * 2);
+        size_t alloc = MP_STATE_VM(last_pool)->alloc * 2;
+        #if MICROPY_OPT_QSTR_INDEX
+        // the index follows the qstrs in the same allocation
+        size_t index_size = 16;
+        while (index_size < 2 * alloc) {
+            index_size *= 2;
+        }
+        qstr_pool_t *pool = m_malloc_maybe(sizeof(qstr_pool_t) + alloc * sizeof(const char*) + index_size * sizeof(uint16_t));
+        #else
+        qstr_pool_t *pool = m_new_obj_var_maybe(qstr_pool_t, const char*, alloc);
+        #endif
         if (pool == NULL) {
             QSTR_EXIT();
-            m_malloc_fail(MP_STATE_VM(last_pool)->alloc * 2);
+            m_malloc_fail(alloc);
         }
         pool->prev = MP_STATE_VM(last_pool);
         pool->total_prev_len = MP_STATE_VM(last_pool)->total_prev_len + MP_STATE_VM(last_pool)->len;
-        pool->alloc = MP_STATE_VM(last_pool)->alloc * 2;
+        pool->alloc = alloc;
         pool->len = 0;
+        #if MICROPY_OPT_QSTR_INDEX
+        pool->index = (uint16_t*)&pool->qstrs[alloc];
+        pool->index_size = index_size;
+        memset((uint16_t*)pool->index, 0, index_size * sizeof(uint16_t));
+        #endif
         MP_STATE_VM(last_pool) = pool;
         DEBUG_printf("QSTR: allocate new pool of size %d\n", MP_STATE_VM(last_pool)->alloc);
     }
 
     // add the new qstr
     MP_STATE_VM(last_pool)->qstrs[MP_STATE_VM(last_pool)->len++] = q_ptr;
+    #if MICROPY_OPT_QSTR_INDEX
+    qstr_index_add(MP_STATE_VM(last_pool), MP_STATE_VM(last_pool)->len - 1);
+    #endif
 
     // return id for the newly-added qstr
     return MP_STATE_VM(last_pool)->total_prev_len + MP_STATE_VM(last_pool)->len - 1;
@@ -165,10 +227,26 @@ STATIC qstr qstr_add(const byte *q_ptr) {
 
 qstr qstr_find_strn(const char *str, size_t str_len) {
     // work out hash of str
-    mp_uint_t str_hash = qstr_compute_hash((const byte*)str, str_len);
+    mp_uint_t str_djb2 = qstr_compute_djb2((const byte*)str, str_len);
+    mp_uint_t str_hash = str_djb2 & Q_HASH_MASK;
+    if (str_hash == 0) {
+        str_hash++;
+    }
 
     // search pools for the data
     for (qstr_pool_t *pool = MP_STATE_VM(last_pool); pool != NULL; pool = pool->prev) {
+        #if MICROPY_OPT_QSTR_INDEX
+        if (pool->index != NULL) {
+            size_t mask = pool->index_size - 1;
+            for (size_t pos = qstr_index_hash(str_djb2) & mask; pool->index[pos] != 0; pos = (pos + 1) & mask) {
+                const byte *q = pool->qstrs[pool->index[pos] - 1];
+                if (Q_GET_HASH(q) == str_hash && Q_GET_LENGTH(q) == str_len && memcmp(Q_GET_DATA(q), str, str_len) == 0) {
+                    return pool->total_prev_len + pool->index[pos] - 1;
+                }
+            }
+            continue;
+        }
+        #endif
         for (const byte **q = pool->qstrs, **q_top = pool->qstrs + pool->len; q < q_top; q++) {
             if (Q_GET_HASH(*q) == str_hash && Q_GET_LENGTH(*q) == str_len && memcmp(Q_GET_DATA(*q), str, str_len) == 0) {
                 return pool->total_prev_len + (q - pool->qstrs);
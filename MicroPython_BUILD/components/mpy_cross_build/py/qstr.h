@@ -52,6 +52,10 @@ typedef struct _qstr_pool_t {
     size_t total_prev_len;
     size_t alloc;
     size_t len;
+    #if MICROPY_OPT_QSTR_INDEX
+    const uint16_t *index; // hash index of qstrs, see qstr.c; NULL if none
+    size_t index_size;
+    #endif
     const byte *qstrs[];
 } qstr_pool_t;
 
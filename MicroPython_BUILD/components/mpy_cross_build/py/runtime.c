@@ -27,6 +27,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <limits.h>
 
 #include "py/mpstate.h"
 #include "py/nlr.h"
@@ -64,8 +65,7 @@ void mp_init(void) {
     // no pending exceptions to start with
     MP_STATE_VM(mp_pending_exception) = MP_OBJ_NULL;
     #if MICROPY_ENABLE_SCHEDULER
-    MP_STATE_VM(sched_state) = MP_SCHED_IDLE;
-    MP_STATE_VM(sched_sp) = 0;
+    mp_sched_init(MICROPY_SCHEDULER_DEPTH);
     #endif
 
 #if MICROPY_ENABLE_EMERGENCY_EXCEPTION_BUF
@@ -94,6 +94,9 @@ void mp_init(void) {
 
     // initialise the __main__ module
     mp_obj_dict_init(&MP_STATE_VM(dict_main), 1);
+    #if MICROPY_OPT_INLINE_CACHE
+    MP_STATE_VM(dict_main).map.is_versioned = 1;
+    #endif
     mp_obj_dict_store(MP_OBJ_FROM_PTR(&MP_STATE_VM(dict_main)), MP_OBJ_NEW_QSTR(MP_QSTR___name__), MP_OBJ_NEW_QSTR(MP_QSTR___main__));
 
     // locals = globals for outer module (see Objects/frameobject.c/PyFrame_New())
@@ -118,6 +121,34 @@ void mp_init(void) {
 
     #if MICROPY_PY_THREAD_GIL
     mp_thread_mutex_init(&MP_STATE_VM(gil_mutex));
+    #if MICROPY_PY_THREAD_GIL_SWITCH_INTERVAL
+    MP_STATE_VM(gil_waiting) = 0;
+    MP_STATE_VM(gil_waiter_prio) = INT_MIN;
+    MP_STATE_VM(gil_switch_interval) = MICROPY_PY_THREAD_GIL_SWITCH_INTERVAL;
+    #endif
+    #endif
+
+    #if MICROPY_OPT_INLINE_CACHE
+    MP_STATE_VM(inline_cache_epoch) = 0;
+    memset(MP_STATE_VM(inline_cache), 0, sizeof(MP_STATE_VM(inline_cache)));
+    #endif
+
+    #if MICROPY_OPT_STR_FORMAT_CACHE
+    // dynamic qstrs are numbered afresh after a soft reset
+    memset(MP_STATE_VM(str_format_cache), 0, sizeof(MP_STATE_VM(str_format_cache)));
+    #endif
+
+    #if MICROPY_PY_MICROPYTHON_HEAP_PROFILE
+    MP_STATE_VM(heap_profile_enabled) = false;
+    memset(MP_STATE_VM(heap_profile_sites), 0, sizeof(MP_STATE_VM(heap_profile_sites)));
+    MP_STATE_THREAD(current_code_state) = NULL;
+    #endif
+
+    #if MICROPY_PY_MICROPYTHON_PROFILE
+    MP_STATE_VM(profile_enabled) = false;
+    memset(MP_STATE_VM(profile_opcodes), 0, sizeof(MP_STATE_VM(profile_opcodes)));
+    memset(MP_STATE_VM(profile_funs), 0, sizeof(MP_STATE_VM(profile_funs)));
+    MP_STATE_THREAD(profile_inner_ticks) = 0;
     #endif
 
     MP_THREAD_GIL_ENTER();
@@ -127,6 +158,11 @@ void mp_deinit(void) {
     //mp_obj_dict_free(&dict_main);
     //mp_map_deinit(&MP_STATE_VM(mp_loaded_modules_map));
 
+    #if MICROPY_ENABLE_SCHEDULER
+    // the queue is on the heap, so ISRs must stop using it before gc_init
+    mp_sched_deinit();
+    #endif
+
     // call port specific deinitialization if any
 #ifdef MICROPY_PORT_INIT_FUNC
     MICROPY_PORT_DEINIT_FUNC;
@@ -245,6 +245,22 @@ const byte *mp_bytecode_print_str(const byte *ip) {
             printf("LOAD_METHOD %s", qstr_str(qst));
             break;
 
+        case MP_BC_LOAD_FAST_ATTR:
+            DECODE_QSTR;
+            printf("LOAD_FAST_ATTR %s " UINT_FMT, qstr_str(qst), (mp_uint_t)*ip++);
+            break;
+
+        case MP_BC_LOAD_FAST_METHOD:
+            DECODE_QSTR;
+            printf("LOAD_FAST_METHOD %s " UINT_FMT, qstr_str(qst), (mp_uint_t)*ip++);
+            break;
+
+        case MP_BC_BINARY_OP_FAST_SMALL_INT:
+            printf("BINARY_OP_FAST_SMALL_INT " UINT_FMT " " INT_FMT " %s",
+                (mp_uint_t)ip[0], (mp_int_t)(int8_t)ip[1], qstr_str(mp_binary_op_method_name[ip[2]]));
+            ip += 3;
+            break;
+
         case MP_BC_LOAD_SUPER_METHOD:
             DECODE_QSTR;
             printf("LOAD_SUPER_METHOD %s", qstr_str(qst));
@@ -345,6 +361,18 @@ const byte *mp_bytecode_print_str(const byte *ip) {
             printf("POP_JUMP_IF_FALSE " UINT_FMT, (mp_uint_t)(ip + unum - mp_showbc_code_start));
             break;
 
+        case MP_BC_BINARY_OP_POP_JUMP_IF_TRUE:
+            DECODE_SLABEL;
+            printf("BINARY_OP_POP_JUMP_IF_TRUE " UINT_FMT " %s", (mp_uint_t)(ip + unum - mp_showbc_code_start), qstr_str(mp_binary_op_method_name[*ip]));
+            ip += 1;
+            break;
+
+        case MP_BC_BINARY_OP_POP_JUMP_IF_FALSE:
+            DECODE_SLABEL;
+            printf("BINARY_OP_POP_JUMP_IF_FALSE " UINT_FMT " %s", (mp_uint_t)(ip + unum - mp_showbc_code_start), qstr_str(mp_binary_op_method_name[*ip]));
+            ip += 1;
+            break;
+
         case MP_BC_JUMP_IF_TRUE_OR_POP:
             DECODE_SLABEL;
             printf("JUMP_IF_TRUE_OR_POP " UINT_FMT, (mp_uint_t)(ip + unum - mp_showbc_code_start));
@@ -34,8 +34,15 @@
 #include "py/emitglue.h"
 #include "py/objtype.h"
 #include "py/runtime.h"
+#include "py/smallint.h"
 #include "py/bc0.h"
 #include "py/bc.h"
+#include "py/builtin.h"
+#include "py/gc.h"
+
+#if MICROPY_PY_MICROPYTHON_PROFILE || (MICROPY_PY_THREAD_GIL && MICROPY_PY_THREAD_GIL_SWITCH_INTERVAL)
+#include "py/mphal.h"
+#endif
 
 #if 0
 #define TRACE(ip) printf("sp=%d ", (int)(sp - &code_state->state[0] + 1)); mp_bytecode_print2(ip, 1, code_state->fun_bc->const_table);
@@ -43,6 +50,12 @@
 #define TRACE(ip)
 #endif
 
+#if MICROPY_PY_MICROPYTHON_PROFILE
+#define PROFILE_OPCODE(ip) if (MP_STATE_VM(profile_enabled)) { MP_STATE_VM(profile_opcodes)[*(ip)] += 1; }
+#else
+#define PROFILE_OPCODE(ip)
+#endif
+
 // Value stack grows up (this makes it incompatible with native C stack, but
 // makes sure that arguments to functions are in natural order arg1..argN
 // (Python semantics mandates left-to-right evaluation order, including for
@@ -120,13 +133,211 @@ typedef enum {
     exc_sp--; /* pop back to previous exception handler */ \
     CLEAR_SYS_EXC_INFO() /* just clear sys.exc_info(), not compliant, but it shouldn't be used in 1st place */
 
+#if MICROPY_OPT_INLINE_CACHE
+
+#if MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE
+#error MICROPY_OPT_INLINE_CACHE and MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE are exclusive
+#endif
+#if MICROPY_PY_THREAD && !MICROPY_PY_THREAD_GIL
+#error MICROPY_OPT_INLINE_CACHE requires MICROPY_PY_THREAD_GIL
+#endif
+
+// The inline cache remembers where LOAD_NAME, LOAD_GLOBAL, LOAD_ATTR,
+// LOAD_METHOD and STORE_ATTR found their name the last time they ran, so the
+// next run can skip the hash probe.  It is a direct-mapped table indexed by
+// the address of the opcode's argument, so the bytecode is not changed and
+// may be in ROM.  An entry is one of:
+//  - IC_MAP_SLOT: the index of the name in a map; it is checked against the
+//    key in that slot of the map at hand, so it needs no invalidation
+//  - IC_BUILTIN: the builtin found by LOAD_GLOBAL, for the globals in key
+//  - IC_METHOD: the method found by LOAD_METHOD on instances of the type in key
+//  - IC_STORE_SLOT: like IC_MAP_SLOT, for STORE_ATTR on instances of the type
+//    in key, which must have no __setattr__
+// All but IC_MAP_SLOT only hold while inline_cache_epoch is unchanged.  It is
+// incremented when a key is added to or removed from a versioned map (module
+// globals, the builtins override dict and the dicts of classes), when a class
+// attribute is stored, and when a class is created.  Slot indices rather than
+// pointers are kept so that the cache stays valid when a map table is resized
+// or moved by the GC.
+#define IC_NONE (0)
+#define IC_MAP_SLOT (1)
+#define IC_BUILTIN (2)
+#define IC_METHOD (3)
+#define IC_STORE_SLOT (4)
+
+#define IC_ENTRY(ip) (&MP_STATE_VM(inline_cache)[((uintptr_t)(ip) ^ ((uintptr_t)(ip) >> 7)) & (MICROPY_OPT_INLINE_CACHE_SIZE - 1)])
+
+STATIC mp_map_elem_t *ic_map_lookup(const byte *ip, qstr qst, mp_map_t *map) {
+    mp_inline_cache_entry_t *e = IC_ENTRY(ip);
+    mp_obj_t key = MP_OBJ_NEW_QSTR(qst);
+    if (e->ip == ip && e->kind == IC_MAP_SLOT && e->slot < map->alloc && map->table[e->slot].key == key) {
+        return &map->table[e->slot];
+    }
+    mp_map_elem_t *elem = mp_map_lookup(map, key, MP_MAP_LOOKUP);
+    if (elem != NULL && elem - map->table <= 0xffff) {
+        e->ip = ip;
+        e->qst = qst;
+        e->kind = IC_MAP_SLOT;
+        e->slot = elem - map->table;
+    }
+    return elem;
+}
+
+STATIC mp_obj_t ic_load_global(const byte *ip, qstr qst) {
+    mp_map_t *map = &mp_globals_get()->map;
+    mp_inline_cache_entry_t *e = IC_ENTRY(ip);
+    if (e->ip == ip && e->kind == IC_BUILTIN && e->qst == qst && e->key == map
+        && e->epoch == MP_STATE_VM(inline_cache_epoch)) {
+        return e->value;
+    }
+    mp_map_elem_t *elem = ic_map_lookup(ip, qst, map);
+    if (elem != NULL) {
+        return elem->value;
+    }
+    // only builtins from ROM are cached; the values of the override dict may change
+    if (map->is_versioned) {
+        mp_obj_t key = MP_OBJ_NEW_QSTR(qst);
+        #if MICROPY_CAN_OVERRIDE_BUILTINS
+        mp_obj_dict_t *override = MP_STATE_VM(mp_module_builtins_override_dict);
+        if (override == NULL || mp_map_lookup(&override->map, key, MP_MAP_LOOKUP) == NULL)
+        #endif
+        {
+            elem = mp_map_lookup((mp_map_t*)&mp_module_builtins_globals.map, key, MP_MAP_LOOKUP);
+            if (elem != NULL) {
+                e->ip = ip;
+                e->qst = qst;
+                e->kind = IC_BUILTIN;
+                e->key = map;
+                e->value = elem->value;
+                e->epoch = MP_STATE_VM(inline_cache_epoch);
+                return elem->value;
+            }
+        }
+    }
+    return mp_load_global(qst);
+}
+
+STATIC mp_obj_t ic_load_name(const byte *ip, qstr qst) {
+    mp_obj_dict_t *locals = mp_locals_get();
+    if (locals == mp_globals_get()) {
+        return ic_load_global(ip, qst);
+    }
+    mp_map_elem_t *elem = ic_map_lookup(ip, qst, &locals->map);
+    if (elem != NULL) {
+        return elem->value;
+    }
+    return mp_load_global(qst);
+}
+
+// The map an attribute of obj is looked up in first, if it is a plain map
+STATIC mp_map_t *ic_attr_map(mp_obj_t obj, mp_obj_type_t *type) {
+    if (type->attr == mp_obj_instance_attr) {
+        return &((mp_obj_instance_t*)MP_OBJ_TO_PTR(obj))->members;
+    } else if (type == &mp_type_module) {
+        return &((mp_obj_module_t*)MP_OBJ_TO_PTR(obj))->globals->map;
+    }
+    return NULL;
+}
+
+STATIC mp_obj_t ic_load_attr(const byte *ip, qstr qst, mp_obj_t obj) {
+    mp_map_t *map = ic_attr_map(obj, mp_obj_get_type(obj));
+    if (map != NULL) {
+        mp_map_elem_t *elem = ic_map_lookup(ip, qst, map);
+        if (elem != NULL) {
+            return elem->value;
+        }
+    }
+    return mp_load_attr(obj, qst);
+}
+
+STATIC void ic_load_method(const byte *ip, qstr qst, mp_obj_t obj, mp_obj_t *dest) {
+    mp_obj_type_t *type = mp_obj_get_type(obj);
+    mp_map_t *map = ic_attr_map(obj, type);
+    mp_inline_cache_entry_t *e = IC_ENTRY(ip);
+    if (e->ip == ip && e->kind == IC_METHOD && e->qst == qst && e->key == type
+        && e->epoch == MP_STATE_VM(inline_cache_epoch)
+        && (map == NULL || mp_map_lookup(map, MP_OBJ_NEW_QSTR(qst), MP_MAP_LOOKUP) == NULL)) {
+        dest[0] = e->value;
+        dest[1] = obj;
+        return;
+    }
+    if (type == &mp_type_module) {
+        mp_map_elem_t *elem = ic_map_lookup(ip, qst, map);
+        if (elem != NULL) {
+            dest[0] = elem->value;
+            dest[1] = MP_OBJ_NULL;
+            return;
+        }
+    }
+    mp_load_method(obj, qst, dest);
+    // only methods bound to obj itself, found in the dict of its type (or of
+    // a base), are cached; native types without an attr handler can't change
+    if (dest[1] == obj && (type->attr == NULL || type->attr == mp_obj_instance_attr)) {
+        e->ip = ip;
+        e->qst = qst;
+        e->kind = IC_METHOD;
+        e->key = type;
+        e->value = dest[0];
+        e->epoch = MP_STATE_VM(inline_cache_epoch);
+    }
+}
+
+// A member is only stored to directly once the class has been checked for a
+// property or data descriptor of the same name, which take the store even
+// if the instance has the member, and for __setattr__; the cached slot is
+// dropped with the epoch when a class attribute changes.  New members are
+// added, and a value of MP_OBJ_NULL deletes the attribute, on the slow path.
+STATIC void ic_store_attr(const byte *ip, qstr qst, mp_obj_t obj, mp_obj_t value) {
+    mp_obj_type_t *type = mp_obj_get_type(obj);
+    if (type->attr == mp_obj_instance_attr && value != MP_OBJ_NULL) {
+        mp_obj_instance_t *self = MP_OBJ_TO_PTR(obj);
+        mp_map_t *map = &self->members;
+        mp_obj_t key = MP_OBJ_NEW_QSTR(qst);
+        mp_inline_cache_entry_t *e = IC_ENTRY(ip);
+        mp_map_elem_t *elem;
+        if (e->ip == ip && e->kind == IC_STORE_SLOT && e->key == type
+            && e->epoch == MP_STATE_VM(inline_cache_epoch)
+            && e->slot < map->alloc && map->table[e->slot].key == key) {
+            elem = &map->table[e->slot];
+        } else {
+            if (!mp_obj_instance_store_is_direct(obj, qst)) {
+                goto store_attr;
+            }
+            elem = mp_map_lookup(map, key, MP_MAP_LOOKUP);
+            if (elem == NULL) {
+                goto store_attr;
+            }
+            if (elem - map->table <= 0xffff) {
+                e->ip = ip;
+                e->qst = qst;
+                e->kind = IC_STORE_SLOT;
+                e->key = type;
+                e->slot = elem - map->table;
+                e->epoch = MP_STATE_VM(inline_cache_epoch);
+            }
+        }
+        elem->value = value;
+        MP_GC_WRITE_BARRIER(self);
+        return;
+    }
+store_attr:
+    mp_store_attr(obj, qst, value);
+}
+
+#endif // MICROPY_OPT_INLINE_CACHE
+
 // fastn has items in reverse order (fastn[0] is local[0], fastn[-1] is local[1], etc)
 // sp points to bottom of stack which grows up
 // returns:
 //  MP_VM_RETURN_NORMAL, sp valid, return value in *sp
 //  MP_VM_RETURN_YIELD, ip, sp valid, yielded value in *sp
 //  MP_VM_RETURN_EXCEPTION, exception in fastn[0]
+#if MICROPY_PY_MICROPYTHON_PROFILE
+// (wrapped by the profiling mp_execute_bytecode() at the end of this file)
+STATIC mp_vm_return_kind_t mp_execute_bytecode_run(mp_code_state_t *code_state, volatile mp_obj_t inject_exc) {
+#else
 mp_vm_return_kind_t mp_execute_bytecode(mp_code_state_t *code_state, volatile mp_obj_t inject_exc) {
+#endif
 #define SELECTIVE_EXC_IP (0)
 #if SELECTIVE_EXC_IP
 #define MARK_EXC_IP_SELECTIVE() { code_state->ip = ip; } /* stores ip 1 byte past last opcode */
@@ -139,6 +350,7 @@ mp_vm_return_kind_t mp_execute_bytecode(mp_code_state_t *code_state, volatile mp
     #include "py/vmentrytable.h"
     #define DISPATCH() do { \
         TRACE(ip); \
+        PROFILE_OPCODE(ip); \
         MARK_EXC_IP_GLOBAL(); \
         goto *entry_table[*ip++]; \
     } while (0)
@@ -160,6 +372,9 @@ mp_vm_return_kind_t mp_execute_bytecode(mp_code_state_t *code_state, volatile mp
 
 #if MICROPY_STACKLESS
 run_code_state: ;
+    #if MICROPY_PY_MICROPYTHON_HEAP_PROFILE
+    MP_STATE_THREAD(current_code_state) = code_state;
+    #endif
 #endif
     // Pointers which are constant for particular invocation of mp_execute_bytecode()
     mp_obj_t * /*const*/ fastn;
@@ -174,7 +389,7 @@ run_code_state: ;
     volatile bool currently_in_except_block = MP_TAGPTR_TAG0(code_state->exc_sp); // 0 or 1, to detect nested exceptions
     mp_exc_stack_t *volatile exc_sp = MP_TAGPTR_PTR(code_state->exc_sp); // stack grows up, exc_sp points to top of stack
 
-    #if MICROPY_PY_THREAD_GIL && MICROPY_PY_THREAD_GIL_VM_DIVISOR
+    #if MICROPY_PY_THREAD_GIL && MICROPY_PY_THREAD_GIL_VM_DIVISOR && !MICROPY_PY_THREAD_GIL_SWITCH_INTERVAL
     // This needs to be volatile and outside the VM loop so it persists across handling
     // of any exceptions.  Otherwise it's possible that the VM never gives up the GIL.
     volatile int gil_divisor = MICROPY_PY_THREAD_GIL_VM_DIVISOR;
@@ -210,6 +425,7 @@ dispatch_loop:
                 DISPATCH();
 #else
                 TRACE(ip);
+                PROFILE_OPCODE(ip);
                 MARK_EXC_IP_GLOBAL();
                 switch (*ip++) {
 #endif
@@ -276,7 +492,15 @@ dispatch_loop:
                     goto load_check;
                 }
 
-                #if !MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE
+                #if MICROPY_OPT_INLINE_CACHE
+                ENTRY(MP_BC_LOAD_NAME): {
+                    MARK_EXC_IP_SELECTIVE();
+                    const byte *ic_ip = ip;
+                    DECODE_QSTR;
+                    PUSH(ic_load_name(ic_ip, qst));
+                    DISPATCH();
+                }
+                #elif !MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE
                 ENTRY(MP_BC_LOAD_NAME): {
                     MARK_EXC_IP_SELECTIVE();
                     DECODE_QSTR;
@@ -305,7 +529,15 @@ dispatch_loop:
                 }
                 #endif
 
-                #if !MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE
+                #if MICROPY_OPT_INLINE_CACHE
+                ENTRY(MP_BC_LOAD_GLOBAL): {
+                    MARK_EXC_IP_SELECTIVE();
+                    const byte *ic_ip = ip;
+                    DECODE_QSTR;
+                    PUSH(ic_load_global(ic_ip, qst));
+                    DISPATCH();
+                }
+                #elif !MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE
                 ENTRY(MP_BC_LOAD_GLOBAL): {
                     MARK_EXC_IP_SELECTIVE();
                     DECODE_QSTR;
@@ -334,7 +566,15 @@ dispatch_loop:
                 }
                 #endif
 
-                #if !MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE
+                #if MICROPY_OPT_INLINE_CACHE
+                ENTRY(MP_BC_LOAD_ATTR): {
+                    MARK_EXC_IP_SELECTIVE();
+                    const byte *ic_ip = ip;
+                    DECODE_QSTR;
+                    SET_TOP(ic_load_attr(ic_ip, qst, TOP()));
+                    DISPATCH();
+                }
+                #elif !MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE
                 ENTRY(MP_BC_LOAD_ATTR): {
                     MARK_EXC_IP_SELECTIVE();
                     DECODE_QSTR;
@@ -372,6 +612,16 @@ dispatch_loop:
                 }
                 #endif
 
+                #if MICROPY_OPT_INLINE_CACHE
+                ENTRY(MP_BC_LOAD_METHOD): {
+                    MARK_EXC_IP_SELECTIVE();
+                    const byte *ic_ip = ip;
+                    DECODE_QSTR;
+                    ic_load_method(ic_ip, qst, *sp, sp);
+                    sp += 1;
+                    DISPATCH();
+                }
+                #else
                 ENTRY(MP_BC_LOAD_METHOD): {
                     MARK_EXC_IP_SELECTIVE();
                     DECODE_QSTR;
@@ -379,6 +629,7 @@ dispatch_loop:
                     sp += 1;
                     DISPATCH();
                 }
+                #endif
 
                 ENTRY(MP_BC_LOAD_SUPER_METHOD): {
                     MARK_EXC_IP_SELECTIVE();
@@ -426,7 +677,16 @@ dispatch_loop:
                     DISPATCH();
                 }
 
-                #if !MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE
+                #if MICROPY_OPT_INLINE_CACHE
+                ENTRY(MP_BC_STORE_ATTR): {
+                    MARK_EXC_IP_SELECTIVE();
+                    const byte *ic_ip = ip;
+                    DECODE_QSTR;
+                    ic_store_attr(ic_ip, qst, sp[0], sp[-1]);
+                    sp -= 2;
+                    DISPATCH();
+                }
+                #elif !MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE
                 ENTRY(MP_BC_STORE_ATTR): {
                     MARK_EXC_IP_SELECTIVE();
                     DECODE_QSTR;
@@ -460,6 +720,7 @@ dispatch_loop:
                             }
                         }
                         elem->value = sp[-1];
+                        MP_GC_WRITE_BARRIER(self);
                         sp -= 2;
                         ip++;
                         DISPATCH();
@@ -512,6 +773,73 @@ dispatch_loop:
                     DISPATCH();
                 }
 
+                ENTRY(MP_BC_LOAD_FAST_ATTR): {
+                    MARK_EXC_IP_SELECTIVE();
+                    #if MICROPY_OPT_INLINE_CACHE
+                    const byte *ic_ip = ip;
+                    #endif
+                    DECODE_QSTR;
+                    obj_shared = fastn[-(mp_int_t)*ip++];
+                    if (obj_shared == MP_OBJ_NULL) {
+                        goto local_name_error;
+                    }
+                    #if MICROPY_OPT_INLINE_CACHE
+                    PUSH(ic_load_attr(ic_ip, qst, obj_shared));
+                    #else
+                    PUSH(mp_load_attr(obj_shared, qst));
+                    #endif
+                    DISPATCH();
+                }
+
+                ENTRY(MP_BC_LOAD_FAST_METHOD): {
+                    MARK_EXC_IP_SELECTIVE();
+                    #if MICROPY_OPT_INLINE_CACHE
+                    const byte *ic_ip = ip;
+                    #endif
+                    DECODE_QSTR;
+                    obj_shared = fastn[-(mp_int_t)*ip++];
+                    if (obj_shared == MP_OBJ_NULL) {
+                        goto local_name_error;
+                    }
+                    sp += 1;
+                    #if MICROPY_OPT_INLINE_CACHE
+                    ic_load_method(ic_ip, qst, obj_shared, sp);
+                    #else
+                    mp_load_method(obj_shared, qst, sp);
+                    #endif
+                    sp += 1;
+                    DISPATCH();
+                }
+
+                ENTRY(MP_BC_BINARY_OP_FAST_SMALL_INT): {
+                    MARK_EXC_IP_SELECTIVE();
+                    mp_obj_t lhs = fastn[-(mp_int_t)ip[0]];
+                    mp_int_t rhs = (int8_t)ip[1];
+                    mp_binary_op_t op = ip[2];
+                    ip += 3;
+                    if (lhs == MP_OBJ_NULL) {
+                        goto local_name_error;
+                    }
+                    // counting up and down is common enough to skip mp_binary_op
+                    if (MP_OBJ_IS_SMALL_INT(lhs)) {
+                        mp_int_t res;
+                        if (op == MP_BINARY_OP_ADD || op == MP_BINARY_OP_INPLACE_ADD) {
+                            res = MP_OBJ_SMALL_INT_VALUE(lhs) + rhs;
+                        } else if (op == MP_BINARY_OP_SUBTRACT || op == MP_BINARY_OP_INPLACE_SUBTRACT) {
+                            res = MP_OBJ_SMALL_INT_VALUE(lhs) - rhs;
+                        } else {
+                            goto binary_op_small_int;
+                        }
+                        if (MP_SMALL_INT_FITS(res)) {
+                            PUSH(MP_OBJ_NEW_SMALL_INT(res));
+                            DISPATCH();
+                        }
+                    }
+                binary_op_small_int:
+                    PUSH(mp_binary_op(op, lhs, MP_OBJ_NEW_SMALL_INT(rhs)));
+                    DISPATCH();
+                }
+
                 ENTRY(MP_BC_DUP_TOP): {
                     mp_obj_t top = TOP();
                     PUSH(top);
@@ -585,6 +913,38 @@ dispatch_loop:
                     DISPATCH_WITH_PEND_EXC_CHECK();
                 }
 
+                ENTRY(MP_BC_BINARY_OP_POP_JUMP_IF_TRUE):
+                ENTRY(MP_BC_BINARY_OP_POP_JUMP_IF_FALSE): {
+                    MARK_EXC_IP_SELECTIVE();
+                    bool jump_if = ip[-1] == MP_BC_BINARY_OP_POP_JUMP_IF_TRUE;
+                    DECODE_SLABEL;
+                    const byte *dest_ip = ip + slab;
+                    mp_binary_op_t op = *ip++;
+                    mp_obj_t rhs = POP();
+                    mp_obj_t lhs = POP();
+                    bool cond;
+                    if (MP_OBJ_IS_SMALL_INT(lhs) && MP_OBJ_IS_SMALL_INT(rhs)
+                        && op >= MP_BINARY_OP_LESS && op <= MP_BINARY_OP_NOT_EQUAL) {
+                        // comparing small ints needs no bool object
+                        mp_int_t l = MP_OBJ_SMALL_INT_VALUE(lhs);
+                        mp_int_t r = MP_OBJ_SMALL_INT_VALUE(rhs);
+                        switch (op) {
+                            case MP_BINARY_OP_LESS: cond = l < r; break;
+                            case MP_BINARY_OP_MORE: cond = l > r; break;
+                            case MP_BINARY_OP_EQUAL: cond = l == r; break;
+                            case MP_BINARY_OP_LESS_EQUAL: cond = l <= r; break;
+                            case MP_BINARY_OP_MORE_EQUAL: cond = l >= r; break;
+                            default: cond = l != r; break;
+                        }
+                    } else {
+                        cond = mp_obj_is_true(mp_binary_op(op, lhs, rhs));
+                    }
+                    if (cond == jump_if) {
+                        ip = dest_ip;
+                    }
+                    DISPATCH_WITH_PEND_EXC_CHECK();
+                }
+
                 ENTRY(MP_BC_SETUP_WITH): {
                     MARK_EXC_IP_SELECTIVE();
                     // stack: (..., ctx_mgr)
@@ -1287,9 +1647,7 @@ pending_exception_check:
                     mp_obj_t obj = MP_STATE_VM(mp_pending_exception);
                     if (obj != MP_OBJ_NULL) {
                         MP_STATE_VM(mp_pending_exception) = MP_OBJ_NULL;
-                        if (!mp_sched_num_pending()) {
-                            MP_STATE_VM(sched_state) = MP_SCHED_IDLE;
-                        }
+                        mp_sched_idle();
                         MICROPY_END_ATOMIC_SECTION(atomic_state);
                         RAISE(obj);
                     }
@@ -1306,7 +1664,13 @@ pending_exception_check:
                 #endif
 
                 #if MICROPY_PY_THREAD_GIL
-                #if MICROPY_PY_THREAD_GIL_VM_DIVISOR
+                #if MICROPY_PY_THREAD_GIL_SWITCH_INTERVAL
+                // only hand the GIL over to a waiting thread, once this one
+                // has had it for the interval or straight away if it's more urgent
+                if (MP_STATE_VM(gil_waiting) != 0
+                    && (MP_STATE_VM(gil_waiter_prio) > MP_STATE_VM(gil_holder_prio)
+                        || mp_hal_ticks_us() - MP_STATE_VM(gil_acquired_us) >= MP_STATE_VM(gil_switch_interval))) {
+                #elif MICROPY_PY_THREAD_GIL_VM_DIVISOR
                 if (--gil_divisor == 0) {
                     gil_divisor = MICROPY_PY_THREAD_GIL_VM_DIVISOR;
                 #else
@@ -1318,6 +1682,9 @@ pending_exception_check:
                     #endif
                     {
                     MP_THREAD_GIL_EXIT();
+                    #if MICROPY_PY_THREAD_GIL_SWITCH_INTERVAL
+                    MICROPY_PY_THREAD_GIL_YIELD();
+                    #endif
                     MP_THREAD_GIL_ENTER();
                     }
                 }
@@ -1365,50 +1732,10 @@ unwind_loop:
             // But consider how to handle nested exceptions.
             // TODO need a better way of not adding traceback to constant objects (right now, just GeneratorExit_obj and MemoryError_obj)
             if (nlr.ret_val != &mp_const_GeneratorExit_obj && nlr.ret_val != &mp_const_MemoryError_obj) {
-                const byte *ip = code_state->fun_bc->bytecode;
-                ip = mp_decode_uint_skip(ip); // skip n_state
-                ip = mp_decode_uint_skip(ip); // skip n_exc_stack
-                ip++; // skip scope_params
-                ip++; // skip n_pos_args
-                ip++; // skip n_kwonly_args
-                ip++; // skip n_def_pos_args
-                size_t bc = code_state->ip - ip;
-                size_t code_info_size = mp_decode_uint_value(ip);
-                ip = mp_decode_uint_skip(ip); // skip code_info_size
-                bc -= code_info_size;
-                #if MICROPY_PERSISTENT_CODE
-                qstr block_name = ip[0] | (ip[1] << 8);
-                qstr source_file = ip[2] | (ip[3] << 8);
-                ip += 4;
-                #else
-                qstr block_name = mp_decode_uint_value(ip);
-                ip = mp_decode_uint_skip(ip);
-                qstr source_file = mp_decode_uint_value(ip);
-                ip = mp_decode_uint_skip(ip);
-                #endif
-                size_t source_line = 1;
-                size_t c;
-                while ((c = *ip)) {
-                    size_t b, l;
-                    if ((c & 0x80) == 0) {
-                        // 0b0LLBBBBB encoding
-                        b = c & 0x1f;
-                        l = c >> 5;
-                        ip += 1;
-                    } else {
-                        // 0b1LLLBBBB 0bLLLLLLLL encoding (l's LSB in second byte)
-                        b = c & 0xf;
-                        l = ((c << 4) & 0x700) | ip[1];
-                        ip += 2;
-                    }
-                    if (bc >= b) {
-                        bc -= b;
-                        source_line += l;
-                    } else {
-                        // found source line corresponding to bytecode offset
-                        break;
-                    }
-                }
+                qstr block_name, source_file;
+                size_t bc_offset;
+                size_t source_line = mp_bytecode_get_source_line(code_state->fun_bc->bytecode,
+                    code_state->ip, &block_name, &source_file, &bc_offset);
                 mp_obj_exception_add_traceback(MP_OBJ_FROM_PTR(nlr.ret_val), source_file, source_line, block_name);
             }
 
@@ -1441,6 +1768,9 @@ unwind_loop:
             } else if (code_state->prev != NULL) {
                 mp_globals_set(code_state->old_globals);
                 code_state = code_state->prev;
+                #if MICROPY_PY_MICROPYTHON_HEAP_PROFILE
+                MP_STATE_THREAD(current_code_state) = code_state;
+                #endif
                 size_t n_state = mp_decode_uint_value(code_state->fun_bc->bytecode);
                 fastn = &code_state->state[n_state - 1];
                 exc_stack = (mp_exc_stack_t*)(code_state->state + n_state);
@@ -1459,3 +1789,51 @@ unwind_loop:
         }
     }
 }
+
+#if MICROPY_PY_MICROPYTHON_PROFILE
+// Find the counters of a function, as in gc_profile_alloc().  Entry 0 is for
+// the functions which find no free entry.
+STATIC mp_profile_fun_t *vm_profile_fun(const byte *bytecode) {
+    mp_profile_fun_t *funs = MP_STATE_VM(profile_funs);
+    size_t hash = (uintptr_t)bytecode ^ ((uintptr_t)bytecode >> 7);
+    for (size_t n = 0; n < MICROPY_PY_MICROPYTHON_PROFILE_FUNS - 1; n++) {
+        mp_profile_fun_t *f = &funs[1 + (hash + n) % (MICROPY_PY_MICROPYTHON_PROFILE_FUNS - 1)];
+        if (f->bytecode == NULL) {
+            f->bytecode = bytecode;
+            return f;
+        }
+        if (f->bytecode == bytecode) {
+            return f;
+        }
+    }
+    return &funs[0];
+}
+
+// Run the bytecode, counting a call when it starts a fresh frame (rather than
+// resuming a generator) and the cycles it took.  The cycles of the functions
+// it calls are counted in its total but not in its self time.  With
+// MICROPY_STACKLESS calls between bytecode functions don't come through here
+// and are counted against the caller.
+mp_vm_return_kind_t mp_execute_bytecode(mp_code_state_t *code_state, volatile mp_obj_t inject_exc) {
+    if (!MP_STATE_VM(profile_enabled)) {
+        return mp_execute_bytecode_run(code_state, inject_exc);
+    }
+    const byte *bytecode = code_state->fun_bc->bytecode;
+    mp_profile_fun_t *f = vm_profile_fun(bytecode);
+    if (code_state->sp == &code_state->state[0] - 1) {
+        f->n_calls += 1;
+    }
+    uint32_t outer_ticks = MP_STATE_THREAD(profile_inner_ticks);
+    MP_STATE_THREAD(profile_inner_ticks) = 0;
+    uint32_t start = MICROPY_PY_MICROPYTHON_PROFILE_TICKS();
+    mp_vm_return_kind_t ret_kind = mp_execute_bytecode_run(code_state, inject_exc);
+    uint32_t ticks = (uint32_t)MICROPY_PY_MICROPYTHON_PROFILE_TICKS() - start;
+    // the counters may have been cleared while the bytecode ran
+    if (f->bytecode == bytecode || f == &MP_STATE_VM(profile_funs)[0]) {
+        f->total_ticks += ticks;
+        f->self_ticks += ticks - MP_STATE_THREAD(profile_inner_ticks);
+    }
+    MP_STATE_THREAD(profile_inner_ticks) = outer_ticks + ticks;
+    return ret_kind;
+}
+#endif // MICROPY_PY_MICROPYTHON_PROFILE
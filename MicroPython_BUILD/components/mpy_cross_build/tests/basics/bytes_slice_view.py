@@ -0,0 +1,80 @@
+# With MICROPY_OPT_BYTES_SLICE_VIEW a long bytes slice shares the data of the
+# bytes it was sliced from: the view must keep that data alive once the
+# source is gone, never form a chain of views, hash and compare like any
+# bytes, and give the consumers that need a terminated string a copy.
+
+try:
+    import uctypes
+    _b = bytes(range(256))
+    if uctypes.addressof(_b[64:200]) != uctypes.addressof(_b) + 64:
+        raise AttributeError
+except (ImportError, AttributeError):
+    print('SKIP')
+    raise SystemExit
+import gc
+import ujson
+import ustruct
+
+MIN = 64
+
+src = bytes(range(256))
+addr = uctypes.addressof(src)
+
+# long slices share, short ones are copies; either way they are bytes
+v = src[16:200]
+s = src[16:16 + MIN - 1]
+print(type(v) is bytes, v == bytes(range(16, 200)), len(v))
+print(uctypes.addressof(v) == addr + 16, uctypes.addressof(s) != addr + 16)
+print(src[:MIN] == bytes(range(MIN)), src[-MIN:] == bytes(range(256 - MIN, 256)))
+
+# a slice of a view points into the original data, not into the view
+vv = v[10:150]
+print(uctypes.addressof(vv) == addr + 26, vv == bytes(range(26, 166)))
+vvv = vv[:]
+print(uctypes.addressof(vvv) == addr + 26, vvv == vv)
+
+
+# the data stays alive when only views of it are left
+def views():
+    data = bytes((i * 7) & 0xff for i in range(1000))
+    return data[100:400], data[500:900][10:300]
+
+
+a, b = views()
+for i in range(200):
+    bytes(300)
+gc.collect()
+print(a == bytes((i * 7) & 0xff for i in range(100, 400)),
+      b == bytes((i * 7) & 0xff for i in range(510, 800)))
+
+# hashing and dict keys, both ways round
+key = bytes(range(100, 200))
+d = {key: 1}
+kv = src[100:200]
+print(hash(kv) == hash(key), d[kv], kv in d)
+d[kv] = 2
+print(len(d), d[key], {kv: 3}[key])
+print(kv == key, kv != key[1:], kv < src[101:201], kv + b'!' == key + b'!')
+
+# bytes methods and operators on views
+print(v.find(bytes([50])), v.startswith(bytes(range(16, 20))), bytes([100]) in v)
+print(len(v * 2), v[5], v[-1], list(v[:3]), bytes(v) == v)
+t = (b'word ' * 30)[5:120]
+print(t.split()[:3], len(t.split()), t.strip()[-4:])
+
+# memoryview, decode and str of a view
+m = memoryview(v)
+print(m[0], m[-1], len(m), bytes(m[10:20]) == v[10:20])
+text = (b'#' + 'héllo wörld '.encode() * 10)[1:]
+print(text.decode()[:12], str(text, 'utf-8') == text.decode(), len(str(text, 'utf-8')))
+
+# consumers that read the data through the buffer protocol
+js = (b' ' * 20 + b'{"a": [1, 2, 3], "b": "x"}' * 4)[20:]
+print(ujson.loads(js[:26]), ujson.loads(memoryview(js)[:26]), ujson.loads(bytearray(js[:26])))
+print(int.from_bytes(v[:8], 'little') == int.from_bytes(bytes(range(16, 24)), 'little'))
+print(ustruct.unpack_from('<HH', v, 4), ustruct.unpack('<I', v[:4]))
+
+# a view whose data isn't followed by a null still gives a terminated string
+fmt_src = b'x<' + b'B' * 70 + b'HHHH'
+fmt = fmt_src[1:72]
+print(len(fmt), ustruct.calcsize(fmt), ustruct.unpack(fmt, bytes(range(70)))[-1])
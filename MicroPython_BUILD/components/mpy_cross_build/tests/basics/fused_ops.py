@@ -0,0 +1,188 @@
+# The fused instructions must give the same results as the sequences they
+# replace: a local and a small int in a binary op, a comparison followed by a
+# jump, and an attribute or method of a local.
+
+
+# local op small int, on small ints at the edges of the small int range
+def add_sub(x):
+    a = x + 1
+    b = x - 1
+    x += 1
+    return a, b, x
+
+
+for e in (30, 31, 62, 63):
+    for v in (2 ** e - 2, 2 ** e - 1, 2 ** e, -(2 ** e) - 1, -(2 ** e), -(2 ** e) + 1):
+        print(e, add_sub(v) == (v + 1, v - 1, v + 1))
+
+
+def count_up(i, n):
+    while i < n:
+        i = i + 1
+    return i
+
+
+def count_down(i, n):
+    while i > n:
+        i -= 1
+    return i
+
+
+print(count_up(2 ** 30 - 3, 2 ** 30 + 2))
+print(count_up(2 ** 62 - 3, 2 ** 62 + 2))
+print(count_down(-(2 ** 30) + 2, -(2 ** 30) - 3))
+print(count_down(-(2 ** 62) + 2, -(2 ** 62) - 3))
+
+
+# local op small int, on operands that are not small ints
+class Num:
+    def __init__(self, v):
+        self.v = v
+
+    def __add__(self, other):
+        return Num(self.v + other)
+
+    def __sub__(self, other):
+        return Num(self.v - other)
+
+    def __iadd__(self, other):
+        self.v += 10 * other
+        return self
+
+    def __lt__(self, other):
+        return self.v < other
+
+    def __repr__(self):
+        return 'Num(%d)' % self.v
+
+
+def ops(x):
+    a = x + 2
+    b = x - 2
+    x += 2
+    return a, b, x
+
+
+print(ops(1.5))
+print(ops(2 ** 100))
+print(ops(True))
+print(ops(Num(5)))
+for x in ('s', [1], (1,), b'b'):
+    try:
+        ops(x)
+    except TypeError:
+        print('TypeError', type(x).__name__)
+
+
+def mul(x):
+    return x * 2, x * -1
+
+
+print(mul('ab'))
+print(mul([1]))
+print(mul(2 ** 40))
+
+
+# compare and jump, on small ints and on other types
+def below(x):
+    if x < 3:
+        return 'below'
+    return 'not below'
+
+
+def while_below(x):
+    n = 0
+    while x < 3:
+        x = x + 1
+        n += 1
+    return n
+
+
+for x in (2, 3, -5, 2.5, 3.5, 2 ** 70, -(2 ** 70), True, Num(2), Num(4)):
+    print(repr(x), below(x))
+
+for x in (2, 3, -5, 2.5, 3.5, 2 ** 70, -(2 ** 70) // 2 ** 68, True):
+    print(repr(x), while_below(x))
+
+try:
+    below('a')
+except TypeError:
+    print('TypeError')
+
+
+def equal(x, y):
+    if x == y:
+        return True
+    return False
+
+
+print(equal(1, 1), equal(1, 1.0), equal('a', 'a'), equal([1], [2]), equal(None, 0))
+
+
+# unbound local
+def unbound(flag):
+    if flag:
+        x = 1
+    return x + 1
+
+
+print(unbound(True))
+try:
+    unbound(False)
+except NameError:
+    print('NameError')
+
+
+# attribute and method of a local
+class Point:
+    def __init__(self, x):
+        self.x = x
+
+    def get(self):
+        return self.x
+
+
+class Slotted(Point):
+    @property
+    def x(self):
+        return self._x * 2
+
+    @x.setter
+    def x(self, v):
+        self._x = v
+
+
+def attrs(p):
+    return p.x, p.get()
+
+
+print(attrs(Point(4)))
+print(attrs(Slotted(4)))
+
+l = [3, 1, 2]
+
+
+def methods(o):
+    o.append(0)
+    o.sort()
+    return o.pop()
+
+
+print(methods(l), l)
+
+
+def get(d):
+    return d.get(1), d.get(2, 'none')
+
+
+class Store:
+    def get(self, k, d=None):
+        return (k, d)
+
+
+print(get({1: 'one'}))
+print(get(Store()))
+try:
+    methods('s')
+except AttributeError:
+    print('AttributeError')
@@ -0,0 +1,91 @@
+# gc.compact() moves the payloads of bytes, bytearray, array, dict and
+# instance objects down into the holes below them: the objects keep their
+# identity and contents, and a payload that a memoryview on the stack or in
+# the heap points into stays where it is.
+
+try:
+    import gc
+    gc.compact
+except AttributeError:
+    print('SKIP')
+    raise SystemExit
+import uctypes
+from array import array
+
+
+class Obj:
+    pass
+
+
+def make(i):
+    o = Obj()
+    for j in range(12):
+        setattr(o, 'a%d' % j, i * 100 + j)
+    return [
+        bytes(range(i, i + 120)),
+        bytearray(range(i + 1, i + 201)),
+        array('i', range(i, i + 60)),
+        {'k%d' % j: i * 1000 + j for j in range(24)},
+        o,
+    ]
+
+
+def check(i, objs):
+    b, ba, a, d, o = objs
+    return (b == bytes(range(i, i + 120))
+            and ba == bytearray(range(i + 1, i + 201))
+            and a == array('i', range(i, i + 60))
+            and all(d['k%d' % j] == i * 1000 + j for j in range(24)) and len(d) == 24
+            and all(getattr(o, 'a%d' % j) == i * 100 + j for j in range(12)))
+
+
+# owners with holes between them, so their payloads can move down
+gc.collect()
+groups = []
+holes = []
+for i in range(16):
+    holes.append(bytearray(400))
+    groups.append(make(i))
+holes = None
+
+ids = [[id(x) for x in objs] for objs in groups]
+addrs = [[uctypes.addressof(x) for x in objs[:3]] for objs in groups]
+
+# a payload pinned from the heap, and one pinned from a local of the caller
+pinned_heap = groups[3][1]
+views = [memoryview(pinned_heap)]
+pinned_stack = groups[5][1]
+
+
+def compact(view):
+    # the view stays live on the stack across the compaction
+    return gc.compact(), view
+
+
+(moved, before, after), view = compact(memoryview(pinned_stack)[10:])
+
+print(moved > 0, after >= before)
+print(all(check(i, objs) for i, objs in enumerate(groups)))
+print(all(ids[i] == [id(x) for x in objs] for i, objs in enumerate(groups)))
+print(any(addrs[i] != [uctypes.addressof(x) for x in objs[:3]] for i, objs in enumerate(groups)))
+
+# the pinned payloads have not moved, and their views still see them
+print(uctypes.addressof(pinned_heap) == addrs[3][1], uctypes.addressof(pinned_stack) == addrs[5][1])
+pinned_heap[7] = 99
+view[0] = 77
+print(views[0][7], pinned_stack[10])
+
+# the moved payloads can still be written, grown and freed
+for i, objs in enumerate(groups):
+    b, ba, a, d, o = objs
+    ba.extend(b'end')
+    a.append(-1)
+    d['new'] = i
+    o.new = i
+print(all(objs[1][-3:] == b'end' and objs[2][-1] == -1 and objs[3]['new'] == i and objs[4].new == i
+          for i, objs in enumerate(groups)))
+groups = None
+views = None
+view = None
+gc.collect()
+print(gc.compact()[0] >= 0)
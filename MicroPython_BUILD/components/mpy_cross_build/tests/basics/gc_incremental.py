@@ -0,0 +1,95 @@
+# gc.collect(budget_us=...) runs an incremental collection a step at a time,
+# and the program runs between the steps: objects stored into containers
+# that were already traced, or moved there out of ones not traced yet, must
+# survive the end of the cycle, in every way of storing them.
+
+import gc
+from array import array
+
+try:
+    gc.collect(budget_us=0)
+except TypeError:
+    print('SKIP')
+    raise SystemExit
+
+N = 200
+
+
+class Obj:
+    pass
+
+
+def young(i):
+    return ('young', i, (i, -i), 'y%d' % i)
+
+
+def is_young(x, i):
+    return x == ('young', i, (i, -i), 'y%d' % i)
+
+
+# enough containers that a cycle takes many steps
+lists = [[None] * 4 for i in range(N)]
+dicts = [{} for i in range(N)]
+sets = [set() for i in range(N)]
+arrays = [array('O', [None] * 4) for i in range(N)]
+objs = [Obj() for i in range(N)]
+# young objects held only here at first, to be moved into the containers
+moving = [[young(-1 - i)] for i in range(N)]
+
+
+def store(k, n):
+    # stores into container k by each path, returning the numbers stored
+    lists[k][0] = young(n)
+    lists[k].append(young(n + 1))
+    lists[k].insert(0, young(n + 2))
+    lists[k][2:3] = [young(n + 3)]
+    dicts[k][n] = young(n + 4)
+    dicts[k].update({'u': young(n + 5)})
+    sets[k].add(young(n + 6))
+    arrays[k][0] = young(n + 7)
+    arrays[k].append(young(n + 8))
+    objs[k].x = young(n + 9)
+    setattr(objs[k], 'y', young(n + 10))
+    # and a move: the old holder lets go of it
+    objs[k].moved = moving[k].pop()
+
+
+def check(k, n):
+    return (is_young(lists[k][0], n + 2) and is_young(lists[k][1], n)
+            and is_young(lists[k][2], n + 3) and is_young(lists[k][-1], n + 1)
+            and is_young(dicts[k][n], n + 4) and is_young(dicts[k]['u'], n + 5)
+            and any(is_young(x, n + 6) for x in sets[k])
+            and is_young(arrays[k][0], n + 7) and is_young(arrays[k][-1], n + 8)
+            and is_young(objs[k].x, n + 9) and is_young(objs[k].y, n + 10)
+            and is_young(objs[k].moved, -1 - k))
+
+
+gc.collect()
+steps = 0
+done = False
+stored = []
+while not done:
+    done = gc.collect(budget_us=0)
+    # store into containers on both sides of where the trace has got to
+    for k in (steps * 7 % N, N - 1 - steps * 7 % N):
+        if k not in [s[0] for s in stored]:
+            store(k, 100 * len(stored))
+            stored.append((k, 100 * len(stored)))
+    steps += 1
+print(steps > 2, len(stored) > 2)
+
+# the cycle is over; collect again so anything left unmarked is freed
+for i in range(2):
+    gc.collect()
+    for j in range(200):
+        [j] * 16
+print(all(check(k, n) for k, n in stored))
+
+# a second cycle, stored into throughout again
+done = False
+while not done:
+    done = gc.collect(budget_us=0)
+    for k, n in stored:
+        objs[k].x = young(n + 9)
+gc.collect()
+print(all(check(k, n) for k, n in stored))
@@ -0,0 +1,142 @@
+# Young objects stored only in old containers must survive the collections
+# that follow: with MICROPY_GC_NURSERY a minor collection traces only the
+# old blocks written since the last one, so every way of storing into a
+# list, dict, set, object array or instance has to record the write.  On
+# other builds the same stores just go through full collections.
+
+import gc
+from array import array
+
+nursery = hasattr(gc, 'nursery')
+if nursery:
+    gc.nursery(4096)
+
+K = 16
+
+
+class Obj:
+    pass
+
+
+def young(i):
+    # a new object that is easy to check, with young contents of its own
+    return ('young', i, (i, -i), 'y%d' % i)
+
+
+def is_young(x, i):
+    return x == ('young', i, (i, -i), 'y%d' % i)
+
+
+def churn():
+    # allocate enough garbage for several minor collections
+    for i in range(200):
+        [i] * 16
+
+
+# containers that become old in a full collection; they are held by an old
+# object rather than by the module globals, whose table hangs off the roots
+# and is traced on every minor collection
+def containers():
+    h = Obj()
+    h.l = [None] * K
+    h.d = {}
+    h.s = set()
+    h.a = array('O', [None] * K)
+    h.o = Obj()
+    return h
+
+
+h = containers()
+gc.collect()
+
+n = 0
+
+
+def new():
+    global n
+    n += 1
+    return young(n)
+
+
+def run(name, store, load):
+    # make K stores, then after some minor collections check what they stored
+    first = n + 1
+    for j in range(K):
+        store(j, new())
+    churn()
+    churn()
+    print(name, all(is_young(load(j), first + j) for j in range(K)))
+
+
+def list_setitem(j, v):
+    h.l[j] = v
+
+
+def list_slice(j, v):
+    h.l[j:j + 1] = [v]
+
+
+def dict_setitem(j, v):
+    h.d[j] = v
+
+
+def dict_key(j, v):
+    h.d[v] = j
+
+
+def array_setitem(j, v):
+    h.a[j] = v
+
+
+def array_slice(j, v):
+    h.a[j:j + 1] = array('O', [v])
+
+
+def store_attr(j, v):
+    h.o.x = v
+    setattr(h.o, 'a%d' % j, h.o.x)
+
+
+def by_number(objs):
+    return {x[1]: x for x in objs if isinstance(x, tuple)}
+
+
+run('list setitem', list_setitem, lambda j: h.l[j])
+base = len(h.l)
+run('list append', lambda j, v: h.l.append(v), lambda j: h.l[base + j])
+run('list insert', lambda j, v: h.l.insert(0, v), lambda j: h.l[K - 1 - j])
+base = len(h.l)
+run('list extend', lambda j, v: h.l.extend([v]), lambda j: h.l[base + j])
+run('list slice', list_slice, lambda j: h.l[j])
+
+run('dict setitem', dict_setitem, lambda j: h.d[j])
+run('dict setdefault', lambda j, v: h.d.setdefault(-1 - j, v), lambda j: h.d[-1 - j])
+run('dict update', lambda j, v: h.d.update({'u%d' % j: v}), lambda j: h.d['u%d' % j])
+first = n + 1
+run('dict key', dict_key, lambda j: by_number(h.d)[first + j])
+
+first = n + 1
+run('set add', lambda j, v: h.s.add(v), lambda j: by_number(h.s)[first + j])
+first = n + 1
+run('set update', lambda j, v: h.s.update([v]), lambda j: by_number(h.s)[first + j])
+
+run('array setitem', array_setitem, lambda j: h.a[j])
+base = len(h.a)
+run('array append', lambda j, v: h.a.append(v), lambda j: h.a[base + j])
+base = len(h.a)
+run('array extend', lambda j, v: h.a.extend(array('O', [v])), lambda j: h.a[base + j])
+run('array slice', array_slice, lambda j: h.a[j])
+
+run('instance attr', store_attr, lambda j: getattr(h.o, 'a%d' % j))
+
+# the same containers again, now that they have been written to before
+run('list setitem again', list_setitem, lambda j: h.l[j])
+run('dict setitem again', dict_setitem, lambda j: h.d[j])
+run('instance attr again', store_attr, lambda j: getattr(h.o, 'a%d' % j))
+
+# and after a full collection, which makes everything so far old
+gc.collect()
+run('list after full', list_setitem, lambda j: h.l[j])
+run('dict after full', dict_setitem, lambda j: h.d[j])
+
+print(not nursery or gc.mem_info()[0] > 0)
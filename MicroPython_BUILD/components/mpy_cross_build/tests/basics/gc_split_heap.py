@@ -0,0 +1,47 @@
+# cmdline: -X fastheap=64k
+# test the placement of allocations in the regions of a split heap
+
+import gc
+
+try:
+    gc.mem_regions
+except AttributeError:
+    print("SKIP")
+    raise SystemExit
+
+
+def used():
+    gc.collect()
+    r = gc.mem_regions()
+    return r[0][1], r[1][1]
+
+
+print(gc.mem_regions()[1][0])
+
+# small objects go in the fast region
+objs = [None] * 1000
+main0, fast0 = used()
+for i in range(len(objs)):
+    objs[i] = (i, i)
+main1, fast1 = used()
+print(fast1 - fast0 >= 1000 * 2 * 8, main1 - main0 < 1000)
+
+# buffers go in the main region, their objects in the fast one
+buf = bytearray(10000)
+main2, fast2 = used()
+print(main2 - main1 >= 10000, fast2 - fast1 < 100)
+
+# small objects spill into the main region when the fast one is full
+more = [None] * 5000
+for i in range(len(more)):
+    more[i] = (i, i)
+main3, fast3 = used()
+print(gc.mem_regions()[1][2] < 1024, main3 - main2 > 5000 * 2 * 8 - 65536)
+
+# and the fast region is used again when they are freed
+objs = more = None
+main4, fast4 = used()
+print(fast4 - fast0 < 1000, main4 - main2 < 1000)
+objs = [(i, i) for i in range(100)]
+main5, fast5 = used()
+print(fast5 > fast4)
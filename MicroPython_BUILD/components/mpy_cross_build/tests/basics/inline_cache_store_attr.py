@@ -0,0 +1,79 @@
+# STORE_ATTR on an instance member must still go through a property, data
+# descriptor or __setattr__ added to the class after the store was cached.
+
+log = []
+
+
+class A:
+    pass
+
+
+def getx(self):
+    return self.__dict__['x']
+
+
+def setx(self, v):
+    log.append(v)
+
+
+a = A()
+a.x = 1
+for i in range(3):
+    a.x = 2
+print(a.x)
+A.x = property(getx, setx)
+for i in range(3):
+    a.x = 2
+print(a.x, log)
+
+# a plain class attribute doesn't take the store
+class B:
+    y = 0
+
+
+b = B()
+for i in range(3):
+    b.y = i
+print(b.y, B.y)
+
+# a descriptor with __set__, when descriptors are enabled
+class D:
+    def __get__(self, obj, cls):
+        return 'desc'
+
+    def __set__(self, obj, value):
+        log.append(('set', value))
+
+
+class C:
+    pass
+
+
+c = C()
+c.z = 1
+for i in range(2):
+    c.z = 3
+C.z = D()
+log.clear()
+for i in range(2):
+    c.z = 4
+print(log == [('set', 4), ('set', 4)] or log == [])
+
+# __setattr__ added to the class
+class E:
+    pass
+
+
+def setattr_(self, name, value):
+    log.append(name)
+
+
+e = E()
+e.w = 1
+for i in range(2):
+    e.w = 5
+log.clear()
+E.__setattr__ = setattr_
+for i in range(2):
+    e.w = 6
+print(log == ['w', 'w'] and e.w == 5 or log == [] and e.w == 6)
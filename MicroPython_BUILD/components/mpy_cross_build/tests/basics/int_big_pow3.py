@@ -0,0 +1,73 @@
+# pow(a, b, m) on big ints, with odd moduli (Montgomery form) and even moduli,
+# checked against square-and-multiply with %, and big products (Karatsuba)
+# checked against their factors.
+
+seed = 1
+
+
+def rand_bits(bits):
+    global seed
+    n = 0
+    for i in range(0, bits, 16):
+        seed = (seed * 1103515245 + 12345) & 0x7fffffff
+        n = n << 16 | seed >> 15
+    n >>= (bits + 15) // 16 * 16 - bits
+    return n | 1 << (bits - 1)
+
+
+def ref_pow(a, b, m):
+    r = 1 % m
+    a %= m
+    while b:
+        if b & 1:
+            r = r * a % m
+        a = a * a % m
+        b >>= 1
+    return r
+
+
+def check(a, b, m):
+    return pow(a, b, m) == ref_pow(a, b, m)
+
+
+# odd and even moduli of various sizes, and exponents that are short, long,
+# all ones and sparse, so that every window size is used
+for bits in (16, 31, 32, 33, 63, 64, 65, 127, 128, 256, 521, 1024, 2048):
+    for odd in (True, False):
+        m = rand_bits(bits)
+        m = m | 1 if odd else m & ~1
+        ok = True
+        for e in (0, 1, 2, 3, 255, 65537, (1 << 200) - 1, 1 << 300, rand_bits(bits)):
+            a = rand_bits(bits + 7)
+            ok = ok and check(a, e, m) and check(a % m, e, m) and check(m - 1, e, m)
+        print(bits, 'odd' if odd else 'even', ok)
+
+# powers of two and one less as moduli, and bases that are 0, 1 or -1
+for m in (1, 2, 3, 1 << 64, (1 << 64) - 1, (1 << 64) + 1, 1 << 128, (1 << 128) - 1):
+    print(m, [check(a, e, m) for a in (0, 1, -1, 2, -(1 << 100)) for e in (0, 1, 2, 1 << 70)])
+
+# a known result
+print(pow(3, (1 << 2048) - 1, (1 << 2048) + 981))
+
+# products big enough for Karatsuba, including very unequal and negative ones
+p = 0xfffffffb
+for abits, bbits in ((512, 512), (2048, 2048), (2048, 2049), (8192, 1024), (65536, 4096), (4096, 64)):
+    for sa, sb in ((1, 1), (-1, 1), (-1, -1)):
+        a = sa * rand_bits(abits)
+        b = sb * rand_bits(bbits)
+        c = a * b
+        print(abits, bbits, sa * sb, c // a == b, c // b == a, c % p == (a % p) * (b % p) % p)
+
+# squares, which multiply an operand by itself
+a = rand_bits(4096)
+print((a * a) // a == a, (a * a) % p == (a % p) ** 2 % p, a ** 2 == a * a)
+
+# divisions where a digit of the quotient is first estimated as a digit too
+# big, as the leading digits of the numerator and denominator are equal
+for k in (48, 64, 65, 96, 128, 2048):
+    m = (1 << k) - 1
+    ok = True
+    for x in ((m - 1) << 32, (m - 1) << 64, (m - 1) << 96, (m - 1) * (m - 1), m << k | m):
+        q, r = divmod(x, m)
+        ok = ok and q * m + r == x and 0 <= r < m
+    print(k, ok, ((m - 1) << 64) % m)
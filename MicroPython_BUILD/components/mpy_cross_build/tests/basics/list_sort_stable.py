@@ -0,0 +1,115 @@
+# list.sort() and sorted() are stable merge sorts: equal elements keep their
+# order, also with key= and reverse=True, runs already in order are found,
+# and a comparison or key function that raises leaves every element in the
+# list.
+
+seed = 1
+
+
+def rand(n):
+    global seed
+    seed = (seed * 1103515245 + 12345) & 0x7fffffff
+    return seed % n
+
+
+class Item:
+    # compares by key only, so that the order of equal items shows
+    def __init__(self, key, n):
+        self.key = key
+        self.n = n
+
+    def __lt__(self, other):
+        return self.key < other.key
+
+    def __repr__(self):
+        return '%d.%d' % (self.key, self.n)
+
+
+def stable(l, key=lambda x: x, reverse=False):
+    # the items are sorted, and equal keys are in the order they came in
+    for a, b in zip(l, l[1:]):
+        ka, kb = key(a), key(b)
+        if (kb < ka if not reverse else ka < kb):
+            return False
+        if not ka < kb and not kb < ka and a.n > b.n:
+            return False
+    return True
+
+
+def items(keys):
+    return [Item(k, n) for n, k in enumerate(keys)]
+
+
+# sizes around the minimum run and the merge buffer, and keys with few and
+# many duplicates
+for size in (0, 1, 2, 31, 32, 33, 64, 65, 200, 1000, 3000):
+    for spread in (2, 10, 1000000):
+        l = items([rand(spread) for i in range(size)])
+        s = sorted(l)
+        r = sorted(l, reverse=True)
+        k = sorted(l, key=lambda x: -x.key)
+        l.sort()
+        print(size, spread, l == s, stable(s), stable(r, reverse=True),
+              stable(k, key=lambda x: -x.key), len(s) == size)
+
+# inputs made of runs: sorted, reversed, sawtooth, organ pipe, one out of place
+N = 1000
+for name, keys in (
+        ('sorted', list(range(N))),
+        ('reversed', list(range(N, 0, -1))),
+        ('equal', [7] * N),
+        ('sawtooth', [i % 50 for i in range(N)]),
+        ('pipe', list(range(N // 2)) + list(range(N // 2, 0, -1))),
+        ('one', list(range(1, N)) + [0]),
+        ('descending runs', [i // 10 * 10 + 9 - i % 10 for i in range(N)]),
+        ('equal descending', [N - i // 3 for i in range(N)])):
+    l = items(keys)
+    l.sort()
+    print(name, stable(l), [x.key for x in l] == sorted(keys))
+
+# plain values of the types the sort compares quickly and those it doesn't
+vals = [rand(1 << 20) - (1 << 19) for i in range(500)]
+print(sorted(vals) == sorted(vals, key=lambda x: x), sorted(vals)[:5])
+print(sorted([1 << 70, -3, 2.5, 0, -(1 << 65), 1, True]))
+print(sorted(['b', 'a', 'ab', '', 'ba', 'A']), sorted([(1, 'b'), (1, 'a'), (0, 'z')]))
+print(sorted(range(10), key=lambda x: x % 3), sorted(range(10), key=lambda x: x % 3, reverse=True))
+
+# a key function is called once per item
+calls = []
+sorted(range(100), key=lambda x: calls.append(x) or -x)
+print(len(calls))
+
+
+# an exception in a comparison or a key leaves every element in the list
+class Bad:
+    def __init__(self, n):
+        self.n = n
+
+    def __lt__(self, other):
+        if self.n == 13 or other.n == 13:
+            raise ValueError('bad')
+        return self.n < other.n
+
+
+for size in (20, 100, 1000):
+    l = [Bad((i * 37) % size) for i in range(size)]
+    try:
+        l.sort()
+    except ValueError as e:
+        print('ValueError', e)
+    print(len(l), sorted(x.n for x in l) == list(range(size)))
+
+l = list(range(100, 0, -1))
+try:
+    l.sort(key=lambda x: 1 // (x - 50))
+except ZeroDivisionError:
+    print('ZeroDivisionError')
+print(sorted(l) == list(range(1, 101)))
+
+
+# a key function that resizes the list makes the sort fail
+l = list(range(10))
+try:
+    l.sort(key=lambda x: l.append(x) or x)
+except ValueError:
+    print('ValueError')
@@ -0,0 +1,64 @@
+# micropython.heap_profile() counts the heap allocations of each bytecode
+# instruction while it is on: the counts belong to the line that allocated,
+# also in generators and callees, and nothing is counted while it is off.
+
+try:
+    import micropython
+    micropython.heap_profile
+except AttributeError:
+    print('SKIP')
+    raise SystemExit
+
+
+def lists(n):
+    for i in range(n):
+        l = [i] * 10
+    return l
+
+
+def buffers(n):
+    for i in range(n):
+        b = bytearray(200)
+    return b
+
+
+def gen(n):
+    for i in range(n):
+        yield (i, str(i) * 20)
+
+
+def sites_of(report):
+    # the sites in this file, by function
+    sites = {}
+    for name, file, line, offset, nbytes, nallocs in report:
+        if name is not None and file.endswith('micropython_heap_profile.py'):
+            sites.setdefault(name, []).append((line, nbytes, nallocs))
+    return sites
+
+
+micropython.heap_profile(True)
+lists(50)
+buffers(20)
+for x in gen(30):
+    pass
+micropython.heap_profile(False)
+report = micropython.heap_profile()
+
+# largest first
+print(all(report[i][4] >= report[i + 1][4] for i in range(len(report) - 1)))
+print(all(nbytes > 0 and nallocs > 0 for name, file, line, offset, nbytes, nallocs in report))
+sites = sites_of(report)
+for name, lineno, n, size in (('lists', 15, 50, 10 * 4), ('buffers', 21, 20, 200), ('gen', 27, 30, 20)):
+    line, nbytes, nallocs = max(sites[name], key=lambda s: s[1])
+    print(name, line == lineno, nallocs >= n and nallocs % n == 0, nbytes >= n * size)
+
+# off, nothing more is counted
+lists(10)
+print(micropython.heap_profile() == report)
+
+# on again, the counts start from zero
+micropython.heap_profile(True)
+lists(7)
+micropython.heap_profile(False)
+sites = sites_of(micropython.heap_profile())
+print(sorted(sites), max(sites['lists'], key=lambda s: s[1])[2] % 7 == 0)
@@ -0,0 +1,92 @@
+# micropython.profile() counts the opcodes run and the calls and cycles of
+# each function while it is on: calls are counted when a frame starts, not
+# when a generator resumes, and the cycles of callees are not in a caller's
+# self time, also across exceptions and recursion.
+
+try:
+    import micropython
+    micropython.profile
+except AttributeError:
+    print('SKIP')
+    raise SystemExit
+
+
+def leaf(x):
+    return x + 1
+
+
+def middle(n):
+    s = 0
+    for i in range(n):
+        s = leaf(s)
+    return s
+
+
+def gen(n):
+    for i in range(n):
+        yield i
+
+
+def fib(n):
+    return n if n < 2 else fib(n - 1) + fib(n - 2)
+
+
+def fail():
+    raise ValueError
+
+
+def catch():
+    try:
+        fail()
+    except ValueError:
+        return leaf(0)
+
+
+def by_name(funs):
+    return {f[0]: f for f in funs if f[0] is not None}
+
+
+micropython.profile(True)
+middle(10)
+middle(5)
+sum(gen(4))
+fib(6)
+catch()
+micropython.profile(False)
+ops, funs = micropython.profile()
+
+# opcodes are bytes, most run first
+print(all(0 <= op < 256 and n > 0 for op, n in ops))
+print(all(ops[i][1] >= ops[i + 1][1] for i in range(len(ops) - 1)))
+
+# functions, most total cycles first, with their calls
+print(all(funs[i][4] >= funs[i + 1][4] for i in range(len(funs) - 1)))
+print(all(0 <= self <= total for name, file, line, calls, total, self in funs))
+f = by_name(funs)
+for name in ('leaf', 'middle', 'gen', 'fib', 'fail', 'catch'):
+    print(name, f[name][3], f[name][1].endswith('micropython_profile.py'))
+print(f['leaf'][2] < f['middle'][2] < f['gen'][2] < f['fib'][2])
+print(f['middle'][4] >= f['leaf'][4], f['catch'][4] >= f['fail'][4])
+
+# off, nothing more is counted
+middle(3)
+print(micropython.profile() == (ops, funs))
+
+# on again, the counts start from zero
+micropython.profile(True)
+middle(3)
+micropython.profile(False)
+f = by_name(micropython.profile()[1])
+print(f['middle'][3], f['leaf'][3], 'fib' in f)
+
+# functions that don't fit in the table are counted together as None
+g = {}
+for i in range(100):
+    exec('def f%d():\n    return %d' % (i, i), g)
+micropython.profile(True)
+for i in range(100):
+    g['f%d' % i]()
+micropython.profile(False)
+funs = micropython.profile()[1]
+print(sum(calls for name, file, line, calls, total, self in funs if name is None or name.startswith('f')) >= 100)
+print(any(name is None for name, file, line, calls, total, self in funs))
@@ -0,0 +1,114 @@
+# micropython.schedule() queues callbacks in a ring per priority level: they
+# run oldest first from the highest level, a full level drops the callback
+# and counts it, coalesce=True leaves out a callback that is still waiting,
+# and schedule_depth() resizes the rings keeping what is pending in order.
+
+try:
+    import micropython
+    micropython.schedule_stats
+except AttributeError:
+    print('SKIP')
+    raise SystemExit
+
+ran = []
+
+
+def cb(arg):
+    ran.append(arg)
+
+
+def run(setup):
+    # callbacks queued by a callback wait until it returns, as the scheduler
+    # is locked while one runs; one runs at each turn of the loop
+    del ran[:]
+    micropython.schedule(setup, None)
+    n = 0
+    while n < 3 or micropython.schedule_stats()[0]:
+        n += 1
+    return ran[:]
+
+
+def fifo(_):
+    for i in range(6):
+        micropython.schedule(cb, i)
+
+
+print('fifo', run(fifo))
+
+
+def priorities(_):
+    micropython.schedule(cb, 'low0')
+    micropython.schedule(cb, 'high0', priority=1)
+    micropython.schedule(cb, 'low1', priority=0)
+    micropython.schedule(cb, 'high1', priority=1)
+
+
+print('priorities', run(priorities))
+
+
+def coalesce(_):
+    for i in range(5):
+        micropython.schedule(cb, 'a', coalesce=True)
+        micropython.schedule(cb, 'b', coalesce=True)
+    micropython.schedule(cb, 'a')
+    micropython.schedule(cb, 'a', priority=1, coalesce=True)
+    micropython.schedule(cb, 'a', priority=1, coalesce=True)
+
+
+print('coalesce', run(coalesce))
+
+
+def nested(arg):
+    ran.append(arg)
+    if arg < 3:
+        micropython.schedule(nested, arg + 1)
+
+
+print('nested', run(lambda _: micropython.schedule(nested, 0)))
+
+# a full level drops the callback, the other level still has room
+depth = micropython.schedule_depth()
+full = []
+
+
+def overflow(_):
+    pending, max_depth, dropped = micropython.schedule_stats()
+    for i in range(depth + 3):
+        try:
+            micropython.schedule(cb, i)
+        except RuntimeError:
+            full.append(i)
+    micropython.schedule(cb, 'high', priority=1)
+    stats = micropython.schedule_stats()
+    full.append((stats[0] == depth + 1, stats[1] >= depth + 1, stats[2] - dropped))
+
+
+r = run(overflow)
+print('overflow', r[0], r[1:] == list(range(depth)), full[:3] == list(range(depth, depth + 3)), full[3])
+
+
+# resizing keeps what is pending in order and drops what doesn't fit
+def resize(_):
+    for i in range(6):
+        micropython.schedule(cb, i)
+    micropython.schedule(cb, 'h', priority=1)
+    micropython.schedule_depth(4)
+    print('resized', micropython.schedule_depth(), micropython.schedule_stats()[0])
+
+
+print(run(resize))
+micropython.schedule_depth(3)
+print(micropython.schedule_depth())
+micropython.schedule_depth(depth)
+print(micropython.schedule_depth() == depth, micropython.schedule_stats()[0])
+
+for args, kw in (((cb, 0), {'priority': 2}), ((cb, 0), {'priority': -1})):
+    try:
+        micropython.schedule(*args, **kw)
+    except ValueError:
+        print('ValueError')
+for d in (0, 1025):
+    try:
+        micropython.schedule_depth(d)
+    except ValueError:
+        print('ValueError')
@@ -0,0 +1,53 @@
+# OrderedDicts of more than 8 entries are looked up through a hash index,
+# which has to follow insertions, removals, growth and copies
+from ucollections import OrderedDict
+
+d = OrderedDict()
+for i in range(40):
+    d['k%d' % i] = i
+    d[i * 7] = str(i)
+print(len(d), d['k0'], d['k39'], d[0], d[273])
+
+# removal leaves holes in the table
+for i in range(0, 40, 3):
+    del d['k%d' % i]
+    d.pop(i * 7)
+print(len(d), list(d.keys())[:6])
+print('k3' in d, 'k4' in d, 21 in d, 28 in d)
+
+# entries added after a removal keep their order
+d['k3'] = -3
+d[21] = '-21'
+print(list(d.items())[-2:])
+
+# copies and popitem
+c = d.copy()
+print(c == d, len(c), c['k4'], c[28])
+k, v = c.popitem()
+print(k in c, c.get(k), k in d)
+while len(c) > 5:
+    c.popitem()
+print(len(c), len(d))
+
+# keys of equal hash
+d = OrderedDict()
+for i in range(20):
+    d[i] = i
+    d[float(i) + 0.5] = i
+d[1.0] = 'one'
+print(len(d), d[1], d[True], d[2.5])
+
+# holes are squeezed out once there are more of them than entries, and by
+# growth; the index slots are wider for tables of 255 entries or more
+for n in (20, 300):
+    d = OrderedDict()
+    for i in range(n):
+        d[i] = i
+    for i in range(0, n, 3):
+        del d[i]
+    for i in range(n, 2 * n):
+        d[i] = i
+        if (i - n + 1) % 3:
+            del d[i - n + 1]
+    print(len(d), list(d)[:4], list(d)[-2:], sum(d.values()))
+    print(all(d[k] == k for k in d), (n - 1) in d, 1 in d)
@@ -0,0 +1,80 @@
+# s += t may append to spare room after s instead of copying: other names for
+# the old value, and strings that share the room, must never see the change,
+# and the results must hash, compare and convert like any other str or bytes.
+
+try:
+    import ustruct as struct
+except ImportError:
+    import struct
+
+# a long string built a chunk at a time
+s = ''
+for i in range(2000):
+    s += 'x%d,' % i
+print(len(s), s[:20], s[-10:], s.count(','))
+
+# the old value is not changed by appending to the new one
+s = 'abc'
+s += 'def'
+a = s
+s += 'ghi'
+print(a, s)
+
+# two strings that share the room both append
+b = s
+s += '123'
+b += 'XYZ'
+print(a, s, b)
+s = s + '456'
+b = b + '789'
+print(s, b, s + b)
+
+# appending a string to itself
+t = 'ab'
+t += 'cd'
+t += t
+t += t
+print(t, len(t))
+
+# hashes, dict keys and comparisons
+k = 'ke'
+k += 'y'
+k += '1'
+d = {'key1': 1}
+print(d[k], k == 'key1', k in d, hash(k) == hash('key1'), 'key1' in {k: 0})
+k2 = k
+k += '2'
+print({k2: 2}['key1'], k2, k, k > k2, k.startswith(k2))
+
+# methods on appended strings and on their stale shorter names
+w = ''
+parts = []
+for i in range(10):
+    w += 'word%d ' % i
+    parts.append(w)
+print(parts[3].split(), parts[9].find('word5'), parts[2].upper(), parts[4][-6:])
+print(''.join(parts[:3]), parts[0] + parts[1])
+
+# non-ASCII characters
+u = 'ä'
+for i in range(5):
+    u += 'ö€'
+print(u, len(u), u[3], u.encode())
+
+# bytes
+y = b''
+for i in range(300):
+    y += bytes([i & 0xff])
+z = y
+y += b'end'
+print(len(y), len(z), y[-3:], z[-3:], y[:300] == z, bytes(range(256)) == z[:256])
+y2 = z + b'!'
+print(y2[-2:], y2 == z + b'!')
+
+# a stale name has lost its terminating null but still works where one is needed
+fmt = '<'
+fmt += 'B'
+fmt += 'H'
+f2 = fmt
+fmt += 'I'
+print(struct.calcsize(f2), struct.calcsize(fmt), struct.unpack(f2, b'\x01\x02\x03'))
@@ -0,0 +1,67 @@
+# str.format() keeps parsed constant templates in a small cache: repeated
+# templates, templates that evict each other, and formatting that runs Python
+# code using another template must give the same results as parsing afresh,
+# and templates the cache doesn't handle, or that are wrong, must still be
+# formatted or rejected by the full parser every time.
+
+
+class Point:
+    def __init__(self, x, y):
+        self.x = x
+        self.y = y
+
+    def __str__(self):
+        # formats with another template while the outer one is in progress
+        return '({}, {})'.format(self.x, self.y)
+
+    def __repr__(self):
+        return 'Point({!r}, {!r})'.format(self.x, self.y)
+
+
+p = Point(1, 'a')
+
+# each template twice, so the second time it comes from the cache
+for i in range(2):
+    print('{} {} {}'.format(1, 'two', 3.5))
+    print('{0}-{1}-{0}'.format('a', 'b'), '{1}{0}'.format(1, 2))
+    print('[{:5}|{:<5}|{:>5}|{:^5}|{:*^7}]'.format(1, 2, 3, 4, 5))
+    print('[{:+d}|{: d}|{:05d}|{:x}|{:#X}|{:o}|{:#b}|{:,}]'.format(7, 7, -7, 255, 255, 8, 5, 1234567))
+    print('[{:8.3f}|{:.2e}|{:g}|{:.1%}|{:<8.2f}]'.format(3.14159, 12345.678, 0.5, 0.25, 2.5))
+    print('[{:.3}|{:>6.2}|{!r}|{!s}|{!r:>8}]'.format('abcdef', 'xyz', 'q', 'q', 'q'))
+    print('{} and {!r} and {:>10}'.format(p, p, str(p)))
+    print('{{}} {{{}}} }}{{ {{'.format(42), '{{0}}'.format(), 'no fields'.format(1))
+    print('{:}|{}|{}'.format(None, True, (1, [2])), '{}{}'.format('', ''))
+
+# more templates than cache entries, used in turn, so they evict each other
+templates = ['t%d {} {:>3} %d' % (i, i) for i in range(20)]
+out = []
+for r in range(3):
+    for t in templates:
+        out.append(t.format(r, 'x'))
+print(out[:3], out[-1], len(set(out)))
+
+# templates built at run time
+t = ''.join(['{', '}', '+', '{', ':', '0', '3', '}'])
+print(t.format(1, 2), t.format('a', 3))
+
+# templates left to the full parser, each twice
+for i in range(2):
+    print('{a}{b}{a}'.format(a=1, b=2))
+    print('{:{}}|{:>{w}}'.format(1, 4, 2, w=3))
+    print('{}{}{}{}{}{}{}{}{}{}{}{}'.format(*range(12)))
+    print('{0}{1}{2}{3}{4}{5}{6}{7}{8}{9}'.format(*'abcdefghij'))
+
+# wrong templates are rejected each time
+for t, args in (('{} {0}', (1, 2)), ('{0} {}', (1, 2)), ('{} {}', (1,)), ('{3}', (1,)),
+                ('{', ()), ('}', ()), ('{0!x}', (1,)), ('{:d}', ('s',)), ('{:s}', (1,)),
+                ('a}b', ())):
+    for i in range(2):
+        try:
+            print(t.format(*args))
+        except (ValueError, IndexError, KeyError) as e:
+            print(t, type(e).__name__)
+
+# % formatting with and without width and precision
+print('%s|%r|%5s|%-5s|%.2s|%s' % ('a', 'a', 'b', 'c', 'def', p))
+print('%d %5d %-5d| %x %o %c' % (1, 2, 3, 255, 8, 65))
+print('%(a)s %(b)r' % {'a': 1, 'b': 'x'})
@@ -0,0 +1,54 @@
+# Builds dicts and OrderedDicts of str keys, looks every key up, then
+# deletes every key in the order they were added, and reports the time taken
+# and the heap used by each.  Run it on builds with
+# and without MICROPY_OPT_MAP_CACHED_HASHES to compare, eg:
+#     ../host/micropython bench/dict_build.py
+#     ../host/micropython-nohash bench/dict_build.py
+
+import gc
+import utime
+from ucollections import OrderedDict
+
+N = 10000
+KEYS = ['telemetry_%d' % i for i in range(N)]
+
+
+def build(d):
+    for k in KEYS:
+        d[k] = 1
+    return d
+
+
+def lookup(d):
+    n = 0
+    for k in KEYS:
+        n += d[k]
+    return n
+
+
+def remove(d):
+    for k in KEYS:
+        del d[k]
+    return len(d)
+
+
+def run(name, new):
+    gc.collect()
+    m0 = gc.mem_alloc()
+    t0 = utime.ticks_us()
+    d = build(new())
+    t1 = utime.ticks_us()
+    assert lookup(d) == N
+    t2 = utime.ticks_us()
+    gc.collect()
+    m1 = gc.mem_alloc()
+    t3 = utime.ticks_us()
+    assert remove(d) == 0
+    t4 = utime.ticks_us()
+    print('%-12s build %7dus  lookup %7dus  remove %7dus  heap %7d bytes' % (
+        name, utime.ticks_diff(t1, t0), utime.ticks_diff(t2, t1),
+        utime.ticks_diff(t4, t3), m1 - m0))
+
+
+run('dict', dict)
+run('OrderedDict', OrderedDict)
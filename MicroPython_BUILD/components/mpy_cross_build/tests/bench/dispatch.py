@@ -0,0 +1,75 @@
+# Times loops typical of sensor processing, made of the instruction sequences
+# that the bytecode emitter fuses into superinstructions: a local and a small
+# int in a binary op, a comparison followed by a jump, and an attribute or
+# method of a local.  Run it on builds with and without
+# MICROPY_OPT_FUSE_BYTECODE to compare, eg:
+#     ../host/micropython bench/dispatch.py
+#     ../host/micropython-nofuse bench/dispatch.py
+
+import utime
+
+N = 100000
+ROUNDS = 5
+
+
+class Sensor:
+    def __init__(self):
+        self.raw = 0
+        self.scale = 3
+        self.offset = -7
+
+    def read(self):
+        self.raw = (self.raw + 13) & 1023
+        return self.raw
+
+
+def count(n):
+    # counting up and down, compared against a bound
+    i = 0
+    j = n
+    while i < n:
+        i = i + 1
+        j -= 1
+    return i + j
+
+
+def threshold(n):
+    # classifying readings with comparisons and jumps
+    low = high = 0
+    x = 0
+    for i in range(n):
+        x = (x + 37) & 1023
+        if x < 100:
+            low += 1
+        elif x > 900:
+            high += 1
+    return low, high
+
+
+def average(n):
+    # a moving average over readings scaled by attributes of a local
+    s = Sensor()
+    acc = 0
+    for i in range(n):
+        v = s.read() * s.scale + s.offset
+        acc = acc + v - (acc >> 3)
+        if acc > 100000:
+            acc = 0
+    return acc
+
+
+def run(name, f):
+    # the best of a few rounds, as the others are slowed down by other work
+    best = None
+    for r in range(ROUNDS):
+        t0 = utime.ticks_us()
+        f(N)
+        t = utime.ticks_diff(utime.ticks_us(), t0)
+        if best is None or t < best:
+            best = t
+    print('%-10s %7dus' % (name, best))
+
+
+run('count', count)
+run('threshold', threshold)
+run('average', average)
@@ -0,0 +1,46 @@
+# Fills the heap with tuples of which every other one is then dropped, which
+# leaves it full of holes of the size of a tuple, and reports the time to
+# allocate ALLOCS such tuples after each gc.collect().  ALLOCS is well above
+# MICROPY_GC_FREE_LIST_DEPTH.  Run it on builds with and without
+# MICROPY_GC_FREE_LISTS to compare, eg:
+#     ../host/micropython -X heapsize=4m bench/gc_alloc.py
+#     ../host/micropython-nofree -X heapsize=4m bench/gc_alloc.py
+
+import gc
+import utime
+
+ALLOCS = 1000
+ROUNDS = 20
+FILL = 0.95
+
+
+def item(i):
+    # a tuple of 10 items takes 3 GC blocks on 32- and 64-bit builds
+    return (i, i, i, i, i, i, i, i, i, i)
+
+
+def fragment(budget):
+    live = []
+    i = 0
+    while gc.mem_alloc() < budget:
+        for _ in range(1000):
+            live.append(item(i))
+            i += 1
+    for i in range(0, len(live), 2):
+        live[i] = None
+    return live
+
+
+new = [None] * ALLOCS
+times = [0] * ROUNDS
+gc.collect()
+live = fragment(int((gc.mem_alloc() + gc.mem_free()) * FILL))
+for r in range(ROUNDS):
+    gc.collect()
+    t0 = utime.ticks_us()
+    for i in range(ALLOCS):
+        new[i] = item(i)
+    times[r] = utime.ticks_diff(utime.ticks_us(), t0)
+times.sort()
+print('%d allocations after each gc.collect(): min %dus  median %dus  max %dus' % (
+    ALLOCS, times[0], times[len(times) // 2], times[-1]))
@@ -0,0 +1,91 @@
+# Fills most of the heap with small live objects and reports the pause of
+# gc.collect() over several runs.  Run it on builds with and without
+# MICROPY_GC_PARALLEL_MARK and a large heap to compare, eg:
+#     ../host/micropython -X heapsize=64m bench/gc_pause.py
+#     ../host/micropython-parmark -X heapsize=64m bench/gc_pause.py
+# The objects hang off a root list in lists of 100 ("wide", the default), or
+# in linked chains of 20000 ("deep", given as an argument), which overflow
+# the GC stack.
+# On a MICROPY_GC_INCREMENTAL build it also runs cycles of
+# gc.collect(budget_us=STEP_US) while the live objects are being replaced,
+# and reports the longest step, which is the one that ends the marking:
+#     ../host/micropython-incr -X heapsize=64m bench/gc_pause.py
+
+import gc
+import sys
+import utime
+
+FILL = 0.6
+RUNS = 15
+STEP_US = 500
+DEEP = len(sys.argv) > 1 and sys.argv[1] == 'deep'
+
+
+def node(i, link):
+    # a list, a tuple, a str and a float: four blocks with pointers between them
+    return [i, (i, 'n%d' % i), i * 0.5, link]
+
+
+def fill(budget):
+    root = []
+    group = None if DEEP else []
+    i = 0
+    while gc.mem_alloc() < budget:
+        for _ in range(2000):
+            if DEEP:
+                group = node(i, group)
+            else:
+                group.append(node(i, None))
+            i += 1
+            if i % (20000 if DEEP else 100) == 0:
+                root.append(group)
+                group = None if DEEP else []
+    root.append(group)
+    return root, i
+
+
+gc.collect()
+live, n = fill(int((gc.mem_alloc() + gc.mem_free()) * FILL))
+gc.collect()
+times = []
+for _ in range(RUNS):
+    t0 = utime.ticks_us()
+    gc.collect()
+    times.append(utime.ticks_diff(utime.ticks_us(), t0))
+times.sort()
+print('%s: %d nodes, %d bytes live' % ('deep' if DEEP else 'wide', n, gc.mem_alloc()))
+print('gc.collect() min %dus  median %dus  max %dus' % (
+    times[0], times[len(times) // 2], times[-1]))
+
+
+def churn(live, i):
+    # replace one group of live objects, and make some garbage
+    if DEEP:
+        group = None
+        for j in range(200):
+            group = node(j, group)
+    else:
+        group = [node(j, None) for j in range(100)]
+    live[i % len(live)] = group
+
+
+try:
+    gc.collect(budget_us=STEP_US)
+except TypeError:
+    # not an incremental build
+    sys.exit()
+gc.collect()
+steps = []
+i = 0
+for _ in range(RUNS // 5):
+    while True:
+        churn(live, i)
+        i += 1
+        t0 = utime.ticks_us()
+        done = gc.collect(budget_us=STEP_US)
+        steps.append(utime.ticks_diff(utime.ticks_us(), t0))
+        if done:
+            break
+steps.sort()
+print('gc.collect(budget_us=%d) %d steps  median %dus  max %dus' % (
+    STEP_US, len(steps), steps[len(steps) // 2], steps[-1]))
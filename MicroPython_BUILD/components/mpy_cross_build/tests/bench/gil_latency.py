@@ -0,0 +1,82 @@
+# Measures how the GIL is handed between threads, on builds with the switch
+# interval (the default) and with the old MICROPY_PY_THREAD_GIL_VM_DIVISOR:
+#     ../host/micropython bench/gil_latency.py
+#     ../host/micropython-divisor bench/gil_latency.py
+# - handoff: a priority 2 thread sleeps 2 ms at a time while a priority 1
+#   thread keeps the VM busy; the latency is how late it runs again.
+# - fairness: two priority 1 threads both keep the VM busy for a second; it
+#   reports how far each got and the longest it went without the GIL.
+# Priorities above 0 are real-time ones on the host, which preempt and share
+# the CPU like FreeRTOS task priorities, if the process may use them.  Linux
+# time-slices them every 100 ms, FreeRTOS on the ESP32 every tick (1 ms); as root,
+#     echo 1 > /proc/sys/kernel/sched_rr_timeslice_ms
+# makes the host closer.
+
+import sys
+import _thread
+import utime
+import threadprio
+
+SAMPLES = 200
+SLEEP_MS = 2
+SPIN_MS = 1000
+
+
+def percentiles(v):
+    v.sort()
+    return 'min %dus  median %dus  99%% %dus  max %dus' % (
+        v[0], v[len(v) // 2], v[len(v) * 99 // 100], v[-1])
+
+
+def spin(prio, start, until, done):
+    threadprio.set(prio)
+    n = 0
+    t_last = start
+    gap = 0
+    while utime.ticks_diff(until, utime.ticks_ms()) > 0:
+        n += 1
+        t = utime.ticks_us()
+        gap = max(gap, utime.ticks_diff(t, t_last))
+        t_last = t
+    gap = max(gap, utime.ticks_diff(utime.ticks_us(), t_last))
+    done.put((n, gap))
+
+
+def handoff():
+    lat = []
+    done = _thread.Channel(1)
+    until = utime.ticks_add(utime.ticks_ms(), SAMPLES * SLEEP_MS * 2 + 500)
+    _thread.start_new_thread('spin', spin, (1, utime.ticks_us(), until, done))
+    utime.sleep_ms(50)
+    threadprio.set(2)
+    for _ in range(SAMPLES):
+        t0 = utime.ticks_us()
+        utime.sleep_ms(SLEEP_MS)
+        lat.append(utime.ticks_diff(utime.ticks_us(), t0) - SLEEP_MS * 1000)
+    threadprio.set(0)
+    done.get()
+    print('handoff:  ' + percentiles(lat))
+
+
+def fairness():
+    done = _thread.Channel(2)
+    # threads start with the priority of the one starting them
+    threadprio.set(1)
+    start = utime.ticks_us()
+    until = utime.ticks_add(utime.ticks_ms(), SPIN_MS)
+    for i in range(2):
+        _thread.start_new_thread('spin%d' % i, spin, (1, start, until, done))
+    res = [done.get() for _ in range(2)]
+    threadprio.set(0)
+    total = res[0][0] + res[1][0]
+    print('fairness: shares %d%% / %d%%  longest wait %dms / %dms' % (
+        res[0][0] * 100 // total, res[1][0] * 100 // total,
+        res[0][1] // 1000, res[1][1] // 1000))
+
+
+if hasattr(sys, 'getswitchinterval'):
+    print('switch interval %dus' % (sys.getswitchinterval() * 1000000))
+else:
+    print('GIL released every 32 jump-loops')
+handoff()
+fairness()
@@ -0,0 +1,56 @@
+# Times big-integer modular exponentiation with 2048-bit and 1024-bit operands,
+# as in the pairing protocol, with odd and even moduli, and a large multiply
+# and power.  Run it on builds with and without MICROPY_OPT_MPZ_KARATSUBA and
+# MICROPY_OPT_MPZ_POW3 to compare, eg:
+#     ../host/micropython bench/mpz_pow.py
+#     ../host/micropython-oldmpz bench/mpz_pow.py
+
+import utime
+
+ROUNDS = 3
+
+seed = 1
+
+
+def rand_bits(bits):
+    # a fixed sequence of numbers with the top bit set, from an LCG
+    global seed
+    n = 0
+    for i in range(0, bits, 16):
+        seed = (seed * 1103515245 + 12345) & 0x7fffffff
+        n = n << 16 | seed >> 15
+    n >>= (bits + 15) // 16 * 16 - bits
+    return n | 1 << (bits - 1)
+
+
+def operands(bits, odd):
+    m = rand_bits(bits)
+    m = m | 1 if odd else m & ~1
+    return rand_bits(bits) % m, rand_bits(bits), m
+
+
+OPERANDS = {
+    'pow 2048 odd': operands(2048, True),
+    'pow 2048 even': operands(2048, False),
+    'pow 1024 odd': operands(1024, True),
+    'pow 1024 even': operands(1024, False),
+}
+BIG = rand_bits(65536), rand_bits(65536)
+
+
+def run(name, f, *args):
+    # the best of a few rounds, as the others are slowed down by other work
+    best = None
+    for r in range(ROUNDS):
+        t0 = utime.ticks_us()
+        f(*args)
+        t = utime.ticks_diff(utime.ticks_us(), t0)
+        if best is None or t < best:
+            best = t
+    print('%-14s %8dus' % (name, best))
+
+
+for name in sorted(OPERANDS):
+    run(name, pow, *OPERANDS[name])
+run('mul 65536', lambda a, b: a * b, *BIG)
+run('3 ** 100000', lambda e: 3 ** e, 100000)
@@ -0,0 +1,132 @@
+# A sensor driver module for bench/qstr_lookup.py to import: a typical mix of
+# register constants, a class with methods and a few helpers, so that
+# compiling it interns the names a real driver module does.
+
+REG_WHO_AM_I = 0x0f
+REG_CTRL1 = 0x20
+REG_CTRL2 = 0x21
+REG_CTRL3 = 0x22
+REG_STATUS = 0x27
+REG_OUT_X_L = 0x28
+REG_OUT_Y_L = 0x2a
+REG_OUT_Z_L = 0x2c
+REG_FIFO_CTRL = 0x2e
+REG_FIFO_SRC = 0x2f
+REG_INT1_CFG = 0x30
+REG_INT1_THS = 0x32
+REG_INT1_DURATION = 0x33
+
+RATE_OFF = 0
+RATE_1HZ = 1
+RATE_10HZ = 2
+RATE_25HZ = 3
+RATE_50HZ = 4
+RATE_100HZ = 5
+RATE_200HZ = 6
+RATE_400HZ = 7
+
+RANGE_2G = 0
+RANGE_4G = 1
+RANGE_8G = 2
+RANGE_16G = 3
+
+SENSITIVITY = {RANGE_2G: 1, RANGE_4G: 2, RANGE_8G: 4, RANGE_16G: 12}
+
+
+class DriverError(Exception):
+    pass
+
+
+def to_signed(value, bits=16):
+    if value & (1 << (bits - 1)):
+        value -= 1 << bits
+    return value
+
+
+def average(samples):
+    if not samples:
+        return 0
+    return sum(samples) // len(samples)
+
+
+class Accelerometer:
+    def __init__(self, bus, address=0x19, rate=RATE_100HZ, range=RANGE_2G):
+        self.bus = bus
+        self.address = address
+        self.buffer = bytearray(6)
+        self.calibration = [0, 0, 0]
+        self.fifo_enabled = False
+        self.interrupt_handler = None
+        self.check_identity()
+        self.set_rate(rate)
+        self.set_range(range)
+
+    def read_register(self, register):
+        return self.bus.readfrom_mem(self.address, register, 1)[0]
+
+    def write_register(self, register, value):
+        self.bus.writeto_mem(self.address, register, bytes((value,)))
+
+    def check_identity(self):
+        identity = self.read_register(REG_WHO_AM_I)
+        if identity != 0x33:
+            raise DriverError('unexpected identity 0x%02x' % identity)
+
+    def set_rate(self, rate):
+        ctrl = self.read_register(REG_CTRL1) & 0x0f
+        self.write_register(REG_CTRL1, ctrl | (rate << 4))
+        self.rate = rate
+
+    def set_range(self, range):
+        ctrl = self.read_register(REG_CTRL3) & 0xcf
+        self.write_register(REG_CTRL3, ctrl | (range << 4))
+        self.range = range
+        self.sensitivity = SENSITIVITY[range]
+
+    def data_ready(self):
+        return bool(self.read_register(REG_STATUS) & 0x08)
+
+    def acceleration(self):
+        self.bus.readfrom_mem_into(self.address, REG_OUT_X_L | 0x80, self.buffer)
+        buf = self.buffer
+        x = to_signed(buf[0] | buf[1] << 8) >> 4
+        y = to_signed(buf[2] | buf[3] << 8) >> 4
+        z = to_signed(buf[4] | buf[5] << 8) >> 4
+        cal = self.calibration
+        scale = self.sensitivity
+        return ((x - cal[0]) * scale, (y - cal[1]) * scale, (z - cal[2]) * scale)
+
+    def calibrate(self, count=16):
+        totals = [[], [], []]
+        for i in range(count):
+            while not self.data_ready():
+                pass
+            for axis, value in enumerate(self.acceleration()):
+                totals[axis].append(value)
+        self.calibration = [average(t) for t in totals]
+
+    def enable_fifo(self, mode=0x80):
+        self.write_register(REG_FIFO_CTRL, mode)
+        self.fifo_enabled = True
+
+    def fifo_level(self):
+        return self.read_register(REG_FIFO_SRC) & 0x1f
+
+    def read_fifo(self):
+        if not self.fifo_enabled:
+            raise DriverError('fifo not enabled')
+        return [self.acceleration() for i in range(self.fifo_level())]
+
+    def set_interrupt(self, threshold, duration, handler):
+        self.write_register(REG_INT1_THS, threshold & 0x7f)
+        self.write_register(REG_INT1_DURATION, duration & 0x7f)
+        self.write_register(REG_INT1_CFG, 0x2a)
+        self.interrupt_handler = handler
+
+    def handle_interrupt(self, pin):
+        if self.interrupt_handler is not None:
+            self.interrupt_handler(self.acceleration())
+
+    def deinit(self):
+        self.set_rate(RATE_OFF)
+        self.interrupt_handler = None
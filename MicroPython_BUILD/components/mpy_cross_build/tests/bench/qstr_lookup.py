@@ -0,0 +1,74 @@
+# Times what looks names up in the qstr pools: importing a driver module,
+# which interns every name in it as it is compiled, and getattr/hasattr/setattr
+# with names built at run time, which are looked up on every call.  Run it on
+# builds with and without MICROPY_OPT_QSTR_INDEX to compare, eg:
+#     ../host/micropython bench/qstr_lookup.py
+#     ../host/micropython-noqidx bench/qstr_lookup.py
+
+import sys
+import utime
+
+N = 200
+ROUNDS = 5
+
+# qstr_driver.py is next to this file
+sys.path.insert(0, sys.argv[0].rsplit('/', 1)[0] if '/' in sys.argv[0] else '')
+
+
+class Record:
+    pass
+
+
+# Each name is formatted at run time, as a new str is looked up in the qstr
+# pools to see whether it is already interned: names in the ROM pool, names
+# interned by this script and names that are not attributes
+ROM_NAMES = [('app', 'end'), ('ext', 'end'), ('ins', 'ert'), ('rem', 'ove'),
+             ('ind', 'ex'), ('cou', 'nt'), ('so', 'rt'), ('rev', 'erse')]
+FIELDS = 64
+
+
+def import_driver(n):
+    for i in range(n):
+        sys.modules.pop('qstr_driver', None)
+        import qstr_driver
+
+
+def getattr_rom(n):
+    l = []
+    for i in range(n):
+        for name in ROM_NAMES:
+            getattr(l, '%s%s' % name)
+
+
+def getattr_fields(n):
+    r = Record()
+    for j in range(FIELDS):
+        setattr(r, 'field_%d' % j, 0)
+    for i in range(n):
+        for j in range(FIELDS):
+            getattr(r, 'field_%d' % j)
+
+
+def hasattr_missing(n):
+    r = Record()
+    for i in range(n):
+        for j in range(FIELDS):
+            hasattr(r, 'missing_%d' % j)
+
+
+def run(name, f, n):
+    # the best of a few rounds, as the others are slowed down by other work
+    best = None
+    for r in range(ROUNDS):
+        t0 = utime.ticks_us()
+        f(n)
+        t = utime.ticks_diff(utime.ticks_us(), t0)
+        if best is None or t < best:
+            best = t
+    print('%-16s %7dus' % (name, best))
+
+
+run('import', import_driver, N)
+run('getattr rom', getattr_rom, 8 * N)
+run('getattr fields', getattr_fields, N)
+run('hasattr missing', hasattr_missing, N)
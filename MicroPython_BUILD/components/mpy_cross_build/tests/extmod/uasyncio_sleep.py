@@ -0,0 +1,51 @@
+# When no task is ready the _uasyncio loop sleeps, with the GIL released,
+# until the first timer is due or a stream it waits on gets ready: another
+# thread runs meanwhile, and the tasks wake in order.
+
+try:
+    import _uasyncio
+    import _thread
+    import hostio
+except ImportError:
+    print('SKIP')
+    raise SystemExit
+import utime
+
+r, w = hostio.pipe()
+loop = _uasyncio.Loop()
+count = [0]
+done = [False]
+
+
+def counter():
+    while not done[0]:
+        count[0] += 1
+
+
+def sleeper():
+    t = utime.ticks_ms()
+    n = count[0]
+    yield 50
+    print('slept', utime.ticks_diff(utime.ticks_ms(), t) >= 50, count[0] > n)
+
+
+def writer():
+    yield 100
+    print('write')
+    w.write(b'hi')
+
+
+def reader():
+    n = count[0]
+    yield loop.wait_read(r)
+    print('read', r.read(10), count[0] > n)
+
+
+_thread.start_new_thread('counter', counter, ())
+loop.create_task(sleeper())
+loop.create_task(writer())
+loop.create_task(reader())
+loop.run_forever()
+done[0] = True
+r.close()
+w.close()
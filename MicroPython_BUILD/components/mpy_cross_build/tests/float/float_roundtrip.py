@@ -0,0 +1,14 @@
+# Round trip random doubles and decimal strings through the float formatter
+# and parser, checking them against the C library.  The count can be given
+# on the command line; the default takes around 15 seconds.
+
+try:
+    import floatcheck
+except ImportError:
+    print('SKIP')
+    raise SystemExit
+
+import sys
+
+n = int(sys.argv[1]) if len(sys.argv) > 1 else 2000000
+print(floatcheck.roundtrip(n, 20180101))
@@ -0,0 +1,41 @@
+# A thread killed while it waits in Channel.get() must be taken off the
+# channel, as its waiter is on the stack that goes with it: the items put
+# afterwards have to reach the thread still waiting, and nothing else.
+
+try:
+    import _thread
+    _thread.Channel
+except (ImportError, AttributeError):
+    print('SKIP')
+    raise SystemExit
+import utime
+
+ch = _thread.Channel(1)
+got = _thread.Channel(4)
+
+
+def getter(name):
+    got.put((name, ch.get()))
+
+
+def scribble(n):
+    # reuses the killed thread's stack, if the system hands it out again
+    if n:
+        scribble(n - 1)
+    else:
+        got.put(('scribble', None))
+
+
+victim = _thread.start_new_thread('victim', getter, ('victim',))
+utime.sleep_ms(50)
+_thread.start_new_thread('waiter', getter, ('waiter',))
+utime.sleep_ms(50)
+print(_thread.kill(victim))
+utime.sleep_ms(50)
+_thread.start_new_thread('scribble', scribble, (50,))
+print(got.get(1000))
+
+ch.put(0)
+print(got.get(1000))
+ch.put(1)
+print(len(ch), ch.get(0))
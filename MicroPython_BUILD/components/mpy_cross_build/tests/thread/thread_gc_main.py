@@ -0,0 +1,39 @@
+# Collections made by other threads must see what the main thread's stack
+# holds while it waits: workers collect and then allocate over anything that
+# was freed, and the main thread's code, locals and objects must be intact
+# when it carries on.
+
+try:
+    import _thread
+except ImportError:
+    print('SKIP')
+    raise SystemExit
+import gc
+import utime
+
+WORKERS = 4
+done = []
+
+
+def worker(i):
+    n = 0
+    for j in range(200):
+        if j % 20 == 0:
+            gc.collect()
+        n += len([i, j] * 8)
+    done.append((i, n))
+
+
+def main():
+    # only held by this frame, which waits in sleep_ms or the loop below
+    local = [('main', k, 'm%d' % k) for k in range(50)]
+    for i in range(WORKERS):
+        _thread.start_new_thread('worker%d' % i, worker, (i,))
+    while len(done) < WORKERS:
+        utime.sleep_ms(5)
+    return all(x == ('main', k, 'm%d' % k) for k, x in enumerate(local))
+
+
+print(main())
+done.sort()
+print(done)
@@ -0,0 +1,44 @@
+# Callbacks scheduled from several threads at once all run, in the order
+# each thread queued them, and a thread that finds the queue full can retry.
+
+try:
+    import _thread
+    import micropython
+    micropython.schedule_stats
+except (ImportError, AttributeError):
+    print('SKIP')
+    raise SystemExit
+import utime
+
+THREADS = 4
+N = 100
+
+ran = []
+done = []
+
+
+def cb(arg):
+    ran.append(arg)
+
+
+def producer(t):
+    full = 0
+    for i in range(N):
+        while True:
+            try:
+                micropython.schedule(cb, (t, i), priority=t & 1)
+                break
+            except RuntimeError:
+                full += 1
+                utime.sleep_ms(1)
+    done.append(t)
+
+
+for t in range(THREADS):
+    _thread.start_new_thread('producer%d' % t, producer, (t,))
+while len(done) < THREADS or micropython.schedule_stats()[0]:
+    utime.sleep_ms(1)
+
+print(len(ran))
+for t in range(THREADS):
+    print(t, [i for u, i in ran if u == t] == list(range(N)))
@@ -0,0 +1,66 @@
+# Threads that wait in a blocking stream read must not hold the GIL: a
+# writer thread feeds several pipes slowly, and while their readers wait a
+# busy thread has to keep most of the throughput it has on its own, and the
+# reads have to overlap instead of running one after another.
+
+try:
+    import _thread
+    import hostio
+    hostio.pipe(True)
+except (ImportError, AttributeError, TypeError):
+    print('SKIP')
+    raise SystemExit
+import utime
+
+READERS = 4
+CHUNKS = 20
+CHUNK = 16
+DELAY_MS = 5
+
+pipes = [hostio.pipe(True) for i in range(READERS)]
+received = []
+
+
+def reader(i):
+    r = pipes[i][0]
+    data = b''
+    for j in range(CHUNKS):
+        data += r.read(CHUNK)
+    received.append((i, data))
+
+
+def writer():
+    for j in range(CHUNKS):
+        for i in range(READERS):
+            pipes[i][1].write(bytes([i * CHUNKS + j]) * CHUNK)
+        utime.sleep_ms(DELAY_MS)
+
+
+def busy(ms):
+    # loop iterations per ms, for the given time or until the readers are done
+    n = 0
+    t0 = utime.ticks_ms()
+    while utime.ticks_diff(utime.ticks_ms(), t0) < ms and len(received) < READERS:
+        n += 1
+    return n / max(1, utime.ticks_diff(utime.ticks_ms(), t0))
+
+
+alone = busy(CHUNKS * DELAY_MS)
+
+for i in range(READERS):
+    _thread.start_new_thread('reader%d' % i, reader, (i,))
+utime.sleep_ms(20)
+t0 = utime.ticks_ms()
+_thread.start_new_thread('writer', writer, ())
+shared = busy(100 * CHUNKS * DELAY_MS)
+elapsed = utime.ticks_diff(utime.ticks_ms(), t0)
+while len(received) < READERS:
+    utime.sleep_ms(10)
+
+received.sort()
+print([i for i, data in received])
+print(all(data == b''.join(bytes([i * CHUNKS + j]) * CHUNK for j in range(CHUNKS)) for i, data in received))
+# the readers wait for the writer's delays together
+print(elapsed < 2 * CHUNKS * DELAY_MS)
+# and the busy thread runs meanwhile
+print(shared > alone / 2)
@@ -0,0 +1,9 @@
+# calls, attributes, constants and arguments of native functions
+
+def f(a, b):
+    x = a + b
+    print(x, None, True, 'hi', 1.5)
+    return x
+
+def g(a):
+    return a.attr
@@ -0,0 +1,7 @@
+# exception handlers use a setjmp based nlr_buf_t on the ESP32
+
+def f(a):
+    try:
+        return a[0]
+    except IndexError:
+        return None
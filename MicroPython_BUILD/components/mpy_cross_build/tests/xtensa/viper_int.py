@@ -0,0 +1,10 @@
+# integer arithmetic and pointers in viper functions
+
+@micropython.viper
+def add1(a: int) -> int:
+    return a + 1
+
+@micropython.viper
+def first(buf) -> int:
+    p = ptr8(buf)
+    return p[0]